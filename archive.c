@@ -0,0 +1,445 @@
+#include "archive.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define LINE_END_CHARS "\r\n"
+
+/* archive receiving output files, NULL when they go to the disk */
+static output_archive *active_archive = NULL;
+
+/**
+ * init_archive - set an archive to the empty state
+ * @param archive: archive to initialize
+ * @param path: archive file
+ */
+static void init_archive(output_archive *archive, const char *path) {
+    archive->path = path;
+    archive->file = NULL;
+    archive->entries = NULL;
+    archive->last = NULL;
+    archive->count = 0;
+    archive->pending = NULL;
+    archive->failed = NO;
+}
+
+/**
+ * free_list - release a list of entries, closing pending scratch streams
+ * @param entry: first entry, may be NULL
+ */
+static void free_list(archive_entry *entry) {
+    archive_entry *next;
+
+    for (; entry; entry = next) {
+        next = entry->next;
+        if (entry->pending) fclose(entry->pending);
+        free(entry->name);
+        free(entry);
+    }
+}
+
+/**
+ * free_entries - release every stored and pending entry
+ * @param archive: archive
+ */
+static void free_entries(output_archive *archive) {
+    free_list(archive->entries);
+    free_list(archive->pending);
+    archive->entries = NULL;
+    archive->last = NULL;
+    archive->count = 0;
+    archive->pending = NULL;
+}
+
+/**
+ * new_entry - allocate an entry that is in no list yet
+ * @param name: output file name
+ * @return new entry, or NULL on allocation failure
+ */
+static archive_entry *new_entry(const char *name) {
+    archive_entry *entry = malloc(sizeof(archive_entry));
+
+    if (!entry || !(entry->name = build_filename(name, ""))) {
+        fprintf(stderr, MALLOC_FAILED);
+        free(entry);
+        return NULL;
+    }
+    entry->offset = 0;
+    entry->length = 0;
+    entry->pending = NULL;
+    entry->next = NULL;
+    return entry;
+}
+
+/**
+ * store_entry - append an entry to the archive order
+ * @param archive: archive
+ * @param entry: entry to append, in no other list
+ */
+static void store_entry(output_archive *archive, archive_entry *entry) {
+    entry->next = NULL;
+    if (archive->last) {
+        archive->last->next = entry;
+    } else {
+        archive->entries = entry;
+    }
+    archive->last = entry;
+    archive->count++;
+}
+
+/**
+ * add_pending - append an entry to the outputs of the current source
+ * the list holds only a few files, so it is walked to its end
+ * @param archive: archive
+ * @param entry: entry to append, in no other list
+ */
+static void add_pending(output_archive *archive, archive_entry *entry) {
+    archive_entry **link = &archive->pending;
+
+    while (*link) link = &(*link)->next;
+    entry->next = NULL;
+    *link = entry;
+}
+
+/**
+ * remove_pending - unlink and free a pending entry
+ * @param archive: archive
+ * @param entry: entry to remove
+ */
+static void remove_pending(output_archive *archive, archive_entry *entry) {
+    archive_entry **link = &archive->pending;
+
+    while (*link && *link != entry) link = &(*link)->next;
+    if (!*link) return;
+    *link = entry->next;
+
+    if (entry->pending) fclose(entry->pending);
+    free(entry->name);
+    free(entry);
+}
+
+/**
+ * find_pending - find the entry still being written for an output file
+ * only the current source's outputs are searched, never the stored ones
+ * @param name: output file name
+ * @return entry, or NULL if no archive is open or the file is not pending
+ */
+static archive_entry *find_pending(const char *name) {
+    archive_entry *entry;
+
+    if (!active_archive) return NULL;
+    for (entry = active_archive->pending; entry; entry = entry->next) {
+        if (strcmp(entry->name, name) == 0) return entry;
+    }
+    return NULL;
+}
+
+/**
+ * find_stream - find the pending entry that owns a stream
+ * @param stream: stream from create_output or reopen_output
+ * @return entry, or NULL if the stream is a plain file
+ */
+static archive_entry *find_stream(const FILE *stream) {
+    archive_entry *entry;
+
+    if (!active_archive) return NULL;
+    for (entry = active_archive->pending; entry; entry = entry->next) {
+        if (entry->pending == stream) return entry;
+    }
+    return NULL;
+}
+
+/**
+ * open_archive - create an archive and send output files to it instead of the disk
+ * @param archive: archive to initialize
+ * @param path: archive file, replaced if it exists
+ * @return SUCCESS if created, FAILURE otherwise
+ */
+int open_archive(output_archive *archive, const char *path) {
+    init_archive(archive, path);
+
+    archive->file = fopen(path, FILE_WRITE_BINARY_MODE);
+    if (!archive->file) {
+        fprintf(stderr, ERROR_ARCHIVE_CREATE, path);
+        return FAILURE;
+    }
+    fprintf(archive->file, "%s %d\n", ARCHIVE_MAGIC, ARCHIVE_VERSION);
+
+    active_archive = archive;
+    return SUCCESS;
+}
+
+/**
+ * create_output - open an output file for writing
+ * with an archive open, the text goes to a scratch stream until commit_outputs
+ * @param filename: output file name
+ * @return stream to write, or NULL on failure; give it back with release_output
+ */
+FILE *create_output(const char *filename) {
+    archive_entry *entry;
+
+    if (!active_archive) return fopen(filename, FILE_WRITE_MODE);
+
+    /* writing a file again replaces what was written before */
+    entry = find_pending(filename);
+    if (entry) remove_pending(active_archive, entry);
+
+    entry = new_entry(filename);
+    if (!entry) return NULL;
+
+    /* tmpfile has no name to create on the output filesystem */
+    entry->pending = tmpfile();
+    if (!entry->pending) {
+        free(entry->name);
+        free(entry);
+        return NULL;
+    }
+    add_pending(active_archive, entry);
+    return entry->pending;
+}
+
+/**
+ * reopen_output - open an output file of the current source for reading
+ * @param filename: output file name
+ * @return stream positioned at the start, or NULL on failure; give it back with release_output
+ */
+FILE *reopen_output(const char *filename) {
+    archive_entry *entry = find_pending(filename);
+
+    if (!entry) return open_file_read(filename);
+    rewind(entry->pending);
+    return entry->pending;
+}
+
+/**
+ * release_output - finish with a stream from create_output or reopen_output
+ * scratch streams stay open until they are committed
+ * @param stream: stream to release
+ */
+void release_output(FILE *stream) {
+    if (!stream) return;
+    if (find_stream(stream)) {
+        fflush(stream);
+    } else {
+        fclose(stream);
+    }
+}
+
+/**
+ * discard_output - delete an output file that must not be kept
+ * @param filename: output file name
+ */
+void discard_output(const char *filename) {
+    archive_entry *entry = find_pending(filename);
+
+    if (entry) {
+        remove_pending(active_archive, entry);
+    } else {
+        remove(filename);
+    }
+}
+
+/**
+ * output_size - size of an output file written so far
+ * @param filename: output file name
+ * @return size in bytes, or -1 if there is no such output
+ */
+long output_size(const char *filename) {
+    archive_entry *entry = find_pending(filename);
+    FILE *file;
+    long size = -1;
+
+    if (entry) {
+        fflush(entry->pending);
+        if (fseek(entry->pending, 0L, SEEK_END) == 0) size = ftell(entry->pending);
+        return size;
+    }
+
+    file = fopen(filename, FILE_READ_BINARY_MODE);
+    if (!file) return -1;
+    if (fseek(file, 0L, SEEK_END) == 0) size = ftell(file);
+    fclose(file);
+    return size;
+}
+
+/**
+ * copy_stream - copy a stream to its end
+ * @param in: source stream
+ * @param out: destination stream
+ * @param limit: bytes to copy, or -1 for everything
+ * @return bytes copied, or -1 on a read or write error
+ */
+static long copy_stream(FILE *in, FILE *out, long limit) {
+    char buffer[ARCHIVE_COPY_BUFFER];
+    size_t want;
+    size_t n;
+    long copied = 0;
+
+    while (limit < 0 || copied < limit) {
+        want = sizeof(buffer);
+        if (limit >= 0 && (long)want > limit - copied) want = (size_t)(limit - copied);
+        n = fread(buffer, 1, want, in);
+        if (n == 0) break;
+        if (fwrite(buffer, 1, n, out) != n) return -1;
+        copied += (long)n;
+    }
+    if (ferror(in) || (limit >= 0 && copied < limit)) return -1;
+    return copied;
+}
+
+/**
+ * commit_outputs - append the pending output files to the archive
+ * called after each source, so scratch streams never outlive one file
+ * @return SUCCESS if stored (or no archive is open), FAILURE on a write error
+ */
+int commit_outputs(void) {
+    archive_entry *entry;
+    output_archive *archive = active_archive;
+
+    if (!archive) return SUCCESS;
+
+    while (archive->pending) {
+        entry = archive->pending;
+        archive->pending = entry->next;
+
+        rewind(entry->pending);
+        entry->offset = ftell(archive->file);
+        entry->length = copy_stream(entry->pending, archive->file, -1);
+        if (entry->offset < 0 || entry->length < 0) {
+            fprintf(stderr, ERROR_ARCHIVE_WRITE, archive->path);
+            archive->failed = YES;
+            entry->length = 0;
+        }
+        fclose(entry->pending);
+        entry->pending = NULL;
+        store_entry(archive, entry);
+    }
+    return archive->failed ? FAILURE : SUCCESS;
+}
+
+/**
+ * close_archive - store pending outputs, write the index and close the archive
+ * @param archive: archive to close
+ * @return SUCCESS if the archive is complete, FAILURE otherwise
+ */
+int close_archive(output_archive *archive) {
+    archive_entry *entry;
+    long index_offset;
+
+    commit_outputs();
+    if (active_archive == archive) active_archive = NULL;
+
+    index_offset = ftell(archive->file);
+    fprintf(archive->file, "%s %lu\n", ARCHIVE_INDEX_KEY, archive->count);
+    for (entry = archive->entries; entry; entry = entry->next) {
+        fprintf(archive->file, "%ld %ld %s\n", entry->offset, entry->length, entry->name);
+    }
+    fprintf(archive->file, ARCHIVE_TRAILER_FORMAT, (unsigned long)index_offset);
+
+    if (index_offset < 0 || ferror(archive->file)) archive->failed = YES;
+    if (fclose(archive->file) != 0) archive->failed = YES;
+    archive->file = NULL;
+    if (archive->failed) fprintf(stderr, ERROR_ARCHIVE_WRITE, archive->path);
+
+    free_entries(archive);
+    return archive->failed ? FAILURE : SUCCESS;
+}
+
+/**
+ * read_index - load the index of an open archive
+ * @param archive: archive with file open for reading
+ * @return SUCCESS if the index is intact, FAILURE otherwise
+ */
+static int read_index(output_archive *archive) {
+    char record[ARCHIVE_RECORD_LENGTH];
+    archive_entry *entry;
+    unsigned long index_offset;
+    unsigned long count;
+    unsigned long i;
+    long offset, length;
+    char *name;
+    char *end;
+    int version;
+
+    if (!fgets(record, sizeof(record), archive->file) ||
+        sscanf(record, ARCHIVE_MAGIC " %d", &version) != 1 || version != ARCHIVE_VERSION) {
+        return FAILURE;
+    }
+
+    /* the trailer has a fixed width, so it is found from the end */
+    if (fseek(archive->file, -(long)ARCHIVE_TRAILER_LENGTH, SEEK_END) != 0 ||
+        !fgets(record, sizeof(record), archive->file) ||
+        sscanf(record, ARCHIVE_TRAILER_KEY " %lu", &index_offset) != 1) {
+        return FAILURE;
+    }
+
+    if (fseek(archive->file, (long)index_offset, SEEK_SET) != 0 ||
+        !fgets(record, sizeof(record), archive->file) ||
+        sscanf(record, ARCHIVE_INDEX_KEY " %lu", &count) != 1) {
+        return FAILURE;
+    }
+
+    for (i = 0; i < count; i++) {
+        if (!fgets(record, sizeof(record), archive->file)) return FAILURE;
+
+        offset = strtol(record, &end, BASE_10);
+        length = strtol(end, &name, BASE_10);
+        if (name == end || *name != SPACE_CHAR || offset < 0 || length < 0 ||
+            (unsigned long)offset + (unsigned long)length > index_offset) {
+            return FAILURE;
+        }
+        name++;
+        name[strcspn(name, LINE_END_CHARS)] = NULL_CHAR;
+
+        entry = new_entry(name);
+        if (!entry) return FAILURE;
+        entry->offset = offset;
+        entry->length = length;
+        store_entry(archive, entry);
+    }
+    return SUCCESS;
+}
+
+/**
+ * read_archive - open an archive and load its index
+ * @param archive: archive to fill; release with free_archive
+ * @param path: archive file
+ * @return SUCCESS if loaded, FAILURE otherwise
+ */
+int read_archive(output_archive *archive, const char *path) {
+    init_archive(archive, path);
+
+    archive->file = fopen(path, FILE_READ_BINARY_MODE);
+    if (!archive->file) {
+        fprintf(stderr, ERROR_CANNOT_OPEN_FILE, path);
+        return FAILURE;
+    }
+
+    if (read_index(archive) == FAILURE) {
+        fprintf(stderr, ERROR_ARCHIVE_FORMAT, path);
+        free_archive(archive);
+        return FAILURE;
+    }
+    return SUCCESS;
+}
+
+/**
+ * copy_archive_entry - write the payload of a stored entry
+ * @param archive: archive opened with read_archive
+ * @param entry: entry to copy
+ * @param out: destination stream
+ * @return SUCCESS if copied, FAILURE otherwise
+ */
+int copy_archive_entry(const output_archive *archive, const archive_entry *entry, FILE *out) {
+    if (fseek(archive->file, entry->offset, SEEK_SET) != 0) return FAILURE;
+    return copy_stream(archive->file, out, entry->length) == entry->length ? SUCCESS : FAILURE;
+}
+
+/**
+ * free_archive - close an archive opened with read_archive and release its index
+ * @param archive: archive to free
+ */
+void free_archive(output_archive *archive) {
+    if (archive->file) fclose(archive->file);
+    archive->file = NULL;
+    free_entries(archive);
+}
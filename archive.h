@@ -0,0 +1,123 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <stdio.h>
+#include "utils.h"
+
+/* archive layout: a header line, the payloads back to back, an index line
+ * "index COUNT" followed by one "OFFSET LENGTH NAME" line per payload, and a
+ * fixed-width trailer holding the offset of the index */
+#define ARCHIVE_MAGIC "asmarchive"
+#define ARCHIVE_VERSION 1
+#define ARCHIVE_INDEX_KEY "index"
+#define ARCHIVE_TRAILER_KEY "trailer"
+#define ARCHIVE_TRAILER_FORMAT "trailer %010lu\n"
+#define ARCHIVE_TRAILER_LENGTH 19       /* "trailer " + 10 digits + newline */
+#define ARCHIVE_RECORD_LENGTH 1100      /* longest index line */
+#define ARCHIVE_COPY_BUFFER 4096
+
+/* error messages */
+#define ERROR_ARCHIVE_CREATE "Error: cannot create archive '%s'\n"
+#define ERROR_ARCHIVE_WRITE "Error: cannot write archive '%s'\n"
+#define ERROR_ARCHIVE_FORMAT "Error: '%s' is not an output archive\n"
+
+/* one output file stored in, or waiting to be stored in, the archive */
+typedef struct archive_entry {
+    char *name;                     /* output file name */
+    long offset;                    /* payload position in the archive */
+    long length;                    /* payload bytes */
+    FILE *pending;                  /* scratch stream until committed, NULL once stored */
+    struct archive_entry *next;     /* next stored entry, or next pending entry */
+} archive_entry;
+
+/* archive of the output files of a batch */
+typedef struct {
+    const char *path;               /* archive file */
+    FILE *file;                     /* open archive */
+    archive_entry *entries;         /* stored entries, in archive order */
+    archive_entry *last;            /* last stored entry, for appending */
+    unsigned long count;            /* stored entries */
+    archive_entry *pending;         /* outputs of the current source, emptied by commit_outputs */
+    int failed;                     /* YES after a write error */
+} output_archive;
+
+/**
+ * open_archive - create an archive and send output files to it instead of the disk
+ * @param archive: archive to initialize
+ * @param path: archive file, replaced if it exists
+ * @return SUCCESS if created, FAILURE otherwise
+ */
+int open_archive(output_archive *archive, const char *path);
+
+/**
+ * create_output - open an output file for writing
+ * with an archive open, the text goes to a scratch stream until commit_outputs
+ * @param filename: output file name
+ * @return stream to write, or NULL on failure; give it back with release_output
+ */
+FILE *create_output(const char *filename);
+
+/**
+ * reopen_output - open an output file of the current source for reading
+ * @param filename: output file name
+ * @return stream positioned at the start, or NULL on failure; give it back with release_output
+ */
+FILE *reopen_output(const char *filename);
+
+/**
+ * release_output - finish with a stream from create_output or reopen_output
+ * @param stream: stream to release
+ */
+void release_output(FILE *stream);
+
+/**
+ * discard_output - delete an output file that must not be kept
+ * @param filename: output file name
+ */
+void discard_output(const char *filename);
+
+/**
+ * output_size - size of an output file written so far
+ * @param filename: output file name
+ * @return size in bytes, or -1 if there is no such output
+ */
+long output_size(const char *filename);
+
+/**
+ * commit_outputs - append the pending output files to the archive
+ * called after each source, so scratch streams never outlive one file
+ * @return SUCCESS if stored (or no archive is open), FAILURE on a write error
+ */
+int commit_outputs(void);
+
+/**
+ * close_archive - store pending outputs, write the index and close the archive
+ * @param archive: archive to close
+ * @return SUCCESS if the archive is complete, FAILURE otherwise
+ */
+int close_archive(output_archive *archive);
+
+/**
+ * read_archive - open an archive and load its index
+ * @param archive: archive to fill; release with free_archive
+ * @param path: archive file
+ * @return SUCCESS if loaded, FAILURE otherwise
+ */
+int read_archive(output_archive *archive, const char *path);
+
+/**
+ * copy_archive_entry - write the payload of a stored entry
+ * @param archive: archive opened with read_archive
+ * @param entry: entry to copy
+ * @param out: destination stream
+ * @return SUCCESS if copied, FAILURE otherwise
+ */
+int copy_archive_entry(const output_archive *archive, const archive_entry *entry, FILE *out);
+
+/**
+ * free_archive - close an archive opened with read_archive and release its index
+ * @param archive: archive to free
+ */
+void free_archive(output_archive *archive);
+
+#endif /* ARCHIVE_H */
@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils.h"
+#include "archive.h"
+
+/* command line */
+#define MIN_ARGC 3
+#define COMMAND_ARG 1
+#define ARCHIVE_ARG 2
+#define FIRST_NAME_ARG 3
+#define COMMAND_LIST "list"
+#define COMMAND_EXTRACT "extract"
+#define COMMAND_CAT "cat"
+
+/* error messages */
+#define ERROR_UNKNOWN_COMMAND "Error: unknown command '%s'\n"
+#define ERROR_NOT_IN_ARCHIVE "Error: '%s' is not in the archive\n"
+#define ERROR_EXTRACT_FAILED "Error: cannot extract '%s'\n"
+
+/* usage messages */
+#define MSG_USAGE_FORMAT "Usage: %s list|extract|cat archive [file...]\n"
+#define MSG_DESCRIPTION "\nReads an archive written by 'assembler -o archive'.\n" \
+    "  list     print the size and name of every stored file\n" \
+    "  extract  write the named files (all files if none are named) to their paths\n" \
+    "  cat      print the named files to standard output\n"
+
+/**
+ * print usage information
+ * @param program_name: name of the executable program
+ */
+static void print_usage(const char *program_name) {
+    printf(MSG_USAGE_FORMAT, program_name);
+    printf(MSG_DESCRIPTION);
+}
+
+/**
+ * is_selected - check whether an entry was named on the command line
+ * @param name: entry name
+ * @param names: names given, or none to select everything
+ * @param count: number of names
+ * @return YES if selected, NO otherwise
+ */
+static int is_selected(const char *name, char **names, int count) {
+    int i;
+
+    if (count == 0) return YES;
+    for (i = 0; i < count; i++) {
+        if (strcmp(names[i], name) == 0) return YES;
+    }
+    return NO;
+}
+
+/**
+ * extract_entry - write one stored file to its path
+ * @param archive: open archive
+ * @param entry: entry to write
+ * @return SUCCESS if written, FAILURE otherwise
+ */
+static int extract_entry(const output_archive *archive, const archive_entry *entry) {
+    FILE *out = fopen(entry->name, FILE_WRITE_BINARY_MODE);
+    int result;
+
+    if (!out) {
+        fprintf(stderr, ERROR_CANNOT_OPEN_FILE_WRITE, entry->name);
+        return FAILURE;
+    }
+    result = copy_archive_entry(archive, entry, out);
+    if (fclose(out) != 0) result = FAILURE;
+    if (result == FAILURE) fprintf(stderr, ERROR_EXTRACT_FAILED, entry->name);
+    return result;
+}
+
+/**
+ * check_names - report names that are not in the archive
+ * @param archive: open archive
+ * @param names: names given
+ * @param count: number of names
+ * @return SUCCESS if every name is stored, FAILURE otherwise
+ */
+static int check_names(const output_archive *archive, char **names, int count) {
+    const archive_entry *entry;
+    int result = SUCCESS;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        for (entry = archive->entries; entry && strcmp(entry->name, names[i]) != 0; entry = entry->next) {
+        }
+        if (!entry) {
+            fprintf(stderr, ERROR_NOT_IN_ARCHIVE, names[i]);
+            result = FAILURE;
+        }
+    }
+    return result;
+}
+
+/**
+ * main
+ * @param argc: number of command line arguments
+ * @param argv: array of command line argument strings
+ * @return 0 on success, EXIT_FAILURE_CODE on failure
+ */
+int main(int argc, char *argv[]) {
+    output_archive archive;
+    const archive_entry *entry;
+    const char *command;
+    char **names;
+    int name_count;
+    int result;
+
+    if (argc < MIN_ARGC) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE_CODE;
+    }
+
+    command = argv[COMMAND_ARG];
+    if (strcmp(command, COMMAND_LIST) != 0 && strcmp(command, COMMAND_EXTRACT) != 0 &&
+        strcmp(command, COMMAND_CAT) != 0) {
+        fprintf(stderr, ERROR_UNKNOWN_COMMAND, command);
+        print_usage(argv[0]);
+        return EXIT_FAILURE_CODE;
+    }
+
+    if (read_archive(&archive, argv[ARCHIVE_ARG]) == FAILURE) return EXIT_FAILURE_CODE;
+
+    names = argv + FIRST_NAME_ARG;
+    name_count = argc - FIRST_NAME_ARG;
+    result = check_names(&archive, names, name_count);
+
+    /* a file written twice in one batch is stored twice; extracting keeps the later one */
+    for (entry = archive.entries; entry; entry = entry->next) {
+        if (!is_selected(entry->name, names, name_count)) continue;
+
+        if (strcmp(command, COMMAND_LIST) == 0) {
+            printf("%10ld %s\n", entry->length, entry->name);
+        } else if (strcmp(command, COMMAND_CAT) == 0) {
+            if (copy_archive_entry(&archive, entry, stdout) == FAILURE) {
+                fprintf(stderr, ERROR_EXTRACT_FAILED, entry->name);
+                result = FAILURE;
+            }
+        } else if (extract_entry(&archive, entry) == FAILURE) {
+            result = FAILURE;
+        }
+    }
+
+    free_archive(&archive);
+    return result == SUCCESS ? 0 : EXIT_FAILURE_CODE;
+}
@@ -6,6 +6,14 @@
 #include "first_pass.h"
 #include "second_pass.h"
 #include "labelTable.h"
+#include "global_symbols.h"
+#include "metrics.h"
+#include "conditional.h"
+#include "parse_cache.h"
+#include "line_memo.h"
+#include "archive.h"
+#include "optimizer.h"
+#include "ir_format.h"
 
 /* file extension*/
 #define AS_EXTENSION ".as"
@@ -17,28 +25,63 @@
 
 /* error messages */
 #define ERROR_NO_INPUT_FILES "Error: No input files specified\n\n"
-#define ERROR_INVALID_FILENAME "Error: Invalid filename '%s' (must end with .as)\n"
+#define ERROR_INVALID_FILENAME "Error: Invalid filename '%s' (must end with .as or .ir)\n"
+#define ERROR_IR_LOAD_FAILED "Error: Failed to load IR file '%s'\n"
 #define ERROR_BASE_FILENAME_FAILED "Error: Failed to extract base filename from '%s'\n"
+#define ERROR_MACRO_EXPANSION_FAILED "Error: Macro expansion failed for file '%s'\n"
 #define ERROR_FIRST_PASS_FAILED "Error: First pass failed for file '%s'\n"
 #define ERROR_SECOND_PASS_FAILED "Error: Second pass failed for file '%s'\n"
+#define ERROR_OPTIMIZER_FAILED "Error: Optimization failed for file '%s'\n"
+#define ERROR_UNKNOWN_OPTION "Error: Unknown option '%s'\n"
+#define ERROR_MISSING_OPTION_VALUE "Error: Option '%s' requires a value\n"
+#define ERROR_INVALID_MEMORY_BUDGET "Error: Invalid memory budget '%s' (minimum %d KB)\n"
+
+/* command line options */
+#define OPTION_PREFIX '-'
+#define OPTION_MEMORY_BUDGET "-m"
+#define OPTION_CROSS_CHECK "-x"
+#define OPTION_STATS_FILE "-S"
+#define OPTION_DEFINE "-D"
+#define OPTION_LINE_MAP "-l"
+#define OPTION_PARSE_CACHE "-P"
+#define OPTION_ARCHIVE "-o"
+#define OPTION_OPTIMIZE "-O"
+#define KILOBYTE 1024
+#define MIN_MEMORY_BUDGET_KB 1
+#define TEXT_BUDGET_SHARE 2             /* 1/2 of -m for object text windows, the rest for parsed lines */
+#define MEMO_BUDGET_SHARE 2             /* with -P, 1/2 of the rest for the line memo, then the parse cache */
 
 /* success messages */
 #define MSG_PROCESSING_FILE "Processing file: %s\n"
 #define MSG_PHASE_1 "  Phase 1: Expanding macros...\n"
+#define MSG_PHASE_1_IR "  Phase 1: Loading IR records...\n"
+#define MSG_IR_SOURCE_ONLY "  Note: -O and -l apply to .as sources only\n"
 #define MSG_PHASE_2 "  Phase 2: First pass analysis...\n"  
+#define MSG_PHASE_OPTIMIZE "  Phase 2b: Optimizing registers...\n"
+#define MSG_OPTIMIZER_STATS "  Optimizer: %d dead register write(s) removed, %d operand(s) folded\n"
 #define MSG_PHASE_3 "  Phase 3: Second pass and code generation...\n"
 #define MSG_SUCCESS "  Successfully processed '%s'\n"
 #define MSG_FAILED "  Failed to process '%s'\n"
 
 /* usage and status messages */
-#define MSG_USAGE_FORMAT "Usage: %s file1.as file2.as file3.as ...\n"
+#define MSG_USAGE_FORMAT "Usage: %s [options] file1.as file2.ir file3.as ...\n"
 #define MSG_DESCRIPTION "\nDescription:\n"
 #define MSG_ASSEMBLER_DESC "  Assembler for custom assembly language\n"
 #define MSG_PROCESSES_DESC "  Processes .as source files and generates:\n"
-#define MSG_AM_FILES_DESC "    - .am files (macro expanded source)\n"
+#define MSG_IR_FILES_DESC "  and .ir files (binary IR from irconv or a code generator)\n"
+#define MSG_AM_FILES_DESC "    - .am files (macro expanded source, .as only)\n"
 #define MSG_OB_FILES_DESC "    - .ob files (object code)\n"
 #define MSG_ENT_FILES_DESC "    - .ent files (entry symbols, if any)\n"
 #define MSG_EXT_FILES_DESC "    - .ext files (external references, if any)\n"
+#define MSG_OPTIONS "\nOptions:\n"
+#define MSG_OPTION_MEMORY_BUDGET "  -m KB   streaming mode: write object code through windows of at most KB kilobytes\n"
+#define MSG_OPTION_CROSS_CHECK "  -x      check .extern names against .entry exports of all files in the batch\n"
+#define MSG_OPTION_STATS_FILE "  -S FILE rewrite FILE with batch progress metrics (Prometheus text format)\n"
+#define MSG_OPTION_LINE_MAP "  -l      write a .lin file with the source line of each .am line\n"
+#define MSG_OPTION_PARSE_CACHE "  -P FILE reuse line parses stored in FILE and update it after the batch\n"
+#define MSG_OPTION_ARCHIVE "  -o FILE store every output file of the batch in the archive FILE (see arctool)\n"
+#define MSG_OPTION_OPTIMIZE "  -O      remove dead register writes and fold constant registers into immediates\n"
+#define MSG_OPTION_DEFINE "  -D NAME[=VALUE] define a symbol for .if/.ifdef (VALUE defaults to 1)\n"
 #define MSG_EXAMPLES "\nExamples:\n"
 #define MSG_EXAMPLE1 "  %s prog1.as\n"
 #define MSG_EXAMPLE2 "  %s file1.as file2.as file3.as\n"
@@ -51,21 +94,67 @@
 #define MSG_SUCCESSFUL_FILES "Successful: %d\n"
 #define MSG_FAILED_FILES "Failed: %d\n"
 #define MSG_SOME_FAILED "\nSome files failed to assemble. Check error messages above.\n"
+#define MSG_CROSS_CHECK_FAILED "\nCross-file symbol check found %d problem(s). Check error messages above.\n"
 #define MSG_ALL_SUCCESS "\nAll files assembled successfully!\n"
 
+/* assembler settings selected on the command line */
+typedef struct {
+    long memory_budget;     /* bytes for -m streaming, 0 keeps the in-memory image */
+    long text_budget;       /* share of memory_budget for streamed object text */
+    long memo_budget;       /* share of memory_budget for the line memo, or LINE_MEMO_DEFAULT_BUDGET */
+    long cache_budget;      /* share of memory_budget for the parse cache, or PARSE_CACHE_DEFAULT_BUDGET */
+    int cross_check;        /* YES to check externs against entries across the batch */
+    const char* stats_file; /* metrics file for -S, or NULL */
+    define_list defines;    /* symbols from -D for conditional assembly */
+    int line_map;           /* YES to write a .lin line map next to the .am file */
+    const char* parse_cache_file; /* parse cache for -P, or NULL */
+    const char* archive_file;     /* output archive for -o, or NULL */
+    int optimize;           /* YES to run the register optimizer between the passes */
+} assembler_options;
 
 
+
+/**
+ * run_optimizer - optimize the expanded source of a file that passed the first pass
+ * addresses shift when instructions shrink, so the first pass runs again on the result
+ * @param macro_filename: expanded source (.am)
+ * @param table: label table of the first pass, rebuilt if the source changed
+ * @param ic_final: instruction counter, updated
+ * @param dc_final: data counter, updated
+ * @return SUCCESS if optimized, FAILURE otherwise
+ */
+static int run_optimizer(const char* macro_filename, label_table* table, int* ic_final, int* dc_final) {
+    optimizer_stats stats;
+
+    printf(MSG_PHASE_OPTIMIZE);
+    if (optimize_program(macro_filename, &stats) == FAILURE) return FAILURE;
+    printf(MSG_OPTIMIZER_STATS, stats.removed, stats.folded);
+    if (stats.removed == 0 && stats.folded == 0) return SUCCESS;
+
+    free_label_table(table);
+    init_label_table(table);
+    return first_pass_on_table(macro_filename, table, ic_final, dc_final);
+}
+
 /**
  * process a single source file through all assembler phases
  * @param filename: path to the source file (.as extension)
+ * @param options: settings selected on the command line
+ * @param globals: batch-wide symbol map for -x, or NULL
+ * @param metrics: batch metrics for -S, or NULL
  * @return SUCCESS if file processed successfully, FAILURE otherwise
  */
-static int process_file(const char* filename) {
+static int process_file(const char* filename, const assembler_options* options, global_symbol_map* globals,
+                        batch_metrics* metrics) {
     char* base_filename;
     char* macro_filename;
+    char* line_map_filename = NULL;
     label_table table;
+    line_memo memo;
+    source_stats source;
     int ic_final, dc_final;
     int result = SUCCESS;
+    clock_t phase_started;
 
     printf(MSG_PROCESSING_FILE, filename);
 
@@ -86,33 +175,80 @@ static int process_file(const char* filename) {
     strcpy(macro_filename, base_filename);
     strcat(macro_filename, MACRO_EXT);
 
+    if (options->line_map) {
+        line_map_filename = build_filename(base_filename, LINE_MAP_EXT);
+        if (!line_map_filename) {
+            free(base_filename);
+            free(macro_filename);
+            return FAILURE;
+        }
+    }
+
     /* 1: Macro expansion */
     printf(MSG_PHASE_1);
-    expand_macros(filename, macro_filename);
+    phase_started = clock();
+    result = expand_macros(filename, macro_filename, &options->defines, line_map_filename, &source);
+    metrics_record_phase(metrics, PHASE_MACRO, phase_started);
+    metrics_record_source(metrics, source.lines, source.bytes);
+    free(line_map_filename);
+    if (result == FAILURE) {
+        fprintf(stderr, ERROR_MACRO_EXPANSION_FAILED, filename);
+        metrics_record_output(metrics, base_filename, MACRO_EXT);
+        /* the partial .am is kept, as it would be on disk */
+        commit_outputs();
+        free(base_filename);
+        free(macro_filename);
+        printf(MSG_FAILED, filename);
+        return FAILURE;
+    }
 
     /* initialize label table */
     init_label_table(&table);
 
+    /* repeated lines are parsed once and shared by both passes, within the -m budget if given */
+    begin_line_memo(&memo, options->memo_budget);
+
     /* 2: first pass */
     printf(MSG_PHASE_2);
-    if (first_pass_on_table(macro_filename, &table, &ic_final, &dc_final) == FAILURE) {
+    phase_started = clock();
+    result = first_pass_on_table(macro_filename, &table, &ic_final, &dc_final);
+    metrics_record_phase(metrics, PHASE_FIRST_PASS, phase_started);
+
+    /* record globals now, so a later failure does not hide this file's exports from -x */
+    if (globals && record_file_symbols(globals, &table, filename) == FAILURE) result = FAILURE;
+    if (result == FAILURE) {
         fprintf(stderr, ERROR_FIRST_PASS_FAILED, filename);
         result = FAILURE;
+    } else if (options->optimize && run_optimizer(macro_filename, &table, &ic_final, &dc_final) == FAILURE) {
+        fprintf(stderr, ERROR_OPTIMIZER_FAILED, filename);
+        result = FAILURE;
     } else {
-
-
         /* 3: second pass */
         printf(MSG_PHASE_3);
+        phase_started = clock();
 
-        if (second_pass(macro_filename, &table, ic_final, dc_final) == FAILURE) {
+        if (options->memory_budget > 0) {
+            result = second_pass_streaming(macro_filename, &table, ic_final, dc_final, options->text_budget);
+        } else {
+            result = second_pass(macro_filename, &table, ic_final, dc_final);
+        }
+        metrics_record_phase(metrics, PHASE_SECOND_PASS, phase_started);
+        if (result == FAILURE) {
             fprintf(stderr, ERROR_SECOND_PASS_FAILED, filename);
             result = FAILURE;
-        } else {
-
         }
     }
 
+    metrics_record_output(metrics, base_filename, MACRO_EXT);
+    metrics_record_output(metrics, base_filename, OBJECT_EXT);
+    metrics_record_output(metrics, base_filename, ENTRIES_EXT);
+    metrics_record_output(metrics, base_filename, EXTERNALS_EXT);
+
+    /* with -o, this file's outputs move from scratch streams into the archive */
+    if (commit_outputs() == FAILURE) result = FAILURE;
+
     /* free ll memory */
+    end_line_memo(&memo);
     free_label_table(&table);
     free(base_filename);
     free(macro_filename);
@@ -127,7 +263,84 @@ static int process_file(const char* filename) {
 }
 
 /**
- * check that the input filename has .as extension
+ * process_ir_file - assemble a binary IR file
+ * the records are already split and checked, so macro expansion and line
+ * parsing are skipped and both passes read the records directly
+ * @param filename: path to the IR file (.ir extension)
+ * @param options: settings selected on the command line
+ * @param globals: batch-wide symbol map for -x, or NULL
+ * @param metrics: batch metrics for -S, or NULL
+ * @return SUCCESS if file processed successfully, FAILURE otherwise
+ */
+static int process_ir_file(const char* filename, const assembler_options* options, global_symbol_map* globals,
+                           batch_metrics* metrics) {
+    char* base_filename;
+    ir_program program;
+    label_table table;
+    int ic_final, dc_final;
+    int result = SUCCESS;
+    clock_t phase_started;
+
+    printf(MSG_PROCESSING_FILE, filename);
+    if (options->optimize || options->line_map) printf(MSG_IR_SOURCE_ONLY);
+
+    base_filename = extract_base_filename(filename);
+    if (!base_filename) {
+        fprintf(stderr, ERROR_BASE_FILENAME_FAILED, filename);
+        return FAILURE;
+    }
+
+    /* 1: load and check the records */
+    printf(MSG_PHASE_1_IR);
+    if (load_ir_program(filename, &program) == FAILURE) {
+        fprintf(stderr, ERROR_IR_LOAD_FAILED, filename);
+        free(base_filename);
+        printf(MSG_FAILED, filename);
+        return FAILURE;
+    }
+
+    init_label_table(&table);
+
+    /* 2: first pass */
+    printf(MSG_PHASE_2);
+    phase_started = clock();
+    result = first_pass_on_program(&program, &table, &ic_final, &dc_final);
+    metrics_record_phase(metrics, PHASE_FIRST_PASS, phase_started);
+    if (globals && record_file_symbols(globals, &table, filename) == FAILURE) result = FAILURE;
+    if (result == FAILURE) {
+        fprintf(stderr, ERROR_FIRST_PASS_FAILED, filename);
+    } else {
+        /* 3: second pass */
+        printf(MSG_PHASE_3);
+        phase_started = clock();
+        result = second_pass_on_program(filename, &program, &table, ic_final, dc_final, options->memory_budget);
+        metrics_record_phase(metrics, PHASE_SECOND_PASS, phase_started);
+        if (result == FAILURE) {
+            fprintf(stderr, ERROR_SECOND_PASS_FAILED, filename);
+        }
+    }
+
+    metrics_record_output(metrics, base_filename, OBJECT_EXT);
+    metrics_record_output(metrics, base_filename, ENTRIES_EXT);
+    metrics_record_output(metrics, base_filename, EXTERNALS_EXT);
+
+    if (commit_outputs() == FAILURE) result = FAILURE;
+
+    free_label_table(&table);
+    free_ir_program(&program);
+    free(base_filename);
+
+    if (result == SUCCESS) {
+        printf(MSG_SUCCESS, filename);
+    } else {
+        printf(MSG_FAILED, filename);
+    }
+
+    return result;
+}
+
+/**
+ * check that the input filename has .as or .ir extension
  * @param filename: filename string to validate
  * @return SUCCESS if filename is valid, FAILURE otherwise
  */
@@ -143,8 +356,8 @@ static int validate_filename(const char* filename) {
         return FAILURE;
     }
 
-    /* Check if filename ends with .as */
-    if (strcmp(filename + len - 3, SOURCE_EXT) != 0) {
+    /* Check if filename ends with .as or .ir */
+    if (strcmp(filename + len - 3, SOURCE_EXT) != 0 && strcmp(filename + len - 3, IR_EXT) != 0) {
         return FAILURE;
     }
 
@@ -160,15 +373,127 @@ static void print_usage(const char* program_name) {
     printf(MSG_DESCRIPTION);
     printf(MSG_ASSEMBLER_DESC);
     printf(MSG_PROCESSES_DESC);
+    printf(MSG_IR_FILES_DESC);
     printf(MSG_AM_FILES_DESC);
     printf(MSG_OB_FILES_DESC);
     printf(MSG_ENT_FILES_DESC);
     printf(MSG_EXT_FILES_DESC);
+    printf(MSG_OPTIONS);
+    printf(MSG_OPTION_MEMORY_BUDGET);
+    printf(MSG_OPTION_CROSS_CHECK);
+    printf(MSG_OPTION_STATS_FILE);
+    printf(MSG_OPTION_DEFINE);
+    printf(MSG_OPTION_LINE_MAP);
+    printf(MSG_OPTION_PARSE_CACHE);
+    printf(MSG_OPTION_ARCHIVE);
+    printf(MSG_OPTION_OPTIMIZE);
     printf(MSG_EXAMPLES);
     printf(MSG_EXAMPLE1, program_name);
     printf(MSG_EXAMPLE2, program_name);
 }
 
+/**
+ * parse_option - read one command line option and its value
+ * @param argc: number of command line arguments
+ * @param argv: array of command line argument strings
+ * @param index: position of the option, advanced past any value it consumes
+ * @param options: settings to update
+ * @return SUCCESS if the option is valid, FAILURE otherwise
+ */
+static int parse_option(int argc, char* argv[], int* index, assembler_options* options) {
+    const char* option = argv[*index];
+    long value;
+    char* end;
+
+    if (strcmp(option, OPTION_CROSS_CHECK) == 0) {
+        options->cross_check = YES;
+        return SUCCESS;
+    }
+
+    if (strcmp(option, OPTION_OPTIMIZE) == 0) {
+        options->optimize = YES;
+        return SUCCESS;
+    }
+
+    if (strcmp(option, OPTION_LINE_MAP) == 0) {
+        options->line_map = YES;
+        return SUCCESS;
+    }
+
+    if (strcmp(option, OPTION_DEFINE) == 0) {
+        if (*index + 1 >= argc) {
+            fprintf(stderr, ERROR_MISSING_OPTION_VALUE, option);
+            return FAILURE;
+        }
+        return parse_define_option(&options->defines, argv[++(*index)]);
+    }
+
+    if (strcmp(option, OPTION_ARCHIVE) == 0) {
+        if (*index + 1 >= argc) {
+            fprintf(stderr, ERROR_MISSING_OPTION_VALUE, option);
+            return FAILURE;
+        }
+        options->archive_file = argv[++(*index)];
+        return SUCCESS;
+    }
+
+    if (strcmp(option, OPTION_PARSE_CACHE) == 0) {
+        if (*index + 1 >= argc) {
+            fprintf(stderr, ERROR_MISSING_OPTION_VALUE, option);
+            return FAILURE;
+        }
+        options->parse_cache_file = argv[++(*index)];
+        return SUCCESS;
+    }
+
+    if (strcmp(option, OPTION_STATS_FILE) == 0) {
+        if (*index + 1 >= argc) {
+            fprintf(stderr, ERROR_MISSING_OPTION_VALUE, option);
+            return FAILURE;
+        }
+        options->stats_file = argv[++(*index)];
+        return SUCCESS;
+    }
+
+    if (strcmp(option, OPTION_MEMORY_BUDGET) == 0) {
+        if (*index + 1 >= argc) {
+            fprintf(stderr, ERROR_MISSING_OPTION_VALUE, option);
+            return FAILURE;
+        }
+        (*index)++;
+        value = strtol(argv[*index], &end, BASE_10);
+        if (*end != NULL_CHAR || value < MIN_MEMORY_BUDGET_KB) {
+            fprintf(stderr, ERROR_INVALID_MEMORY_BUDGET, argv[*index], MIN_MEMORY_BUDGET_KB);
+            return FAILURE;
+        }
+        options->memory_budget = value * KILOBYTE;
+        return SUCCESS;
+    }
+
+    fprintf(stderr, ERROR_UNKNOWN_OPTION, option);
+    return FAILURE;
+}
+
+/**
+ * split_memory_budget - divide the -m budget between the object text windows, the line memo
+ * and the parse cache, so together they stay within the bound the user asked for
+ * @param options: parsed options, text_budget, memo_budget and cache_budget are set
+ */
+static void split_memory_budget(assembler_options* options) {
+    long rest;
+
+    if (options->memory_budget > 0) {
+        options->text_budget = options->memory_budget / TEXT_BUDGET_SHARE;
+        rest = options->memory_budget - options->text_budget;
+        options->memo_budget = options->parse_cache_file ? rest / MEMO_BUDGET_SHARE : rest;
+        options->cache_budget = rest - options->memo_budget;
+    } else {
+        options->text_budget = 0;
+        options->memo_budget = LINE_MEMO_DEFAULT_BUDGET;
+        options->cache_budget = PARSE_CACHE_DEFAULT_BUDGET;
+    }
+}
+
 /**
  * main
  * @param argc: number of command line arguments
@@ -180,6 +505,16 @@ int main(int argc, char* argv[]) {
     int total_files = 0;
     int successful_files = 0;
     int failed_files = 0;
+    assembler_options options;
+    const char** files;
+    int file_count;
+    global_symbol_map globals;
+    batch_metrics metrics;
+    parse_cache cache;
+    output_archive archive;
+    int archive_result = SUCCESS;
+    int global_problems = 0;
+    int result;
 
     /* check command line arguments */
     if (argc < 2) {
@@ -188,31 +523,118 @@ int main(int argc, char* argv[]) {
         return EXIT_FAILURE_CODE;
     }
 
+    files = malloc(argc * sizeof(char*));
+    if (!files) {
+        fprintf(stderr, MALLOC_FAILED);
+        return EXIT_FAILURE_CODE;
+    }
+
+    /* read options before any file is processed */
+    options.memory_budget = 0;
+    options.cross_check = NO;
+    options.stats_file = NULL;
+    init_define_list(&options.defines);
+    options.line_map = NO;
+    options.parse_cache_file = NULL;
+    options.archive_file = NULL;
+    options.optimize = NO;
+    file_count = 0;
+    for (i = 1; i < argc; i++) {
+        if (argv[i][0] != OPTION_PREFIX) {
+            files[file_count++] = argv[i];
+            continue;
+        }
+        if (parse_option(argc, argv, &i, &options) == FAILURE) {
+            print_usage(argv[0]);
+            free_define_list(&options.defines);
+            free(files);
+            return EXIT_FAILURE_CODE;
+        }
+    }
+
+    split_memory_budget(&options);
+
+    if (file_count == 0) {
+        fprintf(stderr, ERROR_NO_INPUT_FILES);
+        print_usage(argv[0]);
+        free_define_list(&options.defines);
+        free(files);
+        return EXIT_FAILURE_CODE;
+    }
+
+    if (options.cross_check && init_global_map(&globals) == FAILURE) {
+        free_define_list(&options.defines);
+        free(files);
+        return EXIT_FAILURE_CODE;
+    }
+
+    if (options.parse_cache_file && open_parse_cache(&cache, options.parse_cache_file, options.cache_budget) == FAILURE) {
+        if (options.cross_check) free_global_map(&globals);
+        free_define_list(&options.defines);
+        free(files);
+        return EXIT_FAILURE_CODE;
+    }
+
+    if (options.archive_file && open_archive(&archive, options.archive_file) == FAILURE) {
+        if (options.parse_cache_file) close_parse_cache(&cache);
+        if (options.cross_check) free_global_map(&globals);
+        free_define_list(&options.defines);
+        free(files);
+        return EXIT_FAILURE_CODE;
+    }
+
+    if (options.stats_file) init_metrics(&metrics, options.stats_file, (unsigned long)file_count);
+
     printf(MSG_ASSEMBLER_STARTED);
     printf(MSG_SEPARATOR);
     printf(MSG_NEWLINE);
 
     /* process each input file */
-    for (i = 1; i < argc; i++) {
+    for (i = 0; i < file_count; i++) {
         total_files++;
 
         /* check filename */
-        if (validate_filename(argv[i]) == FAILURE) {
-            fprintf(stderr, ERROR_INVALID_FILENAME, argv[i]);
+        if (validate_filename(files[i]) == FAILURE) {
+            fprintf(stderr, ERROR_INVALID_FILENAME, files[i]);
             failed_files++;
+            metrics_file_finished(options.stats_file ? &metrics : NULL, FAILURE);
             continue;
         }
 
         /* Process the file */
-        if (process_file(argv[i]) == SUCCESS) {
+        if (strcmp(files[i] + strlen(files[i]) - 3, IR_EXT) == 0) {
+            result = process_ir_file(files[i], &options, options.cross_check ? &globals : NULL,
+                                     options.stats_file ? &metrics : NULL);
+        } else {
+            result = process_file(files[i], &options, options.cross_check ? &globals : NULL,
+                                  options.stats_file ? &metrics : NULL);
+        }
+        if (result == SUCCESS) {
             successful_files++;
         } else {
             failed_files++;
         }
+        metrics_file_finished(options.stats_file ? &metrics : NULL, result);
+
+        printf(MSG_NEWLINE);
+    }
 
+    finish_metrics(options.stats_file ? &metrics : NULL);
+
+    /* batch-wide check once every file has been recorded */
+    if (options.cross_check) {
+        global_problems = check_global_symbols(&globals);
+        free_global_map(&globals);
         printf(MSG_NEWLINE);
     }
 
+    if (options.archive_file) archive_result = close_archive(&archive);
+
+    if (options.parse_cache_file) {
+        printf(MSG_PARSE_CACHE_STATS, cache.hits, cache.lookups);
+        close_parse_cache(&cache);
+    }
+
     /* summary */
     printf(MSG_ASSEMBLY_SUMMARY);
     printf(MSG_SEPARATOR2);
@@ -220,11 +642,22 @@ int main(int argc, char* argv[]) {
     printf(MSG_SUCCESSFUL_FILES, successful_files);
     printf(MSG_FAILED_FILES, failed_files);
 
+    free_define_list(&options.defines);
+    free(files);
+
     if (failed_files > 0) {
         printf(MSG_SOME_FAILED);
         return EXIT_FAILURE_CODE;
     }
 
+    if (global_problems > 0) {
+        printf(MSG_CROSS_CHECK_FAILED, global_problems);
+        return EXIT_FAILURE_CODE;
+    }
+
+    /* the archive error is already reported */
+    if (archive_result == FAILURE) return EXIT_FAILURE_CODE;
+
     printf(MSG_ALL_SUCCESS);
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,341 @@
+#include "conditional.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* comparison operators accepted by .if */
+#define OPERATOR_EQUAL "=="
+#define OPERATOR_NOT_EQUAL "!="
+#define OPERATOR_LESS "<"
+#define OPERATOR_GREATER ">"
+#define OPERATOR_LESS_EQUAL "<="
+#define OPERATOR_GREATER_EQUAL ">="
+
+/* characters that end the text shown in messages */
+#define LINE_END_CHARS "\r\n"
+
+/**
+ * init_define_list - initialize an empty symbol list
+ * @param list: list to initialize
+ */
+void init_define_list(define_list *list) {
+    list->head = NULL;
+}
+
+/**
+ * find_define - look up a symbol
+ * @param list: symbol list
+ * @param name: symbol name
+ * @return symbol node, or NULL if not defined
+ */
+define_node *find_define(const define_list *list, const char *name) {
+    define_node *current;
+
+    for (current = list->head; current; current = current->next) {
+        if (strcmp(current->name, name) == 0) return current;
+    }
+    return NULL;
+}
+
+/**
+ * set_define - define a symbol or change its value
+ * @param list: symbol list
+ * @param name: symbol name
+ * @param value: symbol value
+ * @return SUCCESS if stored, FAILURE on allocation failure
+ */
+int set_define(define_list *list, const char *name, long value) {
+    define_node *node = find_define(list, name);
+
+    if (!node) {
+        node = malloc(sizeof(define_node));
+        if (!node) {
+            fprintf(stderr, MALLOC_FAILED);
+            return FAILURE;
+        }
+        strcpy(node->name, name);
+        node->next = list->head;
+        list->head = node;
+    }
+    node->value = value;
+    return SUCCESS;
+}
+
+/**
+ * free_define_list - release all symbols
+ * @param list: list to free
+ */
+void free_define_list(define_list *list) {
+    define_node *current;
+    define_node *next;
+
+    for (current = list->head; current; current = next) {
+        next = current->next;
+        free(current);
+    }
+    list->head = NULL;
+}
+
+/**
+ * is_valid_symbol_name - check a conditional symbol name
+ * @param name: name to check
+ * @return YES if it is letters, digits and underscores not starting with a digit
+ */
+static int is_valid_symbol_name(const char *name) {
+    int i;
+
+    if (!name[0] || isdigit((unsigned char)name[0]) || strlen(name) >= MAX_MACRO_NAME) return NO;
+    for (i = 0; name[i]; i++) {
+        if (!isalnum((unsigned char)name[i]) && name[i] != UNDERSCORE_CHAR) return NO;
+    }
+    return YES;
+}
+
+/**
+ * parse_number - parse a whole token as a decimal integer
+ * @param text: token
+ * @param value: output parameter for the value
+ * @return SUCCESS if the whole token is a number, FAILURE otherwise
+ */
+static int parse_number(const char *text, long *value) {
+    char *end;
+
+    *value = strtol(text, &end, BASE_10);
+    return (end != text && *end == NULL_CHAR) ? SUCCESS : FAILURE;
+}
+
+/**
+ * parse_define_option - add a command line definition of the form NAME or NAME=VALUE
+ * @param list: symbol list
+ * @param text: option value
+ * @return SUCCESS if valid, FAILURE otherwise
+ */
+int parse_define_option(define_list *list, const char *text) {
+    char name[MAX_MACRO_NAME];
+    const char *separator = strchr(text, DEFINE_VALUE_SEPARATOR);
+    size_t length = separator ? (size_t)(separator - text) : strlen(text);
+    long value = DEFAULT_DEFINE_VALUE;
+
+    if (length >= MAX_MACRO_NAME) {
+        fprintf(stderr, ERROR_INVALID_DEFINE_OPTION, text);
+        return FAILURE;
+    }
+    strncpy(name, text, length);
+    name[length] = NULL_CHAR;
+
+    if (!is_valid_symbol_name(name) || (separator && parse_number(separator + 1, &value) == FAILURE)) {
+        fprintf(stderr, ERROR_INVALID_DEFINE_OPTION, text);
+        return FAILURE;
+    }
+    return set_define(list, name, value);
+}
+
+/**
+ * init_conditions - start a scan with the predefined symbols
+ * @param state: scan state to initialize
+ * @param predefined: symbols from the command line, or NULL
+ * @return SUCCESS if initialized, FAILURE on allocation failure
+ */
+int init_conditions(condition_state *state, const define_list *predefined) {
+    const define_node *current;
+
+    init_define_list(&state->symbols);
+    state->depth = 0;
+    state->active = YES;
+
+    /* each scan gets its own copy, so .define in one pass cannot leak into the next */
+    for (current = predefined ? predefined->head : NULL; current; current = current->next) {
+        if (set_define(&state->symbols, current->name, current->value) == FAILURE) {
+            free_define_list(&state->symbols);
+            return FAILURE;
+        }
+    }
+    return SUCCESS;
+}
+
+/**
+ * evaluate_term - value of a number or symbol in a condition
+ * @param state: scan state
+ * @param token: number or symbol name; undefined symbols are 0
+ * @param value: output parameter for the value
+ * @return SUCCESS if the token is valid, FAILURE otherwise
+ */
+static int evaluate_term(const condition_state *state, const char *token, long *value) {
+    const define_node *symbol;
+
+    if (parse_number(token, value) == SUCCESS) return SUCCESS;
+    if (!is_valid_symbol_name(token)) return FAILURE;
+
+    symbol = find_define(&state->symbols, token);
+    *value = symbol ? symbol->value : 0;
+    return SUCCESS;
+}
+
+/**
+ * evaluate_condition - evaluate "TERM" or "TERM OP TERM"
+ * @param state: scan state
+ * @param first: first term
+ * @param op: comparison operator, or NULL
+ * @param second: second term, or NULL
+ * @param result: output parameter, YES or NO
+ * @return SUCCESS if the condition is valid, FAILURE otherwise
+ */
+static int evaluate_condition(const condition_state *state, const char *first, const char *op,
+                              const char *second, int *result) {
+    long left, right;
+
+    if (!first || evaluate_term(state, first, &left) == FAILURE) return FAILURE;
+    if (!op) {
+        *result = left != 0;
+        return SUCCESS;
+    }
+    if (!second || evaluate_term(state, second, &right) == FAILURE) return FAILURE;
+
+    if (strcmp(op, OPERATOR_EQUAL) == 0) *result = left == right;
+    else if (strcmp(op, OPERATOR_NOT_EQUAL) == 0) *result = left != right;
+    else if (strcmp(op, OPERATOR_LESS) == 0) *result = left < right;
+    else if (strcmp(op, OPERATOR_GREATER) == 0) *result = left > right;
+    else if (strcmp(op, OPERATOR_LESS_EQUAL) == 0) *result = left <= right;
+    else if (strcmp(op, OPERATOR_GREATER_EQUAL) == 0) *result = left >= right;
+    else return FAILURE;
+    return SUCCESS;
+}
+
+/**
+ * open_block - enter a .if/.ifdef/.ifndef block
+ * @param state: scan state
+ * @param condition: whether the block's first branch is chosen
+ * @param line_number: line number for messages
+ * @return CONDITIONAL_DIRECTIVE, or CONDITIONAL_ERROR if nested too deep
+ */
+static int open_block(condition_state *state, int condition, int line_number) {
+    if (state->depth >= MAX_CONDITION_DEPTH) {
+        fprintf(stderr, ERROR_CONDITION_TOO_DEEP, line_number, MAX_CONDITION_DEPTH);
+        return CONDITIONAL_ERROR;
+    }
+    state->parent_active[state->depth] = (unsigned char)state->active;
+    state->branch_taken[state->depth] = (unsigned char)condition;
+    state->in_else[state->depth] = NO;
+    state->depth++;
+    state->active = state->active && condition;
+    return CONDITIONAL_DIRECTIVE;
+}
+
+/**
+ * handle_conditional_line - apply a conditional directive, or classify an ordinary line
+ * lines inside skipped blocks are only checked for nesting directives
+ * @param state: scan state
+ * @param line: source line
+ * @param line_number: line number for messages
+ * @return CONDITIONAL_DIRECTIVE, CONDITIONAL_TEXT or CONDITIONAL_ERROR
+ */
+int handle_conditional_line(condition_state *state, const char *line, int line_number) {
+    char copy[MAX_LINE_LENGTH];
+    char text[MAX_LINE_LENGTH];
+    char *word;
+    char *first, *op, *second;
+    int condition = NO;
+    int top;
+    long value;
+
+    /* cheap test first: every directive starts with a dot */
+    while (*line == SPACE_CHAR || *line == TAB_CHAR) line++;
+    if (*line != DOT_CHAR) return CONDITIONAL_TEXT;
+
+    strncpy(copy, line, sizeof(copy) - 1);
+    copy[sizeof(copy) - 1] = NULL_CHAR;
+    strcpy(text, copy);
+    text[strcspn(text, LINE_END_CHARS)] = NULL_CHAR;
+    word = strtok(copy, WHITESPACE_CHARS);
+    first = strtok(NULL, WHITESPACE_CHARS);
+    op = first ? strtok(NULL, WHITESPACE_CHARS) : NULL;
+    second = op ? strtok(NULL, WHITESPACE_CHARS) : NULL;
+
+    if (strcmp(word, DIRECTIVE_IFDEF) == 0 || strcmp(word, DIRECTIVE_IFNDEF) == 0) {
+        /* inside a skipped block the condition is not even looked at */
+        if (state->active) {
+            if (!first || op || !is_valid_symbol_name(first)) {
+                fprintf(stderr, ERROR_INVALID_SYMBOL_NAME, line_number, first ? first : "");
+                return CONDITIONAL_ERROR;
+            }
+            condition = (find_define(&state->symbols, first) != NULL) == (strcmp(word, DIRECTIVE_IFDEF) == 0);
+        }
+        return open_block(state, condition, line_number);
+    }
+
+    if (strcmp(word, DIRECTIVE_IF) == 0) {
+        if (state->active && (strtok(NULL, WHITESPACE_CHARS) ||
+                              evaluate_condition(state, first, op, second, &condition) == FAILURE)) {
+            fprintf(stderr, ERROR_INVALID_CONDITION, line_number, text);
+            return CONDITIONAL_ERROR;
+        }
+        return open_block(state, condition, line_number);
+    }
+
+    if (strcmp(word, DIRECTIVE_ELSE) == 0) {
+        top = state->depth - 1;
+        if (top < 0) {
+            fprintf(stderr, ERROR_ELSE_WITHOUT_IF, line_number);
+            return CONDITIONAL_ERROR;
+        }
+        if (state->in_else[top]) {
+            fprintf(stderr, ERROR_DUPLICATE_ELSE, line_number);
+            return CONDITIONAL_ERROR;
+        }
+        state->in_else[top] = YES;
+        state->active = state->parent_active[top] && !state->branch_taken[top];
+        return CONDITIONAL_DIRECTIVE;
+    }
+
+    if (strcmp(word, DIRECTIVE_ENDIF) == 0) {
+        if (state->depth == 0) {
+            fprintf(stderr, ERROR_ENDIF_WITHOUT_IF, line_number);
+            return CONDITIONAL_ERROR;
+        }
+        state->depth--;
+        state->active = state->parent_active[state->depth];
+        return CONDITIONAL_DIRECTIVE;
+    }
+
+    if (strcmp(word, DIRECTIVE_DEFINE) == 0) {
+        if (!state->active) return CONDITIONAL_DIRECTIVE;
+        if (!first || !is_valid_symbol_name(first) || second) {
+            fprintf(stderr, ERROR_INVALID_SYMBOL_NAME, line_number, first ? first : "");
+            return CONDITIONAL_ERROR;
+        }
+        value = DEFAULT_DEFINE_VALUE;
+        if (op && parse_number(op, &value) == FAILURE) {
+            fprintf(stderr, ERROR_INVALID_CONDITION, line_number, op);
+            return CONDITIONAL_ERROR;
+        }
+        return set_define(&state->symbols, first, value) == SUCCESS ? CONDITIONAL_DIRECTIVE : CONDITIONAL_ERROR;
+    }
+
+    return CONDITIONAL_TEXT;
+}
+
+/**
+ * finish_conditions - check that every block was closed and release the scan state
+ * @param state: scan state
+ * @return SUCCESS if all blocks were closed, FAILURE otherwise
+ */
+int finish_conditions(condition_state *state) {
+    int result = SUCCESS;
+
+    if (state->depth > 0) {
+        fprintf(stderr, ERROR_MISSING_ENDIF, state->depth);
+        result = FAILURE;
+    }
+    release_conditions(state);
+    return result;
+}
+
+/**
+ * release_conditions - release the scan state without checking it, after an error
+ * @param state: scan state
+ */
+void release_conditions(condition_state *state) {
+    free_define_list(&state->symbols);
+    state->depth = 0;
+}
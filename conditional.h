@@ -0,0 +1,124 @@
+#ifndef CONDITIONAL_H
+#define CONDITIONAL_H
+
+#include "utils.h"
+
+/* conditional assembly directives */
+#define DIRECTIVE_IF ".if"
+#define DIRECTIVE_IFDEF ".ifdef"
+#define DIRECTIVE_IFNDEF ".ifndef"
+#define DIRECTIVE_ELSE ".else"
+#define DIRECTIVE_ENDIF ".endif"
+#define DIRECTIVE_DEFINE ".define"
+
+/* limits and defaults */
+#define MAX_CONDITION_DEPTH 32
+#define DEFAULT_DEFINE_VALUE 1
+#define DEFINE_VALUE_SEPARATOR '='
+
+/* results of handle_conditional_line */
+#define CONDITIONAL_ERROR 0         /* malformed directive, message already printed */
+#define CONDITIONAL_DIRECTIVE 1     /* the line was a conditional directive, do not emit it */
+#define CONDITIONAL_TEXT 2          /* ordinary line; emit it only if conditions_active */
+
+/* error messages */
+#define ERROR_CONDITION_TOO_DEEP "Error (line %d): conditionals nested deeper than %d levels\n"
+#define ERROR_ELSE_WITHOUT_IF "Error (line %d): .else without .if\n"
+#define ERROR_DUPLICATE_ELSE "Error (line %d): second .else for the same .if\n"
+#define ERROR_ENDIF_WITHOUT_IF "Error (line %d): .endif without .if\n"
+#define ERROR_MISSING_ENDIF "Error: %d .if block(s) not closed with .endif\n"
+#define ERROR_INVALID_CONDITION "Error (line %d): invalid condition '%s'\n"
+#define ERROR_INVALID_SYMBOL_NAME "Error (line %d): invalid symbol name '%s'\n"
+#define ERROR_INVALID_DEFINE_OPTION "Error: invalid definition '%s' (expected NAME or NAME=VALUE)\n"
+
+/* symbol set by -D or .define */
+typedef struct define_node {
+    char name[MAX_MACRO_NAME];
+    long value;
+    struct define_node *next;
+} define_node;
+
+/* list of defined symbols */
+typedef struct {
+    define_node *head;
+} define_list;
+
+/* nesting state while scanning a source file */
+typedef struct {
+    define_list symbols;                            /* command line symbols, then .define */
+    int depth;                                      /* open .if blocks */
+    int active;                                     /* whether lines are currently emitted */
+    unsigned char parent_active[MAX_CONDITION_DEPTH];   /* active state outside each block */
+    unsigned char branch_taken[MAX_CONDITION_DEPTH];    /* whether the .if branch was chosen */
+    unsigned char in_else[MAX_CONDITION_DEPTH];         /* whether .else was seen */
+} condition_state;
+
+/**
+ * init_define_list - initialize an empty symbol list
+ * @param list: list to initialize
+ */
+void init_define_list(define_list *list);
+
+/**
+ * set_define - define a symbol or change its value
+ * @param list: symbol list
+ * @param name: symbol name
+ * @param value: symbol value
+ * @return SUCCESS if stored, FAILURE on allocation failure
+ */
+int set_define(define_list *list, const char *name, long value);
+
+/**
+ * find_define - look up a symbol
+ * @param list: symbol list
+ * @param name: symbol name
+ * @return symbol node, or NULL if not defined
+ */
+define_node *find_define(const define_list *list, const char *name);
+
+/**
+ * parse_define_option - add a command line definition of the form NAME or NAME=VALUE
+ * @param list: symbol list
+ * @param text: option value
+ * @return SUCCESS if valid, FAILURE otherwise
+ */
+int parse_define_option(define_list *list, const char *text);
+
+/**
+ * free_define_list - release all symbols
+ * @param list: list to free
+ */
+void free_define_list(define_list *list);
+
+/**
+ * init_conditions - start a scan with the predefined symbols
+ * @param state: scan state to initialize
+ * @param predefined: symbols from the command line, or NULL
+ * @return SUCCESS if initialized, FAILURE on allocation failure
+ */
+int init_conditions(condition_state *state, const define_list *predefined);
+
+/**
+ * handle_conditional_line - apply a conditional directive, or classify an ordinary line
+ * lines inside skipped blocks are only checked for nesting directives
+ * @param state: scan state
+ * @param line: source line
+ * @param line_number: line number for messages
+ * @return CONDITIONAL_DIRECTIVE, CONDITIONAL_TEXT or CONDITIONAL_ERROR
+ */
+int handle_conditional_line(condition_state *state, const char *line, int line_number);
+
+/**
+ * finish_conditions - check that every block was closed and release the scan state
+ * @param state: scan state
+ * @return SUCCESS if all blocks were closed, FAILURE otherwise
+ */
+int finish_conditions(condition_state *state);
+
+/**
+ * release_conditions - release the scan state without checking it, after an error
+ * @param state: scan state
+ */
+void release_conditions(condition_state *state);
+
+#endif /* CONDITIONAL_H */
@@ -0,0 +1,243 @@
+#include "coverage.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+/* hex digits of the executed bitmap */
+#define HEX_DIGITS "0123456789abcdef"
+#define HEX_BASE 16
+#define BITS_PER_HEX_DIGIT 4
+
+/**
+ * init_coverage - create an empty coverage record
+ * @param cov: record to initialize
+ */
+void init_coverage(coverage *cov) {
+    memset(cov, 0, sizeof(coverage));
+    cov->source = NULL;
+}
+
+/**
+ * coverage_run - execute a program while marking each executed instruction address
+ * like profile_run, this is a separate loop so plain runs pay nothing
+ * @param m: machine prepared with init_machine
+ * @param executed: bitmap of MACHINE_MEMORY_SIZE bits to update
+ * @return final machine state
+ */
+machine_state coverage_run(machine *m, unsigned char *executed) {
+    machine_state state = MACHINE_RUNNING;
+
+    while (state == MACHINE_RUNNING) {
+        if (!(m->decoded[m->pc].flags & (DECODED_INVALID | DECODED_EXTERNAL))) {
+            BITMAP_SET(executed, m->pc);
+        }
+        state = machine_step(m);
+    }
+    return state;
+}
+
+/**
+ * coverage_add_line - add a source line to an ascending line list, ignoring duplicates
+ * @param lines: line list of at most MACHINE_MEMORY_SIZE entries
+ * @param count: number of lines in the list, updated
+ * @param line: line to add
+ */
+void coverage_add_line(int *lines, int *count, int line) {
+    int i = *count;
+
+    if (*count >= MACHINE_MEMORY_SIZE) return;
+
+    /* lines mostly arrive in order, so search from the end */
+    while (i > 0 && lines[i - 1] > line) i--;
+    if (i > 0 && lines[i - 1] == line) return;
+
+    memmove(lines + i + 1, lines + i, (*count - i) * sizeof(int));
+    lines[i] = line;
+    (*count)++;
+}
+
+/**
+ * has_line - binary search of an ascending line list
+ * @param lines: line list
+ * @param count: number of lines
+ * @param line: line to find
+ * @return YES if present, NO otherwise
+ */
+static int has_line(const int *lines, int count, int line) {
+    int low = 0;
+    int high = count - 1;
+    int middle;
+
+    while (low <= high) {
+        middle = (low + high) / 2;
+        if (lines[middle] == line) return YES;
+        if (lines[middle] < line) {
+            low = middle + 1;
+        } else {
+            high = middle - 1;
+        }
+    }
+    return NO;
+}
+
+/**
+ * write_lines - write one line-list record
+ * @param out: output stream
+ * @param key: record key
+ * @param lines: line list
+ * @param count: number of lines
+ */
+static void write_lines(FILE *out, const char *key, const int *lines, int count) {
+    int i;
+
+    fputs(key, out);
+    for (i = 0; i < count; i++) {
+        fprintf(out, " %d", lines[i]);
+    }
+    fputc(NEWLINE_CHAR, out);
+}
+
+/**
+ * write_coverage - write a coverage record
+ * @param out: output stream
+ * @param cov: record to write
+ */
+void write_coverage(FILE *out, const coverage *cov) {
+    int i;
+
+    fprintf(out, "%s %d\n", COVERAGE_MAGIC, COVERAGE_VERSION);
+    fprintf(out, "%s %s\n", COVERAGE_KEY_SOURCE, cov->source ? cov->source : "");
+
+    fprintf(out, "%s ", COVERAGE_KEY_EXECUTED);
+    for (i = 0; i < COVERAGE_BITMAP_BYTES; i++) {
+        fputc(HEX_DIGITS[cov->executed[i] >> BITS_PER_HEX_DIGIT], out);
+        fputc(HEX_DIGITS[cov->executed[i] & (HEX_BASE - 1)], out);
+    }
+    fputc(NEWLINE_CHAR, out);
+
+    write_lines(out, COVERAGE_KEY_CODE, cov->code_lines, cov->code_count);
+    write_lines(out, COVERAGE_KEY_COVERED, cov->covered_lines, cov->covered_count);
+}
+
+/**
+ * read_bitmap - decode the hex executed bitmap
+ * @param text: hex digits
+ * @param executed: bitmap to fill
+ * @return SUCCESS if the text is a full bitmap, FAILURE otherwise
+ */
+static int read_bitmap(const char *text, unsigned char *executed) {
+    const char *high, *low;
+    int i;
+
+    if (!text || strlen(text) != COVERAGE_BITMAP_BYTES * 2) return FAILURE;
+    for (i = 0; i < COVERAGE_BITMAP_BYTES; i++) {
+        high = strchr(HEX_DIGITS, tolower((unsigned char)text[2 * i]));
+        low = strchr(HEX_DIGITS, tolower((unsigned char)text[2 * i + 1]));
+        if (!high || !low || !*high || !*low) return FAILURE;
+        executed[i] = (unsigned char)(((high - HEX_DIGITS) << BITS_PER_HEX_DIGIT) | (low - HEX_DIGITS));
+    }
+    return SUCCESS;
+}
+
+/**
+ * read_lines - decode the rest of a line-list record
+ * @param lines: line list to fill
+ * @param count: number of lines, updated
+ * @return SUCCESS if every token is a line number, FAILURE otherwise
+ */
+static int read_lines(int *lines, int *count) {
+    char *token;
+    char *end;
+    long line;
+
+    while ((token = strtok(NULL, WHITESPACE_CHARS)) != NULL) {
+        line = strtol(token, &end, BASE_10);
+        if (*end != NULL_CHAR || line <= 0) return FAILURE;
+        coverage_add_line(lines, count, (int)line);
+    }
+    return SUCCESS;
+}
+
+/**
+ * read_coverage - load a coverage record
+ * @param filename: coverage file
+ * @param cov: record to fill; free with free_coverage
+ * @return SUCCESS if read, FAILURE otherwise
+ */
+int read_coverage(const char *filename, coverage *cov) {
+    char record[COVERAGE_RECORD_LENGTH];
+    FILE *file;
+    char *key;
+    char *value;
+    int result = SUCCESS;
+    int version = 0;
+
+    init_coverage(cov);
+
+    file = fopen(filename, FILE_READ_MODE);
+    if (!file) {
+        fprintf(stderr, ERROR_CANNOT_OPEN_FILE, filename);
+        return FAILURE;
+    }
+
+    if (!fgets(record, sizeof(record), file) || sscanf(record, COVERAGE_MAGIC " %d", &version) != 1 ||
+        version != COVERAGE_VERSION) {
+        result = FAILURE;
+    }
+
+    while (result == SUCCESS && fgets(record, sizeof(record), file)) {
+        key = strtok(record, WHITESPACE_CHARS);
+        if (!key) continue;
+
+        if (strcmp(key, COVERAGE_KEY_SOURCE) == 0) {
+            value = strtok(NULL, WHITESPACE_CHARS);
+            free(cov->source);
+            cov->source = value ? build_filename(value, "") : NULL;
+            if (!cov->source) result = FAILURE;
+        } else if (strcmp(key, COVERAGE_KEY_EXECUTED) == 0) {
+            result = read_bitmap(strtok(NULL, WHITESPACE_CHARS), cov->executed);
+        } else if (strcmp(key, COVERAGE_KEY_CODE) == 0) {
+            result = read_lines(cov->code_lines, &cov->code_count);
+        } else if (strcmp(key, COVERAGE_KEY_COVERED) == 0) {
+            result = read_lines(cov->covered_lines, &cov->covered_count);
+        }
+        /* unknown keys are skipped so newer files stay readable */
+    }
+
+    fclose(file);
+    if (result == FAILURE || !cov->source) {
+        fprintf(stderr, ERROR_COVERAGE_FORMAT, filename);
+        free_coverage(cov);
+        return FAILURE;
+    }
+    return SUCCESS;
+}
+
+/**
+ * coverage_affected - decide whether changed source lines can change a test's behaviour
+ * a changed line counts if the test executed it, or if it produced no instruction
+ * (data, labels, directives, comments), since those can affect any test
+ * @param cov: the test's coverage
+ * @param changed: changed line numbers
+ * @param count: number of changed lines
+ * @return YES if the test should be rerun, NO otherwise
+ */
+int coverage_affected(const coverage *cov, const int *changed, int count) {
+    int i;
+
+    for (i = 0; i < count; i++) {
+        if (has_line(cov->covered_lines, cov->covered_count, changed[i])) return YES;
+        if (!has_line(cov->code_lines, cov->code_count, changed[i])) return YES;
+    }
+    return NO;
+}
+
+/**
+ * free_coverage - release a coverage record
+ * @param cov: record to free
+ */
+void free_coverage(coverage *cov) {
+    free(cov->source);
+    cov->source = NULL;
+}
@@ -0,0 +1,85 @@
+#ifndef COVERAGE_H
+#define COVERAGE_H
+
+#include <stdio.h>
+#include "utils.h"
+#include "machine.h"
+
+/* coverage file layout, one record per line */
+#define COVERAGE_MAGIC "coverage"
+#define COVERAGE_VERSION 1
+#define COVERAGE_KEY_SOURCE "source"        /* source file the line numbers refer to */
+#define COVERAGE_KEY_EXECUTED "executed"    /* hex bitmap of executed instruction addresses */
+#define COVERAGE_KEY_CODE "code"            /* source lines that produced instructions */
+#define COVERAGE_KEY_COVERED "covered"      /* code lines whose instructions ran */
+#define COVERAGE_RECORD_LENGTH 2048
+#define COVERAGE_BITMAP_BYTES BITMAP_BYTES(MACHINE_MEMORY_SIZE)
+
+/* error messages */
+#define ERROR_COVERAGE_FORMAT "Error: '%s' is not a coverage file\n"
+
+/* per-test coverage of one program */
+typedef struct {
+    char *source;                                       /* source file name, allocated */
+    unsigned char executed[COVERAGE_BITMAP_BYTES];      /* executed instruction addresses */
+    int code_lines[MACHINE_MEMORY_SIZE];                /* ascending, no duplicates */
+    int code_count;
+    int covered_lines[MACHINE_MEMORY_SIZE];             /* ascending subset of code_lines */
+    int covered_count;
+} coverage;
+
+/**
+ * init_coverage - create an empty coverage record
+ * @param cov: record to initialize
+ */
+void init_coverage(coverage *cov);
+
+/**
+ * coverage_run - execute a program while marking each executed instruction address
+ * @param m: machine prepared with init_machine
+ * @param executed: bitmap of MACHINE_MEMORY_SIZE bits to update
+ * @return final machine state
+ */
+machine_state coverage_run(machine *m, unsigned char *executed);
+
+/**
+ * coverage_add_line - add a source line to an ascending line list, ignoring duplicates
+ * @param lines: line list
+ * @param count: number of lines in the list, updated
+ * @param line: line to add
+ */
+void coverage_add_line(int *lines, int *count, int line);
+
+/**
+ * write_coverage - write a coverage record
+ * @param out: output stream
+ * @param cov: record to write
+ */
+void write_coverage(FILE *out, const coverage *cov);
+
+/**
+ * read_coverage - load a coverage record
+ * @param filename: coverage file
+ * @param cov: record to fill; free with free_coverage
+ * @return SUCCESS if read, FAILURE otherwise
+ */
+int read_coverage(const char *filename, coverage *cov);
+
+/**
+ * coverage_affected - decide whether changed source lines can change a test's behaviour
+ * a changed line counts if the test executed it, or if it produced no instruction
+ * (data, labels, directives, comments), since those can affect any test
+ * @param cov: the test's coverage
+ * @param changed: changed line numbers
+ * @param count: number of changed lines
+ * @return YES if the test should be rerun, NO otherwise
+ */
+int coverage_affected(const coverage *cov, const int *changed, int count);
+
+/**
+ * free_coverage - release a coverage record
+ * @param cov: record to free
+ */
+void free_coverage(coverage *cov);
+
+#endif /* COVERAGE_H */
@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils.h"
+#include "coverage.h"
+
+/* command line */
+#define MIN_ARGC 4
+#define SOURCE_ARG 1
+#define LINES_ARG 2
+#define FIRST_COVERAGE_ARG 3
+#define RANGE_SEPARATOR '-'
+#define LIST_SEPARATOR ','
+#define PATH_SEPARATOR '/'
+
+/* error messages */
+#define ERROR_INVALID_LINES "Error: invalid line list '%s' (expected e.g. 12,20-31)\n"
+#define WARNING_UNREADABLE_COVERAGE "Warning: selecting '%s' because its coverage cannot be read\n"
+
+/* usage messages */
+#define MSG_USAGE_FORMAT "Usage: %s source.as lines coverage-file...\n"
+#define MSG_DESCRIPTION "\nPrints the coverage files (one per test) whose test must be rerun after\n" \
+    "the given lines of source.as changed. lines is a list such as 12,20-31,\n" \
+    "numbered as in the file before the change.\n"
+
+/**
+ * print usage information
+ * @param program_name: name of the executable program
+ */
+static void print_usage(const char *program_name) {
+    printf(MSG_USAGE_FORMAT, program_name);
+    printf(MSG_DESCRIPTION);
+}
+
+/**
+ * parse_lines - expand a list such as "12,20-31" into line numbers
+ * @param text: line list
+ * @param count: output parameter for the number of lines
+ * @return allocated array of line numbers, or NULL if invalid
+ */
+static int *parse_lines(const char *text, int *count) {
+    const char *p;
+    char *end;
+    long first, last, line;
+    int *lines;
+    int *grown;
+    int capacity = 0;
+
+    *count = 0;
+    lines = NULL;
+    p = text;
+    while (*p) {
+        first = strtol(p, &end, BASE_10);
+        if (end == p || first <= 0) break;
+        last = first;
+        p = end;
+        if (*p == RANGE_SEPARATOR) {
+            last = strtol(p + 1, &end, BASE_10);
+            if (end == p + 1 || last < first) break;
+            p = end;
+        }
+
+        for (line = first; line <= last; line++) {
+            if (*count == capacity) {
+                capacity = capacity ? capacity * 2 : MACHINE_MEMORY_SIZE;
+                grown = realloc(lines, capacity * sizeof(int));
+                if (!grown) {
+                    fprintf(stderr, MALLOC_FAILED);
+                    free(lines);
+                    return NULL;
+                }
+                lines = grown;
+            }
+            lines[(*count)++] = (int)line;
+        }
+
+        if (*p == NULL_CHAR) return lines;
+        if (*p != LIST_SEPARATOR) break;
+        p++;
+    }
+
+    fprintf(stderr, ERROR_INVALID_LINES, text);
+    free(lines);
+    return NULL;
+}
+
+/**
+ * file_part - last component of a path
+ * @param path: file path
+ * @return pointer into path after the last separator
+ */
+static const char *file_part(const char *path) {
+    const char *slash = strrchr(path, PATH_SEPARATOR);
+    return slash ? slash + 1 : path;
+}
+
+/**
+ * main
+ * @param argc: number of command line arguments
+ * @param argv: array of command line argument strings
+ * @return 0 on success, EXIT_FAILURE_CODE on failure
+ */
+int main(int argc, char *argv[]) {
+    coverage cov;
+    int *changed;
+    int changed_count;
+    int i;
+
+    if (argc < MIN_ARGC) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE_CODE;
+    }
+
+    changed = parse_lines(argv[LINES_ARG], &changed_count);
+    if (!changed) return EXIT_FAILURE_CODE;
+
+    for (i = FIRST_COVERAGE_ARG; i < argc; i++) {
+        if (read_coverage(argv[i], &cov) == FAILURE) {
+            /* without coverage the test may reach anything */
+            fprintf(stderr, WARNING_UNREADABLE_COVERAGE, argv[i]);
+            printf("%s\n", argv[i]);
+            continue;
+        }
+
+        if (strcmp(file_part(cov.source), file_part(argv[SOURCE_ARG])) == 0 &&
+            coverage_affected(&cov, changed, changed_count)) {
+            printf("%s\n", argv[i]);
+        }
+        free_coverage(&cov);
+    }
+
+    free(changed);
+    return 0;
+}
@@ -0,0 +1,389 @@
+#include "debugger.h"
+#include "commands.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* action applied to each address a command target resolves to */
+typedef int (*target_action)(debugger *dbg, int address);
+
+/**
+ * init_debugger - attach a debugger to a loaded machine
+ * @param dbg: debugger to initialize
+ * @param m: machine prepared with init_machine
+ * @param entries: entry symbols, used to resolve labels
+ * @param externals: external references, used to resolve external names
+ */
+void init_debugger(debugger *dbg, machine *m, const symbol_file *entries, const symbol_file *externals) {
+    dbg->m = m;
+    dbg->entries = entries;
+    dbg->externals = externals;
+    memset(dbg->breakpoints, 0, sizeof(dbg->breakpoints));
+    memset(dbg->watchpoints, 0, sizeof(dbg->watchpoints));
+    dbg->watch_count = 0;
+    dbg->stopped = NO;
+
+    m->hook = debugger_hook;
+    m->hook_data = dbg;
+}
+
+/**
+ * may_touch_watch - check at flag time whether an operand can hit a watchpoint
+ * matrix addresses depend on registers, so they stay flagged while any watch is set
+ * @param dbg: debugger
+ * @param inst: decoded instruction
+ * @param op: one of the instruction's operands
+ * @return YES if the instruction needs the slow path for this operand, NO otherwise
+ */
+static int may_touch_watch(const debugger *dbg, const decoded_instruction *inst, const decoded_operand *op) {
+    if (dbg->watch_count == 0 || !operand_access(inst, op)) return NO;
+    if (op->mode == MODE_MATRIX) return YES;
+    return BITMAP_TEST(dbg->watchpoints, op->value);
+}
+
+/**
+ * refresh_hooks - flag exactly the instructions that can stop the program
+ * @param dbg: debugger whose points changed
+ */
+static void refresh_hooks(debugger *dbg) {
+    const decoded_instruction *inst;
+    int address;
+    int enabled;
+
+    for (address = 0; address < MACHINE_MEMORY_SIZE; address++) {
+        inst = &dbg->m->decoded[address];
+        enabled = BITMAP_TEST(dbg->breakpoints, address);
+        if (!(inst->flags & DECODED_INVALID)) {
+            enabled = enabled || may_touch_watch(dbg, inst, &inst->src) || may_touch_watch(dbg, inst, &inst->dst);
+        }
+        machine_set_hook_map(dbg->m, address, enabled);
+    }
+}
+
+/**
+ * watched_access - find a watched address the instruction is about to touch
+ * @param dbg: debugger
+ * @param inst: instruction at the program counter
+ * @return the watched address, or -1 if there is none
+ */
+static int watched_access(const debugger *dbg, const decoded_instruction *inst) {
+    int address;
+
+    if (operand_access(inst, &inst->src)) {
+        address = operand_address(dbg->m, &inst->src);
+        if (BITMAP_TEST(dbg->watchpoints, address)) return address;
+    }
+    if (operand_access(inst, &inst->dst)) {
+        address = operand_address(dbg->m, &inst->dst);
+        if (BITMAP_TEST(dbg->watchpoints, address)) return address;
+    }
+    return -1;
+}
+
+/**
+ * debugger_hook - slow-path hook that stops on breakpoints and watched accesses
+ * @param m: machine about to execute
+ * @param inst: instruction at the program counter
+ * @return MACHINE_PAUSED on a hit, MACHINE_RUNNING otherwise
+ */
+machine_state debugger_hook(machine *m, const decoded_instruction *inst) {
+    const debugger *dbg = m->hook_data;
+    int address;
+
+    if (BITMAP_TEST(dbg->breakpoints, m->pc)) {
+        printf(MSG_BREAKPOINT_HIT, m->pc);
+        return MACHINE_PAUSED;
+    }
+
+    address = watched_access(dbg, inst);
+    if (address >= 0) {
+        printf(MSG_WATCHPOINT_HIT, address, m->pc);
+        return MACHINE_PAUSED;
+    }
+
+    return MACHINE_RUNNING;
+}
+
+/**
+ * instruction_containing - find the instruction that holds a code address
+ * @param m: machine with pre-decoded code
+ * @param address: address of any word of an instruction
+ * @return address of the instruction word, or -1 if outside the code
+ */
+static int instruction_containing(const machine *m, int address) {
+    int start = INITIAL_IC;
+
+    while (start < m->code_end && !(m->decoded[start].flags & DECODED_INVALID)) {
+        if (address < start + m->decoded[start].length) {
+            return address >= start ? start : -1;
+        }
+        start += m->decoded[start].length;
+    }
+    return -1;
+}
+
+/**
+ * resolve_address - turn a decimal address or entry label into an address
+ * @param dbg: debugger holding the symbols
+ * @param target: command argument
+ * @param address: output parameter for the address
+ * @return SUCCESS if resolved, FAILURE otherwise
+ */
+static int resolve_address(const debugger *dbg, const char *target, int *address) {
+    const object_symbol *symbol;
+    char *end;
+    long value;
+
+    value = strtol(target, &end, BASE_10);
+    if (end != target && *end == NULL_CHAR) {
+        if (value < 0 || value >= MACHINE_MEMORY_SIZE) return FAILURE;
+        *address = (int)value;
+        return SUCCESS;
+    }
+
+    symbol = find_object_symbol(dbg->entries, target);
+    if (!symbol) return FAILURE;
+    *address = symbol->address;
+    return SUCCESS;
+}
+
+/**
+ * apply_to_target - run an action on every address a target names
+ * an external name stands for each instruction that references it
+ * @param dbg: debugger
+ * @param command: command name, for messages
+ * @param target: command argument, or NULL if missing
+ * @param action: action to apply
+ * @param allow_externals: whether external names are accepted
+ * @return SUCCESS if the target resolved and every action succeeded, FAILURE otherwise
+ */
+static int apply_to_target(debugger *dbg, const char *command, const char *target,
+                           target_action action, int allow_externals) {
+    int address;
+    int found = NO;
+    int result = SUCCESS;
+    int i;
+
+    if (!target) {
+        fprintf(stderr, ERROR_MISSING_TARGET, command);
+        return FAILURE;
+    }
+
+    if (resolve_address(dbg, target, &address) == SUCCESS) {
+        return action(dbg, address);
+    }
+
+    for (i = 0; i < dbg->externals->count; i++) {
+        if (strcmp(dbg->externals->symbols[i].name, target) != 0) continue;
+        if (!allow_externals) {
+            fprintf(stderr, ERROR_EXTERNAL_WATCH, target);
+            return FAILURE;
+        }
+        found = YES;
+        if (action(dbg, instruction_containing(dbg->m, dbg->externals->symbols[i].address)) == FAILURE) {
+            result = FAILURE;
+        }
+    }
+
+    if (!found) {
+        fprintf(stderr, ERROR_UNKNOWN_TARGET, target);
+        return FAILURE;
+    }
+    return result;
+}
+
+/**
+ * set_breakpoint - mark an instruction address in the breakpoint bitmap
+ * @param dbg: debugger
+ * @param address: instruction address
+ * @return SUCCESS if the address starts an instruction, FAILURE otherwise
+ */
+static int set_breakpoint(debugger *dbg, int address) {
+    if (address < 0 || (dbg->m->decoded[address].flags & DECODED_INVALID)) {
+        fprintf(stderr, ERROR_NOT_AN_INSTRUCTION, address);
+        return FAILURE;
+    }
+    BITMAP_SET(dbg->breakpoints, address);
+    printf(MSG_BREAKPOINT_SET, address);
+    return SUCCESS;
+}
+
+/**
+ * set_watchpoint - mark a data address in the watchpoint bitmap
+ * @param dbg: debugger
+ * @param address: memory address
+ * @return SUCCESS
+ */
+static int set_watchpoint(debugger *dbg, int address) {
+    if (!BITMAP_TEST(dbg->watchpoints, address)) {
+        BITMAP_SET(dbg->watchpoints, address);
+        dbg->watch_count++;
+    }
+    printf(MSG_WATCHPOINT_SET, address);
+    return SUCCESS;
+}
+
+/**
+ * delete_points - clear breakpoint and watchpoint bits for an address
+ * @param dbg: debugger
+ * @param address: memory address
+ * @return SUCCESS
+ */
+static int delete_points(debugger *dbg, int address) {
+    if (address < 0) return SUCCESS;
+    if (BITMAP_TEST(dbg->watchpoints, address)) {
+        BITMAP_CLEAR(dbg->watchpoints, address);
+        dbg->watch_count--;
+    }
+    BITMAP_CLEAR(dbg->breakpoints, address);
+    printf(MSG_DELETED, address);
+    return SUCCESS;
+}
+
+/**
+ * report_state - describe why execution stopped
+ * @param m: machine that stopped
+ * @param state: state returned by the engine
+ */
+static void report_state(const machine *m, machine_state state) {
+    switch (state) {
+        case MACHINE_HALTED:
+            printf(MSG_PROGRAM_HALTED, m->steps);
+            break;
+        case MACHINE_FAULT:
+            printf(MSG_PROGRAM_FAULTED, m->pc);
+            break;
+        case MACHINE_RUNNING:
+            printf(MSG_STOPPED_AT, m->pc);
+            break;
+        default:
+            /* the hook already reported the breakpoint or watchpoint */
+            break;
+    }
+}
+
+/**
+ * show_registers - print registers, the zero flag and counters
+ * @param m: machine to show
+ */
+static void show_registers(const machine *m) {
+    int i;
+
+    for (i = 0; i < NUM_REGISTERS; i++) {
+        printf(MSG_REGISTER, i, word_to_int(m->registers[i]));
+    }
+    printf(MSG_MACHINE_STATUS, m->pc, m->zero_flag, m->stack_depth, m->steps);
+}
+
+/**
+ * show_memory - print consecutive memory words
+ * @param dbg: debugger
+ * @param target: start address or entry label
+ * @param count_text: number of words, or NULL for the default
+ */
+static void show_memory(const debugger *dbg, const char *target, const char *count_text) {
+    int address;
+    int count = DEFAULT_DUMP_WORDS;
+    int i;
+
+    if (!target) {
+        fprintf(stderr, ERROR_MISSING_TARGET, CMD_MEM);
+        return;
+    }
+    if (resolve_address(dbg, target, &address) == FAILURE) {
+        fprintf(stderr, ERROR_UNKNOWN_TARGET, target);
+        return;
+    }
+    if (count_text) count = atoi(count_text);
+
+    for (i = 0; i < count; i++) {
+        printf(MSG_MEMORY_WORD, (address + i) & MACHINE_ADDRESS_MASK,
+               word_to_int(dbg->m->memory[(address + i) & MACHINE_ADDRESS_MASK]));
+    }
+}
+
+/**
+ * is_command - compare a command word against its long and short names
+ * @param word: command word typed by the user
+ * @param name: full command name
+ * @param short_name: one-letter alias
+ * @return YES if the word names the command, NO otherwise
+ */
+static int is_command(const char *word, const char *name, const char *short_name) {
+    return strcmp(word, name) == 0 || strcmp(word, short_name) == 0;
+}
+
+/**
+ * resume - continue or single-step the program
+ * execution starts with one unhooked step so a stop at the current
+ * instruction does not trigger again
+ * @param dbg: debugger
+ * @param single: YES to execute one instruction, NO to run
+ * @return state after resuming
+ */
+static machine_state resume(debugger *dbg, int single) {
+    machine_state state = MACHINE_RUNNING;
+
+    if (dbg->m->state == MACHINE_HALTED || dbg->m->state == MACHINE_FAULT) {
+        fprintf(stderr, ERROR_PROGRAM_ENDED);
+        return dbg->m->state;
+    }
+
+    if (single || dbg->stopped) state = machine_step(dbg->m);
+    if (!single && state == MACHINE_RUNNING) state = machine_run(dbg->m);
+
+    dbg->stopped = YES;
+    report_state(dbg->m, state);
+    return state;
+}
+
+/**
+ * run_debugger - read and execute debugger commands until quit or end of input
+ * @param dbg: attached debugger
+ * @param commands: stream of debugger commands
+ * @return final machine state
+ */
+machine_state run_debugger(debugger *dbg, FILE *commands) {
+    char line[MAX_DEBUGGER_COMMAND];
+    char *word;
+    char *target;
+
+    printf(DEBUGGER_PROMPT);
+    fflush(stdout);
+    while (fgets(line, sizeof(line), commands)) {
+        word = strtok(line, WHITESPACE_CHARS);
+        target = word ? strtok(NULL, WHITESPACE_CHARS) : NULL;
+
+        if (!word) {
+            /* empty line */
+        } else if (is_command(word, CMD_BREAK, CMD_BREAK_SHORT)) {
+            apply_to_target(dbg, CMD_BREAK, target, set_breakpoint, YES);
+            refresh_hooks(dbg);
+        } else if (is_command(word, CMD_WATCH, CMD_WATCH_SHORT)) {
+            apply_to_target(dbg, CMD_WATCH, target, set_watchpoint, NO);
+            refresh_hooks(dbg);
+        } else if (is_command(word, CMD_DELETE, CMD_DELETE_SHORT)) {
+            apply_to_target(dbg, CMD_DELETE, target, delete_points, YES);
+            refresh_hooks(dbg);
+        } else if (is_command(word, CMD_STEP, CMD_STEP_SHORT)) {
+            resume(dbg, YES);
+        } else if (is_command(word, CMD_CONTINUE, CMD_CONTINUE_SHORT)) {
+            resume(dbg, NO);
+        } else if (is_command(word, CMD_REGS, CMD_REGS_SHORT)) {
+            show_registers(dbg->m);
+        } else if (is_command(word, CMD_MEM, CMD_MEM_SHORT)) {
+            show_memory(dbg, target, target ? strtok(NULL, WHITESPACE_CHARS) : NULL);
+        } else if (is_command(word, CMD_QUIT, CMD_QUIT_SHORT)) {
+            break;
+        } else if (is_command(word, CMD_HELP, CMD_HELP_SHORT)) {
+            printf(MSG_DEBUGGER_HELP_POINTS);
+            printf(MSG_DEBUGGER_HELP_EXECUTION);
+        } else {
+            fprintf(stderr, ERROR_UNKNOWN_COMMAND, word);
+        }
+
+        printf(DEBUGGER_PROMPT);
+        fflush(stdout);
+    }
+
+    return dbg->m->state;
+}
@@ -0,0 +1,102 @@
+#ifndef DEBUGGER_H
+#define DEBUGGER_H
+
+#include <stdio.h>
+#include "machine.h"
+#include "obj_reader.h"
+
+/* command input */
+#define DEBUGGER_PROMPT "(dbg) "
+#define MAX_DEBUGGER_COMMAND 128
+#define DEFAULT_DUMP_WORDS 8
+
+/* debugger commands (full name and short form) */
+#define CMD_BREAK "break"
+#define CMD_BREAK_SHORT "b"
+#define CMD_DELETE "delete"
+#define CMD_DELETE_SHORT "d"
+#define CMD_WATCH "watch"
+#define CMD_WATCH_SHORT "w"
+#define CMD_STEP "step"
+#define CMD_STEP_SHORT "s"
+#define CMD_CONTINUE "continue"
+#define CMD_CONTINUE_SHORT "c"
+#define CMD_REGS "regs"
+#define CMD_REGS_SHORT "r"
+#define CMD_MEM "mem"
+#define CMD_MEM_SHORT "x"
+#define CMD_QUIT "quit"
+#define CMD_QUIT_SHORT "q"
+#define CMD_HELP "help"
+#define CMD_HELP_SHORT "h"
+
+/* messages */
+#define MSG_DEBUGGER_HELP_POINTS \
+    "Commands:\n" \
+    "  break|b TARGET      stop before the instruction at TARGET\n" \
+    "  delete|d TARGET     remove breakpoints and watchpoints at TARGET\n" \
+    "  watch|w TARGET      stop before an instruction reads or writes TARGET\n"
+#define MSG_DEBUGGER_HELP_EXECUTION \
+    "  step|s              execute one instruction\n" \
+    "  continue|c          run until a breakpoint, watchpoint or halt\n" \
+    "  regs|r              show registers, flags and the call stack depth\n" \
+    "  mem|x TARGET [N]    show N words of memory from TARGET\n" \
+    "  quit|q              leave the debugger\n" \
+    "TARGET is a decimal address, an entry label (.ent) or an external name (.ext)\n"
+#define MSG_BREAKPOINT_SET "Breakpoint at %d\n"
+#define MSG_WATCHPOINT_SET "Watchpoint at %d\n"
+#define MSG_DELETED "Deleted breakpoints and watchpoints at %d\n"
+#define MSG_BREAKPOINT_HIT "Breakpoint at %d\n"
+#define MSG_WATCHPOINT_HIT "Watchpoint: address %d accessed by instruction at %d\n"
+#define MSG_STOPPED_AT "Stopped at %d\n"
+#define MSG_PROGRAM_HALTED "Program halted after %lu instructions\n"
+#define MSG_PROGRAM_FAULTED "Program faulted at %d\n"
+#define MSG_REGISTER "r%d=%d "
+#define MSG_MACHINE_STATUS "\npc=%d zero=%d stack=%d steps=%lu\n"
+#define MSG_MEMORY_WORD "%4d: %5d\n"
+
+/* error messages */
+#define ERROR_UNKNOWN_COMMAND "Error: unknown debugger command '%s' (try 'help')\n"
+#define ERROR_MISSING_TARGET "Error: '%s' needs an address or symbol\n"
+#define ERROR_UNKNOWN_TARGET "Error: '%s' is not an address, entry or external\n"
+#define ERROR_EXTERNAL_WATCH "Error: external '%s' has no address in this image\n"
+#define ERROR_NOT_AN_INSTRUCTION "Error: address %d is not the start of an instruction\n"
+#define ERROR_PROGRAM_ENDED "Error: the program is no longer running\n"
+
+/* debugger session state */
+typedef struct {
+    machine *m;                                                 /* machine being debugged */
+    const symbol_file *entries;                                 /* labels from the .ent file */
+    const symbol_file *externals;                               /* references from the .ext file */
+    unsigned char breakpoints[BITMAP_BYTES(MACHINE_MEMORY_SIZE)];   /* shadow bitmap of instruction addresses */
+    unsigned char watchpoints[BITMAP_BYTES(MACHINE_MEMORY_SIZE)];   /* shadow bitmap of data addresses */
+    int watch_count;                                            /* number of watched addresses */
+    int stopped;                                                /* YES once stopped before the instruction at pc */
+} debugger;
+
+/**
+ * init_debugger - attach a debugger to a loaded machine
+ * @param dbg: debugger to initialize
+ * @param m: machine prepared with init_machine
+ * @param entries: entry symbols, used to resolve labels
+ * @param externals: external references, used to resolve external names
+ */
+void init_debugger(debugger *dbg, machine *m, const symbol_file *entries, const symbol_file *externals);
+
+/**
+ * debugger_hook - slow-path hook that stops on breakpoints and watched accesses
+ * @param m: machine about to execute
+ * @param inst: instruction at the program counter
+ * @return MACHINE_PAUSED on a hit, MACHINE_RUNNING otherwise
+ */
+machine_state debugger_hook(machine *m, const decoded_instruction *inst);
+
+/**
+ * run_debugger - read and execute debugger commands until quit or end of input
+ * @param dbg: attached debugger
+ * @param commands: stream of debugger commands
+ * @return final machine state
+ */
+machine_state run_debugger(debugger *dbg, FILE *commands);
+
+#endif /* DEBUGGER_H */
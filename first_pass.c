@@ -1,6 +1,8 @@
 #include "first_pass.h"
 #include "utils.h"
 #include "parser.h"
+#include "line_memo.h"
+#include "source_reader.h"
 #include "labelTable.h"
 #include "commands.h"
 #include <stdio.h>
@@ -10,6 +12,7 @@
 #define ERROR_MAT_REQUIRES_DIMENSION "Error: .mat directive requires at least dimension specification\n"
 #define ERROR_INVALID_MATRIX_DIMENSIONS "Error: invalid matrix dimensions in '%s'\n"
 #define ERROR_MATRIX_VALUES_MISMATCH "Error: matrix expects 0 or %d values, got %d\n"
+#define ERROR_LOCAL_LABEL_DIRECTIVE "Error (line %d): local label '%s' cannot be named by %s\n"
 #include <ctype.h>
 #include <stdlib.h>
 
@@ -184,7 +187,7 @@ static int estimate_ic_words(const separate_line* parts) {
     }
     /* instruction with one operand */
     else if (inst->num_of_operands == 1) {
-        dst_mode = get_operand_mode(parts->operands[0]);
+        dst_mode = line_operand_mode(parts, 0);
         if (dst_mode == FAILURE) return 0;
 
         /* matrix access needs 2 additional words */
@@ -196,8 +199,8 @@ static int estimate_ic_words(const separate_line* parts) {
     }
     /* instruction with two operands */
     else if (inst->num_of_operands == 2) {
-        src_mode = get_operand_mode(parts->operands[0]);
-        dst_mode = get_operand_mode(parts->operands[1]);
+        src_mode = line_operand_mode(parts, 0);
+        dst_mode = line_operand_mode(parts, 1);
         if (src_mode == FAILURE || dst_mode == FAILURE) return 0;
 
         /* optimization: register to register can be packed in one word */
@@ -273,16 +276,17 @@ static int define_label(label_table* table, const char* name, int address, label
 }
 
 /**
- * process_line - process a single line during first pass
- * @param line: input line string to process
+ * process_line - process a single statement during first pass
+ * @param parts: parsed statement, released here
  * @param table: label table to populate with labels
+ * @param scope: global labels so far (incremented for a global label); local labels go to its scope
  * @param IC: instruction counter (incremented for instructions)
  * @param DC: data counter (incremented for data directives)
  * @param line_number: current line number for error reporting
  * @return SUCCESS if line processed successfully, FAILURE otherwise
  */
-static int process_line(const char* line, label_table* table, int* IC, int* DC, int line_number) {
-    separate_line* parts;
+static int process_line(const separate_line* parts, label_table* table, int* scope, int* IC, int* DC, int line_number) {
+    label_table* labels = table;
     int had_label = 0;
     int count = 0;
     int i;
@@ -293,22 +297,15 @@ static int process_line(const char* line, label_table* table, int* IC, int* DC,
     int rows, cols, total_elements;
     label_node* ex;
 
-    /* skip empty/whitespace lines and comment lines starting with ';' */
-    if (!line) return SUCCESS;
-    while (*line == SPACE_CHAR || *line == TAB_CHAR)
-        line++;
-    if (*line == CARRIAGE_RETURN_CHAR) line++;
-    if (*line == NULL_CHAR || *line == NEWLINE_CHAR || *line == SEMICOLON_CHAR)
-        return SUCCESS;
-
-    parts = parse_line(line);
-    if (!parts) {
-        fprintf(stderr, ERROR_PARSE_FAILED_LINE, line_number);
-        return FAILURE;
-    }
-
     if (parts->label) {
         had_label = 1;
+        /* a global label opens a new scope, a local one is defined in the current scope */
+        if (!is_local_label(parts->label)) {
+            (*scope)++;
+        } else if (!(labels = local_scope_table(table, *scope))) {
+            release_line(parts);
+            return FAILURE;
+        }
     }
 
     /* .data: numeric constants handling */
@@ -320,13 +317,13 @@ static int process_line(const char* line, label_table* table, int* IC, int* DC,
                 op++;
             if (!*op || !isdigit((unsigned char)*op)) {
                 fprintf(stderr, ERROR_INVALID_IMMEDIATE_LINE, line_number, parts->operands[i]);
-                free_separate_line(parts);
+                release_line(parts);
                 return FAILURE;
             }
             while (*op) {
                 if (!isdigit((unsigned char)*op)) {
                     fprintf(stderr, ERROR_INVALID_IMMEDIATE_LINE, line_number, parts->operands[i]);
-                    free_separate_line(parts);
+                    release_line(parts);
                     return FAILURE;
                 }
                 op++;
@@ -334,13 +331,13 @@ static int process_line(const char* line, label_table* table, int* IC, int* DC,
             count++;
         }
         if (had_label) {
-            if (define_label(table, parts->label, *DC, LABEL_DATA) == FAILURE) {
-                free_separate_line(parts);
+            if (define_label(labels, parts->label, *DC, LABEL_DATA) == FAILURE) {
+                release_line(parts);
                 return FAILURE;
             }
         }
         *DC += count;
-        free_separate_line(parts);
+        release_line(parts);
         return SUCCESS;
     }
 
@@ -348,7 +345,7 @@ static int process_line(const char* line, label_table* table, int* IC, int* DC,
     if (is_string_directive(parts->command) == YES) {
         if (parts->how_many_operands != 1 || parts->operands[0][0] != QUOTE_CHAR) {
             fprintf(stderr, ERROR_INVALID_STRING_LINE, line_number, parts->how_many_operands ? parts->operands[0] : "");
-            free_separate_line(parts);
+            release_line(parts);
             return FAILURE;
         }
         {
@@ -356,18 +353,18 @@ static int process_line(const char* line, label_table* table, int* IC, int* DC,
             len = strlen(s);
             if (len < 2 || s[len - 1] != QUOTE_CHAR) {
                 fprintf(stderr, ERROR_INVALID_STRING_LINE, line_number, s);
-                free_separate_line(parts);
+                release_line(parts);
                 return FAILURE;
             }
             if (had_label) {
-                if (define_label(table, parts->label, *DC, LABEL_DATA) == FAILURE) {
-                    free_separate_line(parts);
+                if (define_label(labels, parts->label, *DC, LABEL_DATA) == FAILURE) {
+                    release_line(parts);
                     return FAILURE;
                 }
             }
             *DC += (int)((len >= 2 ? (len - 2) : 0) + 1);
         }
-        free_separate_line(parts);
+        release_line(parts);
         return SUCCESS;
     }
 
@@ -377,13 +374,13 @@ static int process_line(const char* line, label_table* table, int* IC, int* DC,
 
         if (parts->how_many_operands < 1) {
             fprintf(stderr, ERROR_MAT_REQUIRES_DIMENSION);
-            free_separate_line(parts);
+            release_line(parts);
             return FAILURE;
         }
 
         if (parse_matrix_dimensions(parts->operands[0], &rows, &cols) == FAILURE) {
             fprintf(stderr, ERROR_INVALID_MATRIX_DIMENSIONS, parts->operands[0]);
-            free_separate_line(parts);
+            release_line(parts);
             return FAILURE;
         }
 
@@ -395,13 +392,13 @@ static int process_line(const char* line, label_table* table, int* IC, int* DC,
 
             if (!*op || !isdigit((unsigned char)*op)) {
                 fprintf(stderr, ERROR_INVALID_IMMEDIATE_LINE, line_number, parts->operands[i]);
-                free_separate_line(parts);
+                release_line(parts);
                 return FAILURE;
             }
             while (*op) {
                 if (!isdigit((unsigned char)*op)) {
                     fprintf(stderr, ERROR_INVALID_IMMEDIATE_LINE, line_number, parts->operands[i]);
-                    free_separate_line(parts);
+                    release_line(parts);
                     return FAILURE;
                 }
                 op++;
@@ -412,44 +409,57 @@ static int process_line(const char* line, label_table* table, int* IC, int* DC,
         if (values_provided != 0 && values_provided != total_elements) {
             fprintf(stderr, ERROR_MATRIX_VALUES_MISMATCH,
                     total_elements, values_provided);
-            free_separate_line(parts);
+            release_line(parts);
             return FAILURE;
         }
 
         if (had_label) {
-            if (define_label(table, parts->label, *DC, LABEL_DATA) == FAILURE) {
-                free_separate_line(parts);
+            if (define_label(labels, parts->label, *DC, LABEL_DATA) == FAILURE) {
+                release_line(parts);
                 return FAILURE;
             }
         }
 
         *DC += total_elements;
-        free_separate_line(parts);
+        release_line(parts);
         return SUCCESS;
     }
 
     /* .extern: declare external labels handling */
     if (is_extern_directive(parts->command) == YES) {
         for (i = 0; i < parts->how_many_operands; i++) {
+            if (is_local_label(parts->operands[i])) {
+                fprintf(stderr, ERROR_LOCAL_LABEL_DIRECTIVE, line_number, parts->operands[i], DIRECTIVE_EXTERN);
+                release_line(parts);
+                return FAILURE;
+            }
             ex = find_label(table, parts->operands[i]);
             if (ex && ex->is_defined) {
                 fprintf(stderr, ERROR_LABEL_ALREADY_DEFINED, parts->operands[i]);
-                free_separate_line(parts);
+                release_line(parts);
                 return FAILURE;
             }
             if (!ex) {
                 add_label(table, parts->operands[i], 0, LABEL_EXTERNAL);
             }
         }
-        free_separate_line(parts);
+        release_line(parts);
         return SUCCESS;
     }
 
     /* .entry: mark labels as ENTRY handling */
     if (is_entry_directive(parts->command) == YES) {
         for (i = 0; i < parts->how_many_operands; i++) {
-            label_node* en = find_label(table, parts->operands[i]);
+            label_node* en;
+
+            if (is_local_label(parts->operands[i])) {
+                fprintf(stderr, ERROR_LOCAL_LABEL_DIRECTIVE, line_number, parts->operands[i], DIRECTIVE_ENTRY);
+                release_line(parts);
+                return FAILURE;
+            }
+            en = find_label(table, parts->operands[i]);
             if (en) {
+                en->is_entry = YES;
                 if (en->is_defined) {
                     /* if label is already defined, mark it as entry but keep original type for data labels */
                     if (en->type != LABEL_DATA) {
@@ -462,10 +472,12 @@ static int process_line(const char* line, label_table* table, int* IC, int* DC,
                 }
             } else {
                 /* create a placeholder entry label - it will be updated when the actual label is defined */
-                add_label(table, parts->operands[i], 0, LABEL_ENTRY);
+                if (add_label(table, parts->operands[i], 0, LABEL_ENTRY) == SUCCESS) {
+                    find_label(table, parts->operands[i])->is_entry = YES;
+                }
             }
         }
-        free_separate_line(parts);
+        release_line(parts);
         return SUCCESS;
     }
 
@@ -473,82 +485,105 @@ static int process_line(const char* line, label_table* table, int* IC, int* DC,
     {
         words = estimate_ic_words(parts);
         if (words == 0) {
-            free_separate_line(parts);
+            release_line(parts);
             return FAILURE;
         }
         if (had_label) {
-            if (define_label(table, parts->label, *IC, LABEL_CODE) == FAILURE) {
-                free_separate_line(parts);
+            if (define_label(labels, parts->label, *IC, LABEL_CODE) == FAILURE) {
+                release_line(parts);
                 return FAILURE;
             }
         }
         *IC += words;
     }
 
-    free_separate_line(parts);
+    release_line(parts);
     return SUCCESS;
 }
 
 /**
- * first_pass_on_table - run first pass using given label table
+ * relocate_data_labels - move data labels after the instructions
+ * @param table: label table
+ * @param ic_final: final instruction counter
+ */
+static void relocate_data_labels(label_table* table, int ic_final) {
+    label_node* current;
+
+    current = table->head;
+    while (current) {
+        if (current->type == LABEL_DATA && current->is_defined) {
+
+            /* add IC_final to data addresses to place them after instructions */
+            current->address += ic_final;
+        }
+        current = current->next;
+    }
+}
+
+/**
+ * scan_source - first pass over a source, optionally recording the line of each code word
  * @param filename: path to macro-expanded source file (.am)
+ * @param program: loaded IR program to read instead of filename, or NULL
  * @param table: symbol table to populate during first pass
  * @param outIC: output parameter for final instruction counter
  * @param outDC: output parameter for final data counter
+ * @param code_lines: indexed by address, set to the line of each instruction word, or NULL
+ * @param size: number of entries in code_lines
  * @return SUCCESS if first pass completed successfully, FAILURE otherwise
  */
-int first_pass_on_table(const char* filename, label_table* table, int* outIC, int* outDC) {
-    FILE* file;
-    char line[MAX_LINE_LENGTH];
+static int scan_source(const char* filename, const ir_program* program, label_table* table, int* outIC, int* outDC,
+                       int* code_lines, int size) {
+    source_reader reader;
+    const separate_line* parts;
     int IC;
     int DC;
-    int line_number;
+    int line_IC;
+    int status;
     int has_errors;
-    label_node* current;
-
-    file = open_file_read(filename);
+    int scope;
+    local_scope* locals;
 
     IC = INITIAL_IC;
     DC = INITIAL_DC;
-    line_number = INITIAL_LINE_NUMBER;
     has_errors = 0;
+    scope = 0;
 
-    if (!file) {
+    if (table == NULL) {
         return FAILURE;
     }
 
-    if (table == NULL) {
-        fclose(file);
+    if (open_source(&reader, filename, program) == FAILURE) {
         return FAILURE;
     }
 
-    while (fgets(line, sizeof(line), file)) {
-        if (strlen(line) >= MAX_LINE_LENGTH - 1 && line[MAX_LINE_LENGTH - 2] != NEWLINE_CHAR) {
+    while ((status = read_source_line(&reader, &parts)) != SOURCE_END) {
+        if (status == SOURCE_TOO_LONG) {
             fprintf(stderr, ERROR_LINE_TOO_LONG, MAX_LINE_LENGTH - 1);
             has_errors = 1;
-            line_number++;
+            continue;
+        }
+        if (status == SOURCE_UNPARSED) {
+            fprintf(stderr, ERROR_PARSE_FAILED_LINE, reader.line_number);
+            has_errors = 1;
             continue;
         }
 
-        if (!process_line(line, table, &IC, &DC, line_number)) {
+        line_IC = IC;
+        if (!process_line(parts, table, &scope, &IC, &DC, reader.line_number)) {
             has_errors = 1;
         }
-        line_number++;
+        for (; code_lines && line_IC < IC && line_IC < size; line_IC++) {
+            code_lines[line_IC] = reader.line_number;
+        }
     }
 
-    fclose(file);
+    close_source(&reader);
 
     /* update data label addresses after first pass */
     if (!has_errors) {
-
-        current = table->head;
-        while (current) {
-            if (current->type == LABEL_DATA && current->is_defined) {
-
-                /* add IC_final to data addresses to place them after instructions */
-                current->address += IC;
-            }
-            current = current->next;
+        relocate_data_labels(table, IC);
+        for (locals = table->scopes; locals; locals = locals->next) {
+            relocate_data_labels(&locals->labels, IC);
         }
     }
 
@@ -558,6 +593,49 @@ int first_pass_on_table(const char* filename, label_table* table, int* outIC, in
     return has_errors ? FAILURE : SUCCESS;
 }
 
+/**
+ * first_pass_on_table - run first pass using given label table
+ * @param filename: path to macro-expanded source file (.am)
+ * @param table: symbol table to populate during first pass
+ * @param outIC: output parameter for final instruction counter
+ * @param outDC: output parameter for final data counter
+ * @return SUCCESS if first pass completed successfully, FAILURE otherwise
+ */
+int first_pass_on_table(const char* filename, label_table* table, int* outIC, int* outDC) {
+    return scan_source(filename, NULL, table, outIC, outDC, NULL, 0);
+}
+
+/**
+ * first_pass_on_program - run first pass over a loaded IR program
+ * @param program: IR program from load_ir_program
+ * @param table: symbol table to populate during first pass
+ * @param outIC: output parameter for final instruction counter
+ * @param outDC: output parameter for final data counter
+ * @return SUCCESS if first pass completed successfully, FAILURE otherwise
+ */
+int first_pass_on_program(const ir_program* program, label_table* table, int* outIC, int* outDC) {
+    return scan_source(NULL, program, table, outIC, outDC, NULL, 0);
+}
+
+/**
+ * first_pass_code_lines - find the source line of every instruction word
+ * @param filename: path to macro-expanded source file (.am)
+ * @param code_lines: indexed by address; entries for instruction words get their
+ *                    line number, the others are left unchanged
+ * @param size: number of entries in code_lines
+ * @return SUCCESS if first pass completed successfully, FAILURE otherwise
+ */
+int first_pass_code_lines(const char* filename, int* code_lines, int size) {
+    label_table table;
+    int rc;
+    int IC, DC;
+
+    init_label_table(&table);
+    rc = scan_source(filename, NULL, &table, &IC, &DC, code_lines, size);
+    free_label_table(&table);
+    return rc;
+}
+
 /**
  * first_pass - run the assembler first pass over a source file
  * @param filename: path to macro-expanded source file (.am)
@@ -2,6 +2,7 @@
 #define FIRST_PASS_H
 
 #include "labelTable.h"
+#include "ir_format.h"
 
 /**
  * run the assembler first pass over a source file
@@ -20,4 +21,24 @@ int first_pass(const char* filename);
  */
 int first_pass_on_table(const char* filename, label_table* table, int* outIC, int* outDC);
 
+/**
+ * first_pass_on_program - run first pass over a loaded IR program
+ * @param program: IR program from load_ir_program
+ * @param table: symbol table to populate during first pass
+ * @param outIC: output parameter for final instruction counter
+ * @param outDC: output parameter for final data counter
+ * @return SUCCESS if first pass completed successfully, FAILURE otherwise
+ */
+int first_pass_on_program(const ir_program* program, label_table* table, int* outIC, int* outDC);
+
+/**
+ * first_pass_code_lines - find the source line of every instruction word
+ * @param filename: path to macro-expanded source file (.am)
+ * @param code_lines: indexed by address; entries for instruction words get their
+ *                    line number, the others are left unchanged
+ * @param size: number of entries in code_lines
+ * @return SUCCESS if first pass completed successfully, FAILURE otherwise
+ */
+int first_pass_code_lines(const char* filename, int* code_lines, int size);
+
 #endif /* FIRST_PASS_H */ 
\ No newline at end of file
@@ -0,0 +1,209 @@
+#include "global_symbols.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * init_global_map - create an empty symbol map
+ * @param map: map to initialize
+ * @return SUCCESS if allocated, FAILURE otherwise
+ */
+int init_global_map(global_symbol_map *map) {
+    map->buckets = calloc(GLOBAL_MAP_INITIAL_BUCKETS, sizeof(global_symbol *));
+    if (!map->buckets) {
+        fprintf(stderr, MALLOC_FAILED);
+        return FAILURE;
+    }
+    map->bucket_count = GLOBAL_MAP_INITIAL_BUCKETS;
+    map->count = 0;
+    map->first_added = NULL;
+    map->last_added = NULL;
+    return SUCCESS;
+}
+
+/**
+ * grow_map - double the bucket array and rehash
+ * a failed allocation keeps the old buckets, which only lengthens chains
+ * @param map: map to grow
+ */
+static void grow_map(global_symbol_map *map) {
+    global_symbol **buckets;
+    global_symbol *symbol;
+    int size = map->bucket_count * 2;
+    int index;
+
+    buckets = calloc(size, sizeof(global_symbol *));
+    if (!buckets) return;
+
+    for (symbol = map->first_added; symbol; symbol = symbol->next_added) {
+        index = (int)(symbol->hash & (unsigned long)(size - 1));
+        symbol->next = buckets[index];
+        buckets[index] = symbol;
+    }
+
+    free(map->buckets);
+    map->buckets = buckets;
+    map->bucket_count = size;
+}
+
+/**
+ * get_symbol - find a symbol, adding it if missing
+ * @param map: batch-wide map
+ * @param name: symbol name
+ * @return symbol node, or NULL on allocation failure
+ */
+static global_symbol *get_symbol(global_symbol_map *map, const char *name) {
+    global_symbol *symbol;
+    unsigned long hash = hash_string(name);
+    int index = (int)(hash & (unsigned long)(map->bucket_count - 1));
+
+    for (symbol = map->buckets[index]; symbol; symbol = symbol->next) {
+        if (symbol->hash == hash && strcmp(symbol->name, name) == 0) return symbol;
+    }
+
+    symbol = malloc(sizeof(global_symbol) + strlen(name) + 1);
+    if (!symbol) {
+        fprintf(stderr, MALLOC_FAILED);
+        return NULL;
+    }
+    symbol->name = (char *)(symbol + 1);
+    strcpy(symbol->name, name);
+    symbol->hash = hash;
+    symbol->exporters = NULL;
+    symbol->importers = NULL;
+    symbol->export_count = 0;
+    symbol->next_added = NULL;
+
+    symbol->next = map->buckets[index];
+    map->buckets[index] = symbol;
+    if (map->last_added) {
+        map->last_added->next_added = symbol;
+    } else {
+        map->first_added = symbol;
+    }
+    map->last_added = symbol;
+    map->count++;
+
+    if (map->count > map->bucket_count * GLOBAL_MAP_MAX_LOAD) grow_map(map);
+    return symbol;
+}
+
+/**
+ * add_file - prepend a file to a symbol's exporter or importer list
+ * @param list: list head to update
+ * @param filename: file name
+ * @return SUCCESS if added, FAILURE on allocation failure
+ */
+static int add_file(global_file **list, const char *filename) {
+    global_file *file = malloc(sizeof(global_file));
+
+    if (!file) {
+        fprintf(stderr, MALLOC_FAILED);
+        return FAILURE;
+    }
+    file->filename = filename;
+    file->next = *list;
+    *list = file;
+    return SUCCESS;
+}
+
+/**
+ * record_file_symbols - add one file's entries and externals to the map
+ * called right after the first pass, so the exports of a file that fails
+ * later still resolve its importers' externals
+ * @param map: batch-wide map
+ * @param table: the file's label table after the first pass
+ * @param filename: source file name, must outlive the map
+ * @return SUCCESS if recorded, FAILURE on allocation failure
+ */
+int record_file_symbols(global_symbol_map *map, const label_table *table, const char *filename) {
+    const label_node *node;
+    global_symbol *symbol;
+
+    for (node = table->head; node; node = node->next) {
+        if (node->type == LABEL_EXTERNAL) {
+            symbol = get_symbol(map, node->name);
+            if (!symbol || add_file(&symbol->importers, filename) == FAILURE) return FAILURE;
+        } else if (node->is_entry && node->is_defined) {
+            symbol = get_symbol(map, node->name);
+            if (!symbol || add_file(&symbol->exporters, filename) == FAILURE) return FAILURE;
+            symbol->export_count++;
+        }
+    }
+    return SUCCESS;
+}
+
+/**
+ * print_files - list the files of an exporter or importer list
+ * @param list: files to print
+ */
+static void print_files(const global_file *list) {
+    for (; list; list = list->next) {
+        fprintf(stderr, MSG_CROSS_CHECK_FILE, list->filename);
+    }
+}
+
+/**
+ * check_global_symbols - report unresolved externals and entries exported more than once
+ * @param map: batch-wide map
+ * @return number of problems found
+ */
+int check_global_symbols(const global_symbol_map *map) {
+    const global_symbol *symbol;
+    int problems = 0;
+
+    printf(MSG_CROSS_CHECK_HEADER);
+    printf(MSG_CROSS_CHECK_SEPARATOR);
+
+    for (symbol = map->first_added; symbol; symbol = symbol->next_added) {
+        if (symbol->importers && symbol->export_count == 0) {
+            fprintf(stderr, ERROR_GLOBAL_UNRESOLVED, symbol->name);
+            print_files(symbol->importers);
+            problems++;
+        }
+        if (symbol->export_count > 1) {
+            fprintf(stderr, ERROR_GLOBAL_MULTIPLE, symbol->name, symbol->export_count);
+            print_files(symbol->exporters);
+            problems++;
+        }
+    }
+
+    if (problems == 0) printf(MSG_CROSS_CHECK_CLEAN);
+    return problems;
+}
+
+/**
+ * free_file_list - release an exporter or importer list
+ * @param list: list to free
+ */
+static void free_file_list(global_file *list) {
+    global_file *next;
+
+    while (list) {
+        next = list->next;
+        free(list);
+        list = next;
+    }
+}
+
+/**
+ * free_global_map - release a symbol map
+ * @param map: map to free
+ */
+void free_global_map(global_symbol_map *map) {
+    global_symbol *symbol;
+    global_symbol *next;
+
+    for (symbol = map->first_added; symbol; symbol = next) {
+        next = symbol->next_added;
+        free_file_list(symbol->exporters);
+        free_file_list(symbol->importers);
+        free(symbol);
+    }
+    free(map->buckets);
+    map->buckets = NULL;
+    map->first_added = NULL;
+    map->last_added = NULL;
+    map->count = 0;
+}
@@ -0,0 +1,75 @@
+#ifndef GLOBAL_SYMBOLS_H
+#define GLOBAL_SYMBOLS_H
+
+#include "labelTable.h"
+
+/* hash table configuration */
+#define GLOBAL_MAP_INITIAL_BUCKETS 64     /* power of two */
+#define GLOBAL_MAP_MAX_LOAD 2             /* grow when symbols exceed buckets * this */
+
+/* report messages */
+#define MSG_CROSS_CHECK_HEADER "Cross-file symbol check\n"
+#define MSG_CROSS_CHECK_SEPARATOR "#######################\n"
+#define MSG_CROSS_CHECK_CLEAN "All external references resolve to exactly one entry\n"
+#define MSG_CROSS_CHECK_FILE "    %s\n"
+#define ERROR_GLOBAL_UNRESOLVED "Error: external '%s' is not an entry of any file in the batch; used in:\n"
+#define ERROR_GLOBAL_MULTIPLE "Error: entry '%s' is exported by %d files:\n"
+
+/* a file that exports or imports a symbol */
+typedef struct global_file {
+    const char *filename;           /* source file name (owned by the caller) */
+    struct global_file *next;
+} global_file;
+
+/* one batch-wide symbol */
+typedef struct global_symbol {
+    char *name;                     /* stored right after the node */
+    unsigned long hash;             /* cached hash for resizing */
+    global_file *exporters;         /* files with a .entry for the symbol */
+    global_file *importers;         /* files with a .extern for the symbol */
+    int export_count;
+    struct global_symbol *next;     /* next symbol in the bucket */
+    struct global_symbol *next_added;   /* next symbol in first-seen order, for reports */
+} global_symbol;
+
+/* batch-wide map of .entry exports and .extern imports */
+typedef struct {
+    global_symbol **buckets;
+    int bucket_count;
+    int count;
+    global_symbol *first_added;     /* symbols in first-seen order */
+    global_symbol *last_added;
+} global_symbol_map;
+
+/**
+ * init_global_map - create an empty symbol map
+ * @param map: map to initialize
+ * @return SUCCESS if allocated, FAILURE otherwise
+ */
+int init_global_map(global_symbol_map *map);
+
+/**
+ * record_file_symbols - add one file's entries and externals to the map
+ * called right after the first pass, so the exports of a file that fails
+ * later still resolve its importers' externals
+ * @param map: batch-wide map
+ * @param table: the file's label table after the first pass
+ * @param filename: source file name, must outlive the map
+ * @return SUCCESS if recorded, FAILURE on allocation failure
+ */
+int record_file_symbols(global_symbol_map *map, const label_table *table, const char *filename);
+
+/**
+ * check_global_symbols - report unresolved externals and entries exported more than once
+ * @param map: batch-wide map
+ * @return number of problems found
+ */
+int check_global_symbols(const global_symbol_map *map);
+
+/**
+ * free_global_map - release a symbol map
+ * @param map: map to free
+ */
+void free_global_map(global_symbol_map *map);
+
+#endif /* GLOBAL_SYMBOLS_H */
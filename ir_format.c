@@ -0,0 +1,566 @@
+#include "ir_format.h"
+#include "parser.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define ERROR_IR_WRITE "Error: cannot write IR file '%s'\n"
+#define NO_STRING_INDEX (-1)
+
+/* directive names, by index after IR_DIRECTIVE_BASE */
+static const char *const directive_names[IR_DIRECTIVES] = IR_DIRECTIVE_NAMES;
+
+/* IR being built by convert_to_ir */
+typedef struct {
+    ir_program program;
+    unsigned long pool_capacity;
+    int record_capacity;
+    int operand_capacity;
+    unsigned long *strings;                 /* pool offset of each distinct string */
+    int *next_string;                       /* next string in the same bucket */
+    int string_count;
+    int string_capacity;
+    int buckets[IR_POOL_BUCKETS];           /* first string of each bucket */
+} ir_builder;
+
+/**
+ * get_u32 - read a little-endian 32-bit number
+ * @param bytes: four bytes
+ * @return value
+ */
+static unsigned long get_u32(const unsigned char *bytes) {
+    return (unsigned long)bytes[0] | ((unsigned long)bytes[1] << 8) | ((unsigned long)bytes[2] << 16) |
+           ((unsigned long)bytes[3] << 24);
+}
+
+/**
+ * put_u32 - write a little-endian 32-bit number
+ * @param bytes: four bytes to fill
+ * @param value: value
+ */
+static void put_u32(unsigned char *bytes, unsigned long value) {
+    bytes[0] = (unsigned char)(value & 0xFF);
+    bytes[1] = (unsigned char)((value >> 8) & 0xFF);
+    bytes[2] = (unsigned char)((value >> 16) & 0xFF);
+    bytes[3] = (unsigned char)((value >> 24) & 0xFF);
+}
+
+/**
+ * find_opcode - instruction table entry of an opcode
+ * @param opcode: opcode value
+ * @return table entry, or NULL if there is none
+ */
+static const command_instructions *find_opcode(int opcode) {
+    int i;
+
+    for (i = LOOP_START_INDEX; i < NUM_OF_OPCODES; i++) {
+        if ((int)instruction_table[i].opcode == opcode) return &instruction_table[i];
+    }
+    return NULL;
+}
+
+/**
+ * ir_command_name - instruction or directive name of a record kind
+ * @param kind: record kind, already checked
+ * @return name as the text parser would give it
+ */
+const char *ir_command_name(int kind) {
+    if (kind >= IR_DIRECTIVE_BASE) return directive_names[kind - IR_DIRECTIVE_BASE];
+    return find_opcode(kind)->name;
+}
+
+/**
+ * check_operand - check that operand text has the form its type promises
+ * @param type: addressing mode bit
+ * @param text: operand text
+ * @return YES if it does, NO otherwise
+ */
+static int check_operand(int type, const char *text) {
+    switch (type) {
+        case REGISTER:
+            return strlen(text) == REGISTER_NAME_LENGTH && text[0] == REGISTER_PREFIX_CHAR &&
+                   text[1] >= MIN_REGISTER_CHAR && text[1] <= MAX_REGISTER_CHAR;
+        case IMMEDIATE:
+            if (*text++ != IMMEDIATE_PREFIX) return NO;
+            if (*text == PLUS_SIGN || *text == MINUS_SIGN) text++;
+            if (*text == NULL_CHAR) return NO;
+            for (; *text; text++) {
+                if (!isdigit((unsigned char)*text)) return NO;
+            }
+            return YES;
+        case DIRECT:
+            return is_valid_label(text, 0) == SUCCESS;
+        case MATRIX_ACCESS:
+            /* rare enough to take the full check */
+            return get_operand_mode(text) == MATRIX_ACCESS;
+        default:
+            return NO;
+    }
+}
+
+/**
+ * check_record - check a record the way the text parser checks a line
+ * @param program: program holding the record
+ * @param record: record to check
+ * @param filename: file name for messages
+ * @return SUCCESS if the passes can take it, FAILURE otherwise (reported)
+ */
+static int check_record(const ir_program *program, const ir_record *record, const char *filename) {
+    const command_instructions *inst;
+    const ir_operand *operand;
+    int modes[DOUBLE_OPERAND];
+    int i;
+
+    if (record->label != IR_NO_STRING && !is_valid_label(program->pool + record->label, 1)) {
+        fprintf(stderr, ERROR_IR_BAD_RECORD, filename, record->line);
+        return FAILURE;
+    }
+
+    /* directive operands stay text for the directive handlers */
+    if (record->kind >= IR_DIRECTIVE_BASE && record->kind < IR_DIRECTIVE_BASE + IR_DIRECTIVES) {
+        for (i = 0; i < record->operand_count; i++) {
+            if (program->operands[record->first_operand + i].type != 0) {
+                fprintf(stderr, ERROR_IR_BAD_RECORD, filename, record->line);
+                return FAILURE;
+            }
+        }
+        return SUCCESS;
+    }
+
+    inst = find_opcode(record->kind);
+    if (!inst) {
+        fprintf(stderr, ERROR_IR_BAD_RECORD, filename, record->line);
+        return FAILURE;
+    }
+    if (record->operand_count != inst->num_of_operands) {
+        fprintf(stderr, ERROR_WRONG_OPERAND_COUNT, inst->name, inst->num_of_operands);
+        return FAILURE;
+    }
+    for (i = 0; i < record->operand_count; i++) {
+        operand = &program->operands[record->first_operand + i];
+        if (!check_operand(operand->type, program->pool + operand->text)) {
+            fprintf(stderr, ERROR_IR_BAD_OPERAND, filename, record->line, program->pool + operand->text);
+            return FAILURE;
+        }
+        modes[i] = operand->type;
+    }
+
+    if (inst->num_of_operands == DOUBLE_OPERAND) return check_instruction(inst->name, modes[0], modes[1]);
+    if (inst->num_of_operands == SINGLE_OPERAND) return check_instruction(inst->name, NO_OPERANDS, modes[0]);
+    return SUCCESS;
+}
+
+/**
+ * decode_records - unpack the records that follow the pool
+ * @param program: program with its pool loaded
+ * @param data: record bytes
+ * @param size: number of record bytes
+ * @param record_count: records the header announces
+ * @param filename: file name for messages
+ * @return SUCCESS if every record fits the file, FAILURE otherwise (reported)
+ */
+static int decode_records(ir_program *program, const unsigned char *data, unsigned long size,
+                          unsigned long record_count, const char *filename) {
+    ir_record *record;
+    ir_operand *operand;
+    unsigned long position = 0;
+    int i;
+
+    /* bounded by the file size, so a bad count cannot ask for much */
+    if (record_count > size / IR_RECORD_SIZE) {
+        fprintf(stderr, ERROR_IR_TRUNCATED, filename);
+        return FAILURE;
+    }
+    program->records = malloc((size_t)(record_count > 0 ? record_count : 1) * sizeof(ir_record));
+    program->operands = malloc((size_t)(size / IR_OPERAND_SIZE + 1) * sizeof(ir_operand));
+    if (!program->records || !program->operands) {
+        fprintf(stderr, MALLOC_FAILED);
+        return FAILURE;
+    }
+
+    while ((unsigned long)program->record_count < record_count) {
+        if (size - position < IR_RECORD_SIZE) {
+            fprintf(stderr, ERROR_IR_TRUNCATED, filename);
+            return FAILURE;
+        }
+        /* a record counts only once its offsets are known to be inside the pool */
+        record = &program->records[program->record_count];
+        record->kind = data[position];
+        record->operand_count = data[position + 1];
+        record->label = get_u32(data + position + 2);
+        record->line = (int)get_u32(data + position + 6);
+        record->first_operand = program->operand_count;
+        position += IR_RECORD_SIZE;
+        if (record->label != IR_NO_STRING && record->label >= program->pool_size) {
+            fprintf(stderr, ERROR_IR_FORMAT, filename);
+            return FAILURE;
+        }
+
+        if ((size - position) / IR_OPERAND_SIZE < (unsigned long)record->operand_count) {
+            fprintf(stderr, ERROR_IR_TRUNCATED, filename);
+            return FAILURE;
+        }
+        for (i = 0; i < record->operand_count; i++) {
+            operand = &program->operands[program->operand_count];
+            operand->type = data[position];
+            operand->text = get_u32(data + position + 1);
+            position += IR_OPERAND_SIZE;
+            if (operand->text >= program->pool_size) {
+                fprintf(stderr, ERROR_IR_FORMAT, filename);
+                return FAILURE;
+            }
+            program->operand_count++;
+        }
+        program->record_count++;
+    }
+
+    if (position != size) {
+        fprintf(stderr, ERROR_IR_FORMAT, filename);
+        return FAILURE;
+    }
+    return SUCCESS;
+}
+
+/**
+ * load_ir_program - read and check an IR file
+ * @param filename: IR file
+ * @param program: program to fill; release with free_ir_program
+ * @return SUCCESS if read and valid, FAILURE otherwise (reported)
+ */
+int load_ir_program(const char *filename, ir_program *program) {
+    unsigned char *data;
+    unsigned long size;
+    size_t length;
+    int result = SUCCESS;
+    int i;
+
+    program->pool = NULL;
+    program->pool_size = 0;
+    program->records = NULL;
+    program->record_count = 0;
+    program->operands = NULL;
+    program->operand_count = 0;
+
+    data = (unsigned char *)read_entire_file(filename, &length);
+    if (!data) return FAILURE;
+    size = (unsigned long)length;
+
+    if (size < IR_HEADER_SIZE || memcmp(data, IR_MAGIC, IR_MAGIC_LENGTH) != 0 ||
+        data[IR_MAGIC_LENGTH] != IR_VERSION) {
+        fprintf(stderr, ERROR_IR_FORMAT, filename);
+        free(data);
+        return FAILURE;
+    }
+    program->pool_size = get_u32(data + IR_MAGIC_LENGTH + 1);
+    if (program->pool_size > size - IR_HEADER_SIZE) {
+        fprintf(stderr, ERROR_IR_TRUNCATED, filename);
+        free(data);
+        return FAILURE;
+    }
+
+    /* every string ends inside the pool */
+    program->pool = malloc((size_t)program->pool_size + 1);
+    if (!program->pool) {
+        fprintf(stderr, MALLOC_FAILED);
+        free(data);
+        return FAILURE;
+    }
+    memcpy(program->pool, data + IR_HEADER_SIZE, (size_t)program->pool_size);
+    if (program->pool_size > 0 && program->pool[program->pool_size - 1] != NULL_CHAR) {
+        fprintf(stderr, ERROR_IR_FORMAT, filename);
+        result = FAILURE;
+    }
+
+    if (result == SUCCESS) {
+        result = decode_records(program, data + IR_HEADER_SIZE + program->pool_size,
+                                size - IR_HEADER_SIZE - program->pool_size, get_u32(data + IR_MAGIC_LENGTH + 5),
+                                filename);
+    }
+    free(data);
+
+    /* check every record, so one run reports all the bad ones; a file that
+     * did not decode has no records worth checking */
+    if (result == SUCCESS) {
+        for (i = 0; i < program->record_count; i++) {
+            if (check_record(program, &program->records[i], filename) == FAILURE) result = FAILURE;
+        }
+    }
+
+    if (result == FAILURE) free_ir_program(program);
+    return result;
+}
+
+/**
+ * free_ir_program - release a program from load_ir_program
+ * @param program: program to free
+ */
+void free_ir_program(ir_program *program) {
+    free(program->pool);
+    free(program->records);
+    free(program->operands);
+    program->pool = NULL;
+    program->pool_size = 0;
+    program->records = NULL;
+    program->record_count = 0;
+    program->operands = NULL;
+    program->operand_count = 0;
+}
+
+/**
+ * add_string - put a string in the pool, once
+ * @param builder: IR being built
+ * @param text: string
+ * @param offset: output for its pool offset
+ * @return SUCCESS, or FAILURE if out of memory
+ */
+static int add_string(ir_builder *builder, const char *text, unsigned long *offset) {
+    ir_program *program = &builder->program;
+    unsigned long length = (unsigned long)strlen(text) + 1;
+    unsigned long capacity;
+    char *grown;
+    int bucket = (int)(hash_string(text) % IR_POOL_BUCKETS);
+    int i;
+
+    for (i = builder->buckets[bucket]; i != NO_STRING_INDEX; i = builder->next_string[i]) {
+        if (strcmp(program->pool + builder->strings[i], text) == 0) {
+            *offset = builder->strings[i];
+            return SUCCESS;
+        }
+    }
+
+    if (program->pool_size + length > builder->pool_capacity) {
+        capacity = builder->pool_capacity > 0 ? builder->pool_capacity * 2 : IR_INITIAL_CAPACITY;
+        while (capacity < program->pool_size + length) capacity *= 2;
+        grown = realloc(program->pool, (size_t)capacity);
+        if (!grown) {
+            fprintf(stderr, MALLOC_FAILED);
+            return FAILURE;
+        }
+        program->pool = grown;
+        builder->pool_capacity = capacity;
+    }
+    if (grow_array((void **)&builder->next_string, &builder->string_capacity, builder->string_count,
+                   sizeof(int), IR_INITIAL_CAPACITY) == FAILURE) {
+        return FAILURE;
+    }
+    /* both arrays share the capacity */
+    grown = realloc(builder->strings, (size_t)builder->string_capacity * sizeof(unsigned long));
+    if (!grown) {
+        fprintf(stderr, MALLOC_FAILED);
+        return FAILURE;
+    }
+    builder->strings = (unsigned long *)grown;
+
+    memcpy(program->pool + program->pool_size, text, (size_t)length);
+    builder->strings[builder->string_count] = program->pool_size;
+    builder->next_string[builder->string_count] = builder->buckets[bucket];
+    builder->buckets[bucket] = builder->string_count++;
+    *offset = program->pool_size;
+    program->pool_size += length;
+    return SUCCESS;
+}
+
+/**
+ * add_record - convert one parsed line
+ * @param builder: IR being built
+ * @param parts: parsed line
+ * @param source: file name for messages
+ * @param line_number: line of the text
+ * @return SUCCESS, or FAILURE if the line has no IR form (reported)
+ */
+static int add_record(ir_builder *builder, const separate_line *parts, const char *source, int line_number) {
+    ir_program *program = &builder->program;
+    const command_instructions *inst = NULL;
+    ir_record *record;
+    ir_operand *operand;
+    int kind = 0;
+    int i;
+
+    if (!parts->command) {
+        fprintf(stderr, ERROR_IR_NO_STATEMENT, source, line_number);
+        return FAILURE;
+    }
+    if (parts->command[0] == DOT_CHAR) {
+        for (i = 0; i < IR_DIRECTIVES && strcmp(parts->command, directive_names[i]) != 0; i++) {
+        }
+        if (i == IR_DIRECTIVES) {
+            fprintf(stderr, ERROR_IR_UNKNOWN_DIRECTIVE, source, line_number, parts->command);
+            return FAILURE;
+        }
+        kind = IR_DIRECTIVE_BASE + i;
+    } else {
+        inst = get_instruction(parts->command);
+        if (!inst) return FAILURE;
+        kind = (int)inst->opcode;
+    }
+    if (parts->how_many_operands > IR_MAX_OPERANDS) {
+        fprintf(stderr, ERROR_IR_TOO_MANY_OPERANDS, source, line_number, IR_MAX_OPERANDS);
+        return FAILURE;
+    }
+
+    if (grow_array((void **)&program->records, &builder->record_capacity, program->record_count,
+                   sizeof(ir_record), IR_INITIAL_CAPACITY) == FAILURE) {
+        return FAILURE;
+    }
+    record = &program->records[program->record_count];
+    record->kind = kind;
+    record->line = line_number;
+    record->first_operand = program->operand_count;
+    record->operand_count = 0;
+    record->label = IR_NO_STRING;
+    if (parts->label && add_string(builder, parts->label, &record->label) == FAILURE) return FAILURE;
+
+    for (i = 0; i < parts->how_many_operands; i++) {
+        if (grow_array((void **)&program->operands, &builder->operand_capacity, program->operand_count,
+                       sizeof(ir_operand), IR_INITIAL_CAPACITY) == FAILURE) {
+            return FAILURE;
+        }
+        operand = &program->operands[program->operand_count];
+        operand->type = 0;
+        if (inst) {
+            operand->type = get_operand_mode(parts->operands[i]);
+            if (operand->type == FAILURE) return FAILURE;
+        }
+        if (add_string(builder, parts->operands[i], &operand->text) == FAILURE) return FAILURE;
+        program->operand_count++;
+        record->operand_count++;
+    }
+    program->record_count++;
+    return SUCCESS;
+}
+
+/**
+ * write_program - write an IR file
+ * @param program: program to write
+ * @param filename: IR file
+ * @return SUCCESS if written, FAILURE otherwise (reported; a partial file is removed)
+ */
+static int write_program(const ir_program *program, const char *filename) {
+    unsigned char bytes[IR_HEADER_SIZE];
+    const ir_record *record;
+    const ir_operand *operand;
+    FILE *out;
+    int result = SUCCESS;
+    int i, j;
+
+    out = fopen(filename, FILE_WRITE_BINARY_MODE);
+    if (!out) {
+        fprintf(stderr, ERROR_CANNOT_OPEN_FILE_WRITE, filename);
+        return FAILURE;
+    }
+
+    memcpy(bytes, IR_MAGIC, IR_MAGIC_LENGTH);
+    bytes[IR_MAGIC_LENGTH] = IR_VERSION;
+    put_u32(bytes + IR_MAGIC_LENGTH + 1, program->pool_size);
+    put_u32(bytes + IR_MAGIC_LENGTH + 5, (unsigned long)program->record_count);
+    if (fwrite(bytes, 1, IR_HEADER_SIZE, out) != IR_HEADER_SIZE) result = FAILURE;
+    if (program->pool_size > 0 && fwrite(program->pool, 1, (size_t)program->pool_size, out) != program->pool_size) {
+        result = FAILURE;
+    }
+
+    for (i = 0; result == SUCCESS && i < program->record_count; i++) {
+        record = &program->records[i];
+        bytes[0] = (unsigned char)record->kind;
+        bytes[1] = (unsigned char)record->operand_count;
+        put_u32(bytes + 2, record->label);
+        put_u32(bytes + 6, (unsigned long)record->line);
+        if (fwrite(bytes, 1, IR_RECORD_SIZE, out) != IR_RECORD_SIZE) result = FAILURE;
+        for (j = 0; result == SUCCESS && j < record->operand_count; j++) {
+            operand = &program->operands[record->first_operand + j];
+            bytes[0] = (unsigned char)operand->type;
+            put_u32(bytes + 1, operand->text);
+            if (fwrite(bytes, 1, IR_OPERAND_SIZE, out) != IR_OPERAND_SIZE) result = FAILURE;
+        }
+    }
+
+    if (fclose(out) != 0) result = FAILURE;
+    if (result == FAILURE) {
+        fprintf(stderr, ERROR_IR_WRITE, filename);
+        remove(filename);
+    }
+    return result;
+}
+
+/**
+ * convert_to_ir - write the IR of a macro-expanded source
+ * @param source: .am file
+ * @param filename: IR file to write
+ * @return SUCCESS if every line converted and the file was written, FAILURE otherwise
+ */
+int convert_to_ir(const char *source, const char *filename) {
+    ir_builder builder;
+    char line[MAX_LINE_LENGTH];
+    const char *start;
+    separate_line *parts;
+    FILE *in;
+    int line_number = 0;
+    int result = SUCCESS;
+    int i;
+
+    in = fopen(source, FILE_READ_MODE);
+    if (!in) {
+        fprintf(stderr, ERROR_CANNOT_OPEN_FILE, source);
+        return FAILURE;
+    }
+
+    memset(&builder, 0, sizeof(builder));
+    for (i = 0; i < IR_POOL_BUCKETS; i++) builder.buckets[i] = NO_STRING_INDEX;
+
+    while (fgets(line, sizeof(line), in)) {
+        line_number++;
+        if (strlen(line) >= MAX_LINE_LENGTH - 1 && line[MAX_LINE_LENGTH - 2] != NEWLINE_CHAR) {
+            fprintf(stderr, ERROR_LINE_TOO_LONG, MAX_LINE_LENGTH - 1);
+            result = FAILURE;
+            continue;
+        }
+
+        /* blank lines and comments have no record */
+        start = line;
+        while (*start == SPACE_CHAR || *start == TAB_CHAR) start++;
+        if (*start == CARRIAGE_RETURN_CHAR) start++;
+        if (*start == NULL_CHAR || *start == NEWLINE_CHAR || *start == SEMICOLON_CHAR) continue;
+
+        parts = parse_line(start);
+        if (!parts) {
+            fprintf(stderr, ERROR_PARSE_FAILED_LINE, line_number);
+            result = FAILURE;
+            continue;
+        }
+        if (add_record(&builder, parts, source, line_number) == FAILURE) result = FAILURE;
+        free_separate_line(parts);
+    }
+    fclose(in);
+
+    /* the same checks the assembler makes when it loads the file */
+    for (i = 0; result == SUCCESS && i < builder.program.record_count; i++) {
+        if (check_record(&builder.program, &builder.program.records[i], source) == FAILURE) result = FAILURE;
+    }
+    if (result == SUCCESS) result = write_program(&builder.program, filename);
+
+    free_ir_program(&builder.program);
+    free(builder.strings);
+    free(builder.next_string);
+    return result;
+}
+
+/**
+ * write_ir_text - print the records of a program as assembly lines
+ * @param program: loaded program
+ * @param out: destination stream
+ * @return SUCCESS, or FAILURE on a write error
+ */
+int write_ir_text(const ir_program *program, FILE *out) {
+    const ir_record *record;
+    int i, j;
+
+    for (i = 0; i < program->record_count; i++) {
+        record = &program->records[i];
+        if (record->label != IR_NO_STRING) fprintf(out, "%s%c ", program->pool + record->label, COLON);
+        fputs(ir_command_name(record->kind), out);
+        for (j = 0; j < record->operand_count; j++) {
+            fprintf(out, j == 0 ? " %s" : ", %s", program->pool + program->operands[record->first_operand + j].text);
+        }
+        fputc(NEWLINE_CHAR, out);
+    }
+    return ferror(out) ? FAILURE : SUCCESS;
+}
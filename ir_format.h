@@ -0,0 +1,106 @@
+#ifndef IR_FORMAT_H
+#define IR_FORMAT_H
+
+#include <stdio.h>
+#include "utils.h"
+#include "commands.h"
+
+/* binary IR file, for code generators that hold instructions already split up;
+ * integers are little-endian:
+ * header    "ASIR", version (1), pool bytes (4), record count (4)
+ * pool      NUL-terminated strings: labels and operand text, each stored once
+ * records   kind (1), operand count (1), label (4), source line (4),
+ *           then for each operand its type (1) and text (4)
+ * kind is an opcode, or IR_DIRECTIVE_BASE plus the index of a directive in
+ * IR_DIRECTIVE_NAMES; label and text are pool offsets, IR_NO_STRING when a line
+ * has no label; the type of an instruction operand is its addressing mode bit
+ * (IMMEDIATE, DIRECT, MATRIX_ACCESS, REGISTER), 0 for a directive operand */
+#define IR_MAGIC "ASIR"
+#define IR_MAGIC_LENGTH 4
+#define IR_VERSION 1
+#define IR_EXT ".ir"
+#define IR_HEADER_SIZE 13
+#define IR_RECORD_SIZE 10
+#define IR_OPERAND_SIZE 5
+#define IR_NO_STRING 0xFFFFFFFFUL
+#define IR_DIRECTIVE_BASE 32
+#define IR_DIRECTIVE_NAMES { DIRECTIVE_DATA, DIRECTIVE_STRING, DIRECTIVE_MAT, DIRECTIVE_EXTERN, DIRECTIVE_ENTRY }
+#define IR_DIRECTIVES 5
+#define IR_MAX_OPERANDS 255
+#define IR_POOL_BUCKETS 1024
+#define IR_INITIAL_CAPACITY 64
+
+/* error messages */
+#define ERROR_IR_FORMAT "Error: '%s' is not an IR file\n"
+#define ERROR_IR_TRUNCATED "Error: IR file '%s' is truncated\n"
+#define ERROR_IR_BAD_RECORD "Error: %s (line %d): invalid IR record\n"
+#define ERROR_IR_BAD_OPERAND "Error: %s (line %d): operand '%s' does not match its type\n"
+#define ERROR_IR_NO_STATEMENT "Error: %s (line %d): a label needs an instruction or directive\n"
+#define ERROR_IR_UNKNOWN_DIRECTIVE "Error: %s (line %d): unknown directive '%s'\n"
+#define ERROR_IR_TOO_MANY_OPERANDS "Error: %s (line %d): more than %d operands\n"
+
+/* one source line */
+typedef struct {
+    int kind;                   /* opcode, or IR_DIRECTIVE_BASE + directive */
+    unsigned long label;        /* pool offset, or IR_NO_STRING */
+    int line;                   /* line of the text it came from, for messages */
+    int first_operand;          /* index into the program's operands */
+    int operand_count;
+} ir_record;
+
+/* one operand of a record */
+typedef struct {
+    int type;                   /* addressing mode bit, 0 for a directive operand */
+    unsigned long text;         /* pool offset */
+} ir_operand;
+
+/* IR file in memory */
+typedef struct {
+    char *pool;                 /* string pool */
+    unsigned long pool_size;
+    ir_record *records;
+    int record_count;
+    ir_operand *operands;       /* operands of all records, in record order */
+    int operand_count;
+} ir_program;
+
+/**
+ * load_ir_program - read and check an IR file
+ * every record is checked the way the text parser would check its line, so the
+ * passes can take the records as they are
+ * @param filename: IR file
+ * @param program: program to fill; release with free_ir_program
+ * @return SUCCESS if read and valid, FAILURE otherwise (reported)
+ */
+int load_ir_program(const char *filename, ir_program *program);
+
+/**
+ * free_ir_program - release a program from load_ir_program
+ * @param program: program to free
+ */
+void free_ir_program(ir_program *program);
+
+/**
+ * ir_command_name - instruction or directive name of a record kind
+ * @param kind: record kind, already checked
+ * @return name as the text parser would give it
+ */
+const char *ir_command_name(int kind);
+
+/**
+ * convert_to_ir - write the IR of a macro-expanded source
+ * @param source: .am file
+ * @param filename: IR file to write
+ * @return SUCCESS if every line converted and the file was written, FAILURE otherwise
+ */
+int convert_to_ir(const char *source, const char *filename);
+
+/**
+ * write_ir_text - print the records of a program as assembly lines
+ * @param program: loaded program
+ * @param out: destination stream
+ * @return SUCCESS, or FAILURE on a write error
+ */
+int write_ir_text(const ir_program *program, FILE *out);
+
+#endif /* IR_FORMAT_H */
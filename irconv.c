@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils.h"
+#include "macro.h"
+#include "ir_format.h"
+
+/* command line */
+#define MIN_ARGC 2
+#define OPTION_TEXT "-t"
+#define FIRST_FILE_ARG 1
+
+/* error messages */
+#define ERROR_NOT_A_SOURCE "Error: '%s' must end with .as\n"
+#define ERROR_CONVERT_FAILED "Error: cannot convert '%s'\n"
+
+/* output */
+#define MSG_CONVERTED "%s -> %s (%d records)\n"
+
+/* usage messages */
+#define MSG_USAGE_FORMAT "Usage: %s file.as...\n       %s -t file.ir...\n"
+#define MSG_DESCRIPTION "\nConverts assembly sources to the binary IR the assembler also accepts.\n" \
+    "  file.as  expand macros into file.am, then write its records to file.ir\n" \
+    "  -t       print the records of IR files as assembly text\n"
+
+/**
+ * print usage information
+ * @param program_name: name of the executable program
+ */
+static void print_usage(const char *program_name) {
+    printf(MSG_USAGE_FORMAT, program_name, program_name);
+    printf(MSG_DESCRIPTION);
+}
+
+/**
+ * convert_source - write the IR of one assembly source
+ * @param filename: source file (.as)
+ * @return SUCCESS if converted, FAILURE otherwise
+ */
+static int convert_source(const char *filename) {
+    char *base_filename;
+    char *macro_filename = NULL;
+    char *ir_filename = NULL;
+    ir_program program;
+    size_t len = strlen(filename);
+    int result = FAILURE;
+
+    if (len < strlen(SOURCE_EXT) + 1 || strcmp(filename + len - strlen(SOURCE_EXT), SOURCE_EXT) != 0) {
+        fprintf(stderr, ERROR_NOT_A_SOURCE, filename);
+        return FAILURE;
+    }
+
+    base_filename = extract_base_filename(filename);
+    if (!base_filename) return FAILURE;
+    macro_filename = build_filename(base_filename, MACRO_EXT);
+    ir_filename = build_filename(base_filename, IR_EXT);
+
+    if (macro_filename && ir_filename && expand_macros(filename, macro_filename, NULL, NULL, NULL) == SUCCESS &&
+        convert_to_ir(macro_filename, ir_filename) == SUCCESS) {
+        /* read it back, so what is reported is what the assembler will see */
+        if (load_ir_program(ir_filename, &program) == SUCCESS) {
+            printf(MSG_CONVERTED, filename, ir_filename, program.record_count);
+            free_ir_program(&program);
+            result = SUCCESS;
+        }
+    }
+    if (result == FAILURE) fprintf(stderr, ERROR_CONVERT_FAILED, filename);
+
+    free(ir_filename);
+    free(macro_filename);
+    free(base_filename);
+    return result;
+}
+
+/**
+ * print_program - print the records of one IR file
+ * @param filename: IR file
+ * @return SUCCESS if printed, FAILURE otherwise
+ */
+static int print_program(const char *filename) {
+    ir_program program;
+    int result;
+
+    if (load_ir_program(filename, &program) == FAILURE) return FAILURE;
+    result = write_ir_text(&program, stdout);
+    free_ir_program(&program);
+    return result;
+}
+
+/**
+ * main
+ * @param argc: number of command line arguments
+ * @param argv: array of command line argument strings
+ * @return 0 on success, EXIT_FAILURE_CODE on failure
+ */
+int main(int argc, char *argv[]) {
+    int text = NO;
+    int result = SUCCESS;
+    int i = FIRST_FILE_ARG;
+
+    if (argc >= MIN_ARGC && strcmp(argv[i], OPTION_TEXT) == 0) {
+        text = YES;
+        i++;
+    }
+    if (i >= argc) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE_CODE;
+    }
+
+    for (; i < argc; i++) {
+        if ((text ? print_program(argv[i]) : convert_source(argv[i])) == FAILURE) result = FAILURE;
+    }
+    return result == SUCCESS ? 0 : EXIT_FAILURE_CODE;
+}
@@ -16,6 +16,8 @@ void init_label_table(label_table* table) {
     /* initialize empty table */
     table->head = NULL;
     table->count = INITIAL_COUNT;
+    table->scopes = NULL;
+    table->last_scope = NULL;
 }
 
 /**
@@ -45,18 +47,20 @@ int add_label(label_table* table, const char* name, int address, label_type type
         return FAILURE;
     }
 
-    /* allocate memory for new label node */
-    new_node = (label_node*)malloc(sizeof(label_node));
+    /* allocate memory for new label node and its name in one block */
+    new_node = (label_node*)malloc(sizeof(label_node) + strlen(name) + 1);
     if (!new_node) {
         fprintf(stderr, ERROR_MEMORY_ALLOCATION_FAILED, name);
         return FAILURE; 
     }
 
     /* initialize new label node */
+    new_node->name = (char*)(new_node + 1);
     strcpy(new_node->name, name);
     new_node->address = address;
     new_node->type = type;
     new_node->is_defined = 0; 
+    new_node->is_entry = 0;
 
     /* add to beginning of linked list */
     new_node->next = table->head;
@@ -234,6 +238,88 @@ int delete_label(label_table* table, const char* name) {
     return SUCCESS; 
 }
 
+/**
+ * is_local_label - check whether a label name is local to its scope
+ * @param name: label name
+ * @return YES for ".name", NO otherwise
+ */
+int is_local_label(const char* name) {
+    return name && name[0] == LOCAL_LABEL_PREFIX ? YES : NO;
+}
+
+/**
+ * local_scope_table - table of the local labels of a scope, created when first needed
+ * @param table: global label table
+ * @param scope: number of global labels before the scope
+ * @return the scope's table, or NULL if out of memory
+ */
+label_table* local_scope_table(label_table* table, int scope) {
+    local_scope* created;
+
+    if (table->last_scope && table->last_scope->scope == scope) {
+        return &table->last_scope->labels;
+    }
+
+    created = (local_scope*)malloc(sizeof(local_scope));
+    if (!created) {
+        fprintf(stderr, MALLOC_FAILED);
+        return NULL;
+    }
+    created->scope = scope;
+    init_label_table(&created->labels);
+    created->next = NULL;
+
+    /* scopes arrive in source order, so the list stays sorted */
+    if (table->last_scope) {
+        table->last_scope->next = created;
+    } else {
+        table->scopes = created;
+    }
+    table->last_scope = created;
+    return &created->labels;
+}
+
+/**
+ * init_label_scope - start a position at the top of the source
+ * @param position: position to initialize
+ * @param table: table filled by the first pass
+ */
+void init_label_scope(label_scope* position, const label_table* table) {
+    position->table = table;
+    position->next_scope = table->scopes;
+    position->scope = 0;
+}
+
+/**
+ * enter_label_scope - move a position over the label of a line
+ * @param position: position in the source
+ * @param label: label of the line, or NULL
+ */
+void enter_label_scope(label_scope* position, const char* label) {
+    if (!label || is_local_label(label)) return;
+
+    position->scope++;
+    while (position->next_scope && position->next_scope->scope < position->scope) {
+        position->next_scope = position->next_scope->next;
+    }
+}
+
+/**
+ * resolve_label - look up a label as seen from a position in the source
+ * @param position: position in the source
+ * @param name: label name, global or local
+ * @return pointer to label node if found, NULL otherwise
+ */
+label_node* resolve_label(const label_scope* position, const char* name) {
+    if (!is_local_label(name)) {
+        return find_label(position->table, name);
+    }
+    if (position->next_scope && position->next_scope->scope == position->scope) {
+        return find_label(&position->next_scope->labels, name);
+    }
+    return NULL;
+}
+
 /**
  * Release all table memory
  * @param table: pointer to label table to free
@@ -241,6 +327,8 @@ int delete_label(label_table* table, const char* name) {
 void free_label_table(label_table* table) {
     label_node* current_label;
     label_node* next_label;
+    local_scope* current_scope;
+    local_scope* next_scope;
 
     /* validate input parameter */
     if (!table) {
@@ -255,7 +343,18 @@ void free_label_table(label_table* table) {
         current_label = next_label;
     }
 
+    /* and every scope of local labels */
+    current_scope = table->scopes;
+    while (current_scope != NULL) {
+        next_scope = current_scope->next;
+        free_label_table(&current_scope->labels);
+        free(current_scope);
+        current_scope = next_scope;
+    }
+
     /* reset table to empty state */
     table->head = NULL;
     table->count = 0;
+    table->scopes = NULL;
+    table->last_scope = NULL;
 }
\ No newline at end of file
@@ -21,20 +21,41 @@ typedef enum {
 } label_type;
 
 /* label node structure for linked list implementation */
+/* the name is stored right after the node in the same allocation, sized to fit */
 typedef struct label_node {
-    char name[MAX_LABEL_NAME];      /* label identifier */
+    char *name;                     /* label identifier */
     int address;                    /* memory address or value */
     label_type type;                /* label classification */
     int is_defined;                 /* 1 if defined, 0 if only declared */
+    int is_entry;                   /* 1 if named by a .entry directive */
     struct label_node *next;        /* pointer to next node in list */
 } label_node;
 
+struct local_scope;
+
 /* symbol table structure managing all labels */
+/* local labels (LOCAL_LABEL_PREFIX) are kept out of it, in one small table per scope */
 typedef struct {
     label_node *head;               /* pointer to first node in linked list */
     int count;                      /* total number of labels in table */
+    struct local_scope *scopes;     /* scopes that have local labels, in source order */
+    struct local_scope *last_scope; /* last of them, where the first pass adds */
 } label_table;
 
+/* local labels of the lines between one global label and the next */
+typedef struct local_scope {
+    int scope;                      /* global labels before it, 0 for the lines before the first */
+    label_table labels;             /* the local labels, nothing else */
+    struct local_scope *next;       /* next scope with local labels */
+} local_scope;
+
+/* position of a pass that reads the source again: the scope its lines are in */
+typedef struct {
+    const label_table *table;       /* global labels and the scopes */
+    const local_scope *next_scope;  /* first scope at or after the position */
+    int scope;                      /* global labels passed */
+} label_scope;
+
 /**
  * nitialize empty label table
  * @param table: pointer to label table structure to initialize
@@ -103,6 +124,45 @@ int mark_label_defined(label_table *table, const char *name);
  */
 int delete_label(label_table *table, const char *name);
 
+/**
+ * is_local_label - check whether a label name is local to its scope
+ * @param name: label name
+ * @return YES for ".name", NO otherwise
+ */
+int is_local_label(const char *name);
+
+/**
+ * local_scope_table - table of the local labels of a scope, created when first needed
+ * scopes must be asked for in source order, as the first pass reaches them
+ * @param table: global label table
+ * @param scope: number of global labels before the scope
+ * @return the scope's table, or NULL if out of memory
+ */
+label_table *local_scope_table(label_table *table, int scope);
+
+/**
+ * init_label_scope - start a position at the top of the source
+ * @param position: position to initialize
+ * @param table: table filled by the first pass
+ */
+void init_label_scope(label_scope *position, const label_table *table);
+
+/**
+ * enter_label_scope - move a position over the label of a line
+ * a global label opens the next scope, and the scopes before it can no longer be named
+ * @param position: position in the source
+ * @param label: label of the line, or NULL
+ */
+void enter_label_scope(label_scope *position, const char *label);
+
+/**
+ * resolve_label - look up a label as seen from a position in the source
+ * @param position: position in the source
+ * @param name: label name, global or local
+ * @return pointer to label node if found, NULL otherwise
+ */
+label_node *resolve_label(const label_scope *position, const char *name);
+
 /**
  * free all table memory
  * @param table: pointer to label table to free
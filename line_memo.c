@@ -0,0 +1,305 @@
+#include "line_memo.h"
+#include "parser.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* memo consulted by share_line, NULL outside assembler passes */
+static line_memo *active_memo = NULL;
+
+/* entries and their strings are carved from blocks at this alignment */
+typedef union {
+    unsigned long number;
+    void *pointer;
+} memo_align;
+
+#define MEMO_ALIGN(bytes) (((bytes) + sizeof(memo_align) - 1) / sizeof(memo_align) * sizeof(memo_align))
+
+/**
+ * begin_line_memo - start an empty memo and make share_line use it
+ * if the bucket array cannot be allocated or exceeds the budget, lines are parsed without sharing
+ * @param memo: memo to initialize
+ * @param budget: bytes the entries may take (the -m budget, or LINE_MEMO_DEFAULT_BUDGET)
+ */
+void begin_line_memo(line_memo *memo, long budget) {
+    memo->blocks = NULL;
+    memo->free_space = NULL;
+    memo->free_left = 0;
+    /* a budget too small for the buckets leaves every line unshared */
+    memo->buckets = budget >= (long)(LINE_MEMO_INITIAL_BUCKETS * sizeof(memo_entry *))
+                        ? calloc(LINE_MEMO_INITIAL_BUCKETS, sizeof(memo_entry *))
+                        : NULL;
+    memo->bucket_count = memo->buckets ? LINE_MEMO_INITIAL_BUCKETS : 0;
+    memo->count = 0;
+    memo->size = (long)(memo->bucket_count * sizeof(memo_entry *));
+    memo->budget = budget;
+    active_memo = memo->buckets ? memo : NULL;
+}
+
+/**
+ * end_line_memo - release every shared line and stop using the memo
+ * @param memo: memo to release
+ */
+void end_line_memo(line_memo *memo) {
+    memo_block *block;
+
+    while (memo->blocks) {
+        block = memo->blocks;
+        memo->blocks = block->next;
+        free(block);
+    }
+    free(memo->buckets);
+    memo->buckets = NULL;
+    memo->bucket_count = 0;
+    memo->free_space = NULL;
+    memo->free_left = 0;
+    memo->count = 0;
+    memo->size = 0;
+    if (active_memo == memo) active_memo = NULL;
+}
+
+/**
+ * grow_memo - double the bucket array and rehash
+ * a failed allocation, or one past the budget, keeps the old buckets, which only lengthens chains
+ * @param memo: memo to grow
+ */
+static void grow_memo(line_memo *memo) {
+    memo_entry **buckets;
+    memo_entry *entry;
+    memo_entry *next;
+    int size = memo->bucket_count * 2;
+    int index;
+    int i;
+
+    if (memo->size + (long)(memo->bucket_count * sizeof(memo_entry *)) > memo->budget) return;
+    buckets = calloc(size, sizeof(memo_entry *));
+    if (!buckets) return;
+
+    for (i = 0; i < memo->bucket_count; i++) {
+        for (entry = memo->buckets[i]; entry; entry = next) {
+            next = entry->next;
+            index = (int)(entry->hash & (unsigned long)(size - 1));
+            entry->next = buckets[index];
+            buckets[index] = entry;
+        }
+    }
+
+    free(memo->buckets);
+    memo->size += (long)(memo->bucket_count * sizeof(memo_entry *));
+    memo->buckets = buckets;
+    memo->bucket_count = size;
+}
+
+/**
+ * memo_alloc - take bytes from the current block, starting a new one when it is full
+ * blocks keep the memo apart from the assembler's own small allocations
+ * @param memo: memo
+ * @param bytes: bytes needed
+ * @return the bytes, or NULL if the budget is spent or out of memory
+ */
+static void *memo_alloc(line_memo *memo, size_t bytes) {
+    memo_block *block;
+    size_t header = MEMO_ALIGN(sizeof(memo_block));
+    long block_size = LINE_MEMO_BLOCK_SIZE;
+    void *result;
+
+    bytes = MEMO_ALIGN(bytes);
+    if (bytes > memo->free_left) {
+        /* the last block may be smaller so the budget is never passed */
+        if (memo->budget - memo->size < block_size) block_size = memo->budget - memo->size;
+        if (block_size < (long)(header + bytes)) return NULL;
+
+        block = malloc((size_t)block_size);
+        if (!block) return NULL;
+        block->next = memo->blocks;
+        memo->blocks = block;
+        memo->free_space = (char *)block + header;
+        memo->free_left = (size_t)block_size - header;
+        memo->size += block_size;
+    }
+
+    result = memo->free_space;
+    memo->free_space += bytes;
+    memo->free_left -= bytes;
+    return result;
+}
+
+/**
+ * copy_string - copy an optional string to the end of an entry
+ * @param text: string, may be NULL
+ * @param space: where to copy it, advanced past the copy
+ * @return the copy, or NULL for NULL
+ */
+static char *copy_string(const char *text, char **space) {
+    char *copy;
+
+    if (!text) return NULL;
+    copy = strcpy(*space, text);
+    *space += strlen(text) + 1;
+    return copy;
+}
+
+/**
+ * insert_entry - link a filled entry into the table
+ * @param memo: memo
+ * @param entry: entry with everything but its chain set
+ * @param hash: hash_string of its text
+ * @return the entry's shared line
+ */
+static separate_line *insert_entry(line_memo *memo, memo_entry *entry, unsigned long hash) {
+    int index = (int)(hash & (unsigned long)(memo->bucket_count - 1));
+
+    entry->hash = hash;
+    entry->next = memo->buckets[index];
+    memo->buckets[index] = entry;
+    memo->count++;
+
+    if (memo->count > memo->bucket_count * LINE_MEMO_MAX_LOAD) grow_memo(memo);
+    return &entry->parts;
+}
+
+/**
+ * add_entry - copy a fresh parse into the memo
+ * @param memo: memo
+ * @param line: line text
+ * @param hash: hash_string of line
+ * @param parts: parse_line result, freed here when the memo takes a copy
+ * @return shared copy, or parts itself if the budget is spent or out of memory
+ */
+static separate_line *add_entry(line_memo *memo, const char *line, unsigned long hash, separate_line *parts) {
+    memo_entry *entry;
+    char *space;
+    size_t bytes = MEMO_ENTRY_SIZE(parts->how_many_operands) + strlen(line) + 1;
+    int index;
+
+    if (parts->label) bytes += strlen(parts->label) + 1;
+    if (parts->command) bytes += strlen(parts->command) + 1;
+    for (index = 0; index < parts->how_many_operands; index++) {
+        if (parts->operands[index]) bytes += strlen(parts->operands[index]) + 1;
+    }
+
+    entry = memo_alloc(memo, bytes);
+    if (!entry) return parts;
+
+    /* only the operand slots the line uses, then the strings */
+    space = (char *)entry + MEMO_ENTRY_SIZE(parts->how_many_operands);
+    entry->text = copy_string(line, &space);
+    entry->record = NULL;
+    entry->parts.label = copy_string(parts->label, &space);
+    entry->parts.command = copy_string(parts->command, &space);
+    entry->parts.how_many_operands = parts->how_many_operands;
+    entry->parts.shared = YES;
+    for (index = 0; index < parts->how_many_operands; index++) {
+        entry->parts.operands[index] = copy_string(parts->operands[index], &space);
+    }
+    free_separate_line(parts);
+
+    for (index = 0; index < LINE_MEMO_OPERANDS; index++) {
+        entry->modes[index] = MODE_NOT_CACHED;
+    }
+    return insert_entry(memo, entry, hash);
+}
+
+/**
+ * add_record_entry - share a parse cache record through the memo, without copying its strings
+ * operand modes already known to the record are not worked out again
+ * @param memo: memo
+ * @param record: record of the line
+ * @param hash: hash_string of the line
+ * @return shared line, or NULL if the budget is spent or out of memory
+ */
+static separate_line *add_record_entry(line_memo *memo, parse_record *record, unsigned long hash) {
+    memo_entry *entry;
+    int index;
+
+    entry = memo_alloc(memo, MEMO_ENTRY_SIZE(record->operand_count));
+    if (!entry) return NULL;
+
+    entry->text = record->text;
+    entry->record = record;
+    share_record_fields(record, &entry->parts);
+    entry->parts.shared = YES;
+    for (index = 0; index < LINE_MEMO_OPERANDS; index++) {
+        entry->modes[index] = MODE_NOT_CACHED;
+        if (index < PARSE_CACHE_MODES && record->modes[index] != PARSE_CACHE_NO_MODE) {
+            entry->modes[index] = record->modes[index];
+        }
+    }
+    return insert_entry(memo, entry, hash);
+}
+
+/**
+ * share_line - parse a line, reusing the parse of an identical earlier line
+ * the result must not be modified; give it back with release_line
+ * @param line: input line
+ * @return parsed line, or NULL if it cannot be parsed
+ */
+const separate_line *share_line(const char *line) {
+    memo_entry *entry;
+    separate_line *parts;
+    separate_line *shared;
+    parse_record *record;
+    unsigned long hash;
+
+    if (!line) return NULL;
+    if (!active_memo) return parse_line(line);
+
+    hash = hash_string(line);
+    for (entry = active_memo->buckets[hash & (unsigned long)(active_memo->bucket_count - 1)]; entry;
+         entry = entry->next) {
+        if (entry->hash == hash && strcmp(entry->text, line) == 0) return &entry->parts;
+    }
+
+    /* with -P a cached line is shared straight from its record */
+    record = parse_cache_find(line);
+    if (record) {
+        shared = add_record_entry(active_memo, record, hash);
+        return shared ? shared : copy_record_fields(record);
+    }
+
+    /* failed parses are not kept, so their errors are reported at every occurrence */
+    parts = tokenize_line(line);
+    if (!parts) return NULL;
+    record = parse_cache_store(line, parts);
+    if (record && (shared = add_record_entry(active_memo, record, hash)) != NULL) {
+        free_separate_line(parts);
+        return shared;
+    }
+    return add_entry(active_memo, line, hash, parts);
+}
+
+/**
+ * release_line - give back a line from share_line
+ * shared lines stay in the memo; lines parsed without one are freed
+ * @param parts: line to release, may be NULL
+ */
+void release_line(const separate_line *parts) {
+    if (parts && !parts->shared) free_separate_line((separate_line *)parts);
+}
+
+/**
+ * line_operand_mode - get_operand_mode of an operand, remembered for shared lines
+ * @param parts: line from share_line
+ * @param index: operand index
+ * @return addressing mode bit mask, or FAILURE if invalid
+ */
+int line_operand_mode(const separate_line *parts, int index) {
+    memo_entry *entry;
+    int mode;
+
+    if (!parts->shared || index < 0 || index >= LINE_MEMO_OPERANDS) {
+        return get_operand_mode(parts->operands[index]);
+    }
+
+    /* parts is the last member of its entry */
+    entry = (memo_entry *)((char *)parts - offsetof(memo_entry, parts));
+    if (entry->modes[index] != MODE_NOT_CACHED) return entry->modes[index];
+
+    /* invalid operands are checked again each time so the error is reported again */
+    mode = get_operand_mode(parts->operands[index]);
+    if (mode != FAILURE) {
+        entry->modes[index] = mode;
+        /* saved with the cache record, so the next run skips this too */
+        if (entry->record && index < PARSE_CACHE_MODES) entry->record->modes[index] = mode;
+    }
+    return mode;
+}
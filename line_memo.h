@@ -0,0 +1,86 @@
+#ifndef LINE_MEMO_H
+#define LINE_MEMO_H
+
+#include <stddef.h>
+#include "utils.h"
+#include "parse_cache.h"
+
+/* hash table configuration */
+#define LINE_MEMO_INITIAL_BUCKETS 1024      /* power of two */
+#define LINE_MEMO_MAX_LOAD 2                /* grow when entries exceed buckets * this */
+#define LINE_MEMO_DEFAULT_BUDGET (4L * 1024 * 1024)   /* bytes of entries without -m */
+#define LINE_MEMO_BLOCK_SIZE 65536          /* entries are carved from blocks this large */
+#define LINE_MEMO_OPERANDS 2            /* instructions take at most two operands */
+#define MODE_NOT_CACHED (-1)
+
+/* one distinct line of the file and its shared parse; the line text and the
+ * label, command and operand strings follow the operands in the same block,
+ * or are those of a parse cache record (-P) */
+typedef struct memo_entry {
+    unsigned long hash;                     /* hash_string of text */
+    const char *text;                       /* line text */
+    int modes[LINE_MEMO_OPERANDS];          /* get_operand_mode results, MODE_NOT_CACHED until asked */
+    parse_record *record;                   /* parse cache record the strings belong to, or NULL */
+    struct memo_entry *next;                /* bucket chain */
+    separate_line parts;                    /* last member: allocated with how_many_operands operands */
+} memo_entry;
+
+/* bytes of an entry whose line has count operands */
+#define MEMO_ENTRY_SIZE(count) \
+    (offsetof(memo_entry, parts) + offsetof(separate_line, operands) + (size_t)(count) * sizeof(char *))
+
+/* block of entries, freed all at once */
+typedef struct memo_block {
+    struct memo_block *next;
+} memo_block;
+
+/* parses of the lines of one file, shared by every pass over it */
+typedef struct {
+    memo_block *blocks;                     /* newest first */
+    char *free_space;                       /* unused end of the newest block */
+    size_t free_left;                       /* bytes there */
+    memo_entry **buckets;
+    int bucket_count;
+    int count;                              /* entries in the table */
+    long size;                              /* bytes of blocks and buckets */
+    long budget;                            /* no blocks are added past this many bytes */
+} line_memo;
+
+/**
+ * begin_line_memo - start an empty memo and make share_line use it
+ * if the bucket array cannot be allocated or exceeds the budget, lines are parsed without sharing
+ * @param memo: memo to initialize
+ * @param budget: bytes the entries may take (the -m budget, or LINE_MEMO_DEFAULT_BUDGET)
+ */
+void begin_line_memo(line_memo *memo, long budget);
+
+/**
+ * end_line_memo - release every shared line and stop using the memo
+ * @param memo: memo to release
+ */
+void end_line_memo(line_memo *memo);
+
+/**
+ * share_line - parse a line, reusing the parse of an identical earlier line
+ * the result must not be modified; give it back with release_line
+ * @param line: input line
+ * @return parsed line, or NULL if it cannot be parsed
+ */
+const separate_line *share_line(const char *line);
+
+/**
+ * release_line - give back a line from share_line
+ * shared lines stay in the memo; lines parsed without one are freed
+ * @param parts: line to release, may be NULL
+ */
+void release_line(const separate_line *parts);
+
+/**
+ * line_operand_mode - get_operand_mode of an operand, remembered for shared lines
+ * @param parts: line from share_line
+ * @param index: operand index
+ * @return addressing mode bit mask, or FAILURE if invalid
+ */
+int line_operand_mode(const separate_line *parts, int index);
+
+#endif /* LINE_MEMO_H */
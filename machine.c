@@ -0,0 +1,449 @@
+#include "machine.h"
+#include "commands.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * word_to_int - sign-extend a 10-bit word
+ * @param word: 10-bit value
+ * @return signed value
+ */
+int word_to_int(int word) {
+    word &= TEN_BIT_MASK;
+    return (word & WORD_SIGN_BIT) ? word - (TEN_BIT_MASK + 1) : word;
+}
+
+/**
+ * operand_count_for - number of operands an opcode takes
+ * @param opcode: opcode from an instruction word
+ * @return operand count from the instruction table, or -1 if unknown
+ */
+static int operand_count_for(int opcode) {
+    int i;
+
+    for (i = 0; i < NUM_OF_OPCODES; i++) {
+        if ((int)instruction_table[i].opcode == opcode) {
+            return instruction_table[i].num_of_operands;
+        }
+    }
+    return -1;
+}
+
+/**
+ * decode_operand - decode the operand words of one operand
+ * @param m: machine holding the code
+ * @param mode: addressing mode from the instruction word
+ * @param address: address of the operand's first word
+ * @param op: output decoded operand
+ * @param flags: instruction flags, DECODED_EXTERNAL is added when needed
+ * @return number of words used
+ */
+static int decode_operand(const machine *m, int mode, int address, decoded_operand *op, unsigned char *flags) {
+    unsigned int word = m->memory[address & MACHINE_ADDRESS_MASK];
+    unsigned int value = word >> OPERAND_VALUE_SHIFT;
+
+    op->mode = (unsigned char)mode;
+    op->reg = 0;
+    op->reg2 = 0;
+    op->value = 0;
+
+    switch (mode) {
+        case MODE_IMMEDIATE:
+            /* 8-bit two's complement, kept as a 10-bit word */
+            value &= EIGHT_BIT_MASK;
+            op->value = (value & IMMEDIATE_SIGN_BIT) ? (int)((value - (EIGHT_BIT_MASK + 1)) & TEN_BIT_MASK) : (int)value;
+            return 1;
+
+        case MODE_REGISTER:
+            op->reg = (unsigned char)(value & SEVEN_BIT_MASK);
+            return 1;
+
+        case MODE_MATRIX:
+            word = m->memory[(address + 1) & MACHINE_ADDRESS_MASK];
+            op->reg = (unsigned char)((word >> FIRST_REGISTER_SHIFT) & SEVEN_BIT_MASK);
+            op->reg2 = (unsigned char)((word >> SECOND_REGISTER_SHIFT) & SEVEN_BIT_MASK);
+            word = m->memory[address & MACHINE_ADDRESS_MASK];
+            /* fall through to decode the label word */
+
+        default:
+            op->value = (int)((word >> OPERAND_VALUE_SHIFT) & MACHINE_ADDRESS_MASK);
+            if ((word & ARE_MASK) == ARE_EXTERNAL) {
+                *flags |= DECODED_EXTERNAL;
+            }
+            return mode == MODE_MATRIX ? 2 : 1;
+    }
+}
+
+/**
+ * decode_instruction - decode the instruction starting at an address
+ * @param m: machine holding the code
+ * @param address: address of the instruction word
+ * @param inst: output decoded instruction
+ * @return SUCCESS if the word is a valid instruction, FAILURE otherwise
+ */
+static int decode_instruction(const machine *m, int address, decoded_instruction *inst) {
+    unsigned int word = m->memory[address];
+    int src_mode = (word >> SRC_MODE_SHIFT) & MODE_MASK;
+    int dst_mode = (word >> DST_MODE_SHIFT) & MODE_MASK;
+    int count;
+    unsigned int pair;
+
+    inst->opcode = (unsigned char)((word >> OPCODE_SHIFT) & OPCODE_MASK);
+    inst->flags = 0;
+    inst->length = 1;
+    memset(&inst->src, 0, sizeof(inst->src));
+    memset(&inst->dst, 0, sizeof(inst->dst));
+
+    count = operand_count_for(inst->opcode);
+    if (count < 0) return FAILURE;
+    inst->operands = (unsigned char)count;
+
+    if (count == DOUBLE_OPERAND && src_mode == MODE_REGISTER && dst_mode == MODE_REGISTER) {
+        /* both registers share one word */
+        pair = m->memory[(address + 1) & MACHINE_ADDRESS_MASK];
+        inst->src.mode = MODE_REGISTER;
+        inst->src.reg = (unsigned char)((pair >> FIRST_REGISTER_SHIFT) & SEVEN_BIT_MASK);
+        inst->dst.mode = MODE_REGISTER;
+        inst->dst.reg = (unsigned char)((pair >> SECOND_REGISTER_SHIFT) & SEVEN_BIT_MASK);
+        inst->length = 2;
+    } else if (count == DOUBLE_OPERAND) {
+        inst->length += decode_operand(m, src_mode, address + inst->length, &inst->src, &inst->flags);
+        inst->length += decode_operand(m, dst_mode, address + inst->length, &inst->dst, &inst->flags);
+    } else if (count == SINGLE_OPERAND) {
+        inst->length += decode_operand(m, dst_mode, address + inst->length, &inst->dst, &inst->flags);
+    }
+
+    return SUCCESS;
+}
+
+/**
+ * refresh_slow_flag - recompute whether an address takes the slow path
+ * @param m: machine to update
+ * @param address: instruction address
+ */
+static void refresh_slow_flag(machine *m, int address) {
+    decoded_instruction *inst = &m->decoded[address];
+
+    if (m->hook_map[address] || (inst->flags & (DECODED_INVALID | DECODED_EXTERNAL))) {
+        inst->flags |= DECODED_SLOW_PATH;
+    } else {
+        inst->flags &= ~DECODED_SLOW_PATH;
+    }
+}
+
+/**
+ * machine_predecode - rebuild the decoded table from memory and the hook map
+ * @param m: machine to decode
+ * @return SUCCESS if every instruction decodes, FAILURE otherwise
+ */
+int machine_predecode(machine *m) {
+    int address;
+
+    /* anything that is not an instruction start faults on the slow path */
+    for (address = 0; address < MACHINE_MEMORY_SIZE; address++) {
+        m->decoded[address].flags = DECODED_INVALID | DECODED_SLOW_PATH;
+    }
+
+    address = INITIAL_IC;
+    while (address < m->code_end) {
+        if (decode_instruction(m, address, &m->decoded[address]) == FAILURE) {
+            m->decoded[address].flags = DECODED_INVALID | DECODED_SLOW_PATH;
+            fprintf(stderr, ERROR_BAD_INSTRUCTION, address);
+            return FAILURE;
+        }
+        refresh_slow_flag(m, address);
+        address += m->decoded[address].length;
+    }
+
+    return SUCCESS;
+}
+
+/**
+ * init_machine - load an object into a fresh machine and pre-decode its code
+ * @param m: machine to initialize
+ * @param module: object read by load_object_file
+ * @param input: stream read by red
+ * @param output: stream written by prn
+ * @return SUCCESS if the program fits and decodes, FAILURE otherwise
+ */
+int init_machine(machine *m, const object_module *module, FILE *input, FILE *output) {
+    int i;
+
+    if (module->word_count > MACHINE_MEMORY_SIZE - INITIAL_IC) {
+        fprintf(stderr, ERROR_PROGRAM_TOO_LARGE, module->word_count, MACHINE_MEMORY_SIZE - INITIAL_IC, INITIAL_IC);
+        return FAILURE;
+    }
+
+    memset(m->memory, 0, sizeof(m->memory));
+    memset(m->hook_map, 0, sizeof(m->hook_map));
+    memset(m->registers, 0, sizeof(m->registers));
+    for (i = 0; i < module->word_count; i++) {
+        m->memory[INITIAL_IC + i] = module->words[i];
+    }
+
+    m->stack_depth = 0;
+    m->pc = INITIAL_IC;
+    m->zero_flag = NO;
+    m->code_end = INITIAL_IC + module->instruction_count;
+    m->steps = 0;
+    m->state = MACHINE_RUNNING;
+    m->hook = NULL;
+    m->hook_data = NULL;
+    m->input = input;
+    m->output = output;
+
+    return machine_predecode(m);
+}
+
+/**
+ * machine_set_hook_map - change which addresses take the slow path
+ * @param m: machine to update
+ * @param address: instruction address
+ * @param enabled: YES to flag the address, NO to clear it
+ */
+void machine_set_hook_map(machine *m, int address, int enabled) {
+    address &= MACHINE_ADDRESS_MASK;
+    m->hook_map[address] = (unsigned char)(enabled ? YES : NO);
+    refresh_slow_flag(m, address);
+}
+
+/**
+ * operand_address - effective memory address of a direct or matrix operand
+ * the object does not record matrix shape, so an element is addressed as
+ * label + row register + column register
+ * @param m: machine supplying register values
+ * @param op: decoded operand
+ * @return memory address, or -1 for immediate and register operands
+ */
+int operand_address(const machine *m, const decoded_operand *op) {
+    if (op->mode == MODE_DIRECT) return op->value;
+    if (op->mode == MODE_MATRIX) {
+        return (op->value + m->registers[op->reg] + m->registers[op->reg2]) & MACHINE_ADDRESS_MASK;
+    }
+    return -1;
+}
+
+/**
+ * operand_access - how executing an instruction touches an operand's memory
+ * @param inst: decoded instruction
+ * @param op: &inst->src or &inst->dst
+ * @return OPERAND_READ and/or OPERAND_WRITE, or OPERAND_NO_ACCESS for
+ *         registers, immediates, lea sources and jump targets
+ */
+int operand_access(const decoded_instruction *inst, const decoded_operand *op) {
+    if (op->mode != MODE_DIRECT && op->mode != MODE_MATRIX) return OPERAND_NO_ACCESS;
+
+    if (op == &inst->src) {
+        return (inst->operands == DOUBLE_OPERAND && inst->opcode != LEA) ? OPERAND_READ : OPERAND_NO_ACCESS;
+    }
+    if (inst->operands == NO_OPERANDS) return OPERAND_NO_ACCESS;
+
+    switch (inst->opcode) {
+        case MOV:
+        case LEA:
+        case CLR:
+        case RED:
+            return OPERAND_WRITE;
+        case CMP:
+        case PRN:
+            return OPERAND_READ;
+        case JMP:
+        case BNE:
+        case JSR:
+            return OPERAND_NO_ACCESS;
+        default:
+            return OPERAND_READ | OPERAND_WRITE;
+    }
+}
+
+/**
+ * read_operand - fetch the value of an operand
+ * @param m: machine to read
+ * @param op: decoded operand
+ * @return 10-bit value
+ */
+static int read_operand(const machine *m, const decoded_operand *op) {
+    switch (op->mode) {
+        case MODE_IMMEDIATE: return op->value;
+        case MODE_REGISTER: return m->registers[op->reg];
+        default: return m->memory[operand_address(m, op)];
+    }
+}
+
+/**
+ * write_operand - store a value through an operand
+ * @param m: machine to update
+ * @param op: decoded destination operand
+ * @param value: value to store (truncated to 10 bits)
+ */
+static void write_operand(machine *m, const decoded_operand *op, int value) {
+    int address;
+
+    value &= TEN_BIT_MASK;
+    switch (op->mode) {
+        case MODE_REGISTER:
+            m->registers[op->reg] = value;
+            break;
+        case MODE_DIRECT:
+        case MODE_MATRIX:
+            address = operand_address(m, op);
+            m->memory[address] = (unsigned short)value;
+            /* code was decoded at load time; keep it in step with self-modification */
+            if (address >= INITIAL_IC && address < m->code_end) {
+                machine_predecode(m);
+            }
+            break;
+        default:
+            fprintf(stderr, ERROR_BAD_DESTINATION, m->pc);
+            m->state = MACHINE_FAULT;
+            break;
+    }
+}
+
+/**
+ * execute - run one decoded instruction and advance the program counter
+ * @param m: machine to update
+ * @param inst: instruction at the program counter
+ */
+static void execute(machine *m, const decoded_instruction *inst) {
+    int next = (m->pc + inst->length) & MACHINE_ADDRESS_MASK;
+    int value;
+
+    switch (inst->opcode) {
+        case MOV:
+            write_operand(m, &inst->dst, read_operand(m, &inst->src));
+            break;
+        case CMP:
+            m->zero_flag = read_operand(m, &inst->src) == read_operand(m, &inst->dst);
+            break;
+        case ADD:
+            write_operand(m, &inst->dst, read_operand(m, &inst->dst) + read_operand(m, &inst->src));
+            break;
+        case SUB:
+            write_operand(m, &inst->dst, read_operand(m, &inst->dst) - read_operand(m, &inst->src));
+            break;
+        case LEA:
+            write_operand(m, &inst->dst, operand_address(m, &inst->src));
+            break;
+        case CLR:
+            write_operand(m, &inst->dst, 0);
+            break;
+        case NOT:
+            write_operand(m, &inst->dst, ~read_operand(m, &inst->dst));
+            break;
+        case INC:
+            write_operand(m, &inst->dst, read_operand(m, &inst->dst) + 1);
+            break;
+        case DEC:
+            write_operand(m, &inst->dst, read_operand(m, &inst->dst) - 1);
+            break;
+        case JMP:
+            next = operand_address(m, &inst->dst);
+            break;
+        case BNE:
+            if (!m->zero_flag) next = operand_address(m, &inst->dst);
+            break;
+        case JSR:
+            if (m->stack_depth >= MACHINE_STACK_SIZE) {
+                fprintf(stderr, ERROR_STACK_OVERFLOW, m->pc);
+                m->state = MACHINE_FAULT;
+                return;
+            }
+            m->stack[m->stack_depth++] = next;
+            next = operand_address(m, &inst->dst);
+            break;
+        case RED:
+            value = getc(m->input);
+            write_operand(m, &inst->dst, value);
+            break;
+        case PRN:
+            fprintf(m->output, "%d\n", word_to_int(read_operand(m, &inst->dst)));
+            break;
+        case RTS:
+            /* returning from the outermost routine ends the program */
+            if (m->stack_depth == 0) {
+                m->state = MACHINE_HALTED;
+                next = m->pc;
+                break;
+            }
+            next = m->stack[--m->stack_depth];
+            break;
+        case STOP:
+            m->state = MACHINE_HALTED;
+            next = m->pc;
+            break;
+    }
+
+    m->pc = next;
+    m->steps++;
+}
+
+/**
+ * check_executable - fault on addresses that cannot run
+ * @param m: machine about to execute
+ * @param inst: instruction at the program counter
+ * @return SUCCESS if the instruction can run, FAILURE after setting the fault state
+ */
+static int check_executable(machine *m, const decoded_instruction *inst) {
+    if (inst->flags & DECODED_INVALID) {
+        fprintf(stderr, ERROR_EXECUTE_INVALID, m->pc);
+        m->state = MACHINE_FAULT;
+        return FAILURE;
+    }
+    if (inst->flags & DECODED_EXTERNAL) {
+        fprintf(stderr, ERROR_EXECUTE_EXTERNAL, m->pc);
+        m->state = MACHINE_FAULT;
+        return FAILURE;
+    }
+    return SUCCESS;
+}
+
+/**
+ * slow_path - run tool hooks and fault checks for a flagged instruction
+ * @param m: machine about to execute
+ * @param inst: instruction at the program counter
+ * @return MACHINE_RUNNING to execute it, any other state to stop
+ */
+static machine_state slow_path(machine *m, const decoded_instruction *inst) {
+    if (m->hook && m->hook_map[m->pc]) {
+        m->state = m->hook(m, inst);
+        if (m->state != MACHINE_RUNNING) return m->state;
+    }
+    check_executable(m, inst);
+    return m->state;
+}
+
+/**
+ * machine_step - execute one instruction without running the slow-path hook
+ * @param m: machine to step
+ * @return state after the instruction
+ */
+machine_state machine_step(machine *m) {
+    const decoded_instruction *inst = &m->decoded[m->pc];
+
+    m->state = MACHINE_RUNNING;
+    if (check_executable(m, inst) == SUCCESS) {
+        execute(m, inst);
+    }
+    return m->state;
+}
+
+/**
+ * machine_run - execute until halt, fault, or a hook pauses
+ * @param m: machine to run
+ * @return final state
+ */
+machine_state machine_run(machine *m) {
+    const decoded_instruction *inst;
+
+    m->state = MACHINE_RUNNING;
+    while (m->state == MACHINE_RUNNING) {
+        inst = &m->decoded[m->pc];
+        /* the only per-instruction test; breakpoints and faults live behind it */
+        if ((inst->flags & DECODED_SLOW_PATH) && slow_path(m, inst) != MACHINE_RUNNING) {
+            break;
+        }
+        execute(m, inst);
+    }
+    return m->state;
+}
@@ -0,0 +1,159 @@
+#ifndef MACHINE_H
+#define MACHINE_H
+
+#include <stdio.h>
+#include "utils.h"
+#include "obj_reader.h"
+
+/* machine configuration */
+#define MACHINE_MEMORY_SIZE OBJECT_ADDRESS_SPACE
+#define MACHINE_ADDRESS_MASK OBJECT_ADDRESS_MASK
+#define NUM_REGISTERS (MAX_REGISTER_NUMBER + 1)
+#define MACHINE_STACK_SIZE 64
+
+/* sign bits for operand values */
+#define IMMEDIATE_SIGN_BIT 0x80     /* immediates are 8-bit two's complement */
+#define WORD_SIGN_BIT 0x200         /* memory and registers hold 10-bit words */
+
+/* operand word layout */
+#define OPERAND_VALUE_SHIFT 2       /* value/address above the A,R,E bits */
+#define FIRST_REGISTER_SHIFT 6      /* packed register pair: first register */
+#define SECOND_REGISTER_SHIFT 2     /* packed register pair: second register */
+
+/* decoded instruction flags */
+#define DECODED_INVALID 0x1         /* address is not the start of an instruction */
+#define DECODED_SLOW_PATH 0x2       /* run the slow path before executing */
+#define DECODED_EXTERNAL 0x4        /* has an unresolved external operand */
+
+/* how an instruction uses an operand's memory */
+#define OPERAND_NO_ACCESS 0x0
+#define OPERAND_READ 0x1
+#define OPERAND_WRITE 0x2
+
+/* error messages */
+#define ERROR_PROGRAM_TOO_LARGE "Error: program has %d words, memory holds %d from address %d\n"
+#define ERROR_BAD_INSTRUCTION "Error: invalid instruction word at address %d\n"
+#define ERROR_EXECUTE_INVALID "Runtime error: no instruction at address %d\n"
+#define ERROR_EXECUTE_EXTERNAL "Runtime error: unresolved external reference at address %d\n"
+#define ERROR_STACK_OVERFLOW "Runtime error: call stack overflow at address %d\n"
+#define ERROR_BAD_DESTINATION "Runtime error: immediate destination at address %d\n"
+
+/* execution states */
+typedef enum {
+    MACHINE_RUNNING,     /* ready to execute the next instruction */
+    MACHINE_PAUSED,      /* a slow-path hook requested a stop */
+    MACHINE_HALTED,      /* stop, or rts with an empty call stack */
+    MACHINE_FAULT        /* runtime error */
+} machine_state;
+
+/* one operand of a pre-decoded instruction */
+typedef struct {
+    unsigned char mode;         /* addressing_mode */
+    unsigned char reg;          /* register, or matrix row register */
+    unsigned char reg2;         /* matrix column register */
+    int value;                  /* immediate value or memory address */
+} decoded_operand;
+
+/* instruction decoded once at load time */
+typedef struct {
+    unsigned char opcode;       /* opcode_types value */
+    unsigned char operands;     /* number of operands */
+    unsigned char length;       /* words including operand words */
+    unsigned char flags;        /* DECODED_* flags */
+    decoded_operand src;        /* source operand (two-operand instructions) */
+    decoded_operand dst;        /* destination operand */
+} decoded_instruction;
+
+struct machine;
+
+/**
+ * machine_hook - slow-path callback, called before executing a flagged instruction
+ * @param m: machine about to execute
+ * @param inst: instruction at the program counter
+ * @return MACHINE_RUNNING to execute it, or MACHINE_PAUSED to stop before it
+ */
+typedef machine_state (*machine_hook)(struct machine *m, const decoded_instruction *inst);
+
+/* execution engine state */
+typedef struct machine {
+    unsigned short memory[MACHINE_MEMORY_SIZE];         /* 10-bit words */
+    decoded_instruction decoded[MACHINE_MEMORY_SIZE];   /* pre-decoded code, one entry per address */
+    unsigned char hook_map[MACHINE_MEMORY_SIZE];        /* addresses that take the slow path */
+    int registers[NUM_REGISTERS];                       /* 10-bit register values */
+    int stack[MACHINE_STACK_SIZE];                      /* return addresses */
+    int stack_depth;
+    int pc;                     /* program counter */
+    int zero_flag;              /* set by cmp when both operands are equal */
+    int code_end;               /* first address after the instruction segment */
+    unsigned long steps;        /* instructions executed */
+    machine_state state;
+    machine_hook hook;          /* slow-path callback, or NULL */
+    void *hook_data;            /* tool state for the hook */
+    FILE *input;                /* stream read by red */
+    FILE *output;               /* stream written by prn */
+} machine;
+
+/**
+ * init_machine - load an object into a fresh machine and pre-decode its code
+ * @param m: machine to initialize
+ * @param module: object read by load_object_file
+ * @param input: stream read by red
+ * @param output: stream written by prn
+ * @return SUCCESS if the program fits and decodes, FAILURE otherwise
+ */
+int init_machine(machine *m, const object_module *module, FILE *input, FILE *output);
+
+/**
+ * machine_predecode - rebuild the decoded table from memory and the hook map
+ * @param m: machine to decode
+ * @return SUCCESS if every instruction decodes, FAILURE otherwise
+ */
+int machine_predecode(machine *m);
+
+/**
+ * machine_set_hook_map - change which addresses take the slow path
+ * @param m: machine to update
+ * @param address: instruction address
+ * @param enabled: YES to flag the address, NO to clear it
+ */
+void machine_set_hook_map(machine *m, int address, int enabled);
+
+/**
+ * machine_step - execute one instruction without running the slow-path hook
+ * @param m: machine to step
+ * @return state after the instruction
+ */
+machine_state machine_step(machine *m);
+
+/**
+ * machine_run - execute until halt, fault, or a hook pauses
+ * @param m: machine to run
+ * @return final state
+ */
+machine_state machine_run(machine *m);
+
+/**
+ * operand_address - effective memory address of a direct or matrix operand
+ * @param m: machine supplying register values
+ * @param op: decoded operand
+ * @return memory address, or -1 for immediate and register operands
+ */
+int operand_address(const machine *m, const decoded_operand *op);
+
+/**
+ * operand_access - how executing an instruction touches an operand's memory
+ * @param inst: decoded instruction
+ * @param op: &inst->src or &inst->dst
+ * @return OPERAND_READ and/or OPERAND_WRITE, or OPERAND_NO_ACCESS for
+ *         registers, immediates, lea sources and jump targets
+ */
+int operand_access(const decoded_instruction *inst, const decoded_operand *op);
+
+/**
+ * word_to_int - sign-extend a 10-bit word
+ * @param word: 10-bit value
+ * @return signed value
+ */
+int word_to_int(int word);
+
+#endif /* MACHINE_H */
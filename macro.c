@@ -1,4 +1,6 @@
 #include "macro.h"
+#include "repeat.h"
+#include "archive.h"
 
 #include <ctype.h>
 
@@ -12,8 +14,22 @@
  * @macro_list: pointer to macro list structure
  */
 void init_macro_list(macro_list* macro_list) {
+    int i;
+
     macro_list->head = INITIAL_MACRO_LIST_HEAD;
     macro_list->count = INITIAL_MACRO_COUNT;
+    for (i = LOOP_START_INDEX; i < MACRO_HASH_BUCKETS; i++) {
+        macro_list->buckets[i] = NULL;
+    }
+}
+
+/**
+ * macro_bucket - bucket of a macro name
+ * @name: macro name
+ * @return index into macro_list buckets
+ */
+static int macro_bucket(const char* name) {
+    return (int)(hash_string(name) & (MACRO_HASH_BUCKETS - 1));
 }
 
 /**
@@ -24,7 +40,7 @@ void init_macro_list(macro_list* macro_list) {
 int check_if_macro_start(const char* line) {
     const char* name_start;
     char temp_name[MAX_WORD_LENGTH];
-    char* newline;
+    int i;
 
     /* remove all tabs and spaces */
     while (*line == SPACE_CHAR || *line == TAB_CHAR) {
@@ -43,15 +59,14 @@ int check_if_macro_start(const char* line) {
     name_start = line + MCRO_SPACE_OFFSET;
     while (*name_start == SPACE_CHAR) name_start++;
 
-    /* copy the name of the macro to a temp string */
-    strcpy(temp_name, name_start);
-
-    /* look for new line - so the macro name is before it and we will get a pointer to it */
-    newline = strchr(temp_name, NEWLINE_CHAR);
-    if (newline) {
-        /* find the name, now put end of line */
-        *newline = NULL_CHAR;
+    /* copy the name of the macro to a temp string, the parameters follow it */
+    i = 0;
+    while (name_start[i] && name_start[i] != SPACE_CHAR && name_start[i] != TAB_CHAR &&
+           name_start[i] != NEWLINE_CHAR && i < MAX_WORD_LENGTH - 1) {
+        temp_name[i] = name_start[i];
+        i++;
     }
+    temp_name[i] = NULL_CHAR;
 
     /* check macro name length */
     if (strlen(temp_name) > MAX_MACRO_NAME - NULL_TERMINATOR_SIZE) {
@@ -123,16 +138,100 @@ void extract_macro_name(const char* line, char* name) {
 }
 
 /**
- * is_macro_call - checks if line contains macro invocation
+ * is_param_name - checks a parameter name: a letter, then letters, digits and underscores
+ * @name: name to check
+ * @return YES if valid, NO otherwise
+ */
+static int is_param_name(const char* name) {
+    int i;
+
+    if (!isalpha((unsigned char)name[0])) return NO;
+    for (i = 1; name[i]; i++) {
+        if (!isalnum((unsigned char)name[i]) && name[i] != UNDERSCORE_CHAR) return NO;
+    }
+    return YES;
+}
+
+/**
+ * find_param - looks up a parameter by name
+ * @params: declared parameters
+ * @name: name to find
+ * @return index of the parameter, -1 if not declared
+ */
+static int find_param(const macro_params* params, const char* name) {
+    int i;
+
+    for (i = 0; i < params->count; i++) {
+        if (strcmp(params->names[i], name) == 0) return i;
+    }
+    return -1;
+}
+
+/**
+ * extract_macro_params - reads the parameter list of a macro definition line
+ * @line: macro definition line, "mcro name a, b"
+ * @name: macro name, for messages
+ * @params: output parameter names
+ * @line_number: line number for messages
+ * @return SUCCESS if every parameter is a valid, distinct name, FAILURE otherwise
+ */
+int extract_macro_params(const char* line, const char* name, macro_params* params, int line_number) {
+    char param[MAX_WORD_LENGTH];
+    int i;
+
+    params->count = 0;
+
+    /* skip 'mcro' and the name */
+    while (*line == SPACE_CHAR || *line == TAB_CHAR) line++;
+    line += MCRO_SPACE_OFFSET;
+    while (*line == SPACE_CHAR || *line == TAB_CHAR) line++;
+    while (*line && *line != SPACE_CHAR && *line != TAB_CHAR && *line != NEWLINE_CHAR) line++;
+    while (*line == SPACE_CHAR || *line == TAB_CHAR) line++;
+    if (*line == NULL_CHAR || *line == NEWLINE_CHAR) return SUCCESS;
+
+    while (1) {
+        /* one name, up to a comma or the end of the line */
+        i = 0;
+        while (*line && *line != COMMA_CHAR && *line != SPACE_CHAR && *line != TAB_CHAR && *line != NEWLINE_CHAR &&
+               i < MAX_WORD_LENGTH - 1) {
+            param[i++] = *line++;
+        }
+        param[i] = NULL_CHAR;
+        while (*line == SPACE_CHAR || *line == TAB_CHAR) line++;
+
+        if (!is_param_name(param) || strlen(param) > MAX_MACRO_NAME - NULL_TERMINATOR_SIZE ||
+            find_param(params, param) >= 0 || (*line && *line != COMMA_CHAR && *line != NEWLINE_CHAR)) {
+            fprintf(stderr, ERROR_INVALID_MACRO_PARAM, param, name, line_number);
+            return FAILURE;
+        }
+        if (params->count == MAX_MACRO_PARAMS) {
+            fprintf(stderr, ERROR_TOO_MANY_MACRO_PARAMS, name, MAX_MACRO_PARAMS, line_number);
+            return FAILURE;
+        }
+        strcpy(params->names[params->count++], param);
+
+        if (*line != COMMA_CHAR) return SUCCESS;
+        line++;
+        while (*line == SPACE_CHAR || *line == TAB_CHAR) line++;
+    }
+}
+
+/**
+ * find_macro_call - looks up the macro a line invokes
  * @line: line string to check
  * @macro_list: table of defined macros
- * @return SUCCESS if macro call detected, FAILURE otherwise
+ * @return pointer to the called macro, NULL if the line is not a macro call
  */
-int is_macro_call(const char* line, const macro_list* macro_list) {
+macro* find_macro_call(const char* line, const macro_list* macro_list) {
     char first_word[MAX_MACRO_NAME];
     int i;
     int j;
 
+    /* nothing to find, skip copying the word */
+    if (macro_list->count == INITIAL_MACRO_COUNT) {
+        return NULL;
+    }
+
     i = 0;
     j = 0;
 
@@ -146,16 +245,95 @@ int is_macro_call(const char* line, const macro_list* macro_list) {
     /* put end of string */
     first_word[i] = NULL_CHAR;
     /* check if the macro is in the macro list */
-    return find_macro(macro_list, first_word) != NULL;
+    return find_macro(macro_list, first_word);
+}
+
+/**
+ * is_macro_call - checks if line contains macro invocation
+ * @line: line string to check
+ * @macro_list: table of defined macros
+ * @return SUCCESS if macro call detected, FAILURE otherwise
+ */
+int is_macro_call(const char* line, const macro_list* macro_list) {
+    return find_macro_call(line, macro_list) != NULL;
+}
+/**
+ * reference_param - finds the parameter a reference in a macro body names
+ * the name is the longest run of letters, digits and underscores after the prefix
+ * @m: macro with its params set
+ * @text: text after the prefix
+ * @end: output for the end of the name
+ * @return parameter index, or -1 if the text does not name a declared parameter
+ */
+static int reference_param(const macro* m, const char* text, const char** end) {
+    char reference[MAX_MACRO_NAME];
+    int i = 0;
+
+    while (isalnum((unsigned char)*text) || *text == UNDERSCORE_CHAR) {
+        /* a name longer than any parameter can match none of them */
+        if (i == MAX_MACRO_NAME - NULL_TERMINATOR_SIZE) return -1;
+        reference[i++] = *text++;
+    }
+    reference[i] = NULL_CHAR;
+    *end = text;
+    return find_param(&m->params, reference);
 }
+
 /**
- * add_macro - adds new macro to table
+ * compile_macro - splits a macro body into literal text and parameter slots
+ * only the prefix followed by a declared parameter name is a slot; anything else
+ * (a backslash in a .string, the .rept counter, any body of a macro without
+ * parameters) is text, so bodies written before parameters existed are unchanged
+ * @m: macro with name, params and line origins set
+ * @body: body as written
+ */
+static void compile_macro(macro* m, const char* body) {
+    const char* end;
+    int param;
+    int length = 0;
+    int line = 0;
+
+    m->slot_count = 0;
+    m->line_starts[0] = 0;
+    m->line_slots[0] = 0;
+    while (*body) {
+        if (*body == MACRO_PARAM_PREFIX && m->params.count > 0 && isalpha((unsigned char)body[1]) &&
+            (param = reference_param(m, body + 1, &end)) >= 0) {
+            m->slots[m->slot_count].param = param;
+            m->slots[m->slot_count++].offset = length;
+            body = end;
+            continue;
+        }
+        m->content[length++] = *body;
+        if (*body++ == NEWLINE_CHAR) {
+            line++;
+            m->line_starts[line] = length;
+            m->line_slots[line] = m->slot_count;
+        }
+    }
+    m->content[length] = NULL_CHAR;
+
+    /* a last line without a newline still counts */
+    if (length > m->line_starts[line] || m->line_slots[line] < m->slot_count) {
+        line++;
+        m->line_starts[line] = length;
+        m->line_slots[line] = m->slot_count;
+    }
+    m->body_lines = line;
+}
+
+/**
+ * add_macro - adds new macro to table, compiling its body into a template
  * @macro_list: pointer to macro table
  * @name: macro name
+ * @params: declared parameters
  * @content: macro body content
- * @return SUCCESS on successful addition, FAILURE otherwise
+ * @lines: source line of each body line
+ * @line_count: number of body lines
+ * @return SUCCESS on successful addition, FAILURE otherwise (no memory)
  */
-int add_macro(macro_list* macro_list, const char* name, const char* content) {
+int add_macro(macro_list* macro_list, const char* name, const macro_params* params, const char* content,
+              const int* lines, int line_count) {
     macro_node* new_node;
 
     new_node = (macro_node*)malloc(sizeof(macro_node));
@@ -166,12 +344,19 @@ int add_macro(macro_list* macro_list, const char* name, const char* content) {
     }
     /*copy the name*/
     strcpy(new_node->macro.name, name);
-    /*copy the macro code*/
-    strcpy(new_node->macro.content, content);
+    /*copy where each body line came from, for the line map*/
+    memcpy(new_node->macro.lines, lines, line_count * sizeof(int));
+    new_node->macro.line_count = line_count;
+    new_node->macro.params = *params;
+    /*compile the macro code, so a call only joins text and arguments*/
+    compile_macro(&new_node->macro, content);
     /*add the macro to the macro list*/
     new_node->next = macro_list->head;
     macro_list->head = new_node;
     macro_list->count++;
+    /*and to its bucket, for find_macro*/
+    new_node->next_in_bucket = macro_list->buckets[macro_bucket(name)];
+    macro_list->buckets[macro_bucket(name)] = new_node;
 
     return SUCCESS; /* success */
 }
@@ -185,12 +370,12 @@ int add_macro(macro_list* macro_list, const char* name, const char* content) {
 macro* find_macro(const macro_list* macro_list, const char* name) {
     macro_node* current;
 
-    current = macro_list->head;
+    current = macro_list->buckets[macro_bucket(name)];
     while (current != NULL) {
         if (strcmp(current->macro.name, name) == 0) {
             return &current->macro;
         }
-        current = current->next;
+        current = current->next_in_bucket;
     }
     return NULL;
 }
@@ -212,52 +397,231 @@ void free_macro_list(macro_list* macro_list) {
     init_macro_list(macro_list);
 }
 
+/**
+ * close_output - close the expanded file and the line map
+ * @out: destination files
+ */
+static void close_output(const expansion_output* out) {
+    flush_expansion(out);
+    free_text_buffer(out->chunk);
+    release_output(out->text);
+    if (out->lines) release_output(out->lines);
+}
+
+/**
+ * split_macro_args - splits the arguments of a macro call at commas
+ * @line: macro call line, copied into buffer
+ * @macro: macro being called
+ * @buffer: holds the arguments
+ * @args: output, one trimmed argument per parameter
+ * @line_number: line of the macro call, for messages
+ * @return SUCCESS if there is one non-empty argument per parameter, FAILURE otherwise
+ */
+static int split_macro_args(const char* line, const macro* macro, char* buffer, const char** args, int line_number) {
+    char* p;
+    char* start;
+    char* end;
+    char separator;
+    int count = 0;
+
+    strcpy(buffer, line);
+    p = buffer;
+    /* skip the macro name */
+    while (*p == SPACE_CHAR || *p == TAB_CHAR) p++;
+    while (*p && *p != SPACE_CHAR && *p != TAB_CHAR && *p != NEWLINE_CHAR) p++;
+
+    while (1) {
+        /* one argument, up to a comma or the end of the line */
+        while (*p == SPACE_CHAR || *p == TAB_CHAR) p++;
+        start = p;
+        while (*p && *p != COMMA_CHAR && *p != NEWLINE_CHAR) p++;
+        separator = *p;
+        end = p;
+        while (end > start && (end[-1] == SPACE_CHAR || end[-1] == TAB_CHAR)) end--;
+        *end = NULL_CHAR;
+        if (start == end) {
+            if (count == 0 && separator != COMMA_CHAR) break;   /* no arguments at all */
+            fprintf(stderr, ERROR_EMPTY_MACRO_ARG, line_number, macro->name);
+            return FAILURE;
+        }
+        if (count < MAX_MACRO_PARAMS) args[count] = start;
+        count++;
+        if (separator != COMMA_CHAR) break;
+        p++;
+    }
+
+    if (count != macro->params.count) {
+        fprintf(stderr, ERROR_MACRO_ARG_COUNT, line_number, macro->name, macro->params.count, count);
+        return FAILURE;
+    }
+    return SUCCESS;
+}
+
+/**
+ * append_line_text - appends to a line being expanded
+ * @line: line buffer of MAX_LINE_LENGTH characters
+ * @length: current length, advanced
+ * @text: text to append
+ * @count: number of characters
+ * @return SUCCESS if it fits, FAILURE otherwise
+ */
+static int append_line_text(char* line, size_t* length, const char* text, size_t count) {
+    if (*length + count >= MAX_LINE_LENGTH) return FAILURE;
+    memcpy(line + *length, text, count);
+    *length += count;
+    return SUCCESS;
+}
+
+/**
+ * write_macro_content - write an expanded macro body through the repeat block handling
+ * each line is joined from the literal pieces of the compiled body and the arguments
+ * @macro: macro being called
+ * @args: one argument per parameter
+ * @repeat: repeat state of the file being expanded
+ * @line_number: line of the macro call, for messages
+ * @out: destination files
+ * @return SUCCESS if written, FAILURE on a malformed repeat block or an overlong line
+ */
+static int write_macro_content(const macro* macro, const char** args, repeat_state* repeat, int line_number,
+                               const expansion_output* out) {
+    char line[MAX_LINE_LENGTH];
+    const macro_slot* slot;
+    size_t length;
+    int from;
+    int fits;
+    int index;
+    int s;
+
+    for (index = 0; index < macro->body_lines; index++) {
+        length = 0;
+        from = macro->line_starts[index];
+        fits = SUCCESS;
+        for (s = macro->line_slots[index]; s < macro->line_slots[index + 1] && fits; s++) {
+            slot = &macro->slots[s];
+            fits = append_line_text(line, &length, macro->content + from, (size_t)(slot->offset - from));
+            if (fits) fits = append_line_text(line, &length, args[slot->param], strlen(args[slot->param]));
+            from = slot->offset;
+        }
+        if (fits) fits = append_line_text(line, &length, macro->content + from, (size_t)(macro->line_starts[index + 1] - from));
+        if (!fits) {
+            fprintf(stderr, ERROR_MACRO_LINE_TOO_LONG, line_number, macro->name, MAX_LINE_LENGTH - 1);
+            return FAILURE;
+        }
+        line[length] = NULL_CHAR;
+        if (repeat_line(repeat, line, macro->lines[index < macro->line_count ? index : macro->line_count - 1],
+                        line_number, out) == FAILURE) {
+            return FAILURE;
+        }
+    }
+    return SUCCESS;
+}
+
 /**
  * expand_macros - expands macros from input file to output file
  * @input_file: source file containing macro definitions and calls
  * @output_file: destination file for macro-expanded code
+ * @defines: symbols defined on the command line for conditional assembly, or NULL
+ * @line_map_file: file to receive the source line of each expanded line, or NULL
+ * @stats: receives the lines and bytes of input_file, or NULL
+ * @return SUCCESS if expanded, FAILURE otherwise
  */
-void expand_macros(const char* input_file, const char* output_file) {
+int expand_macros(const char* input_file, const char* output_file, const define_list* defines,
+                  const char* line_map_file, source_stats* stats) {
     FILE* input;
     FILE* output;
     macro_list macro_list;
     int in_macro_definition;
     char current_macro_name[MAX_MACRO_NAME];
+    macro_params current_params;
     char current_macro_content[MAX_MACRO_BODY];
+    int current_macro_lines[MAX_MACRO_LINES];
+    int current_line_count;
     char line[MAX_LINE_LENGTH];
     int content_length;
     int line_number;
+    condition_state conditions;
+    repeat_state repeat;
+    expansion_output out;
+    text_buffer chunk;
+    macro* called;
+    char arguments[MAX_LINE_LENGTH];
+    const char* args[MAX_MACRO_PARAMS];
+    int line_kind;
+    int status;
+
+    if (stats) {
+        stats->lines = 0;
+        stats->bytes = 0;
+    }
 
     /*open the input file for reading */
     input = fopen(input_file, FILE_READ_MODE);
     if (!input) {
         fprintf(stderr, ERROR_CANNOT_OPEN_INPUT, input_file);
-        return;
+        return FAILURE;
     }
-    output = fopen(output_file, FILE_WRITE_MODE);
+    output = create_output(output_file);
     if (!output) {
         fprintf(stderr, ERROR_CANNOT_CREATE_OUTPUT, output_file);
         fclose(input);
-        return;
+        return FAILURE;
+    }
+    out.text = output;
+    out.lines = NULL;
+    init_text_buffer(&chunk);
+    out.chunk = &chunk;
+    if (line_map_file) {
+        out.lines = create_output(line_map_file);
+        if (!out.lines) {
+            fprintf(stderr, ERROR_CANNOT_CREATE_OUTPUT, line_map_file);
+            fclose(input);
+            release_output(output);
+            return FAILURE;
+        }
     }
 
     init_macro_list(&macro_list);
     in_macro_definition = 0;
     content_length = INITIAL_CONTENT_LENGTH;
+    current_line_count = 0;
     line_number = 0;
 
+    if (init_conditions(&conditions, defines) == FAILURE) {
+        fclose(input);
+        close_output(&out);
+        return FAILURE;
+    }
+
     /* first pass: collect macro definitions */
     while (fgets(line, sizeof(line), input)) {
         line_number++;
 
+        /* the whole file passes through here once, so it is measured here */
+        if (stats) {
+            stats->lines++;
+            stats->bytes += (unsigned long)strlen(line);
+        }
+
         if (strlen(line) >= MAX_LINE_LENGTH - 1 && line[MAX_LINE_LENGTH - 2] != NEWLINE_CHAR) {
             fprintf(stderr, ERROR_LINE_TOO_LONG, MAX_LINE_LENGTH - 1);
+            release_conditions(&conditions);
             free_macro_list(&macro_list);
             fclose(input);
-            fclose(output);
-            return;
+            close_output(&out);
+            return FAILURE;
         }
 
+        /* conditional directives are consumed here; skipped lines never reach the parser */
+        line_kind = handle_conditional_line(&conditions, line, line_number);
+        if (line_kind == CONDITIONAL_ERROR) {
+            release_conditions(&conditions);
+            free_macro_list(&macro_list);
+            fclose(input);
+            close_output(&out);
+            return FAILURE;
+        }
+        if (line_kind == CONDITIONAL_DIRECTIVE || !conditions.active) continue;
+
         /*check if their a macro start in the line*/
         if (check_if_macro_start(line)) {
             /* extract macro name to check if valid */
@@ -266,21 +630,37 @@ void expand_macros(const char* input_file, const char* output_file) {
             /* check if valid */
             if (!validate_macro_name(current_macro_name, &macro_list)) {
                 fprintf(stderr, ERROR_INVALID_MACRO_NAME, current_macro_name, line_number);
+                release_conditions(&conditions);
                 free_macro_list(&macro_list);
                 fclose(input);
-                fclose(output);
-                return;
+                close_output(&out);
+                return FAILURE;
+            }
+            if (extract_macro_params(line, current_macro_name, &current_params, line_number) == FAILURE) {
+                release_conditions(&conditions);
+                free_macro_list(&macro_list);
+                fclose(input);
+                close_output(&out);
+                return FAILURE;
             }
 
             in_macro_definition = 1;
             content_length = INITIAL_CONTENT_LENGTH;
             current_macro_content[0] = NULL_CHAR;
+            current_line_count = 0;
         }
         /*check if their a macro end in the line*/
         else if (check_if_macro_end(line)) {
             /*there is a macro end, so  add the macro if we are in the first pass*/
             if (in_macro_definition) {
-                add_macro(&macro_list, current_macro_name, current_macro_content);
+                if (add_macro(&macro_list, current_macro_name, &current_params, current_macro_content,
+                              current_macro_lines, current_line_count) == FAILURE) {
+                    release_conditions(&conditions);
+                    free_macro_list(&macro_list);
+                    fclose(input);
+                    close_output(&out);
+                    return FAILURE;
+                }
                 in_macro_definition = 0;
             }
         }
@@ -294,37 +674,74 @@ void expand_macros(const char* input_file, const char* output_file) {
                 /*add the line to the macro content*/
                 strcat(current_macro_content, line);
                 content_length += (int)line_len;
+                if (current_line_count < MAX_MACRO_LINES) current_macro_lines[current_line_count++] = line_number;
             }
         }
     }
 
+    /* every .if must be closed before the macros are expanded */
+    if (finish_conditions(&conditions) == FAILURE) {
+        free_macro_list(&macro_list);
+        fclose(input);
+        close_output(&out);
+        return FAILURE;
+    }
+
     /* check if we're still in a macro definition - there is no endmcro */
     if (in_macro_definition) {
         fprintf(stderr, ERROR_MISSING_ENDMCRO, current_macro_name);
         free_macro_list(&macro_list);
         fclose(input);
-        fclose(output);
-        return;
+        close_output(&out);
+        return FAILURE;
     }
 
     /*return to the start of the file*/
     rewind(input);
     line_number = 0;
+    if (init_conditions(&conditions, defines) == FAILURE) {
+        free_macro_list(&macro_list);
+        fclose(input);
+        close_output(&out);
+        return FAILURE;
+    }
 
     /* seond pass: expand macros */
     in_macro_definition = 0; /* Reset for second pass */
+    init_repeat(&repeat);
+    status = SUCCESS;
     while (fgets(line, sizeof(line), input)) {
         line_number++;
 
         if (strlen(line) >= MAX_LINE_LENGTH - 1 && line[MAX_LINE_LENGTH - 2] != NEWLINE_CHAR) {
             fprintf(stderr, ERROR_LINE_TOO_LONG, MAX_LINE_LENGTH - 1);
+            release_conditions(&conditions);
+            free_repeat(&repeat);
             free_macro_list(&macro_list);
             fclose(input);
-            fclose(output);
-            return;
+            close_output(&out);
+            return FAILURE;
         }
+
+        /* conditional directives are consumed here; skipped lines never reach the parser */
+        line_kind = handle_conditional_line(&conditions, line, line_number);
+        if (line_kind == CONDITIONAL_ERROR) {
+            release_conditions(&conditions);
+            free_repeat(&repeat);
+            free_macro_list(&macro_list);
+            fclose(input);
+            close_output(&out);
+            return FAILURE;
+        }
+        if (line_kind == CONDITIONAL_DIRECTIVE || !conditions.active) continue;
+
         /*if the line is a macro start, skip it and enter macro definition mode*/
         if (check_if_macro_start(line)) {
+            if (repeat.active) {
+                fprintf(stderr, ERROR_MACRO_IN_REPT, line_number);
+                status = FAILURE;
+                break;
+            }
             in_macro_definition = 1;
             continue;
         }
@@ -337,36 +754,31 @@ void expand_macros(const char* input_file, const char* output_file) {
         else if (in_macro_definition) {
             continue;
         }
-        /*if macro call, expand the macro*/
-        else if (is_macro_call(line, &macro_list)) {
-            char macro_name[MAX_MACRO_NAME];
-            macro* macro;
-            int i;
-            int j;
-
-            i = 0;
-            j = 0;
-            while (line[j] == SPACE_CHAR || line[j] == TAB_CHAR) j++;
-            while (line[j] && line[j] != SPACE_CHAR && line[j] != TAB_CHAR && line[j] != NEWLINE_CHAR && i < MAX_MACRO_NAME - 1) {
-                macro_name[i++] = line[j++];
-            }
-            macro_name[i] = NULL_CHAR;
-
-            /*find the macro in the macro list*/
-            macro = find_macro(&macro_list, macro_name);
-            if (macro) {
-                /*copy the macro content to the output file*/
-                fputs(macro->content, output);
-            }
+        /*if macro call, expand the macro (one lookup finds and fetches it)*/
+        else if ((called = find_macro_call(line, &macro_list)) != NULL) {
+            /*copy the macro content to the output file, a line at a time so .rept works inside macros*/
+            status = split_macro_args(line, called, arguments, args, line_number);
+            if (status == FAILURE) break;
+            status = write_macro_content(called, args, &repeat, line_number, &out);
+            if (status == FAILURE) break;
         }
-        else {
-            fputs(line, output);
+        else if ((status = repeat_line(&repeat, line, line_number, line_number, &out)) == FAILURE) {
+            break;
         }
     }
 
+    if (status == FAILURE) {
+        /* the error is already reported, only release the scan state */
+        release_conditions(&conditions);
+        free_repeat(&repeat);
+    } else {
+        finish_conditions(&conditions);
+        status = finish_repeat(&repeat);
+    }
     free_macro_list(&macro_list);
     fclose(input);
-    fclose(output);
+    close_output(&out);
+    return status;
 }
 
 /**
@@ -2,6 +2,7 @@
 #define MACRO_H
 
 #include "utils.h"
+#include "conditional.h"
 
 /* macro initialization */
 #define INITIAL_MACRO_LIST_HEAD NULL
@@ -22,7 +23,14 @@
 
 /* macro buffers size */
 #define MACRO_CONTENT_BUFFER_SIZE 1000
+#define MAX_MACRO_LINES (MAX_MACRO_BODY / 2)   /* a body line is at least a character and a newline */
 #define LINE_LENGTH_CHECK_OFFSET 2
+#define MACRO_HASH_BUCKETS 256          /* power of two */
+
+/* macro parameters: "mcro name a, b" declares them, "\a" in the body is replaced by an argument */
+#define MAX_MACRO_PARAMS 8
+#define MACRO_PARAM_PREFIX '\\'
+#define MAX_MACRO_SLOTS (MAX_MACRO_BODY / 2)   /* a reference is at least two characters */
 
 /* error message definitions for macro processing */
 #define ERROR_LINE_TOO_LONG "Error: line exceeds maximum length of %d characters\n"
@@ -31,23 +39,58 @@
 #define ERROR_CANNOT_CREATE_OUTPUT "Error: cannot create output file '%s'\n"
 #define ERROR_INVALID_MACRO_NAME "Error: invalid macro name '%s' at line %d\n"
 #define ERROR_MISSING_ENDMCRO "Error: macro '%s' missing 'endmcro' directive\n"
+#define ERROR_INVALID_MACRO_PARAM "Error: invalid parameter '%s' of macro '%s' at line %d\n"
+#define ERROR_TOO_MANY_MACRO_PARAMS "Error: macro '%s' has more than %d parameters at line %d\n"
+#define ERROR_MACRO_ARG_COUNT "Error (line %d): macro '%s' takes %d arguments, got %d\n"
+#define ERROR_EMPTY_MACRO_ARG "Error (line %d): empty argument to macro '%s'\n"
+#define ERROR_MACRO_LINE_TOO_LONG "Error (line %d): a line of macro '%s' is longer than %d characters after substitution\n"
+
+/* size of a source, counted while expand_macros reads it */
+typedef struct {
+    unsigned long lines;            /* lines read */
+    unsigned long bytes;            /* bytes read */
+} source_stats;
+
+/* parameter names of a macro, in declaration order */
+typedef struct {
+    char names[MAX_MACRO_PARAMS][MAX_MACRO_NAME];
+    int count;
+} macro_params;
+
+/* parameter reference cut out of a compiled body */
+typedef struct {
+    int offset;                     /* position in content where the argument goes */
+    int param;                      /* index into the macro's parameters */
+} macro_slot;
 
 /* macro definition structure */
+/* the body is compiled once when defined: literal text, where each line starts,
+ * and the slots that take arguments, so a call never rescans the body */
 typedef struct {
     char name[MAX_MACRO_NAME];      /* macro identifier */
-    char content[MAX_MACRO_BODY];   /* macro body content */
+    char content[MAX_MACRO_BODY];   /* macro body content, parameter references removed */
+    int lines[MAX_MACRO_LINES];     /* source line of each body line */
+    int line_count;                 /* number of body lines */
+    macro_params params;            /* declared parameters */
+    int body_lines;                 /* lines in content */
+    int line_starts[MAX_MACRO_LINES + 1];  /* offset of each line in content, then the end */
+    int line_slots[MAX_MACRO_LINES + 1];   /* first slot of each line, then slot_count */
+    macro_slot slots[MAX_MACRO_SLOTS];     /* argument slots in content order */
+    int slot_count;
 } macro;
 
 /* macro table node for linked list */
 typedef struct macro_node {
     macro macro;                    /* macro data */
     struct macro_node* next;        /* pointer to next node */
+    struct macro_node* next_in_bucket; /* next node with the same name hash */
 } macro_node;
 
 /* macro table s managing all macros */
 typedef struct {
     macro_node* head;               /* pointer to first node in list */
     int count;                      /* total number of macros */
+    macro_node* buckets[MACRO_HASH_BUCKETS]; /* nodes by name hash, for find_macro */
 } macro_list;
 
 /**
@@ -77,6 +120,16 @@ int check_if_macro_end(const char* line);
  */
 void extract_macro_name(const char* line, char* name);
 
+/**
+ * extract_macro_params - reads the parameter list of a macro definition line
+ * @line: macro definition line, "mcro name a, b"
+ * @name: macro name, for messages
+ * @params: output parameter names
+ * @line_number: line number for messages
+ * @return SUCCESS if every parameter is a valid, distinct name, FAILURE otherwise
+ */
+int extract_macro_params(const char* line, const char* name, macro_params* params, int line_number);
+
 /**
  * is_macro_call - checks if line contains macro invocation
  * @line: line string to check
@@ -86,13 +139,25 @@ void extract_macro_name(const char* line, char* name);
 int is_macro_call(const char* line, const macro_list* macro_list);
 
 /**
- * add_macro - adds new macro to table
+ * find_macro_call - looks up the macro a line invokes
+ * @line: line string to check
+ * @macro_list: table of defined macros
+ * @return pointer to the called macro, NULL if the line is not a macro call
+ */
+macro* find_macro_call(const char* line, const macro_list* macro_list);
+
+/**
+ * add_macro - adds new macro to table, compiling its body into a template
  * @macro_list: pointer to macro table
  * @name: macro name
+ * @params: declared parameters
  * @content: macro body content
- * @return SUCCESS on successful addition, FAILURE otherwise
+ * @lines: source line of each body line
+ * @line_count: number of body lines
+ * @return SUCCESS on successful addition, FAILURE otherwise (no memory)
  */
-int add_macro(macro_list* macro_list, const char* name, const char* content);
+int add_macro(macro_list* macro_list, const char* name, const macro_params* params, const char* content,
+              const int* lines, int line_count);
 
 /**
  * find_macro - searches for macro by name
@@ -112,8 +177,13 @@ void free_macro_list(macro_list* macro_list);
  * expand_macros - expands macros from input file to output file
  * @input_file: source file containing macro definitions and calls
  * @output_file: destination file for macro-expanded code
+ * @defines: symbols defined on the command line for conditional assembly, or NULL
+ * @line_map_file: file to receive the source line of each expanded line, or NULL
+ * @stats: receives the lines and bytes of input_file, or NULL
+ * @return SUCCESS if expanded, FAILURE otherwise
  */
-void expand_macros(const char* input_file, const char* output_file);
+int expand_macros(const char* input_file, const char* output_file, const define_list* defines,
+                  const char* line_map_file, source_stats* stats);
 
 /**
  * validate_macro_name - macro name validation
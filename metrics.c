@@ -0,0 +1,232 @@
+#include "metrics.h"
+#include "utils.h"
+#include "archive.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* metric names */
+#define METRIC_PREFIX "assembler_"
+
+static const double bucket_bounds[METRICS_BUCKETS] = METRICS_BUCKET_BOUNDS;
+static const char *const phase_names[METRICS_PHASES] = {"macro", "first_pass", "second_pass"};
+
+/**
+ * seconds_since - processor seconds elapsed since a clock() value
+ * @param started: earlier clock() value
+ * @return elapsed seconds
+ */
+static double seconds_since(clock_t started) {
+    return (double)(clock() - started) / CLOCKS_PER_SEC;
+}
+
+/**
+ * init_metrics - start collecting batch metrics
+ * @param metrics: counters to reset
+ * @param path: stats file to rewrite
+ * @param files_total: number of files in the batch
+ */
+void init_metrics(batch_metrics *metrics, const char *path, unsigned long files_total) {
+    memset(metrics, 0, sizeof(batch_metrics));
+    metrics->path = path;
+    metrics->files_total = files_total;
+    metrics->started = clock();
+    write_metrics(metrics);
+    metrics->last_write = time(NULL);
+}
+
+/**
+ * metrics_record_phase - add one phase duration to its histogram
+ * @param metrics: counters, or NULL when metrics are off
+ * @param phase: phase that just finished
+ * @param started: clock() value taken when the phase started
+ */
+void metrics_record_phase(batch_metrics *metrics, metrics_phase phase, clock_t started) {
+    double seconds;
+    int bucket = 0;
+
+    if (!metrics) return;
+
+    seconds = seconds_since(started);
+    while (bucket < METRICS_BUCKETS && seconds > bucket_bounds[bucket]) bucket++;
+
+    metrics->phase_buckets[phase][bucket]++;
+    metrics->phase_count[phase]++;
+    metrics->phase_seconds[phase] += seconds;
+    metrics->busy += clock() - started;
+}
+
+/**
+ * metrics_record_source - add the size of a source file, as measured by expand_macros
+ * @param metrics: counters, or NULL when metrics are off
+ * @param lines: lines read
+ * @param bytes: bytes read
+ */
+void metrics_record_source(batch_metrics *metrics, unsigned long lines, unsigned long bytes) {
+    if (!metrics) return;
+
+    metrics->lines += lines;
+    metrics->bytes_in += bytes;
+}
+
+/**
+ * metrics_record_output - add the size of an output file, if it exists
+ * @param metrics: counters, or NULL when metrics are off
+ * @param base_filename: base name without extension
+ * @param suffix: output file extension
+ */
+void metrics_record_output(batch_metrics *metrics, const char *base_filename, const char *suffix) {
+    char *filename;
+    long size;
+
+    if (!metrics) return;
+
+    filename = build_filename(base_filename, suffix);
+    if (!filename) return;
+
+    /* with -o the output is still in the archive's scratch stream */
+    size = output_size(filename);
+    if (size > 0) metrics->bytes_out += (unsigned long)size;
+    free(filename);
+}
+
+/**
+ * metrics_file_finished - count a finished file, rewriting the stats file if
+ * METRICS_WRITE_INTERVAL has passed since the last rewrite
+ * @param metrics: counters, or NULL when metrics are off
+ * @param success: SUCCESS or FAILURE
+ */
+void metrics_file_finished(batch_metrics *metrics, int success) {
+    time_t now;
+
+    if (!metrics) return;
+
+    if (success == SUCCESS) {
+        metrics->files_done++;
+    } else {
+        metrics->files_failed++;
+    }
+
+    /* a batch of small files would otherwise spend more time on the stats file than on the files */
+    now = time(NULL);
+    if (difftime(now, metrics->last_write) >= METRICS_WRITE_INTERVAL) {
+        write_metrics(metrics);
+        metrics->last_write = now;
+    }
+}
+
+/**
+ * finish_metrics - write the final stats file at the end of the batch
+ * @param metrics: counters, or NULL when metrics are off
+ */
+void finish_metrics(batch_metrics *metrics) {
+    if (!metrics) return;
+
+    write_metrics(metrics);
+    metrics->last_write = time(NULL);
+}
+
+/**
+ * write_metric - print one metric with its help and type lines
+ * @param out: stats stream
+ * @param name: metric name without prefix
+ * @param type: Prometheus metric type
+ * @param help: description
+ * @param value: metric value
+ */
+static void write_metric(FILE *out, const char *name, const char *type, const char *help, double value) {
+    fprintf(out, "# HELP " METRIC_PREFIX "%s %s\n", name, help);
+    fprintf(out, "# TYPE " METRIC_PREFIX "%s %s\n", name, type);
+    fprintf(out, METRIC_PREFIX "%s %.10g\n", name, value);
+}
+
+/**
+ * write_phase_histogram - print the per-phase latency histogram
+ * @param out: stats stream
+ * @param metrics: counters to export
+ */
+static void write_phase_histogram(FILE *out, const batch_metrics *metrics) {
+    unsigned long cumulative;
+    int phase, bucket;
+
+    fprintf(out, "# HELP " METRIC_PREFIX "phase_seconds Processor time per assembler phase and file.\n");
+    fprintf(out, "# TYPE " METRIC_PREFIX "phase_seconds histogram\n");
+    for (phase = 0; phase < METRICS_PHASES; phase++) {
+        cumulative = 0;
+        for (bucket = 0; bucket < METRICS_BUCKETS; bucket++) {
+            cumulative += metrics->phase_buckets[phase][bucket];
+            fprintf(out, METRIC_PREFIX "phase_seconds_bucket{phase=\"%s\",le=\"%g\"} %lu\n",
+                    phase_names[phase], bucket_bounds[bucket], cumulative);
+        }
+        cumulative += metrics->phase_buckets[phase][METRICS_BUCKETS];
+        fprintf(out, METRIC_PREFIX "phase_seconds_bucket{phase=\"%s\",le=\"+Inf\"} %lu\n",
+                phase_names[phase], cumulative);
+        fprintf(out, METRIC_PREFIX "phase_seconds_sum{phase=\"%s\"} %.10g\n",
+                phase_names[phase], metrics->phase_seconds[phase]);
+        fprintf(out, METRIC_PREFIX "phase_seconds_count{phase=\"%s\"} %lu\n",
+                phase_names[phase], metrics->phase_count[phase]);
+    }
+}
+
+/**
+ * write_metrics - rewrite the stats file in Prometheus text format
+ * readers never see a half-written file: the text goes to a temporary
+ * file that is then renamed over the stats file
+ * @param metrics: counters to export
+ * @return SUCCESS if written, FAILURE otherwise
+ */
+int write_metrics(const batch_metrics *metrics) {
+    char *temp_name;
+    FILE *out;
+    double elapsed = seconds_since(metrics->started);
+    double busy = (double)metrics->busy / CLOCKS_PER_SEC;
+    unsigned long finished = metrics->files_done + metrics->files_failed;
+
+    temp_name = build_filename(metrics->path, METRICS_TEMP_SUFFIX);
+    if (!temp_name) return FAILURE;
+
+    out = fopen(temp_name, FILE_WRITE_MODE);
+    if (!out) {
+        fprintf(stderr, ERROR_METRICS_WRITE, temp_name);
+        free(temp_name);
+        return FAILURE;
+    }
+
+    write_metric(out, "files_total", "gauge", "Files named on the command line.", (double)metrics->files_total);
+    write_metric(out, "files_done_total", "counter", "Files assembled successfully.", (double)metrics->files_done);
+    write_metric(out, "files_failed_total", "counter", "Files that failed to assemble.", (double)metrics->files_failed);
+    write_metric(out, "files_queued", "gauge", "Files not yet finished.",
+                 (double)(metrics->files_total > finished ? metrics->files_total - finished : 0));
+    write_metric(out, "source_lines_total", "counter", "Source lines read.", (double)metrics->lines);
+    write_metric(out, "lines_per_second", "gauge", "Source lines per processor second since the batch started.",
+                 elapsed > 0 ? metrics->lines / elapsed : 0.0);
+    write_metric(out, "bytes_in_total", "counter", "Source bytes read.", (double)metrics->bytes_in);
+    write_metric(out, "bytes_out_total", "counter", "Bytes of .am, .ob, .ent and .ext files written.",
+                 (double)metrics->bytes_out);
+    write_phase_histogram(out, metrics);
+    write_metric(out, "workers", "gauge", "Files assembled concurrently.", 1.0);
+    write_metric(out, "worker_utilization", "gauge", "Share of processor time spent inside assembler phases.",
+                 elapsed > 0 ? (busy < elapsed ? busy / elapsed : 1.0) : 0.0);
+    write_metric(out, "elapsed_seconds", "gauge", "Processor time since the batch started.", elapsed);
+
+    if (fclose(out) != 0) {
+        fprintf(stderr, ERROR_METRICS_WRITE, temp_name);
+        remove(temp_name);
+        free(temp_name);
+        return FAILURE;
+    }
+
+    /* rename over an existing file is not portable, so fall back to remove + rename */
+    if (rename(temp_name, metrics->path) != 0) {
+        remove(metrics->path);
+        if (rename(temp_name, metrics->path) != 0) {
+            fprintf(stderr, ERROR_METRICS_WRITE, metrics->path);
+            remove(temp_name);
+            free(temp_name);
+            return FAILURE;
+        }
+    }
+
+    free(temp_name);
+    return SUCCESS;
+}
@@ -0,0 +1,97 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <time.h>
+
+/* latency histogram bucket bounds in seconds; the last bucket is +Inf */
+#define METRICS_BUCKET_BOUNDS {0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1.0, 5.0, 30.0}
+#define METRICS_BUCKETS 9
+
+/* stats file is written next to its final name, then renamed over it */
+#define METRICS_TEMP_SUFFIX ".tmp"
+
+/* while files finish, the stats file is rewritten at most this often (wall-clock seconds) */
+#define METRICS_WRITE_INTERVAL 1
+
+/* error messages */
+#define ERROR_METRICS_WRITE "Error: cannot write stats file '%s'\n"
+
+/* assembler phases that are timed */
+typedef enum {
+    PHASE_MACRO,            /* macro expansion */
+    PHASE_FIRST_PASS,       /* symbol table construction */
+    PHASE_SECOND_PASS,      /* encoding and output files */
+    METRICS_PHASES
+} metrics_phase;
+
+/* batch counters, exported in Prometheus text format */
+typedef struct {
+    const char *path;                       /* stats file */
+    time_t last_write;                      /* when the stats file was last rewritten */
+    clock_t started;                        /* processor time at batch start */
+    clock_t busy;                           /* processor time spent inside phases */
+    unsigned long files_total;              /* files named on the command line */
+    unsigned long files_done;               /* files assembled successfully */
+    unsigned long files_failed;             /* files that failed */
+    unsigned long lines;                    /* source lines read */
+    unsigned long bytes_in;                 /* source bytes read */
+    unsigned long bytes_out;                /* bytes of .am, .ob, .ent and .ext written */
+    unsigned long phase_buckets[METRICS_PHASES][METRICS_BUCKETS + 1];  /* non-cumulative counts */
+    unsigned long phase_count[METRICS_PHASES];
+    double phase_seconds[METRICS_PHASES];
+} batch_metrics;
+
+/**
+ * init_metrics - start collecting batch metrics
+ * @param metrics: counters to reset
+ * @param path: stats file to rewrite
+ * @param files_total: number of files in the batch
+ */
+void init_metrics(batch_metrics *metrics, const char *path, unsigned long files_total);
+
+/**
+ * metrics_record_phase - add one phase duration to its histogram
+ * @param metrics: counters, or NULL when metrics are off
+ * @param phase: phase that just finished
+ * @param started: clock() value taken when the phase started
+ */
+void metrics_record_phase(batch_metrics *metrics, metrics_phase phase, clock_t started);
+
+/**
+ * metrics_record_source - add the size of a source file, as measured by expand_macros
+ * @param metrics: counters, or NULL when metrics are off
+ * @param lines: lines read
+ * @param bytes: bytes read
+ */
+void metrics_record_source(batch_metrics *metrics, unsigned long lines, unsigned long bytes);
+
+/**
+ * metrics_record_output - add the size of an output file, if it exists
+ * @param metrics: counters, or NULL when metrics are off
+ * @param base_filename: base name without extension
+ * @param suffix: output file extension
+ */
+void metrics_record_output(batch_metrics *metrics, const char *base_filename, const char *suffix);
+
+/**
+ * metrics_file_finished - count a finished file, rewriting the stats file if
+ * METRICS_WRITE_INTERVAL has passed since the last rewrite
+ * @param metrics: counters, or NULL when metrics are off
+ * @param success: SUCCESS or FAILURE
+ */
+void metrics_file_finished(batch_metrics *metrics, int success);
+
+/**
+ * finish_metrics - write the final stats file at the end of the batch
+ * @param metrics: counters, or NULL when metrics are off
+ */
+void finish_metrics(batch_metrics *metrics);
+
+/**
+ * write_metrics - rewrite the stats file in Prometheus text format
+ * @param metrics: counters to export
+ * @return SUCCESS if written, FAILURE otherwise
+ */
+int write_metrics(const batch_metrics *metrics);
+
+#endif /* METRICS_H */
@@ -0,0 +1,289 @@
+#include "obj_reader.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* marker for characters that are not base-4 letters (any bit above the low two) */
+#define INVALID_DIGIT 0xFF
+#define CHAR_TABLE_SIZE 256
+
+/* letter -> digit table, built on first use */
+static unsigned char base4_digits[CHAR_TABLE_SIZE];
+static int base4_digits_ready = NO;
+
+/**
+ * init_base4_digits - fill the letter -> digit lookup table
+ */
+static void init_base4_digits(void) {
+    int i;
+
+    for (i = 0; i < CHAR_TABLE_SIZE; i++) {
+        base4_digits[i] = INVALID_DIGIT;
+    }
+    for (i = 0; i < BASE4_RADIX; i++) {
+        base4_digits[BASE4_LETTER_OFFSET + i] = (unsigned char)i;
+    }
+    base4_digits_ready = YES;
+}
+
+/**
+ * decode_base4_field - decode a fixed-width field of base-4 letters (a-d)
+ * @param text: first letter of the field
+ * @param digits: number of letters in the field
+ * @param value: output parameter for the decoded value
+ * @return SUCCESS if every letter is a-d, FAILURE otherwise
+ */
+int decode_base4_field(const char *text, int digits, unsigned int *value) {
+    unsigned int result = 0;
+    unsigned int invalid = 0;
+    unsigned int digit;
+    int i;
+
+    if (!base4_digits_ready) init_base4_digits();
+
+    /* no branch per letter: bad letters set high bits that are checked once */
+    for (i = 0; i < digits; i++) {
+        digit = base4_digits[(unsigned char)text[i]];
+        invalid |= digit;
+        result = (result << MODE_BITS) | (digit & TWO_BIT_MASK);
+    }
+
+    if (invalid & ~(unsigned int)TWO_BIT_MASK) return FAILURE;
+    *value = result;
+    return SUCCESS;
+}
+
+/**
+ * field_length - count the letters of a space/newline terminated field
+ * @param text: start of the field
+ * @return number of characters before the next space, CR, newline or end
+ */
+static int field_length(const char *text) {
+    int n = 0;
+    while (text[n] && text[n] != SPACE_CHAR && text[n] != CARRIAGE_RETURN_CHAR && text[n] != NEWLINE_CHAR) {
+        n++;
+    }
+    return n;
+}
+
+/**
+ * skip_line_end - step over an optional CR and a newline
+ * @param text: position right after the last field of a line
+ * @return start of the next line, or NULL if the line does not end here
+ */
+static const char *skip_line_end(const char *text) {
+    if (*text == CARRIAGE_RETURN_CHAR) text++;
+    if (*text == NEWLINE_CHAR) return text + 1;
+    if (*text == NULL_CHAR) return text;
+    return NULL;
+}
+
+/**
+ * parse_object_header - decode the "IC DC" header line
+ * @param text: start of the file
+ * @param module: object receiving the counts
+ * @return start of the first word line, or NULL if the header is invalid
+ */
+static const char *parse_object_header(const char *text, object_module *module) {
+    unsigned int ic, dc;
+    int len;
+
+    len = field_length(text);
+    if (len == 0 || len > BASE4_ADDRESS_DIGITS || decode_base4_field(text, len, &ic) == FAILURE) return NULL;
+    text += len;
+    if (*text++ != SPACE_CHAR) return NULL;
+
+    len = field_length(text);
+    if (len == 0 || len > BASE4_ADDRESS_DIGITS || decode_base4_field(text, len, &dc) == FAILURE) return NULL;
+    text += len;
+
+    module->instruction_count = (int)ic;
+    module->data_count = (int)dc;
+    return skip_line_end(text);
+}
+
+/**
+ * load_object_file - read and validate an object file
+ * @param filename: path to the .ob file
+ * @param module: output structure (free with free_object_module)
+ * @return SUCCESS if the file is well formed, FAILURE otherwise
+ */
+int load_object_file(const char *filename, object_module *module) {
+    char *text;
+    const char *p;
+    const char *end;
+    size_t length;
+    unsigned int address, word;
+    int expected_words;
+    int capacity;
+    int line_number = 2;
+    int count = 0;
+
+    module->words = NULL;
+    module->word_count = 0;
+
+    text = read_entire_file(filename, &length);
+    if (!text) return FAILURE;
+    end = text + length;
+
+    p = parse_object_header(text, module);
+    if (!p) {
+        fprintf(stderr, ERROR_OB_BAD_HEADER, filename);
+        free(text);
+        return FAILURE;
+    }
+
+    /* header counts wrap like addresses, so size the array from the text instead */
+    expected_words = module->instruction_count + module->data_count;
+    capacity = (int)((end - p) / OB_WORD_LINE_TEXT) + 1;
+    module->words = malloc(capacity * sizeof(unsigned short));
+    if (!module->words) {
+        fprintf(stderr, MALLOC_FAILED);
+        free(text);
+        return FAILURE;
+    }
+
+    /* every word line has the same layout, so fields are decoded at fixed offsets */
+    while (p < end) {
+        if (end - p < OB_WORD_LINE_TEXT || p[BASE4_ADDRESS_DIGITS] != SPACE_CHAR ||
+            decode_base4_field(p, BASE4_ADDRESS_DIGITS, &address) == FAILURE ||
+            decode_base4_field(p + BASE4_ADDRESS_DIGITS + 1, BASE4_CODE_DIGITS, &word) == FAILURE ||
+            (p = skip_line_end(p + OB_WORD_LINE_TEXT)) == NULL) {
+            fprintf(stderr, ERROR_OB_BAD_LINE, filename, line_number);
+            free_object_module(module);
+            free(text);
+            return FAILURE;
+        }
+
+        if ((int)address != ((INITIAL_IC + count) & OBJECT_ADDRESS_MASK)) {
+            fprintf(stderr, ERROR_OB_BAD_ADDRESS, filename, line_number,
+                    (INITIAL_IC + count) & OBJECT_ADDRESS_MASK, (int)address);
+            free_object_module(module);
+            free(text);
+            return FAILURE;
+        }
+
+        module->words[count++] = (unsigned short)word;
+        line_number++;
+    }
+
+    free(text);
+
+    if ((count & OBJECT_ADDRESS_MASK) != (expected_words & OBJECT_ADDRESS_MASK)) {
+        fprintf(stderr, ERROR_OB_WORD_COUNT, filename, expected_words, count);
+        free_object_module(module);
+        return FAILURE;
+    }
+
+    module->word_count = count;
+    return SUCCESS;
+}
+
+/**
+ * free_object_module - release an object read by load_object_file
+ * @param module: object to free
+ */
+void free_object_module(object_module *module) {
+    if (!module) return;
+    free(module->words);
+    module->words = NULL;
+    module->word_count = 0;
+}
+
+/**
+ * load_symbol_file - read an entries (.ent) or externals (.ext) file
+ * @param filename: path to the file
+ * @param symbols: output structure (free with free_symbol_file)
+ * @param required: whether a missing file is an error (1) or an empty list (0)
+ * @return SUCCESS if the file is well formed (or absent and not required), FAILURE otherwise
+ */
+int load_symbol_file(const char *filename, symbol_file *symbols, int required) {
+    FILE *probe;
+    char *p;
+    char *name;
+    size_t length;
+    unsigned int address;
+    int lines = 1;
+    int line_number = 1;
+    int len;
+
+    symbols->symbols = NULL;
+    symbols->count = 0;
+    symbols->text = NULL;
+
+    /* entries and externals files are only written when non-empty */
+    if (!required) {
+        probe = fopen(filename, FILE_READ_BINARY_MODE);
+        if (!probe) return SUCCESS;
+        fclose(probe);
+    }
+
+    symbols->text = read_entire_file(filename, &length);
+    if (!symbols->text) return FAILURE;
+
+    for (p = symbols->text; *p; p++) {
+        if (*p == NEWLINE_CHAR) lines++;
+    }
+
+    symbols->symbols = malloc(lines * sizeof(object_symbol));
+    if (!symbols->symbols) {
+        fprintf(stderr, MALLOC_FAILED);
+        free_symbol_file(symbols);
+        return FAILURE;
+    }
+
+    /* each line is "NAME aaaa"; names are cut in place */
+    p = symbols->text;
+    while (*p) {
+        name = p;
+        len = field_length(p);
+        p += len;
+        if (len == 0 || *p != SPACE_CHAR ||
+            field_length(p + 1) != BASE4_ADDRESS_DIGITS ||
+            decode_base4_field(p + 1, BASE4_ADDRESS_DIGITS, &address) == FAILURE ||
+            skip_line_end(p + 1 + BASE4_ADDRESS_DIGITS) == NULL) {
+            fprintf(stderr, ERROR_SYMBOL_BAD_LINE, filename, line_number);
+            free_symbol_file(symbols);
+            return FAILURE;
+        }
+        *p = NULL_CHAR;
+        p = (char *)skip_line_end(p + 1 + BASE4_ADDRESS_DIGITS);
+
+        symbols->symbols[symbols->count].name = name;
+        symbols->symbols[symbols->count].address = (int)address;
+        symbols->count++;
+        line_number++;
+    }
+
+    return SUCCESS;
+}
+
+/**
+ * find_object_symbol - search a symbol file by name
+ * @param symbols: symbols to search
+ * @param name: symbol name
+ * @return pointer to the symbol, or NULL if not found
+ */
+const object_symbol *find_object_symbol(const symbol_file *symbols, const char *name) {
+    int i;
+
+    for (i = 0; i < symbols->count; i++) {
+        if (strcmp(symbols->symbols[i].name, name) == 0) {
+            return &symbols->symbols[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * free_symbol_file - release symbols read by load_symbol_file
+ * @param symbols: symbols to free
+ */
+void free_symbol_file(symbol_file *symbols) {
+    if (!symbols) return;
+    free(symbols->symbols);
+    free(symbols->text);
+    symbols->symbols = NULL;
+    symbols->text = NULL;
+    symbols->count = 0;
+}
@@ -0,0 +1,88 @@
+#ifndef OBJ_READER_H
+#define OBJ_READER_H
+
+#include <stddef.h>
+#include "utils.h"
+
+/* addresses are written with 4 base-4 digits, so they wrap at 4^4 */
+#define OBJECT_ADDRESS_SPACE 256
+#define OBJECT_ADDRESS_MASK (OBJECT_ADDRESS_SPACE - 1)
+
+/* a word line without its line ending: 4 address digits, space, 5 code digits */
+#define OB_WORD_LINE_TEXT (BASE4_ADDRESS_DIGITS + 1 + BASE4_CODE_DIGITS)
+
+/* error messages */
+#define ERROR_OB_BAD_HEADER "Error: %s: invalid object header\n"
+#define ERROR_OB_BAD_LINE "Error: %s (line %d): invalid object line\n"
+#define ERROR_OB_BAD_ADDRESS "Error: %s (line %d): expected address %d, found %d\n"
+#define ERROR_OB_WORD_COUNT "Error: %s: header declares %d words, found %d\n"
+#define ERROR_SYMBOL_BAD_LINE "Error: %s (line %d): invalid symbol line\n"
+
+/* decoded object file (.ob) */
+typedef struct {
+    int instruction_count;      /* instruction words declared in the header (modulo 256) */
+    int data_count;             /* data words declared in the header (modulo 256) */
+    int word_count;             /* words read (instructions, then data) */
+    unsigned short *words;      /* packed 10-bit words, words[i] is at INITIAL_IC + i */
+} object_module;
+
+/* one symbol from an entries (.ent) or externals (.ext) file */
+typedef struct {
+    const char *name;           /* points into the file text */
+    int address;                /* decoded address */
+} object_symbol;
+
+/* decoded entries (.ent) or externals (.ext) file */
+typedef struct {
+    object_symbol *symbols;     /* symbols in file order */
+    int count;                  /* number of symbols */
+    char *text;                 /* file contents, names are terminated in place */
+} symbol_file;
+
+/**
+ * decode_base4_field - decode a fixed-width field of base-4 letters (a-d)
+ * @param text: first letter of the field
+ * @param digits: number of letters in the field
+ * @param value: output parameter for the decoded value
+ * @return SUCCESS if every letter is a-d, FAILURE otherwise
+ */
+int decode_base4_field(const char *text, int digits, unsigned int *value);
+
+/**
+ * load_object_file - read and validate an object file
+ * @param filename: path to the .ob file
+ * @param module: output structure (free with free_object_module)
+ * @return SUCCESS if the file is well formed, FAILURE otherwise
+ */
+int load_object_file(const char *filename, object_module *module);
+
+/**
+ * free_object_module - release an object read by load_object_file
+ * @param module: object to free
+ */
+void free_object_module(object_module *module);
+
+/**
+ * load_symbol_file - read an entries (.ent) or externals (.ext) file
+ * @param filename: path to the file
+ * @param symbols: output structure (free with free_symbol_file)
+ * @param required: whether a missing file is an error (1) or an empty list (0)
+ * @return SUCCESS if the file is well formed (or absent and not required), FAILURE otherwise
+ */
+int load_symbol_file(const char *filename, symbol_file *symbols, int required);
+
+/**
+ * find_object_symbol - search a symbol file by name
+ * @param symbols: symbols to search
+ * @param name: symbol name
+ * @return pointer to the symbol, or NULL if not found
+ */
+const object_symbol *find_object_symbol(const symbol_file *symbols, const char *name);
+
+/**
+ * free_symbol_file - release symbols read by load_symbol_file
+ * @param symbols: symbols to free
+ */
+void free_symbol_file(symbol_file *symbols);
+
+#endif /* OBJ_READER_H */
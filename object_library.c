@@ -0,0 +1,471 @@
+#include "object_library.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+/* file extension of each part, in payload order */
+static const char *part_extensions[LIBRARY_PARTS] = {OBJECT_EXT, ENTRIES_EXT, EXTERNALS_EXT};
+
+/**
+ * trim_field - cut the padding spaces off a fixed-width field
+ * @param field: field text, terminated after its width
+ */
+static void trim_field(char *field) {
+    size_t length = strlen(field);
+
+    while (length > 0 && field[length - 1] == SPACE_CHAR) field[--length] = NULL_CHAR;
+}
+
+/**
+ * is_safe_member_name - check that a member name names a file in the current directory
+ * extract writes files named after members, so a damaged or crafted library must
+ * not reach another directory or produce names with control bytes
+ * @param name: trimmed member name
+ * @return YES if it has no directory part, no ".." and only printable characters
+ */
+static int is_safe_member_name(const char *name) {
+    const char *c;
+
+    if (name[0] == NULL_CHAR || strchr(name, OBLIB_PATH_SEPARATOR) || strstr(name, OBLIB_PARENT_DIRECTORY)) {
+        return NO;
+    }
+    for (c = name; *c; c++) {
+        if (!isprint((unsigned char)*c)) return NO;
+    }
+    return YES;
+}
+
+/**
+ * read_record - read a fixed-width record
+ * @param file: open library
+ * @param offset: record position
+ * @param record: buffer of length + 1 bytes, NUL-terminated on success
+ * @param length: record width, newline included
+ * @return SUCCESS if read and newline-terminated, FAILURE otherwise
+ */
+static int read_record(FILE *file, unsigned long offset, char *record, size_t length) {
+    if (fseek(file, (long)offset, SEEK_SET) != 0 || fread(record, 1, length, file) != length ||
+        record[length - 1] != NEWLINE_CHAR) {
+        return FAILURE;
+    }
+    record[length] = NULL_CHAR;
+    return SUCCESS;
+}
+
+/**
+ * read_part - load one file of a module
+ * @param module: module with base set
+ * @param part: part to load
+ * @param required: YES if a missing file is an error
+ * @return SUCCESS if loaded or absent and optional, FAILURE otherwise
+ */
+static int read_part(library_module *module, library_part part, int required) {
+    char *filename = build_filename(module->base, part_extensions[part]);
+    FILE *probe;
+
+    if (!filename) return FAILURE;
+    if (!required) {
+        probe = fopen(filename, FILE_READ_BINARY_MODE);
+        if (!probe) {
+            free(filename);
+            return SUCCESS;
+        }
+        fclose(probe);
+    }
+    module->text[part] = read_entire_file(filename, &module->lengths[part]);
+    free(filename);
+    return module->text[part] ? SUCCESS : FAILURE;
+}
+
+/**
+ * free_module - release a loaded module
+ * @param module: module to free
+ */
+static void free_module(library_module *module) {
+    int part;
+
+    for (part = 0; part < LIBRARY_PARTS; part++) free(module->text[part]);
+    free_symbol_file(&module->entries);
+    free(module->base);
+}
+
+/**
+ * load_module - read and check the files of one module
+ * @param module: module to fill; free with free_module even on failure
+ * @param path: module path, with or without .ob
+ * @return SUCCESS if loaded, FAILURE otherwise
+ */
+static int load_module(library_module *module, const char *path) {
+    object_module object;
+    const char *slash;
+    char *filename;
+    size_t length = strlen(path);
+    int part;
+    int result;
+    int i;
+
+    module->base = NULL;
+    module->name = NULL;
+    for (part = 0; part < LIBRARY_PARTS; part++) {
+        module->text[part] = NULL;
+        module->lengths[part] = 0;
+    }
+    module->entries.symbols = NULL;
+    module->entries.count = 0;
+    module->entries.text = NULL;
+
+    /* "lib/sqrt" and "lib/sqrt.ob" name the same module */
+    if (length >= strlen(OBJECT_EXT) && strcmp(path + length - strlen(OBJECT_EXT), OBJECT_EXT) == 0) {
+        length -= strlen(OBJECT_EXT);
+    }
+    module->base = malloc(length + 1);
+    if (!module->base) {
+        fprintf(stderr, MALLOC_FAILED);
+        return FAILURE;
+    }
+    memcpy(module->base, path, length);
+    module->base[length] = NULL_CHAR;
+
+    slash = strrchr(module->base, OBLIB_PATH_SEPARATOR);
+    module->name = slash ? slash + 1 : module->base;
+    if (strlen(module->name) == 0 || strlen(module->name) > OBLIB_NAME_WIDTH) {
+        fprintf(stderr, ERROR_OBLIB_NAME_TOO_LONG, module->name, OBLIB_NAME_WIDTH);
+        return FAILURE;
+    }
+    /* extract would refuse it, so it is refused here already */
+    if (!is_safe_member_name(module->name)) {
+        fprintf(stderr, ERROR_OBLIB_BAD_NAME, module->name);
+        return FAILURE;
+    }
+
+    if (read_part(module, PART_OBJECT, YES) == FAILURE || read_part(module, PART_ENTRIES, NO) == FAILURE ||
+        read_part(module, PART_EXTERNALS, NO) == FAILURE) {
+        return FAILURE;
+    }
+
+    /* only well-formed modules go in */
+    filename = build_filename(module->base, OBJECT_EXT);
+    if (!filename) return FAILURE;
+    result = load_object_file(filename, &object);
+    if (result == SUCCESS) free_object_module(&object);
+    free(filename);
+    if (result == FAILURE) return FAILURE;
+
+    filename = build_filename(module->base, ENTRIES_EXT);
+    if (!filename) return FAILURE;
+    result = load_symbol_file(filename, &module->entries, NO);
+    free(filename);
+    if (result == FAILURE) return FAILURE;
+
+    for (i = 0; i < module->entries.count; i++) {
+        if (strlen(module->entries.symbols[i].name) > OBLIB_SYMBOL_WIDTH) {
+            fprintf(stderr, ERROR_OBLIB_SYMBOL_TOO_LONG, module->entries.symbols[i].name, module->name,
+                    OBLIB_SYMBOL_WIDTH);
+            return FAILURE;
+        }
+    }
+    return SUCCESS;
+}
+
+/**
+ * build_index - place every exported symbol in an open-addressing table
+ * @param modules: loaded modules
+ * @param count: number of modules
+ * @param slot_count: output for the table size
+ * @return allocated slots (free them), or NULL on failure
+ */
+static library_slot *build_index(const library_module *modules, int count, unsigned long *slot_count) {
+    library_slot *slots;
+    unsigned long symbols = 0;
+    unsigned long slot;
+    int m, i;
+
+    for (m = 0; m < count; m++) symbols += (unsigned long)modules[m].entries.count;
+    for (*slot_count = 1; *slot_count < symbols * OBLIB_LOAD_FACTOR; *slot_count *= 2) {
+    }
+
+    slots = calloc(*slot_count, sizeof(library_slot));
+    if (!slots) {
+        fprintf(stderr, MALLOC_FAILED);
+        return NULL;
+    }
+
+    for (m = 0; m < count; m++) {
+        for (i = 0; i < modules[m].entries.count; i++) {
+            const char *name = modules[m].entries.symbols[i].name;
+
+            for (slot = hash_string(name) % *slot_count; slots[slot].name; slot = (slot + 1) % *slot_count) {
+                if (strcmp(slots[slot].name, name) == 0) {
+                    fprintf(stderr, ERROR_OBLIB_DUPLICATE_SYMBOL, name, modules[slots[slot].member].name,
+                            modules[m].name);
+                    free(slots);
+                    return NULL;
+                }
+            }
+            slots[slot].name = name;
+            slots[slot].member = (unsigned long)m;
+            slots[slot].address = modules[m].entries.symbols[i].address;
+        }
+    }
+    return slots;
+}
+
+/**
+ * write_library_file - write the header, payloads, member table and index
+ * @param file: library opened for writing
+ * @param modules: loaded modules
+ * @param count: number of modules
+ * @param slots: symbol index
+ * @param slot_count: index size
+ * @return SUCCESS if every record was written, FAILURE otherwise
+ */
+static int write_library_file(FILE *file, const library_module *modules, int count, const library_slot *slots,
+                              unsigned long slot_count) {
+    unsigned long offset = OBLIB_HEADER_LENGTH;
+    unsigned long table_offset;
+    unsigned long slot;
+    int result = SUCCESS;
+    int m, part;
+
+    table_offset = offset;
+    for (m = 0; m < count; m++) {
+        for (part = 0; part < LIBRARY_PARTS; part++) table_offset += (unsigned long)modules[m].lengths[part];
+    }
+
+    if (fprintf(file, OBLIB_HEADER_FORMAT, OBLIB_VERSION, (unsigned long)count, slot_count, table_offset,
+                table_offset + (unsigned long)count * OBLIB_MEMBER_LENGTH) != OBLIB_HEADER_LENGTH) {
+        return FAILURE;
+    }
+
+    for (m = 0; m < count; m++) {
+        for (part = 0; part < LIBRARY_PARTS; part++) {
+            if (modules[m].lengths[part] > 0 &&
+                fwrite(modules[m].text[part], 1, modules[m].lengths[part], file) != modules[m].lengths[part]) {
+                return FAILURE;
+            }
+        }
+    }
+
+    for (m = 0; result == SUCCESS && m < count; m++) {
+        if (fprintf(file, OBLIB_MEMBER_FORMAT, offset, (unsigned long)modules[m].lengths[PART_OBJECT],
+                    (unsigned long)modules[m].lengths[PART_ENTRIES], (unsigned long)modules[m].lengths[PART_EXTERNALS],
+                    modules[m].name) != OBLIB_MEMBER_LENGTH) {
+            result = FAILURE;
+        }
+        for (part = 0; part < LIBRARY_PARTS; part++) offset += (unsigned long)modules[m].lengths[part];
+    }
+
+    for (slot = 0; result == SUCCESS && slot < slot_count; slot++) {
+        if (fprintf(file, OBLIB_SLOT_FORMAT, slots[slot].name ? slots[slot].name : "", slots[slot].member,
+                    slots[slot].address) != OBLIB_SLOT_LENGTH) {
+            result = FAILURE;
+        }
+    }
+    return result;
+}
+
+/**
+ * write_object_library - pack assembled modules and their .entry index into one file
+ * @param path: library file, replaced if it exists
+ * @param modules: module paths, with or without the .ob extension
+ * @param count: number of modules
+ * @return SUCCESS if written, FAILURE otherwise (a partly written file is removed)
+ */
+int write_object_library(const char *path, char **modules, int count) {
+    library_module *loaded;
+    library_slot *slots = NULL;
+    unsigned long slot_count = 0;
+    FILE *file;
+    int result = SUCCESS;
+    int loaded_count = 0;
+    int m, other;
+
+    loaded = malloc((size_t)(count > 0 ? count : 1) * sizeof(library_module));
+    if (!loaded) {
+        fprintf(stderr, MALLOC_FAILED);
+        return FAILURE;
+    }
+
+    for (m = 0; result == SUCCESS && m < count; m++) {
+        result = load_module(&loaded[m], modules[m]);
+        loaded_count++;
+        for (other = 0; result == SUCCESS && other < m; other++) {
+            if (strcmp(loaded[other].name, loaded[m].name) == 0) {
+                fprintf(stderr, ERROR_OBLIB_DUPLICATE_MEMBER, loaded[m].name);
+                result = FAILURE;
+            }
+        }
+    }
+
+    if (result == SUCCESS) {
+        slots = build_index(loaded, count, &slot_count);
+        if (!slots) result = FAILURE;
+    }
+
+    if (result == SUCCESS) {
+        file = fopen(path, FILE_WRITE_BINARY_MODE);
+        if (!file) {
+            fprintf(stderr, ERROR_CANNOT_OPEN_FILE_WRITE, path);
+            result = FAILURE;
+        } else {
+            result = write_library_file(file, loaded, count, slots, slot_count);
+            if (fclose(file) != 0) result = FAILURE;
+            if (result == FAILURE) {
+                fprintf(stderr, ERROR_OBLIB_WRITE, path);
+                remove(path);
+            }
+        }
+    }
+
+    for (m = 0; m < loaded_count; m++) free_module(&loaded[m]);
+    free(loaded);
+    free(slots);
+    return result;
+}
+
+/**
+ * open_object_library - open a library and read its header
+ * @param library: library to initialize; release with close_object_library
+ * @param path: library file
+ * @return SUCCESS if opened, FAILURE otherwise
+ */
+int open_object_library(object_library *library, const char *path) {
+    char record[OBLIB_HEADER_LENGTH + 1];
+    int version;
+
+    library->path = path;
+    library->file = fopen(path, FILE_READ_BINARY_MODE);
+    if (!library->file) {
+        fprintf(stderr, ERROR_CANNOT_OPEN_FILE, path);
+        return FAILURE;
+    }
+
+    if (read_record(library->file, 0, record, OBLIB_HEADER_LENGTH) == FAILURE ||
+        sscanf(record, OBLIB_MAGIC " %d members %lu slots %lu table %lu index %lu", &version,
+               &library->member_count, &library->slot_count, &library->table_offset, &library->index_offset) != 5 ||
+        version != OBLIB_VERSION || library->slot_count == 0 ||
+        library->index_offset != library->table_offset + library->member_count * OBLIB_MEMBER_LENGTH) {
+        fprintf(stderr, ERROR_OBLIB_FORMAT, path);
+        close_object_library(library);
+        return FAILURE;
+    }
+    return SUCCESS;
+}
+
+/**
+ * read_library_member - read one member record
+ * @param library: open library
+ * @param index: member number, from 0
+ * @param member: output for the record
+ * @return SUCCESS if read, FAILURE otherwise
+ */
+int read_library_member(const object_library *library, unsigned long index, library_member *member) {
+    char record[OBLIB_MEMBER_LENGTH + 1];
+    char *p;
+    char *end;
+    int part;
+
+    if (index >= library->member_count ||
+        read_record(library->file, library->table_offset + index * OBLIB_MEMBER_LENGTH, record,
+                    OBLIB_MEMBER_LENGTH) == FAILURE) {
+        fprintf(stderr, ERROR_OBLIB_READ, library->path);
+        return FAILURE;
+    }
+
+    member->offset = strtoul(record, &end, BASE_10);
+    p = end;
+    for (part = 0; part < LIBRARY_PARTS; part++) {
+        member->lengths[part] = strtoul(p, &end, BASE_10);
+        if (end == p) {
+            fprintf(stderr, ERROR_OBLIB_FORMAT, library->path);
+            return FAILURE;
+        }
+        p = end;
+    }
+
+    /* the name is the last field, padded to its width */
+    record[OBLIB_MEMBER_LENGTH - 1] = NULL_CHAR;
+    strcpy(member->name, record + OBLIB_MEMBER_LENGTH - 1 - OBLIB_NAME_WIDTH);
+    trim_field(member->name);
+    if (!is_safe_member_name(member->name)) {
+        fprintf(stderr, ERROR_OBLIB_FORMAT, library->path);
+        return FAILURE;
+    }
+    return SUCCESS;
+}
+
+/**
+ * find_library_symbol - find the member that exports a symbol
+ * hashes the name and reads the slot it lands on, probing on only when slots collide
+ * @param library: open library
+ * @param name: symbol name
+ * @param member: output for the member number
+ * @param address: output for the symbol address in the member
+ * @return YES if found, NO if not exported (or on a read error, which is reported)
+ */
+int find_library_symbol(const object_library *library, const char *name, unsigned long *member, int *address) {
+    char record[OBLIB_SLOT_LENGTH + 1];
+    unsigned long slot;
+    unsigned long probes;
+    char *end;
+
+    if (strlen(name) > OBLIB_SYMBOL_WIDTH) return NO;
+
+    slot = hash_string(name) % library->slot_count;
+    for (probes = 0; probes < library->slot_count; probes++) {
+        if (read_record(library->file, library->index_offset + slot * OBLIB_SLOT_LENGTH, record,
+                        OBLIB_SLOT_LENGTH) == FAILURE) {
+            fprintf(stderr, ERROR_OBLIB_READ, library->path);
+            return NO;
+        }
+        record[OBLIB_SYMBOL_WIDTH] = NULL_CHAR;
+        trim_field(record);
+
+        /* an empty slot ends the probe sequence */
+        if (record[0] == NULL_CHAR) return NO;
+        if (strcmp(record, name) == 0) {
+            *member = strtoul(record + OBLIB_SYMBOL_WIDTH + 1, &end, BASE_10);
+            *address = (int)strtol(end, NULL, BASE_10);
+            return YES;
+        }
+        slot = (slot + 1) % library->slot_count;
+    }
+    return NO;
+}
+
+/**
+ * copy_library_part - write one part of a member
+ * @param library: open library
+ * @param member: member record
+ * @param part: part to copy
+ * @param out: destination stream
+ * @return SUCCESS if copied, FAILURE otherwise
+ */
+int copy_library_part(const object_library *library, const library_member *member, library_part part, FILE *out) {
+    char buffer[OBLIB_COPY_BUFFER];
+    unsigned long offset = member->offset;
+    unsigned long left = member->lengths[part];
+    size_t want;
+    int i;
+
+    for (i = 0; i < (int)part; i++) offset += member->lengths[i];
+    if (fseek(library->file, (long)offset, SEEK_SET) != 0) return FAILURE;
+
+    while (left > 0) {
+        want = left < sizeof(buffer) ? (size_t)left : sizeof(buffer);
+        if (fread(buffer, 1, want, library->file) != want || fwrite(buffer, 1, want, out) != want) {
+            return FAILURE;
+        }
+        left -= (unsigned long)want;
+    }
+    return SUCCESS;
+}
+
+/**
+ * close_object_library - close a library opened with open_object_library
+ * @param library: library to close
+ */
+void close_object_library(object_library *library) {
+    if (library->file) fclose(library->file);
+    library->file = NULL;
+}
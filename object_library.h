@@ -0,0 +1,132 @@
+#ifndef OBJECT_LIBRARY_H
+#define OBJECT_LIBRARY_H
+
+#include <stdio.h>
+#include "utils.h"
+#include "obj_reader.h"
+
+/* library layout, every record has a fixed width so it can be read by position:
+ * header     "oblib 1 members M slots S table T index I\n"
+ * payloads   the .ob, .ent and .ext text of each member, back to back
+ * table      one member record per member, at offset T
+ * index      S symbol slots at offset I, open addressing by hash_string of the name */
+#define OBLIB_MAGIC "oblib"
+#define OBLIB_VERSION 1
+#define OBLIB_HEADER_FORMAT "oblib %d members %010lu slots %010lu table %010lu index %010lu\n"
+#define OBLIB_HEADER_LENGTH 78
+#define OBLIB_MEMBER_FORMAT "%010lu %010lu %010lu %010lu %-64s\n"
+#define OBLIB_MEMBER_LENGTH 109
+#define OBLIB_NAME_WIDTH 64                 /* member name, padded with spaces */
+#define OBLIB_SLOT_FORMAT "%-31s %010lu %04d\n"
+#define OBLIB_SLOT_LENGTH 48
+#define OBLIB_SYMBOL_WIDTH 31               /* symbol name, padded; all spaces in an empty slot */
+#define OBLIB_LOAD_FACTOR 2                 /* at least twice as many slots as symbols */
+#define OBLIB_COPY_BUFFER 4096
+#define OBLIB_PATH_SEPARATOR '/'            /* member names drop the directory */
+#define OBLIB_PARENT_DIRECTORY ".."         /* never allowed in a member name */
+
+/* error messages */
+#define ERROR_OBLIB_FORMAT "Error: '%s' is not an object library\n"
+#define ERROR_OBLIB_READ "Error: cannot read object library '%s'\n"
+#define ERROR_OBLIB_WRITE "Error: cannot write object library '%s'\n"
+#define ERROR_OBLIB_NAME_TOO_LONG "Error: module name '%s' is longer than %d characters\n"
+#define ERROR_OBLIB_BAD_NAME "Error: module name '%s' cannot be stored in a library\n"
+#define ERROR_OBLIB_SYMBOL_TOO_LONG "Error: symbol '%s' in '%s' is longer than %d characters\n"
+#define ERROR_OBLIB_DUPLICATE_MEMBER "Error: module '%s' is given twice\n"
+#define ERROR_OBLIB_DUPLICATE_SYMBOL "Error: symbol '%s' is exported by both '%s' and '%s'\n"
+
+/* parts of a member, in payload order */
+typedef enum {
+    PART_OBJECT,        /* .ob */
+    PART_ENTRIES,       /* .ent */
+    PART_EXTERNALS,     /* .ext */
+    LIBRARY_PARTS
+} library_part;
+
+/* open object library */
+typedef struct {
+    const char *path;               /* library file */
+    FILE *file;                     /* open for reading */
+    unsigned long member_count;
+    unsigned long slot_count;
+    unsigned long table_offset;     /* first member record */
+    unsigned long index_offset;     /* first symbol slot */
+} object_library;
+
+/* one member record */
+typedef struct {
+    char name[OBLIB_NAME_WIDTH + 1];            /* module name, without extension */
+    unsigned long offset;                       /* first payload byte */
+    unsigned long lengths[LIBRARY_PARTS];       /* bytes of each part, 0 if the file was absent */
+} library_member;
+
+/* module being packed by write_object_library */
+typedef struct {
+    char *base;                                 /* module path without extension */
+    const char *name;                           /* file name part of base */
+    char *text[LIBRARY_PARTS];                  /* file contents, NULL if the file is absent */
+    size_t lengths[LIBRARY_PARTS];
+    symbol_file entries;                        /* .entry symbols from the .ent file */
+} library_module;
+
+/* symbol slot of the index being built */
+typedef struct {
+    const char *name;                           /* symbol, NULL while empty */
+    unsigned long member;                       /* exporting member */
+    int address;                                /* symbol address in the member */
+} library_slot;
+
+/**
+ * write_object_library - pack assembled modules and their .entry index into one file
+ * @param path: library file, replaced if it exists
+ * @param modules: module paths, with or without the .ob extension
+ * @param count: number of modules
+ * @return SUCCESS if written, FAILURE otherwise (a partly written file is removed)
+ */
+int write_object_library(const char *path, char **modules, int count);
+
+/**
+ * open_object_library - open a library and read its header
+ * @param library: library to initialize; release with close_object_library
+ * @param path: library file
+ * @return SUCCESS if opened, FAILURE otherwise
+ */
+int open_object_library(object_library *library, const char *path);
+
+/**
+ * read_library_member - read one member record
+ * @param library: open library
+ * @param index: member number, from 0
+ * @param member: output for the record
+ * @return SUCCESS if read, FAILURE otherwise
+ */
+int read_library_member(const object_library *library, unsigned long index, library_member *member);
+
+/**
+ * find_library_symbol - find the member that exports a symbol
+ * hashes the name and reads the slot it lands on, probing on only when slots collide
+ * @param library: open library
+ * @param name: symbol name
+ * @param member: output for the member number
+ * @param address: output for the symbol address in the member
+ * @return YES if found, NO if not exported (or on a read error, which is reported)
+ */
+int find_library_symbol(const object_library *library, const char *name, unsigned long *member, int *address);
+
+/**
+ * copy_library_part - write one part of a member
+ * @param library: open library
+ * @param member: member record
+ * @param part: part to copy
+ * @param out: destination stream
+ * @return SUCCESS if copied, FAILURE otherwise
+ */
+int copy_library_part(const object_library *library, const library_member *member, library_part part, FILE *out);
+
+/**
+ * close_object_library - close a library opened with open_object_library
+ * @param library: library to close
+ */
+void close_object_library(object_library *library);
+
+#endif /* OBJECT_LIBRARY_H */
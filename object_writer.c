@@ -0,0 +1,146 @@
+#include "object_writer.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * format_base4 - write a fixed number of base-4 letters, most significant first
+ * @param out: destination buffer
+ * @param value: value to format
+ * @param digits: number of digits to write
+ */
+static void format_base4(char *out, unsigned int value, int digits) {
+    int i;
+
+    /* fill from right to left (least significant first) */
+    for (i = digits - 1; i >= 0; i--) {
+        out[i] = (char)(BASE4_LETTER_OFFSET + (value % BASE4_RADIX));
+        value /= BASE4_RADIX;
+    }
+}
+
+/**
+ * format_object_line - format one address/word pair as an .ob line
+ * @param line: destination, OB_LINE_LENGTH bytes ending in a newline, not terminated
+ * @param address: word address (4 base-4 digits)
+ * @param word: machine word (5 base-4 digits, 10 bits)
+ */
+void format_object_line(char *line, int address, unsigned int word) {
+    format_base4(line, (unsigned int)address, BASE4_ADDRESS_DIGITS);
+    line[BASE4_ADDRESS_DIGITS] = SPACE_CHAR;
+    format_base4(line + BASE4_ADDRESS_DIGITS + 1, word & TEN_BIT_MASK, BASE4_CODE_DIGITS);
+    line[OB_LINE_LENGTH - 1] = NEWLINE_CHAR;
+}
+
+/**
+ * init_text_window - allocate a text window over a stream
+ * @param window: window to initialize
+ * @param file: stream the window is flushed to
+ * @param capacity: window size in bytes (rounded down to whole lines, at least one line)
+ * @return SUCCESS if allocated, FAILURE otherwise
+ */
+int init_text_window(text_window *window, FILE *file, size_t capacity) {
+    if (!window) return FAILURE;
+
+    /* keep whole lines only so a flush never splits one */
+    capacity -= capacity % OB_LINE_LENGTH;
+    if (capacity < OB_LINE_LENGTH) capacity = OB_LINE_LENGTH;
+
+    window->text = malloc(capacity);
+    if (!window->text) {
+        fprintf(stderr, MALLOC_FAILED);
+        return FAILURE;
+    }
+    window->file = file;
+    window->capacity = capacity;
+    window->length = 0;
+    return SUCCESS;
+}
+
+/**
+ * window_write_word - format one address/word pair into the window
+ * @param window: destination window
+ * @param address: word address (4 base-4 digits)
+ * @param word: machine word (5 base-4 digits, 10 bits)
+ * @return SUCCESS if written, FAILURE on write error
+ */
+int window_write_word(text_window *window, int address, unsigned int word) {
+    /* make room for one more line */
+    if (window->length + OB_LINE_LENGTH > window->capacity) {
+        if (flush_text_window(window) == FAILURE) return FAILURE;
+    }
+
+    format_object_line(window->text + window->length, address, word);
+    window->length += OB_LINE_LENGTH;
+    return SUCCESS;
+}
+
+/**
+ * flush_text_window - write the buffered text to the stream and empty the window
+ * @param window: window to flush
+ * @return SUCCESS if written, FAILURE on write error
+ */
+int flush_text_window(text_window *window) {
+    if (window->length > 0) {
+        if (fwrite(window->text, 1, window->length, window->file) != window->length) {
+            fprintf(stderr, ERROR_WINDOW_WRITE_FAILED);
+            return FAILURE;
+        }
+        window->length = 0;
+    }
+    return SUCCESS;
+}
+
+/**
+ * free_text_window - release the window buffer (does not close the stream)
+ * @param window: window to free
+ */
+void free_text_window(text_window *window) {
+    if (!window) return;
+    free(window->text);
+    window->text = NULL;
+    window->capacity = 0;
+    window->length = 0;
+}
+
+/**
+ * write_object_header - write the "IC DC" header line of an object file
+ * @param file: destination stream
+ * @param ic_count: number of instruction words
+ * @param dc_count: number of data words
+ */
+void write_object_header(FILE *file, int ic_count, int dc_count) {
+    char ic_str[BASE4_ADDRESS_BUFFER_SIZE];
+    char dc_str[BASE4_ADDRESS_BUFFER_SIZE];
+    char *ic_start;
+    char *dc_start;
+
+    strcpy(ic_str, number_to_base4_letters(ic_count));
+    strcpy(dc_str, number_to_base4_letters(dc_count));
+    ic_start = ic_str;
+    dc_start = dc_str;
+
+    /* remove only leading 'a's, keep minimum required digits */
+    while (*ic_start == BASE4_LETTER_OFFSET && *(ic_start + 1) != NULL_CHAR) ic_start++;
+    while (*dc_start == BASE4_LETTER_OFFSET && *(dc_start + 1) != NULL_CHAR) dc_start++;
+
+    fprintf(file, FORMAT_TWO_STRINGS, ic_start, dc_start);
+}
+
+/**
+ * append_stream - copy the rest of one stream to another
+ * @param from: source stream (read from its current position)
+ * @param to: destination stream
+ * @return SUCCESS if copied, FAILURE on write error
+ */
+int append_stream(FILE *from, FILE *to) {
+    char buffer[COPY_BUFFER_SIZE];
+    size_t n;
+
+    while ((n = fread(buffer, 1, sizeof(buffer), from)) > 0) {
+        if (fwrite(buffer, 1, n, to) != n) {
+            fprintf(stderr, ERROR_WINDOW_WRITE_FAILED);
+            return FAILURE;
+        }
+    }
+    return SUCCESS;
+}
@@ -0,0 +1,80 @@
+#ifndef OBJECT_WRITER_H
+#define OBJECT_WRITER_H
+
+#include <stdio.h>
+#include "utils.h"
+
+/* one .ob line: 4 address digits, space, 5 code digits, newline */
+#define OB_LINE_LENGTH (BASE4_ADDRESS_DIGITS + 1 + BASE4_CODE_DIGITS + 1)
+
+/* copy buffer used when appending a spilled stream to the object file */
+#define COPY_BUFFER_SIZE 4096
+
+/* error messages */
+#define ERROR_WINDOW_WRITE_FAILED "Error: failed to write object text\n"
+#define ERROR_SPILL_CREATE_FAILED "Error: cannot create temporary data stream\n"
+
+/* fixed-size window of formatted .ob text, flushed to a stream when full */
+typedef struct {
+    FILE *file;         /* stream the window is flushed to */
+    char *text;         /* formatted .ob lines */
+    size_t capacity;    /* window size in bytes */
+    size_t length;      /* bytes currently buffered */
+} text_window;
+
+/**
+ * format_object_line - format one address/word pair as an .ob line
+ * @param line: destination, OB_LINE_LENGTH bytes ending in a newline, not terminated
+ * @param address: word address (4 base-4 digits)
+ * @param word: machine word (5 base-4 digits, 10 bits)
+ */
+void format_object_line(char *line, int address, unsigned int word);
+
+/**
+ * init_text_window - allocate a text window over a stream
+ * @param window: window to initialize
+ * @param file: stream the window is flushed to
+ * @param capacity: window size in bytes (rounded down to whole lines, at least one line)
+ * @return SUCCESS if allocated, FAILURE otherwise
+ */
+int init_text_window(text_window *window, FILE *file, size_t capacity);
+
+/**
+ * window_write_word - format one address/word pair into the window
+ * @param window: destination window
+ * @param address: word address (4 base-4 digits)
+ * @param word: machine word (5 base-4 digits, 10 bits)
+ * @return SUCCESS if written, FAILURE on write error
+ */
+int window_write_word(text_window *window, int address, unsigned int word);
+
+/**
+ * flush_text_window - write the buffered text to the stream and empty the window
+ * @param window: window to flush
+ * @return SUCCESS if written, FAILURE on write error
+ */
+int flush_text_window(text_window *window);
+
+/**
+ * free_text_window - release the window buffer (does not close the stream)
+ * @param window: window to free
+ */
+void free_text_window(text_window *window);
+
+/**
+ * write_object_header - write the "IC DC" header line of an object file
+ * @param file: destination stream
+ * @param ic_count: number of instruction words
+ * @param dc_count: number of data words
+ */
+void write_object_header(FILE *file, int ic_count, int dc_count);
+
+/**
+ * append_stream - copy the rest of one stream to another
+ * @param from: source stream (read from its current position)
+ * @param to: destination stream
+ * @return SUCCESS if copied, FAILURE on write error
+ */
+int append_stream(FILE *from, FILE *to);
+
+#endif /* OBJECT_WRITER_H */
@@ -0,0 +1,241 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils.h"
+#include "object_library.h"
+
+/* command line */
+#define MIN_ARGC 3
+#define COMMAND_ARG 1
+#define LIBRARY_ARG 2
+#define FIRST_NAME_ARG 3
+#define COMMAND_CREATE "create"
+#define COMMAND_LIST "list"
+#define COMMAND_FIND "find"
+#define COMMAND_EXTRACT "extract"
+
+/* error messages */
+#define ERROR_UNKNOWN_COMMAND "Error: unknown command '%s'\n"
+#define ERROR_NO_MODULES "Error: create needs at least one module\n"
+#define ERROR_NO_SYMBOLS "Error: find needs at least one symbol\n"
+#define ERROR_SYMBOL_NOT_FOUND "Error: no member exports '%s'\n"
+#define ERROR_MEMBER_NOT_FOUND "Error: '%s' is not a member of the library\n"
+#define ERROR_EXTRACT_FAILED "Error: cannot extract '%s'\n"
+
+/* output */
+#define MSG_LIST_ROW "%8lu %8lu %8lu  %s\n"
+#define MSG_LIST_HEADER "      ob      ent      ext  member\n"
+#define MSG_FIND_ROW "%s %s %d\n"
+
+/* usage messages */
+#define MSG_USAGE_FORMAT "Usage: %s create|list|find|extract library [name...]\n"
+#define MSG_DESCRIPTION "\nPacks assembled modules into one object library with an index of their\n" \
+    ".entry symbols.\n" \
+    "  create   pack the named modules (prog or prog.ob, with its .ent and .ext)\n" \
+    "  list     print the part sizes and name of every member\n" \
+    "  find     print the member and address that export each named symbol\n" \
+    "  extract  write the named members (all if none are named) as .ob/.ent/.ext files\n"
+
+/**
+ * print usage information
+ * @param program_name: name of the executable program
+ */
+static void print_usage(const char *program_name) {
+    printf(MSG_USAGE_FORMAT, program_name);
+    printf(MSG_DESCRIPTION);
+}
+
+/**
+ * extract_part - write one part of a member to name + extension
+ * @param library: open library
+ * @param member: member record
+ * @param part: part to write
+ * @param extension: file extension of the part
+ * @return SUCCESS if written (or empty), FAILURE otherwise
+ */
+static int extract_part(const object_library *library, const library_member *member, library_part part,
+                        const char *extension) {
+    char *filename;
+    FILE *out;
+    int result;
+
+    /* a part of length 0 was absent when the library was created */
+    if (member->lengths[part] == 0 && part != PART_OBJECT) return SUCCESS;
+
+    filename = build_filename(member->name, extension);
+    if (!filename) return FAILURE;
+    out = fopen(filename, FILE_WRITE_BINARY_MODE);
+    if (!out) {
+        fprintf(stderr, ERROR_CANNOT_OPEN_FILE_WRITE, filename);
+        free(filename);
+        return FAILURE;
+    }
+    result = copy_library_part(library, member, part, out);
+    if (fclose(out) != 0) result = FAILURE;
+    if (result == FAILURE) fprintf(stderr, ERROR_EXTRACT_FAILED, filename);
+    free(filename);
+    return result;
+}
+
+/**
+ * extract_member - write the files of one member
+ * @param library: open library
+ * @param member: member record
+ * @return SUCCESS if written, FAILURE otherwise
+ */
+static int extract_member(const object_library *library, const library_member *member) {
+    int result = SUCCESS;
+
+    if (extract_part(library, member, PART_OBJECT, OBJECT_EXT) == FAILURE) result = FAILURE;
+    if (extract_part(library, member, PART_ENTRIES, ENTRIES_EXT) == FAILURE) result = FAILURE;
+    if (extract_part(library, member, PART_EXTERNALS, EXTERNALS_EXT) == FAILURE) result = FAILURE;
+    return result;
+}
+
+/**
+ * is_selected - check whether a member was named on the command line
+ * @param name: member name
+ * @param names: names given, or none to select everything
+ * @param count: number of names
+ * @param found: per-name flags, set for the name that matched
+ * @return YES if selected, NO otherwise
+ */
+static int is_selected(const char *name, char **names, int count, int *found) {
+    int i;
+
+    if (count == 0) return YES;
+    for (i = 0; i < count; i++) {
+        if (strcmp(names[i], name) == 0) {
+            found[i] = YES;
+            return YES;
+        }
+    }
+    return NO;
+}
+
+/**
+ * list_or_extract - walk the member table for list and extract
+ * @param library: open library
+ * @param extract: YES to write the members, NO to list them
+ * @param names: members named on the command line
+ * @param count: number of names
+ * @return SUCCESS if every member was handled and every name found, FAILURE otherwise
+ */
+static int list_or_extract(const object_library *library, int extract, char **names, int count) {
+    library_member member;
+    unsigned long i;
+    int *found;
+    int result = SUCCESS;
+    int n;
+
+    found = calloc((size_t)(count > 0 ? count : 1), sizeof(int));
+    if (!found) {
+        fprintf(stderr, MALLOC_FAILED);
+        return FAILURE;
+    }
+
+    if (!extract) printf(MSG_LIST_HEADER);
+    for (i = 0; i < library->member_count; i++) {
+        if (read_library_member(library, i, &member) == FAILURE) {
+            result = FAILURE;
+            break;
+        }
+        if (!is_selected(member.name, names, count, found)) continue;
+        if (!extract) {
+            printf(MSG_LIST_ROW, member.lengths[PART_OBJECT], member.lengths[PART_ENTRIES],
+                   member.lengths[PART_EXTERNALS], member.name);
+        } else if (extract_member(library, &member) == FAILURE) {
+            result = FAILURE;
+        }
+    }
+
+    for (n = 0; n < count; n++) {
+        if (!found[n]) {
+            fprintf(stderr, ERROR_MEMBER_NOT_FOUND, names[n]);
+            result = FAILURE;
+        }
+    }
+    free(found);
+    return result;
+}
+
+/**
+ * find_symbols - print the member exporting each symbol
+ * @param library: open library
+ * @param names: symbols to look up
+ * @param count: number of symbols
+ * @return SUCCESS if every symbol was found, FAILURE otherwise
+ */
+static int find_symbols(const object_library *library, char **names, int count) {
+    library_member member;
+    unsigned long index;
+    int address;
+    int result = SUCCESS;
+    int i;
+
+    if (count == 0) {
+        fprintf(stderr, ERROR_NO_SYMBOLS);
+        return FAILURE;
+    }
+    for (i = 0; i < count; i++) {
+        if (find_library_symbol(library, names[i], &index, &address) != YES) {
+            fprintf(stderr, ERROR_SYMBOL_NOT_FOUND, names[i]);
+            result = FAILURE;
+        } else if (read_library_member(library, index, &member) == FAILURE) {
+            result = FAILURE;
+        } else {
+            printf(MSG_FIND_ROW, names[i], member.name, address);
+        }
+    }
+    return result;
+}
+
+/**
+ * main
+ * @param argc: number of command line arguments
+ * @param argv: array of command line argument strings
+ * @return 0 on success, EXIT_FAILURE_CODE on failure
+ */
+int main(int argc, char *argv[]) {
+    object_library library;
+    const char *command;
+    char **names;
+    int name_count;
+    int result;
+
+    if (argc < MIN_ARGC) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE_CODE;
+    }
+
+    command = argv[COMMAND_ARG];
+    names = argv + FIRST_NAME_ARG;
+    name_count = argc - FIRST_NAME_ARG;
+
+    if (strcmp(command, COMMAND_CREATE) == 0) {
+        if (name_count == 0) {
+            fprintf(stderr, ERROR_NO_MODULES);
+            return EXIT_FAILURE_CODE;
+        }
+        result = write_object_library(argv[LIBRARY_ARG], names, name_count);
+        return result == SUCCESS ? 0 : EXIT_FAILURE_CODE;
+    }
+
+    if (strcmp(command, COMMAND_LIST) != 0 && strcmp(command, COMMAND_FIND) != 0 &&
+        strcmp(command, COMMAND_EXTRACT) != 0) {
+        fprintf(stderr, ERROR_UNKNOWN_COMMAND, command);
+        print_usage(argv[0]);
+        return EXIT_FAILURE_CODE;
+    }
+
+    if (open_object_library(&library, argv[LIBRARY_ARG]) == FAILURE) return EXIT_FAILURE_CODE;
+
+    if (strcmp(command, COMMAND_FIND) == 0) {
+        result = find_symbols(&library, names, name_count);
+    } else {
+        result = list_or_extract(&library, strcmp(command, COMMAND_EXTRACT) == 0, names, name_count);
+    }
+
+    close_object_library(&library);
+    return result == SUCCESS ? 0 : EXIT_FAILURE_CODE;
+}
@@ -0,0 +1,889 @@
+#include "optimizer.h"
+#include "parser.h"
+#include "second_pass.h"
+#include "archive.h"
+#include "labelTable.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+/**
+ * copy_string - duplicate a string
+ * @param text: string to copy
+ * @return malloc'd copy, or NULL if out of memory
+ */
+static char *copy_string(const char *text) {
+    char *copy = malloc(strlen(text) + 1);
+
+    if (!copy) {
+        fprintf(stderr, MALLOC_FAILED);
+        return NULL;
+    }
+    strcpy(copy, text);
+    return copy;
+}
+
+/**
+ * find_instruction - look up a mnemonic without reporting unknown names
+ * @param name: command name
+ * @return instruction table entry, or NULL for directives and unknown names
+ */
+static const command_instructions *find_instruction(const char *name) {
+    int i;
+
+    if (!name) return NULL;
+    for (i = LOOP_START_INDEX; i < NUM_OF_OPCODES; i++) {
+        if (strcmp(name, instruction_table[i].name) == 0) return &instruction_table[i];
+    }
+    return NULL;
+}
+
+/**
+ * reads_destination - check whether an instruction reads its destination operand
+ * @param opcode: instruction opcode
+ * @return YES or NO
+ */
+static int reads_destination(int opcode) {
+    return opcode == CMP || opcode == ADD || opcode == SUB || opcode == NOT ||
+           opcode == INC || opcode == DEC || opcode == PRN;
+}
+
+/**
+ * writes_destination - check whether an instruction writes its destination operand
+ * @param opcode: instruction opcode
+ * @return YES or NO
+ */
+static int writes_destination(int opcode) {
+    return opcode == MOV || opcode == ADD || opcode == SUB || opcode == LEA || opcode == CLR ||
+           opcode == NOT || opcode == INC || opcode == DEC || opcode == RED;
+}
+
+/**
+ * ends_block - check whether control may leave an instruction other than to the next one
+ * @param opcode: instruction opcode
+ * @return YES or NO
+ */
+static int ends_block(int opcode) {
+    return opcode == JMP || opcode == BNE || opcode == JSR || opcode == RTS || opcode == STOP;
+}
+
+/**
+ * register_of - register number of a register operand
+ * @param operand: operand such as "r3"
+ * @return register number
+ */
+static int register_of(const char *operand) {
+    return operand[1] - MIN_REGISTER_CHAR;
+}
+
+/**
+ * matrix_registers - registers used to index a matrix operand
+ * @param operand: operand such as "M[r1][r2]"
+ * @return bit mask of the registers
+ */
+static int matrix_registers(const char *operand) {
+    const char *p;
+    int mask = 0;
+
+    for (p = strchr(operand, OPEN_BRACKET); p; p = strchr(p + 1, OPEN_BRACKET)) {
+        const char *reg = p + 1;
+
+        while (isspace((unsigned char)*reg)) reg++;
+        if (reg[0] == REGISTER_PREFIX_CHAR && reg[1] >= MIN_REGISTER_CHAR && reg[1] <= MAX_REGISTER_CHAR) {
+            mask |= 1 << (reg[1] - MIN_REGISTER_CHAR);
+        }
+    }
+    return mask;
+}
+
+/**
+ * immediate_word - register value an immediate operand loads
+ * @param operand: operand such as "#-3"
+ * @return 10-bit word, sign-extended from the 8 encoded bits
+ */
+static int immediate_word(const char *operand) {
+    int value = parse_immediate_value(operand) & EIGHT_BIT_MASK;
+
+    if (value > MAX_FOLDED_IMMEDIATE) value -= EIGHT_BIT_MASK + 1;
+    return value & TEN_BIT_MASK;
+}
+
+/**
+ * signed_word - value of a 10-bit word as a signed number
+ * @param word: 10-bit word
+ * @return value in -512..511
+ */
+static int signed_word(int word) {
+    return word > TEN_BIT_MASK / 2 ? word - (TEN_BIT_MASK + 1) : word;
+}
+
+/**
+ * describe_instruction - work out addressing modes and register effects of an instruction
+ * @param ins: instruction with parts and inst set
+ */
+static void describe_instruction(opt_instruction *ins) {
+    const separate_line *parts = ins->parts;
+    int count = parts->how_many_operands;
+    int opcode = ins->inst->opcode;
+    int dst;
+    int i;
+
+    ins->use = 0;
+    ins->def = NO_REGISTER;
+    for (i = 0; i < count && i < OPT_OPERANDS; i++) {
+        ins->modes[i] = get_operand_mode(parts->operands[i]);
+        if (ins->modes[i] == MATRIX_ACCESS) ins->use |= matrix_registers(parts->operands[i]);
+    }
+
+    if (count == DOUBLE_OPERAND && ins->modes[FIRST_OPERAND_INDEX] == REGISTER) {
+        ins->use |= 1 << register_of(parts->operands[FIRST_OPERAND_INDEX]);
+    }
+    if (count > NO_OPERANDS && ins->modes[count - 1] == REGISTER) {
+        dst = register_of(parts->operands[count - 1]);
+        if (reads_destination(opcode)) ins->use |= 1 << dst;
+        if (writes_destination(opcode)) ins->def = dst;
+    }
+
+    /* the callee may read any register */
+    if (opcode == JSR) ins->use = ALL_REGISTERS;
+}
+
+/**
+ * add_line - keep a copy of a source line
+ * @param program: program being loaded
+ * @param line: line text
+ * @return SUCCESS, or FAILURE if out of memory
+ */
+static int add_line(opt_program *program, const char *line) {
+    char *copy;
+
+    if (grow_array((void **)&program->lines, &program->line_capacity, program->line_count,
+                   sizeof(char *), OPT_INITIAL_CAPACITY) == FAILURE) {
+        return FAILURE;
+    }
+    copy = copy_string(line);
+    if (!copy) return FAILURE;
+    program->lines[program->line_count++] = copy;
+    return SUCCESS;
+}
+
+/**
+ * add_entries - remember the names of an .entry directive
+ * @param program: program being loaded
+ * @param parts: parsed directive
+ * @return SUCCESS, or FAILURE if out of memory
+ */
+static int add_entries(opt_program *program, const separate_line *parts) {
+    char *copy;
+    int i;
+
+    for (i = 0; i < parts->how_many_operands; i++) {
+        if (grow_array((void **)&program->entries, &program->entry_capacity, program->entry_count,
+                       sizeof(char *), OPT_INITIAL_CAPACITY) == FAILURE) {
+            return FAILURE;
+        }
+        copy = copy_string(parts->operands[i]);
+        if (!copy) return FAILURE;
+        program->entries[program->entry_count++] = copy;
+    }
+    return SUCCESS;
+}
+
+/**
+ * add_code_line - parse a source line and keep it if it is an instruction
+ * @param program: program being loaded
+ * @param index: index of the line
+ * @return SUCCESS, or FAILURE if out of memory
+ */
+static int add_code_line(opt_program *program, int index) {
+    const char *line = program->lines[index];
+    const command_instructions *inst;
+    opt_instruction *ins;
+    separate_line *parts;
+    int result = SUCCESS;
+
+    while (isspace((unsigned char)*line)) line++;
+    if (*line == NULL_CHAR || *line == SEMICOLON_CHAR) return SUCCESS;
+
+    /* the first pass already accepted the line, so parsing reports nothing */
+    parts = parse_line(program->lines[index]);
+    if (!parts) return SUCCESS;
+    /* every global label, on code or data, opens the scope of the local labels after it */
+    if (parts->label && !is_local_label(parts->label)) program->scope++;
+
+    if (parts->command && strcmp(parts->command, DIRECTIVE_ENTRY) == 0) {
+        result = add_entries(program, parts);
+        free_separate_line(parts);
+        return result;
+    }
+
+    inst = find_instruction(parts->command);
+    if (!inst || parts->how_many_operands > OPT_OPERANDS) {
+        free_separate_line(parts);
+        return SUCCESS;
+    }
+
+    if (grow_array((void **)&program->code, &program->code_capacity, program->code_count,
+                   sizeof(opt_instruction), OPT_INITIAL_CAPACITY) == FAILURE) {
+        free_separate_line(parts);
+        return FAILURE;
+    }
+    ins = &program->code[program->code_count++];
+    ins->line = index;
+    ins->parts = parts;
+    ins->inst = inst;
+    ins->target = NO_TARGET;
+    ins->entered = NO;
+    ins->next_label = NO_TARGET;
+    ins->scope = program->scope;
+    ins->removed = NO;
+    ins->folded = NO;
+    describe_instruction(ins);
+    return SUCCESS;
+}
+
+/**
+ * load_program - read the source and collect its instructions
+ * @param program: program to fill
+ * @param filename: source file
+ * @return SUCCESS if loaded, FAILURE on an I/O or allocation error or an unexpected line
+ */
+static int load_program(opt_program *program, const char *filename) {
+    char line[MAX_LINE_LENGTH + 1];
+    FILE *file;
+    size_t length;
+    int result = SUCCESS;
+    int i;
+
+    file = reopen_output(filename);
+    if (!file) {
+        fprintf(stderr, ERROR_CANNOT_OPEN_FILE, filename);
+        return FAILURE;
+    }
+    while (result == SUCCESS && fgets(line, sizeof(line), file)) {
+        length = strlen(line);
+        /* the first pass rejects longer lines, so this only guards the buffer */
+        if (length == sizeof(line) - 1 && line[length - 1] != NEWLINE_CHAR) result = FAILURE;
+        else result = add_line(program, line);
+    }
+    release_output(file);
+
+    for (i = 0; result == SUCCESS && i < program->line_count; i++) {
+        result = add_code_line(program, i);
+    }
+    return result;
+}
+
+/**
+ * find_code_label - find the instruction carrying a label
+ * @param program: loaded program
+ * @param name: label name
+ * @param scope: scope the name is used in, which a local label must share
+ * @return instruction index, or NO_TARGET if the label is not on an instruction
+ */
+static int find_code_label(const opt_program *program, const char *name, int scope) {
+    int i;
+
+    for (i = program->label_buckets[hash_string(name) % OPT_LABEL_BUCKETS]; i != NO_TARGET;
+         i = program->code[i].next_label) {
+        if (strcmp(program->code[i].parts->label, name) == 0 &&
+            (!is_local_label(name) || program->code[i].scope == scope)) {
+            return i;
+        }
+    }
+    return NO_TARGET;
+}
+
+/**
+ * operand_label - code label an operand names
+ * @param program: loaded program
+ * @param operand: direct or matrix operand
+ * @param scope: scope of the instruction using it
+ * @return instruction index, or NO_TARGET if it names data or an external
+ */
+static int operand_label(const opt_program *program, const char *operand, int scope) {
+    char name[MAX_LINE_LENGTH];
+    size_t length = strcspn(operand, "[ \t");
+
+    if (length >= sizeof(name)) return NO_TARGET;
+    memcpy(name, operand, length);
+    name[length] = NULL_CHAR;
+    return find_code_label(program, name, scope);
+}
+
+/**
+ * resolve_labels - find jump targets and the labels code outside the program can reach
+ * @param program: loaded program
+ */
+static void resolve_labels(opt_program *program) {
+    opt_instruction *ins;
+    int bucket;
+    int label;
+    int i, j;
+
+    for (i = 0; i < OPT_LABEL_BUCKETS; i++) program->label_buckets[i] = NO_TARGET;
+    for (i = program->code_count - 1; i >= 0; i--) {
+        if (!program->code[i].parts->label) continue;
+        bucket = (int)(hash_string(program->code[i].parts->label) % OPT_LABEL_BUCKETS);
+        program->code[i].next_label = program->label_buckets[bucket];
+        program->label_buckets[bucket] = i;
+    }
+
+    for (i = 0; i < program->code_count; i++) {
+        ins = &program->code[i];
+        for (j = 0; j < ins->parts->how_many_operands; j++) {
+            if (ins->modes[j] != DIRECT && ins->modes[j] != MATRIX_ACCESS) continue;
+            label = operand_label(program, ins->parts->operands[j], ins->scope);
+
+            if ((ins->inst->opcode == JMP || ins->inst->opcode == BNE) && ins->modes[j] == DIRECT) {
+                ins->target = label;
+                continue;
+            }
+            if (ins->inst->opcode == JSR && ins->modes[j] == DIRECT) ins->target = label;
+            if (ends_block(ins->inst->opcode) && ins->modes[j] == MATRIX_ACCESS) program->indirect_jumps = YES;
+
+            /* subroutines and labels whose address is taken are entered from unknown places */
+            if (label != NO_TARGET) program->code[label].entered = YES;
+        }
+    }
+
+    for (i = 0; i < program->entry_count; i++) {
+        label = find_code_label(program, program->entries[i], 0);
+        if (label != NO_TARGET) program->code[label].entered = YES;
+    }
+
+    /* a computed jump may land on any label */
+    if (program->indirect_jumps) {
+        for (i = 0; i < program->code_count; i++) {
+            if (program->code[i].parts->label) program->code[i].entered = YES;
+        }
+    }
+}
+
+/**
+ * link_block - set the successors of a block from its last instruction
+ * @param program: program with blocks built
+ * @param b: block index
+ */
+static void link_block(opt_program *program, int b) {
+    basic_block *block = &program->blocks[b];
+    const opt_instruction *last = &program->code[block->last];
+    int next = block->last + 1 < program->code_count ? program->block_of[block->last + 1] : NO_TARGET;
+    int target = last->target != NO_TARGET ? program->block_of[last->target] : NO_TARGET;
+
+    block->successors[0] = NO_TARGET;
+    block->successors[1] = NO_TARGET;
+    block->exit_live = 0;
+
+    switch (last->inst->opcode) {
+        case JMP:
+            block->successors[0] = target;
+            break;
+        case BNE:
+            block->successors[0] = next;
+            block->successors[1] = target;
+            if (next == NO_TARGET) block->exit_live = ALL_REGISTERS;
+            break;
+        case RTS:
+            /* the caller is unknown */
+            block->exit_live = ALL_REGISTERS;
+            return;
+        case STOP:
+            return;
+        default:
+            block->successors[0] = next;
+            break;
+    }
+
+    /* jumps out of the program and running off its end */
+    if (block->successors[0] == NO_TARGET) block->exit_live = ALL_REGISTERS;
+    if (last->inst->opcode == BNE && target == NO_TARGET) block->exit_live = ALL_REGISTERS;
+}
+
+/**
+ * build_blocks - split the instructions into basic blocks and link them
+ * @param program: program with labels resolved
+ * @return SUCCESS, or FAILURE if out of memory
+ */
+static int build_blocks(opt_program *program) {
+    basic_block *block;
+    int count = program->code_count;
+    int b, i, s, position;
+
+    program->block_of = malloc((size_t)(count > 0 ? count : 1) * sizeof(int));
+    program->blocks = malloc((size_t)(count > 0 ? count : 1) * sizeof(basic_block));
+    program->pred_first = malloc((size_t)(count + 1) * sizeof(int));
+    program->preds = malloc((size_t)(count > 0 ? 2 * count : 1) * sizeof(int));
+    if (!program->block_of || !program->blocks || !program->pred_first || !program->preds) {
+        fprintf(stderr, MALLOC_FAILED);
+        return FAILURE;
+    }
+
+    /* a block starts at a label and after every transfer of control */
+    program->block_count = 0;
+    for (i = 0; i < count; i++) {
+        if (i == 0 || program->code[i].parts->label || ends_block(program->code[i - 1].inst->opcode)) {
+            block = &program->blocks[program->block_count++];
+            block->first = i;
+            block->unknown_entry = i == 0 || program->code[i].entered;
+        }
+        program->blocks[program->block_count - 1].last = i;
+        program->block_of[i] = program->block_count - 1;
+    }
+
+    for (b = 0; b < program->block_count; b++) link_block(program, b);
+
+    /* predecessor lists, for merging constants */
+    for (i = 0; i < 2 * count; i++) program->preds[i] = NO_TARGET;
+    for (b = 0; b <= program->block_count; b++) program->pred_first[b] = 0;
+    for (b = 0; b < program->block_count; b++) {
+        for (s = 0; s < 2; s++) {
+            if (program->blocks[b].successors[s] != NO_TARGET) {
+                program->pred_first[program->blocks[b].successors[s] + 1]++;
+            }
+        }
+    }
+    for (b = 0; b < program->block_count; b++) program->pred_first[b + 1] += program->pred_first[b];
+    for (b = 0; b < program->block_count; b++) {
+        for (s = 0; s < 2; s++) {
+            i = program->blocks[b].successors[s];
+            if (i == NO_TARGET) continue;
+            /* fill from the back of each range so no cursor array is needed */
+            position = program->pred_first[i + 1] - 1;
+            while (program->preds[position] != NO_TARGET) position--;
+            program->preds[position] = b;
+        }
+    }
+    return SUCCESS;
+}
+
+/**
+ * live_before - registers live before an instruction
+ * @param ins: instruction
+ * @param live: registers live after it
+ * @return registers live before it
+ */
+static int live_before(const opt_instruction *ins, int live) {
+    if (ins->def != NO_REGISTER) live &= ~(1 << ins->def);
+    return live | ins->use;
+}
+
+/**
+ * compute_liveness - iterate register liveness over the blocks to a fixed point
+ * @param program: program with blocks built
+ */
+static void compute_liveness(opt_program *program) {
+    basic_block *block;
+    int changed = YES;
+    int live_in, live_out;
+    int b, i, s;
+
+    for (b = 0; b < program->block_count; b++) {
+        program->blocks[b].live_in = 0;
+        program->blocks[b].live_out = 0;
+    }
+
+    while (changed) {
+        changed = NO;
+        for (b = program->block_count - 1; b >= 0; b--) {
+            block = &program->blocks[b];
+            live_out = block->exit_live;
+            for (s = 0; s < 2; s++) {
+                if (block->successors[s] != NO_TARGET) live_out |= program->blocks[block->successors[s]].live_in;
+            }
+            live_in = live_out;
+            for (i = block->last; i >= block->first; i--) {
+                if (!program->code[i].removed) live_in = live_before(&program->code[i], live_in);
+            }
+            if (live_in != block->live_in || live_out != block->live_out) {
+                block->live_in = live_in;
+                block->live_out = live_out;
+                changed = YES;
+            }
+        }
+    }
+}
+
+/**
+ * remove_dead_writes - drop register writes no later instruction reads
+ * writes carrying a label stay so the label keeps its address, red stays for its input
+ * @param program: program with liveness computed
+ * @return number of instructions removed
+ */
+static int remove_dead_writes(opt_program *program) {
+    opt_instruction *ins;
+    int removed = 0;
+    int live;
+    int b, i;
+
+    for (b = 0; b < program->block_count; b++) {
+        live = program->blocks[b].live_out;
+        for (i = program->blocks[b].last; i >= program->blocks[b].first; i--) {
+            ins = &program->code[i];
+            if (ins->removed) continue;
+            if (ins->def != NO_REGISTER && !(live & (1 << ins->def)) && ins->inst->opcode != RED &&
+                !ins->parts->label) {
+                ins->removed = YES;
+                removed++;
+                continue;
+            }
+            live = live_before(ins, live);
+        }
+    }
+    return removed;
+}
+
+/**
+ * operand_constant - value an operand is known to have
+ * @param ins: instruction
+ * @param index: operand index
+ * @param state: register constants before the instruction
+ * @param value: output for the value
+ * @return YES if the value is known, NO otherwise
+ */
+static int operand_constant(const opt_instruction *ins, int index, const register_constants *state, int *value) {
+    const char *operand = ins->parts->operands[index];
+    int reg;
+
+    if (ins->modes[index] == IMMEDIATE) {
+        *value = immediate_word(operand);
+        return YES;
+    }
+    if (ins->modes[index] == REGISTER) {
+        reg = register_of(operand);
+        if (state->known & (1 << reg)) {
+            *value = state->values[reg];
+            return YES;
+        }
+    }
+    return NO;
+}
+
+/**
+ * apply_constants - update register constants across an instruction
+ * @param ins: instruction
+ * @param state: constants before, updated to after
+ */
+static void apply_constants(const opt_instruction *ins, register_constants *state) {
+    int d = ins->def;
+    int bit;
+    int old, source;
+    int known;
+
+    if (ins->inst->opcode == JSR) {
+        state->known = 0;
+        return;
+    }
+    if (d == NO_REGISTER) return;
+
+    bit = 1 << d;
+    old = state->values[d];
+    known = NO;
+    switch (ins->inst->opcode) {
+        case MOV:
+            known = operand_constant(ins, FIRST_OPERAND_INDEX, state, &state->values[d]);
+            break;
+        case CLR:
+            state->values[d] = 0;
+            known = YES;
+            break;
+        case ADD:
+        case SUB:
+            if ((state->known & bit) && operand_constant(ins, FIRST_OPERAND_INDEX, state, &source)) {
+                state->values[d] = ins->inst->opcode == ADD ? old + source : old - source;
+                known = YES;
+            }
+            break;
+        case NOT:
+            state->values[d] = ~old;
+            known = (state->known & bit) != 0;
+            break;
+        case INC:
+            state->values[d] = old + 1;
+            known = (state->known & bit) != 0;
+            break;
+        case DEC:
+            state->values[d] = old - 1;
+            known = (state->known & bit) != 0;
+            break;
+        default:
+            /* lea loads an address, red reads input */
+            break;
+    }
+
+    if (known) {
+        state->known |= bit;
+        state->values[d] &= TEN_BIT_MASK;
+    } else {
+        state->known &= ~bit;
+    }
+}
+
+/**
+ * same_constants - compare two constant states
+ * @return YES if equal, NO otherwise
+ */
+static int same_constants(const register_constants *a, const register_constants *b) {
+    int r;
+
+    if (a->known != b->known) return NO;
+    for (r = 0; r < OPT_REGISTERS; r++) {
+        if ((a->known & (1 << r)) && a->values[r] != b->values[r]) return NO;
+    }
+    return YES;
+}
+
+/**
+ * merge_constants - keep only the constants two states agree on
+ * @param into: state to narrow
+ * @param other: other state
+ */
+static void merge_constants(register_constants *into, const register_constants *other) {
+    int r;
+
+    into->known &= other->known;
+    for (r = 0; r < OPT_REGISTERS; r++) {
+        if ((into->known & (1 << r)) && into->values[r] != other->values[r]) into->known &= ~(1 << r);
+    }
+}
+
+/**
+ * propagate_constants - iterate register constants over the blocks to a fixed point
+ * blocks entered from unknown code start with nothing known
+ * @param program: program with blocks built
+ */
+static void propagate_constants(opt_program *program) {
+    register_constants state;
+    basic_block *block;
+    int changed = YES;
+    int reached;
+    int b, p, i;
+
+    for (b = 0; b < program->block_count; b++) program->blocks[b].reached = NO;
+
+    while (changed) {
+        changed = NO;
+        for (b = 0; b < program->block_count; b++) {
+            block = &program->blocks[b];
+            state.known = 0;
+            reached = block->unknown_entry;
+            if (!reached) {
+                for (p = program->pred_first[b]; p < program->pred_first[b + 1]; p++) {
+                    const basic_block *pred = &program->blocks[program->preds[p]];
+
+                    if (!pred->reached) continue;
+                    if (reached) {
+                        merge_constants(&state, &pred->out);
+                    } else {
+                        state = pred->out;
+                        reached = YES;
+                    }
+                }
+            }
+            if (!reached || (block->reached && same_constants(&state, &block->in))) continue;
+
+            block->in = state;
+            block->reached = YES;
+            for (i = block->first; i <= block->last; i++) {
+                if (!program->code[i].removed) apply_constants(&program->code[i], &state);
+            }
+            block->out = state;
+            changed = YES;
+        }
+    }
+}
+
+/**
+ * fold_instruction - replace register operands holding a known value with immediates
+ * only where the instruction accepts an immediate and the encoding does not grow
+ * @param ins: instruction
+ * @param state: register constants before the instruction
+ * @return number of operands folded, or -1 if out of memory
+ */
+static int fold_instruction(opt_instruction *ins, const register_constants *state) {
+    char text[FOLDED_OPERAND_LENGTH];
+    char *copy;
+    int count = ins->parts->how_many_operands;
+    int folded = 0;
+    int allowed;
+    int reg, value;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        if (ins->modes[i] != REGISTER) continue;
+        allowed = count == DOUBLE_OPERAND && i == FIRST_OPERAND_INDEX ? ins->inst->source_mode
+                                                                      : ins->inst->destination_mode;
+        if (!(allowed & IMMEDIATE)) continue;
+
+        /* two registers share one word; an immediate would need its own */
+        if (count == DOUBLE_OPERAND && ins->modes[1 - i] == REGISTER) continue;
+
+        reg = register_of(ins->parts->operands[i]);
+        if (!(state->known & (1 << reg))) continue;
+        value = signed_word(state->values[reg]);
+        if (value < MIN_FOLDED_IMMEDIATE || value > MAX_FOLDED_IMMEDIATE) continue;
+
+        sprintf(text, "%c%d", IMMEDIATE_PREFIX, value);
+        copy = copy_string(text);
+        if (!copy) return -1;
+        free(ins->parts->operands[i]);
+        ins->parts->operands[i] = copy;
+        ins->folded = YES;
+        folded++;
+        describe_instruction(ins);
+    }
+    return folded;
+}
+
+/**
+ * fold_constants - propagate constants and fold them into operands
+ * @param program: program with blocks built
+ * @return number of operands folded, or -1 if out of memory
+ */
+static int fold_constants(opt_program *program) {
+    register_constants state;
+    opt_instruction *ins;
+    int folded = 0;
+    int n;
+    int b, i;
+
+    propagate_constants(program);
+    for (b = 0; b < program->block_count; b++) {
+        if (!program->blocks[b].reached) continue;
+        state = program->blocks[b].in;
+        for (i = program->blocks[b].first; i <= program->blocks[b].last; i++) {
+            ins = &program->code[i];
+            if (ins->removed) continue;
+            n = fold_instruction(ins, &state);
+            if (n < 0) return -1;
+            folded += n;
+            apply_constants(ins, &state);
+        }
+    }
+    return folded;
+}
+
+/**
+ * write_instruction - write a rewritten instruction line
+ * @param out: output stream
+ * @param ins: instruction
+ * @param original: original line, for its indentation
+ */
+static void write_instruction(FILE *out, const opt_instruction *ins, const char *original) {
+    const separate_line *parts = ins->parts;
+    int i;
+
+    if (parts->label) {
+        fprintf(out, "%s%c ", parts->label, COLON);
+    } else {
+        while (isspace((unsigned char)*original)) fputc(*original++, out);
+    }
+    fputs(parts->command, out);
+    for (i = 0; i < parts->how_many_operands; i++) {
+        fprintf(out, i == 0 ? " %s" : ", %s", parts->operands[i]);
+    }
+    fputc(NEWLINE_CHAR, out);
+}
+
+/**
+ * write_program - rewrite the source with removed and folded instructions
+ * removed instructions become comments so line numbers stay the same
+ * @param program: optimized program
+ * @param filename: source file
+ * @return SUCCESS if written, FAILURE otherwise
+ */
+static int write_program(const opt_program *program, const char *filename) {
+    const opt_instruction *ins;
+    FILE *out;
+    int next = 0;
+    int i;
+
+    out = create_output(filename);
+    if (!out) {
+        fprintf(stderr, ERROR_CANNOT_OPEN_FILE_WRITE, filename);
+        return FAILURE;
+    }
+
+    for (i = 0; i < program->line_count; i++) {
+        ins = next < program->code_count && program->code[next].line == i ? &program->code[next++] : NULL;
+        if (ins && ins->removed) {
+            fprintf(out, "%s%s", OPT_REMOVED_PREFIX, program->lines[i]);
+        } else if (ins && ins->folded) {
+            write_instruction(out, ins, program->lines[i]);
+        } else {
+            fputs(program->lines[i], out);
+        }
+    }
+
+    if (ferror(out)) {
+        fprintf(stderr, ERROR_CANNOT_OPEN_FILE_WRITE, filename);
+        release_output(out);
+        return FAILURE;
+    }
+    release_output(out);
+    return SUCCESS;
+}
+
+/**
+ * free_program - release everything the optimizer loaded
+ * @param program: program to free
+ */
+static void free_program(opt_program *program) {
+    int i;
+
+    for (i = 0; i < program->line_count; i++) free(program->lines[i]);
+    for (i = 0; i < program->code_count; i++) free_separate_line(program->code[i].parts);
+    for (i = 0; i < program->entry_count; i++) free(program->entries[i]);
+    free(program->lines);
+    free(program->code);
+    free(program->entries);
+    free(program->blocks);
+    free(program->block_of);
+    free(program->pred_first);
+    free(program->preds);
+}
+
+/**
+ * optimize_program - remove dead register writes and fold constant registers into immediates
+ * the file must already have passed the first pass; it is rewritten only when something changed
+ * @param filename: macro-expanded source file (.am)
+ * @param stats: output for what changed
+ * @return SUCCESS if the file was optimized or left alone, FAILURE on an I/O or allocation error
+ */
+int optimize_program(const char *filename, optimizer_stats *stats) {
+    opt_program program;
+    int result;
+    int folded, removed;
+    int round;
+
+    stats->removed = 0;
+    stats->folded = 0;
+    memset(&program, 0, sizeof(program));
+
+    result = load_program(&program, filename);
+    if (result == SUCCESS) {
+        resolve_labels(&program);
+        result = build_blocks(&program);
+    }
+
+    /* folding frees registers, removing writes can expose more folds on the next round */
+    for (round = 0; result == SUCCESS && round < OPT_MAX_ROUNDS; round++) {
+        folded = fold_constants(&program);
+        if (folded < 0) {
+            result = FAILURE;
+            break;
+        }
+        compute_liveness(&program);
+        removed = remove_dead_writes(&program);
+        stats->folded += folded;
+        stats->removed += removed;
+        if (folded == 0 && removed == 0) break;
+    }
+
+    if (result == SUCCESS && (stats->folded > 0 || stats->removed > 0)) {
+        result = write_program(&program, filename);
+    }
+    free_program(&program);
+    return result;
+}
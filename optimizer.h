@@ -0,0 +1,99 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "utils.h"
+#include "commands.h"
+
+/* machine registers r0-r7 as bit masks */
+#define OPT_REGISTERS 8
+#define ALL_REGISTERS 0xFF
+#define NO_REGISTER (-1)
+#define NO_TARGET (-1)
+#define OPT_OPERANDS 2
+#define OPT_LABEL_BUCKETS 256
+#define OPT_INITIAL_CAPACITY 64
+
+/* optimization rounds before giving up on a fixed point */
+#define OPT_MAX_ROUNDS 8
+
+/* immediates are 8-bit two's complement, registers hold 10-bit words */
+#define MIN_FOLDED_IMMEDIATE (-128)
+#define MAX_FOLDED_IMMEDIATE 127
+#define FOLDED_OPERAND_LENGTH 8     /* "#-128" and the NUL */
+
+/* removed instructions are kept as comments so line numbers do not move */
+#define OPT_REMOVED_PREFIX ";"
+
+/* what the optimizer changed */
+typedef struct {
+    int removed;        /* dead register writes removed */
+    int folded;         /* register operands replaced by immediates */
+} optimizer_stats;
+
+/* one instruction of the program with its register effects */
+typedef struct {
+    int line;                           /* index of the source line */
+    separate_line *parts;               /* parsed line, operands rewritten when folded */
+    const command_instructions *inst;   /* instruction table entry */
+    int modes[OPT_OPERANDS];            /* operand addressing modes, in line order */
+    int use;                            /* registers read */
+    int def;                            /* register written, or NO_REGISTER */
+    int target;                         /* instruction a direct jump reaches, or NO_TARGET */
+    int entered;                        /* YES if code the optimizer cannot follow may reach the label */
+    int next_label;                     /* next labeled instruction in the same label bucket */
+    int scope;                          /* global labels up to here, where its local labels belong */
+    int removed;                        /* YES once optimized out */
+    int folded;                         /* YES if an operand was rewritten */
+} opt_instruction;
+
+/* register constants at one program point */
+typedef struct {
+    int known;                          /* registers with a known value */
+    int values[OPT_REGISTERS];          /* 10-bit value of each known register */
+} register_constants;
+
+/* basic block of consecutive instructions */
+typedef struct {
+    int first;                          /* first instruction */
+    int last;                           /* last instruction */
+    int successors[2];                  /* successor blocks, or NO_TARGET */
+    int exit_live;                      /* registers live when leaving to unknown code */
+    int unknown_entry;                  /* YES if reachable from code the optimizer cannot see */
+    int live_in;                        /* registers live on entry */
+    int live_out;                       /* registers live on exit */
+    int reached;                        /* YES once constants reach the block */
+    register_constants in;              /* constants on entry */
+    register_constants out;             /* constants on exit */
+} basic_block;
+
+/* whole program as seen by the optimizer */
+typedef struct {
+    char **lines;                       /* source lines, newline included */
+    int line_count;
+    int line_capacity;
+    opt_instruction *code;              /* instructions in program order */
+    int code_count;
+    int code_capacity;
+    char **entries;                     /* .entry names */
+    int entry_count;
+    int entry_capacity;
+    int label_buckets[OPT_LABEL_BUCKETS];/* labeled instructions by label hash */
+    int scope;                          /* global labels read so far */
+    int indirect_jumps;                 /* YES if a jump goes through a matrix operand */
+    basic_block *blocks;
+    int block_count;
+    int *block_of;                      /* block of each instruction */
+    int *pred_first;                    /* predecessors of block b: preds[pred_first[b]..pred_first[b+1]) */
+    int *preds;
+} opt_program;
+
+/**
+ * optimize_program - remove dead register writes and fold constant registers into immediates
+ * the file must already have passed the first pass; it is rewritten only when something changed
+ * @param filename: macro-expanded source file (.am)
+ * @param stats: output for what changed
+ * @return SUCCESS if the file was optimized or left alone, FAILURE on an I/O or allocation error
+ */
+int optimize_program(const char *filename, optimizer_stats *stats);
+
+#endif /* OPTIMIZER_H */
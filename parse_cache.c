@@ -0,0 +1,552 @@
+#include "parse_cache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* record header line in the cache file */
+#define RECORD_HEADER_FORMAT "%d %d %lu %lu %d %d %lu\n"
+#define RECORD_HEADER_FIELDS 7
+#define HEADER_FLAGS 0
+#define HEADER_OPERANDS 1
+#define HEADER_TEXT_LENGTH 2
+#define HEADER_FIELDS_LENGTH 3
+#define HEADER_FIRST_MODE 4
+#define HEADER_CHECKSUM 6
+#define CHECKSUM_NUMBER_BYTES 4         /* numbers are mixed into the checksum as 32 bits */
+
+/* cache consulted by parse_line, NULL when caching is off */
+static parse_cache *active_cache = NULL;
+
+/**
+ * bucket_of - bucket index of a hash
+ * @param cache: cache
+ * @param hash: line hash
+ * @return bucket index
+ */
+static int bucket_of(const parse_cache *cache, unsigned long hash) {
+    return (int)(hash & (unsigned long)(cache->bucket_count - 1));
+}
+
+/**
+ * grow_cache - double the bucket array and rehash
+ * a failed allocation keeps the old buckets, which only lengthens chains
+ * @param cache: cache to grow
+ */
+static void grow_cache(parse_cache *cache) {
+    parse_record **buckets;
+    parse_record *record;
+    int size = cache->bucket_count * 2;
+    int index;
+
+    if (cache->size + (long)(cache->bucket_count * sizeof(parse_record *)) > cache->budget) return;
+    buckets = calloc(size, sizeof(parse_record *));
+    if (!buckets) return;
+    cache->size += (long)(cache->bucket_count * sizeof(parse_record *));
+
+    cache->bucket_count = size;
+    for (record = cache->records; record; record = record->next_record) {
+        index = bucket_of(cache, record->hash);
+        record->next = buckets[index];
+        buckets[index] = record;
+    }
+
+    free(cache->buckets);
+    cache->buckets = buckets;
+}
+
+/**
+ * insert_record - add a record to the table and the record list
+ * @param cache: cache
+ * @param record: record to add
+ */
+static void insert_record(parse_cache *cache, parse_record *record) {
+    int index = bucket_of(cache, record->hash);
+
+    record->next = cache->buckets[index];
+    cache->buckets[index] = record;
+    record->next_record = cache->records;
+    cache->records = record;
+    cache->count++;
+
+    if (cache->count > cache->bucket_count * PARSE_CACHE_MAX_LOAD) grow_cache(cache);
+}
+
+/**
+ * find_record - look up the record of a line
+ * @param cache: cache
+ * @param line: line text
+ * @param hash: hash_string of line
+ * @return record, or NULL if the line is not cached
+ */
+static parse_record *find_record(const parse_cache *cache, const char *line, unsigned long hash) {
+    parse_record *record;
+
+    for (record = cache->buckets[bucket_of(cache, hash)]; record; record = record->next) {
+        if (record->hash == hash && strcmp(record->text, line) == 0) return record;
+    }
+    return NULL;
+}
+
+/**
+ * free_records - release every record and the loaded file
+ * @param cache: cache
+ */
+static void free_records(parse_cache *cache) {
+    parse_record *record;
+    parse_record *next;
+
+    for (record = cache->records; record; record = next) {
+        next = record->next_record;
+        free(record);
+    }
+    cache->records = NULL;
+    cache->count = 0;
+    memset(cache->buckets, 0, cache->bucket_count * sizeof(parse_record *));
+    free(cache->image);
+    cache->image = NULL;
+    cache->size = (long)(cache->bucket_count * sizeof(parse_record *));
+}
+
+/**
+ * checksum_bytes - continue an FNV-1a checksum over a block of bytes
+ * @param hash: checksum so far
+ * @param bytes: bytes to add
+ * @param length: number of bytes
+ * @return updated checksum
+ */
+static unsigned long checksum_bytes(unsigned long hash, const char *bytes, size_t length) {
+    size_t i;
+
+    for (i = 0; i < length; i++) {
+        hash ^= (unsigned char)bytes[i];
+        hash = (hash * FNV_PRIME) & HASH_MASK_32;
+    }
+    return hash;
+}
+
+/**
+ * checksum_number - continue an FNV-1a checksum over the low 32 bits of a number
+ * @param hash: checksum so far
+ * @param number: number to add
+ * @return updated checksum
+ */
+static unsigned long checksum_number(unsigned long hash, unsigned long number) {
+    int i;
+
+    for (i = 0; i < CHECKSUM_NUMBER_BYTES; i++) {
+        hash ^= (number >> (i * BITS_PER_BYTE)) & 0xFFUL;
+        hash = (hash * FNV_PRIME) & HASH_MASK_32;
+    }
+    return hash;
+}
+
+/**
+ * record_checksum - checksum of everything a record tells the assembler
+ * @param record: record
+ * @return 32-bit checksum
+ */
+static unsigned long record_checksum(const parse_record *record) {
+    unsigned long hash = FNV_OFFSET_BASIS;
+    int i;
+
+    hash = checksum_number(hash, (unsigned long)record->flags);
+    hash = checksum_number(hash, (unsigned long)record->operand_count);
+    for (i = 0; i < PARSE_CACHE_MODES; i++) {
+        hash = checksum_number(hash, (unsigned long)record->modes[i]);
+    }
+    hash = checksum_bytes(hash, record->text, strlen(record->text) + 1);
+    return checksum_bytes(hash, record->fields, record->fields_length);
+}
+
+/**
+ * read_header_numbers - decode the numbers of a record header line
+ * strtoul instead of sscanf, which would scan the rest of the image on every call
+ * @param line: start of the header line
+ * @param numbers: output for RECORD_HEADER_FIELDS numbers
+ * @return pointer after the header line, or NULL if it is malformed
+ */
+static char *read_header_numbers(char *line, unsigned long *numbers) {
+    char *end;
+    int i;
+
+    for (i = 0; i < RECORD_HEADER_FIELDS; i++) {
+        if (*line == '-') return NULL;
+        numbers[i] = strtoul(line, &end, BASE_10);
+        if (end == line) return NULL;
+        line = end;
+    }
+    return *line == NEWLINE_CHAR ? line + 1 : NULL;
+}
+
+/**
+ * fields_match - check that a record holds exactly the fields its header announces
+ * @param fields: record fields
+ * @param length: bytes of fields
+ * @param flags: RECORD_* flags
+ * @param operands: operand count
+ * @return YES if the counts agree, NO otherwise
+ */
+static int fields_match(const char *fields, size_t length, unsigned long flags, unsigned long operands) {
+    unsigned long expected = operands;
+    unsigned long found = 0;
+    size_t i;
+
+    if (flags & RECORD_HAS_LABEL) expected++;
+    if (flags & RECORD_HAS_COMMAND) expected++;
+    for (i = 0; i < length; i++) {
+        if (fields[i] == NULL_CHAR) found++;
+    }
+    return found == expected ? YES : NO;
+}
+
+/**
+ * load_image - index the records of a loaded cache file
+ * the records point into the file image, nothing is copied; records failing
+ * their checksum are counted and skipped, and indexing stops at the budget
+ * @param cache: cache holding the image
+ * @param length: image length
+ * @param damaged: output for the number of records dropped
+ * @return SUCCESS if the record structure is intact, FAILURE otherwise
+ */
+static int load_image(parse_cache *cache, size_t length, unsigned long *damaged) {
+    char *position = cache->image;
+    char *end = cache->image + length;
+    char *newline;
+    parse_record *record;
+    unsigned long numbers[RECORD_HEADER_FIELDS];
+    unsigned long text_length, fields_length;
+    int version;
+    int i;
+
+    *damaged = 0;
+
+    newline = strchr(position, NEWLINE_CHAR);
+    if (!newline || sscanf(position, PARSE_CACHE_MAGIC " %d", &version) != 1 || version != PARSE_CACHE_VERSION) {
+        return FAILURE;
+    }
+    position = newline + 1;
+
+    while (position < end) {
+        position = read_header_numbers(position, numbers);
+        if (!position) return FAILURE;
+
+        text_length = numbers[HEADER_TEXT_LENGTH];
+        fields_length = numbers[HEADER_FIELDS_LENGTH];
+        if (numbers[HEADER_OPERANDS] > MAX_OPERANDS || text_length + 1 + fields_length > (unsigned long)(end - position) ||
+            position[text_length] != NULL_CHAR ||
+            !fields_match(position + text_length + 1, (size_t)fields_length, numbers[HEADER_FLAGS],
+                          numbers[HEADER_OPERANDS])) {
+            return FAILURE;
+        }
+
+        /* the rest of the file stays unindexed once the budget is spent */
+        if (cache->size + (long)sizeof(parse_record) > cache->budget) break;
+        record = malloc(sizeof(parse_record));
+        if (!record) {
+            fprintf(stderr, MALLOC_FAILED);
+            return FAILURE;
+        }
+        record->text = position;
+        record->fields = position + text_length + 1;
+        record->fields_length = (size_t)fields_length;
+        record->flags = (int)numbers[HEADER_FLAGS];
+        record->operand_count = (int)numbers[HEADER_OPERANDS];
+        for (i = 0; i < PARSE_CACHE_MODES; i++) {
+            record->modes[i] = (int)numbers[HEADER_FIRST_MODE + i];
+        }
+        position += text_length + 1 + fields_length;
+
+        /* a record that changed on disk would silently change the output */
+        if (record_checksum(record) != numbers[HEADER_CHECKSUM]) {
+            (*damaged)++;
+            free(record);
+            continue;
+        }
+        record->hash = hash_string(record->text);
+        record->used = NO;
+        record->in_image = YES;
+        cache->size += (long)sizeof(parse_record);
+        insert_record(cache, record);
+    }
+    return SUCCESS;
+}
+
+/**
+ * open_parse_cache - load a cache file and make parse_line use it
+ * a missing file, or one larger than the budget, starts an empty cache; a file
+ * with a damaged structure is ignored and records failing their checksum are dropped
+ * @param cache: cache to initialize
+ * @param path: cache file
+ * @param budget: bytes the cache may take (a share of -m, or PARSE_CACHE_DEFAULT_BUDGET)
+ * @return SUCCESS if the cache is ready, FAILURE on allocation failure
+ */
+int open_parse_cache(parse_cache *cache, const char *path, long budget) {
+    FILE *file;
+    size_t length;
+    long file_size;
+    unsigned long damaged;
+
+    cache->path = path;
+    cache->budget = budget;
+    cache->image = NULL;
+    cache->records = NULL;
+    cache->count = 0;
+    cache->hits = 0;
+    cache->lookups = 0;
+    cache->bucket_count = PARSE_CACHE_INITIAL_BUCKETS;
+    cache->buckets = calloc(cache->bucket_count, sizeof(parse_record *));
+    if (!cache->buckets) {
+        fprintf(stderr, MALLOC_FAILED);
+        return FAILURE;
+    }
+    cache->size = (long)(cache->bucket_count * sizeof(parse_record *));
+
+    /* no file yet is the normal first run, not an error */
+    file = fopen(path, FILE_READ_BINARY_MODE);
+    if (file) {
+        file_size = fseek(file, 0L, SEEK_END) == 0 ? ftell(file) : -1;
+        fclose(file);
+        if (file_size < 0 || cache->size + file_size > budget) {
+            fprintf(stderr, WARNING_PARSE_CACHE_TOO_LARGE, path);
+        } else {
+            cache->image = read_entire_file(path, &length);
+        }
+        if (cache->image) {
+            cache->size += (long)length;
+            if (load_image(cache, length, &damaged) == FAILURE) {
+                fprintf(stderr, WARNING_PARSE_CACHE_CORRUPT, path);
+                free_records(cache);
+            } else if (damaged > 0) {
+                fprintf(stderr, WARNING_PARSE_CACHE_RECORDS, damaged, path);
+            }
+        }
+    }
+
+    active_cache = cache;
+    return SUCCESS;
+}
+
+/**
+ * parse_cache_find - look up the record of a line in the active cache
+ * the record stays valid until close_parse_cache and must not be modified,
+ * except for its modes
+ * @param line: source line
+ * @return record, or NULL if there is no cache or no record
+ */
+parse_record *parse_cache_find(const char *line) {
+    parse_record *record;
+
+    if (!active_cache) return NULL;
+
+    active_cache->lookups++;
+    record = find_record(active_cache, line, hash_string(line));
+    if (!record) return NULL;
+
+    record->used = YES;
+    active_cache->hits++;
+    return record;
+}
+
+/**
+ * share_record_fields - point a parsed line at the fields of a record, without copying
+ * @param record: record from parse_cache_find or parse_cache_store
+ * @param parts: line with room for record->operand_count operands
+ */
+void share_record_fields(const parse_record *record, separate_line *parts) {
+    /* fields are stored in order: label, command, operands */
+    char *field = (char *)record->fields;
+    int i;
+
+    parts->label = NULL;
+    parts->command = NULL;
+    if (record->flags & RECORD_HAS_LABEL) {
+        parts->label = field;
+        field += strlen(field) + 1;
+    }
+    if (record->flags & RECORD_HAS_COMMAND) {
+        parts->command = field;
+        field += strlen(field) + 1;
+    }
+    for (i = 0; i < record->operand_count; i++) {
+        parts->operands[i] = field;
+        field += strlen(field) + 1;
+    }
+    parts->how_many_operands = record->operand_count;
+}
+
+/**
+ * copy_field - allocate a copy of a stored field
+ * @param field: field text, may be NULL
+ * @param copy: output for the copy, NULL for NULL
+ * @return SUCCESS, or FAILURE on allocation failure
+ */
+static int copy_field(const char *field, char **copy) {
+    *copy = NULL;
+    if (!field) return SUCCESS;
+
+    *copy = malloc(strlen(field) + 1);
+    if (!*copy) {
+        fprintf(stderr, MALLOC_FAILED);
+        return FAILURE;
+    }
+    strcpy(*copy, field);
+    return SUCCESS;
+}
+
+/**
+ * copy_record_fields - build an allocated parsed line from a record
+ * @param record: record from parse_cache_find
+ * @return newly allocated parsed line, or NULL on allocation failure
+ */
+separate_line *copy_record_fields(const parse_record *record) {
+    separate_line shared;
+    separate_line *parts;
+    int i;
+
+    parts = malloc(sizeof(separate_line));
+    if (!parts) {
+        fprintf(stderr, MALLOC_FAILED);
+        return NULL;
+    }
+    parts->label = NULL;
+    parts->command = NULL;
+    parts->how_many_operands = 0;
+    parts->shared = NO;
+
+    share_record_fields(record, &shared);
+    if (copy_field(shared.label, &parts->label) == FAILURE ||
+        copy_field(shared.command, &parts->command) == FAILURE) {
+        free_separate_line(parts);
+        return NULL;
+    }
+    for (i = 0; i < shared.how_many_operands; i++) {
+        if (copy_field(shared.operands[i], &parts->operands[i]) == FAILURE) {
+            free_separate_line(parts);
+            return NULL;
+        }
+        parts->how_many_operands++;
+    }
+    return parts;
+}
+
+/**
+ * parse_cache_store - remember the parse of a line in the active cache
+ * allocation failures and a spent budget are ignored; the line is just parsed again next time
+ * @param line: source line
+ * @param parts: parse_line result for it
+ * @return the new record, or NULL if it was not stored
+ */
+parse_record *parse_cache_store(const char *line, const separate_line *parts) {
+    parse_record *record;
+    size_t text_length = strlen(line);
+    size_t fields_length = 0;
+    size_t bytes;
+    char *field;
+    int i;
+
+    if (!active_cache || !parts) return NULL;
+
+    if (parts->label) fields_length += strlen(parts->label) + 1;
+    if (parts->command) fields_length += strlen(parts->command) + 1;
+    for (i = 0; i < parts->how_many_operands; i++) {
+        /* a partial operand list is not worth keeping */
+        if (!parts->operands[i]) return NULL;
+        fields_length += strlen(parts->operands[i]) + 1;
+    }
+
+    /* one allocation holds the record, its text and its fields */
+    bytes = sizeof(parse_record) + text_length + 1 + fields_length;
+    if (active_cache->size + (long)bytes > active_cache->budget) return NULL;
+    record = malloc(bytes);
+    if (!record) return NULL;
+    active_cache->size += (long)bytes;
+
+    field = (char *)(record + 1);
+    strcpy(field, line);
+    record->text = field;
+    field += text_length + 1;
+    record->fields = field;
+    record->fields_length = fields_length;
+    record->flags = 0;
+    record->operand_count = parts->how_many_operands;
+    record->hash = hash_string(line);
+    record->used = YES;
+    record->in_image = NO;
+    for (i = 0; i < PARSE_CACHE_MODES; i++) {
+        record->modes[i] = PARSE_CACHE_NO_MODE;
+    }
+
+    if (parts->label) {
+        strcpy(field, parts->label);
+        field += strlen(parts->label) + 1;
+        record->flags |= RECORD_HAS_LABEL;
+    }
+    if (parts->command) {
+        strcpy(field, parts->command);
+        field += strlen(parts->command) + 1;
+        record->flags |= RECORD_HAS_COMMAND;
+    }
+    for (i = 0; i < parts->how_many_operands; i++) {
+        strcpy(field, parts->operands[i]);
+        field += strlen(parts->operands[i]) + 1;
+    }
+
+    insert_record(active_cache, record);
+    return record;
+}
+
+/**
+ * write_records - write the records used in this run
+ * @param cache: cache
+ * @param out: output stream
+ */
+static void write_records(const parse_cache *cache, FILE *out) {
+    const parse_record *record;
+
+    fprintf(out, "%s %d\n", PARSE_CACHE_MAGIC, PARSE_CACHE_VERSION);
+    for (record = cache->records; record; record = record->next_record) {
+        if (!record->used) continue;
+        fprintf(out, RECORD_HEADER_FORMAT, record->flags, record->operand_count,
+                (unsigned long)strlen(record->text), (unsigned long)record->fields_length, record->modes[0],
+                record->modes[1], record_checksum(record));
+        fwrite(record->text, 1, strlen(record->text) + 1, out);
+        fwrite(record->fields, 1, record->fields_length, out);
+    }
+}
+
+/**
+ * close_parse_cache - write the records used in this run back to the file and release the cache
+ * records not used in this run are dropped, so the file tracks the current sources
+ * @param cache: cache to close
+ * @return SUCCESS if written, FAILURE otherwise
+ */
+int close_parse_cache(parse_cache *cache) {
+    char *temp_name;
+    FILE *out;
+    int result = FAILURE;
+
+    if (active_cache == cache) active_cache = NULL;
+
+    temp_name = build_filename(cache->path, PARSE_CACHE_TEMP_SUFFIX);
+    out = temp_name ? fopen(temp_name, FILE_WRITE_BINARY_MODE) : NULL;
+    if (out) {
+        write_records(cache, out);
+        if (fclose(out) == 0) {
+            /* rename over an existing file is not portable, so fall back to remove + rename */
+            if (rename(temp_name, cache->path) == 0) {
+                result = SUCCESS;
+            } else {
+                remove(cache->path);
+                if (rename(temp_name, cache->path) == 0) result = SUCCESS;
+            }
+        }
+        if (result == FAILURE) remove(temp_name);
+    }
+    if (result == FAILURE) fprintf(stderr, ERROR_PARSE_CACHE_WRITE, cache->path);
+
+    free(temp_name);
+    free_records(cache);
+    free(cache->buckets);
+    cache->buckets = NULL;
+    return result;
+}
@@ -0,0 +1,111 @@
+#ifndef PARSE_CACHE_H
+#define PARSE_CACHE_H
+
+#include <stddef.h>
+#include "utils.h"
+
+/* cache file layout: a header line, then per record a header line
+ * "flags operands text_length fields_length mode mode checksum", the
+ * NUL-terminated line text and the NUL-terminated fields (label, command,
+ * operands); the checksum covers the other numbers, the text and the fields */
+#define PARSE_CACHE_MAGIC "asmcache"
+#define PARSE_CACHE_VERSION 2
+#define PARSE_CACHE_TEMP_SUFFIX ".tmp"
+#define PARSE_CACHE_INITIAL_BUCKETS 256
+#define PARSE_CACHE_MAX_LOAD 2
+#define PARSE_CACHE_DEFAULT_BUDGET (64L * 1024 * 1024)    /* bytes of records without -m */
+#define PARSE_CACHE_MODES 2             /* addressing modes kept for the first two operands */
+#define PARSE_CACHE_NO_MODE 0           /* mode not known yet; no valid mode is 0 */
+
+/* record flags */
+#define RECORD_HAS_LABEL 0x1
+#define RECORD_HAS_COMMAND 0x2
+
+/* messages */
+#define WARNING_PARSE_CACHE_CORRUPT "Warning: ignoring damaged parse cache '%s'\n"
+#define WARNING_PARSE_CACHE_RECORDS "Warning: dropped %lu damaged record(s) of parse cache '%s'\n"
+#define WARNING_PARSE_CACHE_TOO_LARGE "Warning: parse cache '%s' exceeds its memory budget, starting empty\n"
+#define ERROR_PARSE_CACHE_WRITE "Error: cannot write parse cache '%s'\n"
+#define MSG_PARSE_CACHE_STATS "Parse cache: %lu of %lu lines reused\n"
+
+/* parse_line result for one line text */
+typedef struct parse_record {
+    unsigned long hash;                 /* hash_string of text */
+    const char *text;                   /* line text */
+    const char *fields;                 /* label, command, operands, each NUL-terminated */
+    size_t fields_length;               /* bytes of fields including the NULs */
+    int flags;                          /* RECORD_* */
+    int operand_count;                  /* operands stored in fields */
+    int modes[PARSE_CACHE_MODES];       /* get_operand_mode results, PARSE_CACHE_NO_MODE until known */
+    int used;                           /* YES if looked up or added in this run */
+    int in_image;                       /* YES if text and fields point into the loaded file */
+    struct parse_record *next;          /* bucket chain */
+    struct parse_record *next_record;   /* list of all records */
+} parse_record;
+
+/* cache of parse_line results, kept between runs in one file */
+typedef struct {
+    const char *path;           /* cache file */
+    char *image;                /* cache file contents, read with one call */
+    parse_record **buckets;     /* hash buckets */
+    int bucket_count;           /* power of two */
+    int count;                  /* records in the table */
+    parse_record *records;      /* all records */
+    long size;                  /* bytes of the image, records and buckets */
+    long budget;                /* no records are added past this many bytes */
+    unsigned long hits;         /* lines answered from the cache */
+    unsigned long lookups;      /* lines looked up */
+} parse_cache;
+
+/**
+ * open_parse_cache - load a cache file and make parse_line use it
+ * a missing file, or one larger than the budget, starts an empty cache; a file
+ * with a damaged structure is ignored and records failing their checksum are dropped
+ * @param cache: cache to initialize
+ * @param path: cache file
+ * @param budget: bytes the cache may take (a share of -m, or PARSE_CACHE_DEFAULT_BUDGET)
+ * @return SUCCESS if the cache is ready, FAILURE on allocation failure
+ */
+int open_parse_cache(parse_cache *cache, const char *path, long budget);
+
+/**
+ * parse_cache_find - look up the record of a line in the active cache
+ * the record stays valid until close_parse_cache and must not be modified,
+ * except for its modes
+ * @param line: source line
+ * @return record, or NULL if there is no cache or no record
+ */
+parse_record *parse_cache_find(const char *line);
+
+/**
+ * parse_cache_store - remember the parse of a line in the active cache
+ * allocation failures and a spent budget are ignored; the line is just parsed again next time
+ * @param line: source line
+ * @param parts: parse_line result for it
+ * @return the new record, or NULL if it was not stored
+ */
+parse_record *parse_cache_store(const char *line, const separate_line *parts);
+
+/**
+ * share_record_fields - point a parsed line at the fields of a record, without copying
+ * @param record: record from parse_cache_find or parse_cache_store
+ * @param parts: line with room for record->operand_count operands
+ */
+void share_record_fields(const parse_record *record, separate_line *parts);
+
+/**
+ * copy_record_fields - build an allocated parsed line from a record
+ * @param record: record from parse_cache_find
+ * @return newly allocated parsed line, or NULL on allocation failure
+ */
+separate_line *copy_record_fields(const parse_record *record);
+
+/**
+ * close_parse_cache - write the records used in this run back to the file and release the cache
+ * records not used in this run are dropped, so the file tracks the current sources
+ * @param cache: cache to close
+ * @return SUCCESS if written, FAILURE otherwise
+ */
+int close_parse_cache(parse_cache *cache);
+
+#endif /* PARSE_CACHE_H */
@@ -1,4 +1,5 @@
 #include "parser.h"
+#include "parse_cache.h"
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -11,10 +12,38 @@ static void initialize_operands_array(char** operands, int max_operands);
 
 /**
  * parse_line - parse a single assembly line
+ * answered from the parse cache when one is open (-P), tokenized otherwise
  * @line: input line to parse
  * @return pointer to allocated separate_line on success, NULL on failure
  */
 separate_line* parse_line(const char* line) {
+    separate_line* separate;
+    parse_record* record;
+
+    if (!line) {
+        return NULL;
+    }
+
+    record = parse_cache_find(line);
+    if (record) {
+        return copy_record_fields(record);
+    }
+
+    /* only successful parses are stored, so failing lines report their errors every run */
+    separate = tokenize_line(line);
+    if (separate) {
+        parse_cache_store(line, separate);
+    }
+    return separate;
+}
+
+/**
+ * tokenize_line - split a single assembly line into label, command and operands
+ * the parse cache is neither consulted nor updated
+ * @line: input line to parse
+ * @return pointer to allocated separate_line on success, NULL on failure
+ */
+separate_line* tokenize_line(const char* line) {
     char line_copy[MAX_LINE_LENGTH];
     const char* rest;
     int i;
@@ -434,6 +463,7 @@ static void initialize_separate_line(separate_line* separate) {
     separate->label = NULL;
     separate->command = NULL;
     separate->how_many_operands = 0;
+    separate->shared = NO;
 
     /* Initialize all operands to NULL */
     for (i = 0; i < MAX_OPERANDS; i++) {
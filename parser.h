@@ -10,6 +10,14 @@
  */
 separate_line* parse_line(const char* line);
 
+/**
+ * tokenize_line - split a single assembly line into label, command and operands
+ * the parse cache is neither consulted nor updated
+ * @line: input line to parse
+ * @return pointer to allocated separate_line on success, NULL on failure
+ */
+separate_line* tokenize_line(const char* line);
+
 /**
  * extract_label - extract label from a line
  * @line: source line
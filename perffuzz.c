@@ -0,0 +1,844 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "utils.h"
+#include "macro.h"
+#include "repeat.h"
+#include "first_pass.h"
+#include "second_pass.h"
+#include "labelTable.h"
+#include "line_memo.h"
+
+/* command line */
+#define MIN_ARGC 2
+#define OPTION_PREFIX '-'
+#define OPTION_ITERATIONS "-n"
+#define OPTION_SEED "-s"
+#define OPTION_TIME_THRESHOLD "-t"
+#define OPTION_ALLOCATION_THRESHOLD "-a"
+#define OPTION_CORPUS_DIR "-c"
+#define OPTION_KEEP "-k"
+#define OPTION_MAX_BYTES "-b"
+#define OPTION_REPEATS "-r"
+
+/* defaults */
+#define DEFAULT_ITERATIONS 500L
+#define DEFAULT_SEED 1L
+#define DEFAULT_TIME_THRESHOLD 10.0         /* microseconds of processor time per input byte */
+#define DEFAULT_ALLOCATION_THRESHOLD 4.0    /* allocations per input byte */
+#define DEFAULT_KEEP 8L
+#define DEFAULT_MAX_BYTES 16384L
+#define DEFAULT_REPEATS 3L
+#define MAX_KEEP 256L
+#define MAX_SEEDS 256
+
+/* inputs below this size are measured but never flagged: fixed costs dominate them */
+#define MIN_FLAG_BYTES 256L
+
+/* scratch files, in the current directory */
+#define WORK_SOURCE "perffuzz_work.as"
+#define WORK_EXPANDED "perffuzz_work.am"
+#define WORK_OUTPUTS {"perffuzz_work.am", "perffuzz_work.ob", "perffuzz_work.ent", "perffuzz_work.ext"}
+#define WORK_OUTPUT_COUNT 4
+
+/* corpus file names */
+#define SLOW_FILE_FORMAT "%s/slow_%02d.as"
+#define FLAGGED_FILE_FORMAT "%s/flagged_%04ld.as"
+#define CORPUS_PATH_EXTRA 24                /* room for the file name after the directory */
+
+/* mutations */
+#define MAX_REPEAT_LINES 64                 /* copies of a duplicated line, labels or data lines added */
+#define MAX_DELETE_LINES 4
+#define MAX_WRAP_LINES 8                    /* lines moved into a macro or .rept body */
+#define MAX_MACRO_CALLS 64
+#define MAX_REPT_COUNT_MUTATION 8
+#define MAX_NESTED_REPT 3                   /* .rept blocks in one input, bounds the expansion */
+#define MAX_SPLICE_LINES 16
+#define MAX_DATA_VALUE 511
+#define DATA_LINE_LIMIT (MAX_LINE_LENGTH - 8)
+#define NUMBER_TEXT_LENGTH 24
+#define PRINTABLE_FIRST ' '
+#define PRINTABLE_COUNT 95
+#define MICROSECONDS 1000000.0
+
+/* error messages */
+#define ERROR_UNKNOWN_OPTION "Error: Unknown option '%s'\n"
+#define ERROR_MISSING_OPTION_VALUE "Error: Option '%s' requires a value\n"
+#define ERROR_INVALID_OPTION_VALUE "Error: Invalid value '%s' for option '%s'\n"
+#define ERROR_TOO_MANY_SEEDS "Error: at most %d seed files\n"
+#define ERROR_NO_SEEDS "Error: no seed files could be read\n"
+
+/* report messages */
+#define MSG_USAGE_FORMAT "Usage: %s [options] seed.as...\n"
+#define MSG_DESCRIPTION "\nMutates the seed sources and runs each variant through macro expansion,\n" \
+    "the first pass and the second pass, measuring processor time and allocations\n" \
+    "per input byte. Keeps the slowest variants and flags any whose cost per byte\n" \
+    "exceeds a threshold. Exits with status 1 if an input was flagged.\n" \
+    "Assembler diagnostics for invalid variants go to standard error.\n"
+#define MSG_OPTIONS "\nOptions:\n" \
+    "  -n N     mutated inputs to try (default 500)\n" \
+    "  -s N     random seed (default 1)\n" \
+    "  -t US    flag inputs above US microseconds per byte (default 10)\n" \
+    "  -a N     flag inputs above N allocations per byte (default 4)\n" \
+    "  -k N     slowest inputs to keep (default 8)\n" \
+    "  -b N     largest input in bytes (default 16384)\n" \
+    "  -r N     runs per input, the fastest counts (default 3)\n" \
+    "  -c DIR   write flagged inputs and the kept corpus to the existing directory DIR\n"
+#define MSG_FLAGGED "FLAG %ld: %.3f us/byte, %.3f allocs/byte, %ld bytes (macro %.0f%%, first %.0f%%, second %.0f%%)%s%s\n"
+#define MSG_SAVED_AS " saved as "
+#define MSG_SUMMARY "\n%ld inputs tried, %ld flagged\n\nSlowest inputs:\n"
+#define MSG_CORPUS_HEADER "  rank   us/byte  allocs/byte    bytes  origin\n"
+#define MSG_CORPUS_ROW "  %4d %9.3f %12.3f %8ld  %s%s%s\n"
+
+/* pipeline phases that are timed */
+typedef enum {
+    PERF_MACRO,
+    PERF_FIRST_PASS,
+    PERF_SECOND_PASS,
+    PERF_PHASES
+} perf_phase;
+
+/* one input and what it cost */
+typedef struct {
+    char *text;                         /* source text */
+    long length;                        /* bytes */
+    char origin[MAX_LINE_LENGTH];       /* seed file or mutation that produced it */
+    double phase_seconds[PERF_PHASES];  /* processor time of the fastest run */
+    unsigned long allocations;          /* allocations in one run */
+    double time_cost;                   /* microseconds per byte */
+    double allocation_cost;             /* allocations per byte */
+} fuzz_input;
+
+/* fuzzer settings selected on the command line */
+typedef struct {
+    long iterations;
+    long seed;
+    double time_threshold;
+    double allocation_threshold;
+    long keep;
+    long max_bytes;
+    long repeats;
+    const char *corpus_dir;             /* NULL to keep inputs in memory only */
+} fuzz_options;
+
+/* one line of an input, not NUL-terminated */
+typedef struct {
+    const char *start;
+    size_t length;                      /* including the newline, if any */
+} text_line;
+
+/* mutations applied to a parent input */
+typedef enum {
+    MUTATE_DUPLICATE,                   /* repeat one line */
+    MUTATE_DELETE,                      /* drop a few lines */
+    MUTATE_LABELS,                      /* insert many labeled instructions */
+    MUTATE_DATA,                        /* insert full .data lines */
+    MUTATE_MACRO,                       /* move lines into a macro and call it often */
+    MUTATE_REPT,                        /* wrap lines in a .rept block */
+    MUTATE_INTERESTING,                 /* insert a line from the dictionary */
+    MUTATE_SPLICE,                      /* copy lines from another input */
+    MUTATE_BYTE,                        /* change one character */
+    MUTATIONS
+} mutation;
+
+/* names of the mutations, for the corpus report */
+static const char *mutation_names[MUTATIONS] = {
+    "duplicate", "delete", "labels", "data", "macro", "rept", "interesting", "splice", "byte"
+};
+
+/* lines that reach unusual paths of the assembler */
+static const char *interesting_lines[] = {
+    "mov M[r1][r2], M[r3][r4]\n",
+    "M: .mat [8][8]\n",
+    "S: .string \"aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa\"\n",
+    ".extern X\n",
+    "jsr X\n",
+    ".entry MAIN\n",
+    "MAIN: prn #-128\n",
+    ".data -512, 511, +7, 0\n",
+    "lea M, r7\n",
+    "; comment\n",
+    "\n",
+    "mov r1, r2, r3\n",
+    "L: L: stop\n",
+    "cmp #1, #2\n",
+    "bne MAIN\n",
+    ".rept 0\n",
+    ".endr\n",
+    "mcroend\n"
+};
+#define INTERESTING_LINES (sizeof(interesting_lines) / sizeof(interesting_lines[0]))
+
+/* numbers labels and macros so that inserted names do not collide */
+static long next_name = 0;
+
+/**
+ * print usage information
+ * @param program_name: name of the executable program
+ */
+static void print_usage(const char *program_name) {
+    printf(MSG_USAGE_FORMAT, program_name);
+    printf(MSG_DESCRIPTION);
+    printf(MSG_OPTIONS);
+}
+
+/**
+ * random_below - pseudo-random number
+ * @param limit: exclusive upper bound, at least 1
+ * @return number from 0 to limit - 1
+ */
+static long random_below(long limit) {
+    unsigned long value = (unsigned long)rand() * ((unsigned long)RAND_MAX + 1UL) + (unsigned long)rand();
+
+    return limit > 0 ? (long)(value % (unsigned long)limit) : 0;
+}
+
+/**
+ * split_lines - find the lines of a text
+ * @param text: text to split
+ * @param length: bytes of text
+ * @param count: output for the number of lines
+ * @return allocated line array (free it), or NULL on allocation failure
+ */
+static text_line *split_lines(const char *text, long length, long *count) {
+    text_line *lines;
+    long capacity = 1;
+    long i;
+
+    for (i = 0; i < length; i++) {
+        if (text[i] == NEWLINE_CHAR) capacity++;
+    }
+    lines = malloc((size_t)capacity * sizeof(text_line));
+    if (!lines) {
+        fprintf(stderr, MALLOC_FAILED);
+        return NULL;
+    }
+
+    *count = 0;
+    i = 0;
+    while (i < length) {
+        lines[*count].start = text + i;
+        while (i < length && text[i] != NEWLINE_CHAR) i++;
+        if (i < length) i++;
+        lines[*count].length = (size_t)(text + i - lines[*count].start);
+        (*count)++;
+    }
+    return lines;
+}
+
+/**
+ * append_span - append part of a string to a buffer
+ * @param buffer: buffer to grow
+ * @param text: start of the text
+ * @param length: bytes to append
+ * @return SUCCESS if appended, FAILURE on allocation failure
+ */
+static int append_span(text_buffer *buffer, const char *text, size_t length) {
+    char piece[MAX_LINE_LENGTH];
+    size_t part;
+
+    while (length > 0) {
+        part = length < sizeof(piece) - 1 ? length : sizeof(piece) - 1;
+        memcpy(piece, text, part);
+        piece[part] = NULL_CHAR;
+        if (append_text(buffer, piece) == FAILURE) return FAILURE;
+        text += part;
+        length -= part;
+    }
+    return SUCCESS;
+}
+
+/**
+ * append_line - append one line, adding a newline if the line lacks one
+ * @param buffer: buffer to grow
+ * @param line: line to append
+ * @return SUCCESS if appended, FAILURE on allocation failure
+ */
+static int append_line(text_buffer *buffer, const text_line *line) {
+    if (append_span(buffer, line->start, line->length) == FAILURE) return FAILURE;
+    if (line->length == 0 || line->start[line->length - 1] != NEWLINE_CHAR) {
+        return append_text(buffer, "\n");
+    }
+    return SUCCESS;
+}
+
+/**
+ * append_lines - append a range of lines
+ * @param buffer: buffer to grow
+ * @param lines: line array
+ * @param first: first line
+ * @param end: line after the last
+ * @return SUCCESS if appended, FAILURE on allocation failure
+ */
+static int append_lines(text_buffer *buffer, const text_line *lines, long first, long end) {
+    long i;
+
+    for (i = first; i < end; i++) {
+        if (append_line(buffer, &lines[i]) == FAILURE) return FAILURE;
+    }
+    return SUCCESS;
+}
+
+/**
+ * append_data_line - append a .data line filled with random values
+ * @param buffer: buffer to grow
+ * @return SUCCESS if appended, FAILURE on allocation failure
+ */
+static int append_data_line(text_buffer *buffer) {
+    char line[MAX_LINE_LENGTH + NUMBER_TEXT_LENGTH];
+    char number[NUMBER_TEXT_LENGTH];
+
+    strcpy(line, DIRECTIVE_DATA);
+    while (strlen(line) < DATA_LINE_LIMIT) {
+        sprintf(number, "%s %ld", strcmp(line, DIRECTIVE_DATA) == 0 ? "" : ",",
+                random_below(2 * MAX_DATA_VALUE + 1) - MAX_DATA_VALUE);
+        strcat(line, number);
+    }
+    strcat(line, "\n");
+    return append_text(buffer, line);
+}
+
+/**
+ * count_rept_blocks - count .rept lines, to bound nested expansion
+ * @param text: input text
+ * @return number of .rept occurrences
+ */
+static int count_rept_blocks(const char *text) {
+    const char *p;
+    int count = 0;
+
+    for (p = strstr(text, DIRECTIVE_REPT); p; p = strstr(p + 1, DIRECTIVE_REPT)) count++;
+    return count;
+}
+
+/**
+ * mutate - build a new input from a parent
+ * @param parent: input to mutate
+ * @param other: second input, for splicing
+ * @param kind: mutation to apply
+ * @param buffer: empty buffer that receives the new text
+ * @return SUCCESS if built, FAILURE on allocation failure
+ */
+static int mutate(const fuzz_input *parent, const fuzz_input *other, mutation kind, text_buffer *buffer) {
+    char line[MAX_LINE_LENGTH + NUMBER_TEXT_LENGTH];
+    text_line *lines;
+    text_line *other_lines = NULL;
+    long count, other_count = 0;
+    long at, span, copies, i;
+    long name;
+    int result = SUCCESS;
+
+    lines = split_lines(parent->text, parent->length, &count);
+    if (!lines) return FAILURE;
+
+    at = random_below(count + 1);
+    span = at < count ? 1 + random_below(MAX_WRAP_LINES < count - at ? MAX_WRAP_LINES : count - at) : 0;
+    copies = 1 + random_below(MAX_REPEAT_LINES);
+    name = next_name++;
+
+    if (kind == MUTATE_SPLICE) {
+        other_lines = split_lines(other->text, other->length, &other_count);
+        if (!other_lines) {
+            free(lines);
+            return FAILURE;
+        }
+    }
+
+    /* lines before the mutation point are kept as they are */
+    result = append_lines(buffer, lines, 0, at);
+
+    switch (kind) {
+        case MUTATE_DUPLICATE:
+            for (i = 0; result == SUCCESS && at < count && i < copies; i++) {
+                result = append_line(buffer, &lines[at]);
+            }
+            break;
+        case MUTATE_DELETE:
+            at += 1 + random_below(MAX_DELETE_LINES);
+            break;
+        case MUTATE_LABELS:
+            for (i = 0; result == SUCCESS && i < copies; i++) {
+                sprintf(line, "F%ldx%ld: inc r%ld\n", name, i, random_below(MAX_REGISTER_CHAR - MIN_REGISTER_CHAR + 1));
+                result = append_text(buffer, line);
+            }
+            break;
+        case MUTATE_DATA:
+            for (i = 0; result == SUCCESS && i < copies; i++) result = append_data_line(buffer);
+            break;
+        case MUTATE_MACRO:
+            sprintf(line, "%s m%ld\n", MCRO_KEYWORD, name);
+            result = append_text(buffer, line);
+            if (result == SUCCESS) result = append_lines(buffer, lines, at, at + span);
+            if (result == SUCCESS) result = append_text(buffer, MCROEND_KEYWORD "\n");
+            sprintf(line, "m%ld\n", name);
+            for (i = 0; result == SUCCESS && i < 1 + random_below(MAX_MACRO_CALLS); i++) {
+                result = append_text(buffer, line);
+            }
+            at += span;
+            break;
+        case MUTATE_REPT:
+            if (count_rept_blocks(parent->text) < MAX_NESTED_REPT) {
+                sprintf(line, "%s %ld\n", DIRECTIVE_REPT, 2 + random_below(MAX_REPT_COUNT_MUTATION - 1));
+                result = append_text(buffer, line);
+                if (result == SUCCESS) result = append_lines(buffer, lines, at, at + span);
+                if (result == SUCCESS) result = append_text(buffer, DIRECTIVE_ENDR "\n");
+                at += span;
+            }
+            break;
+        case MUTATE_INTERESTING:
+            result = append_text(buffer, interesting_lines[random_below((long)INTERESTING_LINES)]);
+            break;
+        case MUTATE_SPLICE:
+            i = random_below(other_count + 1);
+            span = i + 1 + random_below(MAX_SPLICE_LINES);
+            result = append_lines(buffer, other_lines, i, span < other_count ? span : other_count);
+            break;
+        case MUTATE_BYTE:
+            if (at < count && lines[at].length > 0) {
+                i = random_below((long)lines[at].length);
+                result = append_span(buffer, lines[at].start, (size_t)i);
+                line[0] = (char)(PRINTABLE_FIRST + random_below(PRINTABLE_COUNT));
+                line[1] = NULL_CHAR;
+                if (result == SUCCESS) result = append_text(buffer, line);
+                if (result == SUCCESS) {
+                    result = append_span(buffer, lines[at].start + i + 1, lines[at].length - (size_t)i - 1);
+                }
+                at++;
+            }
+            break;
+        default:
+            break;
+    }
+
+    /* and so are the lines after it */
+    if (result == SUCCESS && at < count) result = append_lines(buffer, lines, at, count);
+
+    free(lines);
+    free(other_lines);
+    return result;
+}
+
+/**
+ * write_text - write an input to a file
+ * @param path: file to write
+ * @param text: input text
+ * @param length: bytes
+ * @return SUCCESS if written, FAILURE otherwise
+ */
+static int write_text(const char *path, const char *text, long length) {
+    FILE *file = fopen(path, FILE_WRITE_BINARY_MODE);
+    int result = SUCCESS;
+
+    if (!file) {
+        fprintf(stderr, ERROR_CANNOT_OPEN_FILE_WRITE, path);
+        return FAILURE;
+    }
+    if (length > 0 && fwrite(text, 1, (size_t)length, file) != (size_t)length) result = FAILURE;
+    if (fclose(file) != 0) result = FAILURE;
+    if (result == FAILURE) fprintf(stderr, ERROR_CANNOT_OPEN_FILE_WRITE, path);
+    return result;
+}
+
+/**
+ * run_pipeline - assemble the work source once, timing each phase
+ * @param seconds: output for the processor time of each phase
+ */
+static void run_pipeline(double seconds[PERF_PHASES]) {
+    label_table table;
+    line_memo memo;
+    clock_t started;
+    int ic_final, dc_final;
+    int result;
+    int phase;
+
+    for (phase = 0; phase < PERF_PHASES; phase++) seconds[phase] = 0.0;
+
+    started = clock();
+    result = expand_macros(WORK_SOURCE, WORK_EXPANDED, NULL, NULL, NULL);
+    seconds[PERF_MACRO] = (double)(clock() - started) / CLOCKS_PER_SEC;
+    if (result == FAILURE) return;
+
+    init_label_table(&table);
+    begin_line_memo(&memo, LINE_MEMO_DEFAULT_BUDGET);
+
+    started = clock();
+    result = first_pass_on_table(WORK_EXPANDED, &table, &ic_final, &dc_final);
+    seconds[PERF_FIRST_PASS] = (double)(clock() - started) / CLOCKS_PER_SEC;
+
+    if (result == SUCCESS) {
+        started = clock();
+        second_pass(WORK_EXPANDED, &table, ic_final, dc_final);
+        seconds[PERF_SECOND_PASS] = (double)(clock() - started) / CLOCKS_PER_SEC;
+    }
+
+    end_line_memo(&memo);
+    free_label_table(&table);
+}
+
+/**
+ * measure_input - run an input through the pipeline and record its cost per byte
+ * @param input: input to measure
+ * @param repeats: runs; the fastest counts, allocations come from the first
+ * @return SUCCESS if measured, FAILURE if the work file cannot be written
+ */
+static int measure_input(fuzz_input *input, long repeats) {
+    double seconds[PERF_PHASES];
+    double total, best = -1.0;
+    long run;
+    int phase;
+
+    if (write_text(WORK_SOURCE, input->text, input->length) == FAILURE) return FAILURE;
+
+    for (run = 0; run < repeats; run++) {
+        allocation_count = 0;
+        run_pipeline(seconds);
+        if (run == 0) input->allocations = allocation_count;
+
+        total = 0.0;
+        for (phase = 0; phase < PERF_PHASES; phase++) total += seconds[phase];
+        if (best < 0.0 || total < best) {
+            best = total;
+            memcpy(input->phase_seconds, seconds, sizeof(seconds));
+        }
+    }
+
+    input->time_cost = input->length > 0 ? best * MICROSECONDS / input->length : 0.0;
+    input->allocation_cost = input->length > 0 ? (double)input->allocations / input->length : 0.0;
+    return SUCCESS;
+}
+
+/**
+ * phase_share - percentage of the measured time spent in one phase
+ * @param input: measured input
+ * @param phase: phase
+ * @return percentage, 0 if nothing was measured
+ */
+static double phase_share(const fuzz_input *input, perf_phase phase) {
+    double total = 0.0;
+    int i;
+
+    for (i = 0; i < PERF_PHASES; i++) total += input->phase_seconds[i];
+    return total > 0.0 ? 100.0 * input->phase_seconds[phase] / total : 0.0;
+}
+
+/**
+ * corpus_path - build the name of a corpus file
+ * @param dir: corpus directory
+ * @param format: file name format with the directory and one number
+ * @param number: number for the name
+ * @return allocated path (free it), or NULL on allocation failure
+ */
+static char *corpus_path(const char *dir, const char *format, long number) {
+    char *path = malloc(strlen(dir) + strlen(format) + CORPUS_PATH_EXTRA);
+
+    if (!path) {
+        fprintf(stderr, MALLOC_FAILED);
+        return NULL;
+    }
+    if (strcmp(format, SLOW_FILE_FORMAT) == 0) sprintf(path, format, dir, (int)number);
+    else sprintf(path, format, dir, number);
+    return path;
+}
+
+/**
+ * report_flagged - print a flagged input and save it to the corpus directory
+ * @param input: flagged input
+ * @param iteration: iteration that produced it
+ * @param options: fuzzer settings
+ */
+static void report_flagged(const fuzz_input *input, long iteration, const fuzz_options *options) {
+    char *path = NULL;
+
+    if (options->corpus_dir) {
+        path = corpus_path(options->corpus_dir, FLAGGED_FILE_FORMAT, iteration);
+        if (path && write_text(path, input->text, input->length) == FAILURE) {
+            free(path);
+            path = NULL;
+        }
+    }
+    printf(MSG_FLAGGED, iteration, input->time_cost, input->allocation_cost, input->length,
+           phase_share(input, PERF_MACRO), phase_share(input, PERF_FIRST_PASS),
+           phase_share(input, PERF_SECOND_PASS), path ? MSG_SAVED_AS : "", path ? path : "");
+    free(path);
+}
+
+/**
+ * keep_input - add an input to the corpus of slowest inputs if it is slow enough
+ * the corpus stays sorted, slowest first
+ * @param corpus: kept inputs
+ * @param count: kept inputs, updated
+ * @param keep: corpus capacity
+ * @param input: measured input; its text moves into the corpus or is freed
+ */
+static void keep_input(fuzz_input *corpus, long *count, long keep, fuzz_input *input) {
+    long i;
+
+    if (*count == keep) {
+        if (input->time_cost <= corpus[keep - 1].time_cost) {
+            free(input->text);
+            return;
+        }
+        free(corpus[--(*count)].text);
+    }
+
+    for (i = *count; i > 0 && corpus[i - 1].time_cost < input->time_cost; i--) corpus[i] = corpus[i - 1];
+    corpus[i] = *input;
+    (*count)++;
+}
+
+/**
+ * load_seed - read a seed source and measure it
+ * @param input: input to fill
+ * @param path: seed file
+ * @param repeats: runs per measurement
+ * @return SUCCESS if loaded, FAILURE otherwise
+ */
+static int load_seed(fuzz_input *input, const char *path, long repeats) {
+    size_t length;
+
+    input->text = read_entire_file(path, &length);
+    if (!input->text) return FAILURE;
+    input->length = (long)length;
+    strncpy(input->origin, path, sizeof(input->origin) - 1);
+    input->origin[sizeof(input->origin) - 1] = NULL_CHAR;
+    if (measure_input(input, repeats) == FAILURE) {
+        free(input->text);
+        return FAILURE;
+    }
+    return SUCCESS;
+}
+
+/**
+ * parse_long_option - read the numeric value of an option
+ * @param argc: number of arguments
+ * @param argv: arguments
+ * @param index: option index, advanced past the value
+ * @param minimum: smallest accepted value
+ * @param value: output for the value
+ * @return SUCCESS if valid, FAILURE otherwise
+ */
+static int parse_long_option(int argc, char *argv[], int *index, long minimum, long *value) {
+    char *end;
+
+    if (*index + 1 >= argc) {
+        fprintf(stderr, ERROR_MISSING_OPTION_VALUE, argv[*index]);
+        return FAILURE;
+    }
+    *value = strtol(argv[*index + 1], &end, BASE_10);
+    if (*end != NULL_CHAR || end == argv[*index + 1] || *value < minimum) {
+        fprintf(stderr, ERROR_INVALID_OPTION_VALUE, argv[*index + 1], argv[*index]);
+        return FAILURE;
+    }
+    (*index)++;
+    return SUCCESS;
+}
+
+/**
+ * parse_double_option - read the decimal value of an option
+ * @param argc: number of arguments
+ * @param argv: arguments
+ * @param index: option index, advanced past the value
+ * @param value: output for the value, which must be positive
+ * @return SUCCESS if valid, FAILURE otherwise
+ */
+static int parse_double_option(int argc, char *argv[], int *index, double *value) {
+    char *end;
+
+    if (*index + 1 >= argc) {
+        fprintf(stderr, ERROR_MISSING_OPTION_VALUE, argv[*index]);
+        return FAILURE;
+    }
+    *value = strtod(argv[*index + 1], &end);
+    if (*end != NULL_CHAR || end == argv[*index + 1] || *value <= 0.0) {
+        fprintf(stderr, ERROR_INVALID_OPTION_VALUE, argv[*index + 1], argv[*index]);
+        return FAILURE;
+    }
+    (*index)++;
+    return SUCCESS;
+}
+
+/**
+ * parse_option - read one command line option
+ * @param argc: number of arguments
+ * @param argv: arguments
+ * @param index: option index, advanced past its value
+ * @param options: settings to update
+ * @return SUCCESS if valid, FAILURE otherwise
+ */
+static int parse_option(int argc, char *argv[], int *index, fuzz_options *options) {
+    const char *option = argv[*index];
+
+    if (strcmp(option, OPTION_ITERATIONS) == 0) return parse_long_option(argc, argv, index, 0L, &options->iterations);
+    if (strcmp(option, OPTION_SEED) == 0) return parse_long_option(argc, argv, index, 0L, &options->seed);
+    if (strcmp(option, OPTION_KEEP) == 0) {
+        if (parse_long_option(argc, argv, index, 1L, &options->keep) == FAILURE) return FAILURE;
+        if (options->keep > MAX_KEEP) options->keep = MAX_KEEP;
+        return SUCCESS;
+    }
+    if (strcmp(option, OPTION_MAX_BYTES) == 0) return parse_long_option(argc, argv, index, 1L, &options->max_bytes);
+    if (strcmp(option, OPTION_REPEATS) == 0) return parse_long_option(argc, argv, index, 1L, &options->repeats);
+    if (strcmp(option, OPTION_TIME_THRESHOLD) == 0) {
+        return parse_double_option(argc, argv, index, &options->time_threshold);
+    }
+    if (strcmp(option, OPTION_ALLOCATION_THRESHOLD) == 0) {
+        return parse_double_option(argc, argv, index, &options->allocation_threshold);
+    }
+    if (strcmp(option, OPTION_CORPUS_DIR) == 0) {
+        if (*index + 1 >= argc) {
+            fprintf(stderr, ERROR_MISSING_OPTION_VALUE, option);
+            return FAILURE;
+        }
+        options->corpus_dir = argv[++(*index)];
+        return SUCCESS;
+    }
+    fprintf(stderr, ERROR_UNKNOWN_OPTION, option);
+    return FAILURE;
+}
+
+/**
+ * remove_work_files - delete the scratch source and its outputs
+ */
+static void remove_work_files(void) {
+    const char *outputs[WORK_OUTPUT_COUNT] = WORK_OUTPUTS;
+    int i;
+
+    remove(WORK_SOURCE);
+    for (i = 0; i < WORK_OUTPUT_COUNT; i++) remove(outputs[i]);
+}
+
+/**
+ * print_corpus - report the kept inputs and save them to the corpus directory
+ * @param corpus: kept inputs, slowest first
+ * @param count: kept inputs
+ * @param options: fuzzer settings
+ */
+static void print_corpus(const fuzz_input *corpus, long count, const fuzz_options *options) {
+    char *path;
+    long i;
+
+    printf(MSG_CORPUS_HEADER);
+    for (i = 0; i < count; i++) {
+        path = NULL;
+        if (options->corpus_dir) {
+            path = corpus_path(options->corpus_dir, SLOW_FILE_FORMAT, i + 1);
+            if (path && write_text(path, corpus[i].text, corpus[i].length) == FAILURE) {
+                free(path);
+                path = NULL;
+            }
+        }
+        printf(MSG_CORPUS_ROW, (int)(i + 1), corpus[i].time_cost, corpus[i].allocation_cost, corpus[i].length,
+               corpus[i].origin, path ? MSG_SAVED_AS : "", path ? path : "");
+        free(path);
+    }
+}
+
+/**
+ * main
+ * @param argc: number of command line arguments
+ * @param argv: array of command line argument strings
+ * @return 0 if no input was flagged, EXIT_FAILURE_CODE otherwise
+ */
+int main(int argc, char *argv[]) {
+    fuzz_options options;
+    fuzz_input *corpus;
+    fuzz_input input;
+    text_buffer buffer;
+    const char *seeds[MAX_SEEDS];
+    const fuzz_input *parent;
+    long count = 0;
+    long flagged = 0;
+    long tried = 0;
+    long iteration;
+    mutation kind;
+    int seed_count = 0;
+    int i, j;
+
+    if (argc < MIN_ARGC) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE_CODE;
+    }
+
+    options.iterations = DEFAULT_ITERATIONS;
+    options.seed = DEFAULT_SEED;
+    options.time_threshold = DEFAULT_TIME_THRESHOLD;
+    options.allocation_threshold = DEFAULT_ALLOCATION_THRESHOLD;
+    options.keep = DEFAULT_KEEP;
+    options.max_bytes = DEFAULT_MAX_BYTES;
+    options.repeats = DEFAULT_REPEATS;
+    options.corpus_dir = NULL;
+    for (i = 1; i < argc; i++) {
+        if (argv[i][0] != OPTION_PREFIX) {
+            if (seed_count == MAX_SEEDS) {
+                fprintf(stderr, ERROR_TOO_MANY_SEEDS, MAX_SEEDS);
+                return EXIT_FAILURE_CODE;
+            }
+            seeds[seed_count++] = argv[i];
+            continue;
+        }
+        if (parse_option(argc, argv, &i, &options) == FAILURE) {
+            print_usage(argv[0]);
+            return EXIT_FAILURE_CODE;
+        }
+    }
+
+    corpus = malloc((size_t)(options.keep + 1) * sizeof(fuzz_input));
+    if (!corpus) {
+        fprintf(stderr, MALLOC_FAILED);
+        return EXIT_FAILURE_CODE;
+    }
+
+    /* the seeds start the corpus, so there is always a parent to mutate */
+    srand((unsigned int)options.seed);
+    for (i = 0; i < seed_count; i++) {
+        if (load_seed(&input, seeds[i], options.repeats) == SUCCESS) keep_input(corpus, &count, options.keep, &input);
+    }
+    if (count == 0) {
+        fprintf(stderr, ERROR_NO_SEEDS);
+        free(corpus);
+        remove_work_files();
+        return EXIT_FAILURE_CODE;
+    }
+
+    for (iteration = 1; iteration <= options.iterations; iteration++) {
+        /* slower parents are picked more often: the index is the smaller of two draws */
+        i = (int)random_below(count);
+        j = (int)random_below(count);
+        parent = &corpus[j < i ? j : i];
+        kind = (mutation)random_below(MUTATIONS);
+
+        init_text_buffer(&buffer);
+        if (mutate(parent, &corpus[random_below(count)], kind, &buffer) == FAILURE) {
+            free_text_buffer(&buffer);
+            break;
+        }
+        if (!buffer.data || (long)buffer.length > options.max_bytes) {
+            free_text_buffer(&buffer);
+            continue;
+        }
+
+        input.text = buffer.data;
+        input.length = (long)buffer.length;
+        sprintf(input.origin, "%s #%ld", mutation_names[kind], iteration);
+        if (measure_input(&input, options.repeats) == FAILURE) {
+            free(input.text);
+            break;
+        }
+        tried++;
+
+        if (input.length >= MIN_FLAG_BYTES && (input.time_cost > options.time_threshold ||
+                                               input.allocation_cost > options.allocation_threshold)) {
+            flagged++;
+            report_flagged(&input, iteration, &options);
+        }
+        keep_input(corpus, &count, options.keep, &input);
+    }
+
+    printf(MSG_SUMMARY, tried, flagged);
+    print_corpus(corpus, count, &options);
+
+    while (count > 0) free(corpus[--count].text);
+    free(corpus);
+    remove_work_files();
+    return flagged > 0 ? EXIT_FAILURE_CODE : 0;
+}
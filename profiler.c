@@ -0,0 +1,341 @@
+#include "profiler.h"
+#include "commands.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define PERCENT 100.0
+
+/* a defined label, as used for grouping counters */
+typedef struct {
+    const char *name;
+    int address;
+} profile_symbol;
+
+/* one flat profile row */
+typedef struct {
+    const char *name;
+    unsigned long self;     /* instructions executed inside the routine */
+    unsigned long calls;    /* jsr calls into the routine */
+} flat_row;
+
+/**
+ * create_profile - allocate zeroed profile counters
+ * @return new profile (free with free_profile), or NULL if allocation failed
+ */
+profile *create_profile(void) {
+    profile *p;
+
+    p = calloc(1, sizeof(profile));
+    if (!p) {
+        fprintf(stderr, MALLOC_FAILED);
+        return NULL;
+    }
+
+    p->call_edges = calloc((size_t)MACHINE_MEMORY_SIZE * MACHINE_MEMORY_SIZE, sizeof(unsigned long));
+    if (!p->call_edges) {
+        fprintf(stderr, MALLOC_FAILED);
+        free(p);
+        return NULL;
+    }
+    return p;
+}
+
+/**
+ * free_profile - release a profile
+ * @param p: profile to free
+ */
+void free_profile(profile *p) {
+    if (!p) return;
+    free(p->call_edges);
+    free(p);
+}
+
+/**
+ * count_access - add one operand's data access to the heatmaps
+ * @param m: machine about to execute the instruction
+ * @param p: counters to update
+ * @param inst: instruction at the program counter
+ * @param op: operand of the instruction
+ */
+static void count_access(const machine *m, profile *p, const decoded_instruction *inst, const decoded_operand *op) {
+    int access = operand_access(inst, op);
+    int address;
+
+    if (access == OPERAND_NO_ACCESS) return;
+
+    /* matrix addresses depend on registers, so resolve them before executing */
+    address = operand_address(m, op);
+    if (access & OPERAND_READ) p->reads[address]++;
+    if (access & OPERAND_WRITE) p->writes[address]++;
+}
+
+/**
+ * profile_run - execute a program while counting instructions, calls and data accesses
+ * the plain run loop is left untouched; this loop records each instruction
+ * before stepping it, so only profiled runs pay for counting
+ * @param m: machine prepared with init_machine
+ * @param p: counters to update
+ * @return final machine state
+ */
+machine_state profile_run(machine *m, profile *p) {
+    const decoded_instruction *inst;
+    machine_state state = MACHINE_RUNNING;
+    int target;
+
+    while (state == MACHINE_RUNNING) {
+        inst = &m->decoded[m->pc];
+
+        if (!(inst->flags & (DECODED_INVALID | DECODED_EXTERNAL))) {
+            p->executions[m->pc]++;
+            p->total++;
+            count_access(m, p, inst, &inst->src);
+            count_access(m, p, inst, &inst->dst);
+
+            if (inst->opcode == JSR) {
+                target = operand_address(m, &inst->dst);
+                p->calls[target]++;
+                p->call_edges[m->pc * MACHINE_MEMORY_SIZE + target]++;
+            }
+        }
+
+        state = machine_step(m);
+    }
+    return state;
+}
+
+/**
+ * collect_symbols - copy defined labels in an address range, sorted by address
+ * @param labels: label table from the first pass, or NULL
+ * @param from: first address of the range
+ * @param to: address after the range
+ * @param symbols: output array (caller frees)
+ * @return number of symbols, or -1 if allocation failed
+ */
+static int collect_symbols(const label_table *labels, int from, int to, profile_symbol **symbols) {
+    const label_node *node;
+    profile_symbol symbol;
+    int count = 0;
+    int i;
+
+    *symbols = malloc((labels ? labels->count : 0) * sizeof(profile_symbol) + 1);
+    if (!*symbols) {
+        fprintf(stderr, MALLOC_FAILED);
+        return -1;
+    }
+    if (!labels) return 0;
+
+    for (node = labels->head; node; node = node->next) {
+        if (!node->is_defined || node->type == LABEL_EXTERNAL) continue;
+        if (node->address < from || node->address >= to) continue;
+
+        /* insertion sort: label tables are small */
+        symbol.name = node->name;
+        symbol.address = node->address;
+        for (i = count; i > 0 && (*symbols)[i - 1].address > symbol.address; i--) {
+            (*symbols)[i] = (*symbols)[i - 1];
+        }
+        (*symbols)[i] = symbol;
+        count++;
+    }
+    return count;
+}
+
+/**
+ * owner_index - find the label whose region holds an address
+ * @param symbols: symbols sorted by address
+ * @param count: number of symbols
+ * @param address: address to look up
+ * @return index of the last symbol at or below the address, or -1 if none
+ */
+static int owner_index(const profile_symbol *symbols, int count, int address) {
+    int i;
+
+    for (i = count - 1; i >= 0; i--) {
+        if (symbols[i].address <= address) return i;
+    }
+    return -1;
+}
+
+/**
+ * print_location - print an address as label or label+offset
+ * @param out: report stream
+ * @param symbols: symbols sorted by address
+ * @param count: number of symbols
+ * @param address: address to describe
+ */
+static void print_location(FILE *out, const profile_symbol *symbols, int count, int address) {
+    int i = owner_index(symbols, count, address);
+
+    if (i < 0) {
+        fprintf(out, MSG_NO_LABEL);
+    } else if (symbols[i].address == address) {
+        fprintf(out, "%s", symbols[i].name);
+    } else {
+        fprintf(out, FORMAT_LABEL_OFFSET, symbols[i].name, address - symbols[i].address);
+    }
+}
+
+/**
+ * region_end - first address after a label's region
+ * @param symbols: symbols sorted by address
+ * @param count: number of symbols
+ * @param index: symbol index, or -1 for the region before the first label
+ * @param limit: end of the segment
+ * @return end address of the region
+ */
+static int region_end(const profile_symbol *symbols, int count, int index, int limit) {
+    return index + 1 < count ? symbols[index + 1].address : limit;
+}
+
+/**
+ * write_flat_profile - print instructions executed per routine, busiest first
+ * @param out: report stream
+ * @param m: machine after the run
+ * @param p: collected counters
+ * @param code: code labels sorted by address
+ * @param count: number of code labels
+ * @return SUCCESS, or FAILURE if allocation failed
+ */
+static int write_flat_profile(FILE *out, const machine *m, const profile *p, const profile_symbol *code, int count) {
+    flat_row *rows;
+    flat_row row;
+    int rows_used = 0;
+    int start, end;
+    int i, j, address;
+
+    rows = malloc((count + 1) * sizeof(flat_row));
+    if (!rows) {
+        fprintf(stderr, MALLOC_FAILED);
+        return FAILURE;
+    }
+
+    /* region -1 is code before the first label */
+    for (i = -1; i < count; i++) {
+        start = i < 0 ? INITIAL_IC : code[i].address;
+        end = i < 0 ? (count > 0 ? code[0].address : m->code_end) : region_end(code, count, i, m->code_end);
+
+        row.name = i < 0 ? MSG_NO_LABEL : code[i].name;
+        row.self = 0;
+        row.calls = i < 0 ? 0 : p->calls[start];
+        for (address = start; address < end; address++) {
+            row.self += p->executions[address];
+        }
+        if (i < 0 && row.self == 0) continue;
+
+        for (j = rows_used; j > 0 && rows[j - 1].self < row.self; j--) {
+            rows[j] = rows[j - 1];
+        }
+        rows[j] = row;
+        rows_used++;
+    }
+
+    fprintf(out, MSG_PROFILE_FLAT_HEADER, p->total);
+    fprintf(out, MSG_PROFILE_FLAT_COLUMNS);
+    for (i = 0; i < rows_used; i++) {
+        fprintf(out, MSG_PROFILE_FLAT_ROW, p->total ? rows[i].self * PERCENT / p->total : 0.0,
+                rows[i].self, rows[i].calls, rows[i].name);
+    }
+
+    free(rows);
+    return SUCCESS;
+}
+
+/**
+ * write_call_graph - print each called address with its call sites
+ * @param out: report stream
+ * @param p: collected counters
+ * @param code: code labels sorted by address
+ * @param count: number of code labels
+ */
+static void write_call_graph(FILE *out, const profile *p, const profile_symbol *code, int count) {
+    int target, site;
+    unsigned long calls;
+
+    fprintf(out, MSG_PROFILE_GRAPH_HEADER);
+    for (target = 0; target < MACHINE_MEMORY_SIZE; target++) {
+        if (p->calls[target] == 0) continue;
+
+        print_location(out, code, count, target);
+        fprintf(out, MSG_PROFILE_GRAPH_CALLEE, p->calls[target]);
+        for (site = 0; site < MACHINE_MEMORY_SIZE; site++) {
+            calls = p->call_edges[site * MACHINE_MEMORY_SIZE + target];
+            if (calls == 0) continue;
+            fprintf(out, MSG_PROFILE_GRAPH_CALLER, calls);
+            print_location(out, code, count, site);
+            fprintf(out, MSG_PROFILE_GRAPH_SITE, site);
+        }
+    }
+}
+
+/**
+ * write_data_profile - print reads and writes per data label
+ * @param out: report stream
+ * @param p: collected counters
+ * @param data: data labels sorted by address
+ * @param count: number of data labels
+ */
+static void write_data_profile(FILE *out, const profile *p, const profile_symbol *data, int count) {
+    unsigned long reads, writes;
+    int i, address, end;
+
+    fprintf(out, MSG_PROFILE_DATA_HEADER);
+    fprintf(out, MSG_PROFILE_DATA_COLUMNS);
+    for (i = 0; i < count; i++) {
+        reads = 0;
+        writes = 0;
+        end = region_end(data, count, i, MACHINE_MEMORY_SIZE);
+        for (address = data[i].address; address < end; address++) {
+            reads += p->reads[address];
+            writes += p->writes[address];
+        }
+        fprintf(out, MSG_PROFILE_DATA_ROW, reads, writes, data[i].name);
+    }
+}
+
+/**
+ * write_profile - print flat, call-graph and data-access reports
+ * @param out: report stream
+ * @param m: machine after the profiled run
+ * @param p: collected counters
+ * @param labels: labels from the program source, or NULL to report raw addresses
+ * @return SUCCESS if the report was written, FAILURE otherwise
+ */
+int write_profile(FILE *out, const machine *m, const profile *p, const label_table *labels) {
+    profile_symbol *code;
+    profile_symbol *data;
+    int code_count, data_count;
+    int address;
+    int result;
+
+    code_count = collect_symbols(labels, INITIAL_IC, m->code_end, &code);
+    if (code_count < 0) return FAILURE;
+    data_count = collect_symbols(labels, m->code_end, MACHINE_MEMORY_SIZE, &data);
+    if (data_count < 0) {
+        free(code);
+        return FAILURE;
+    }
+
+    result = write_flat_profile(out, m, p, code, code_count);
+    if (result == SUCCESS) {
+        write_call_graph(out, p, code, code_count);
+        write_data_profile(out, p, data, data_count);
+
+        fprintf(out, MSG_PROFILE_ADDRESS_HEADER);
+        fprintf(out, MSG_PROFILE_ADDRESS_COLUMNS);
+        for (address = 0; address < MACHINE_MEMORY_SIZE; address++) {
+            if (!p->executions[address] && !p->reads[address] && !p->writes[address]) continue;
+            fprintf(out, MSG_PROFILE_ADDRESS_ROW, address, p->executions[address],
+                    p->reads[address], p->writes[address]);
+            if (address < m->code_end) {
+                print_location(out, code, code_count, address);
+            } else {
+                print_location(out, data, data_count, address);
+            }
+            fprintf(out, "\n");
+        }
+    }
+
+    free(code);
+    free(data);
+    return result;
+}
@@ -0,0 +1,67 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdio.h>
+#include "machine.h"
+#include "labelTable.h"
+
+/* report text */
+#define MSG_PROFILE_FLAT_HEADER "Flat profile: %lu instructions executed\n\n"
+#define MSG_PROFILE_FLAT_COLUMNS "  %%instr      self     calls  routine\n"
+#define MSG_PROFILE_FLAT_ROW "  %6.2f %9lu %9lu  %s\n"
+#define MSG_PROFILE_GRAPH_HEADER "\nCall graph (callers of each routine):\n\n"
+#define MSG_PROFILE_GRAPH_CALLEE "  called %lu times\n"
+#define MSG_PROFILE_GRAPH_CALLER "    %9lu  from "
+#define MSG_PROFILE_GRAPH_SITE " (at %d)\n"
+#define MSG_PROFILE_DATA_HEADER "\nData accesses by label:\n\n"
+#define MSG_PROFILE_DATA_COLUMNS "      reads    writes  label\n"
+#define MSG_PROFILE_DATA_ROW "  %9lu %9lu  %s\n"
+#define MSG_PROFILE_ADDRESS_HEADER "\nPer address:\n\n"
+#define MSG_PROFILE_ADDRESS_COLUMNS "  address  executed     reads    writes  location\n"
+#define MSG_PROFILE_ADDRESS_ROW "  %7d %9lu %9lu %9lu  "
+#define MSG_NO_LABEL "(no label)"
+#define FORMAT_LABEL_OFFSET "%s+%d"
+
+/* counters collected during a profiled run */
+typedef struct {
+    unsigned long executions[MACHINE_MEMORY_SIZE];  /* instructions executed at each address */
+    unsigned long calls[MACHINE_MEMORY_SIZE];       /* jsr calls into each target address */
+    unsigned long reads[MACHINE_MEMORY_SIZE];       /* data reads of each address */
+    unsigned long writes[MACHINE_MEMORY_SIZE];      /* data writes of each address */
+    unsigned long *call_edges;                      /* [call site][target] jsr counts */
+    unsigned long total;                            /* instructions executed */
+} profile;
+
+/**
+ * create_profile - allocate zeroed profile counters
+ * @return new profile (free with free_profile), or NULL if allocation failed
+ */
+profile *create_profile(void);
+
+/**
+ * free_profile - release a profile
+ * @param p: profile to free
+ */
+void free_profile(profile *p);
+
+/**
+ * profile_run - execute a program while counting instructions, calls and data accesses
+ * the plain run loop is left untouched; this loop records each instruction
+ * before stepping it, so only profiled runs pay for counting
+ * @param m: machine prepared with init_machine
+ * @param p: counters to update
+ * @return final machine state
+ */
+machine_state profile_run(machine *m, profile *p);
+
+/**
+ * write_profile - print flat, call-graph and data-access reports
+ * @param out: report stream
+ * @param m: machine after the profiled run
+ * @param p: collected counters
+ * @param labels: labels from the program source, or NULL to report raw addresses
+ * @return SUCCESS if the report was written, FAILURE otherwise
+ */
+int write_profile(FILE *out, const machine *m, const profile *p, const label_table *labels);
+
+#endif /* PROFILER_H */
@@ -0,0 +1,349 @@
+#include "repeat.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* results of check_rept_start */
+#define REPT_ERROR 0            /* malformed .rept, message already printed */
+#define REPT_START 1            /* the line opens a repeat block */
+#define REPT_NONE 2             /* any other line */
+
+/**
+ * init_text_buffer - initialize an empty buffer
+ * @param buffer: buffer to initialize
+ */
+void init_text_buffer(text_buffer *buffer) {
+    buffer->data = NULL;
+    buffer->length = 0;
+    buffer->capacity = 0;
+}
+
+/**
+ * append_text - add text to the end of a buffer
+ * @param buffer: buffer to grow
+ * @param text: text to append
+ * @return SUCCESS if appended, FAILURE on allocation failure
+ */
+int append_text(text_buffer *buffer, const char *text) {
+    size_t length = strlen(text);
+    size_t capacity = buffer->capacity ? buffer->capacity : INITIAL_BODY_CAPACITY;
+    char *data;
+
+    while (buffer->length + length + 1 > capacity) capacity *= 2;
+    if (capacity != buffer->capacity) {
+        data = realloc(buffer->data, capacity);
+        if (!data) {
+            fprintf(stderr, MALLOC_FAILED);
+            return FAILURE;
+        }
+        buffer->data = data;
+        buffer->capacity = capacity;
+    }
+
+    memcpy(buffer->data + buffer->length, text, length + 1);
+    buffer->length += length;
+    return SUCCESS;
+}
+
+/**
+ * free_text_buffer - release a buffer
+ * @param buffer: buffer to free
+ */
+void free_text_buffer(text_buffer *buffer) {
+    free(buffer->data);
+    init_text_buffer(buffer);
+}
+
+/**
+ * directive_argument - match a directive at the start of a line
+ * @param line: source line
+ * @param directive: directive name
+ * @return text after the directive, or NULL if the line is not that directive
+ */
+static const char *directive_argument(const char *line, const char *directive) {
+    size_t length = strlen(directive);
+
+    while (*line == SPACE_CHAR || *line == TAB_CHAR) line++;
+    if (strncmp(line, directive, length) != 0) return NULL;
+
+    line += length;
+    /* ".reptX" is some other word */
+    if (*line && !strchr(WHITESPACE_CHARS, *line)) return NULL;
+    return line;
+}
+
+/**
+ * check_rept_start - recognize a .rept N line
+ * @param line: source line
+ * @param count: output parameter for N
+ * @param line_number: line number for messages
+ * @return REPT_START, REPT_NONE or REPT_ERROR
+ */
+static int check_rept_start(const char *line, long *count, int line_number) {
+    const char *argument = directive_argument(line, DIRECTIVE_REPT);
+    char *end;
+
+    if (!argument) return REPT_NONE;
+
+    *count = strtol(argument, &end, BASE_10);
+    while (*end && strchr(WHITESPACE_CHARS, *end)) end++;
+    if (end == argument || *end != NULL_CHAR || *count < 0 || *count > MAX_REPT_COUNT) {
+        fprintf(stderr, ERROR_INVALID_REPT_COUNT, line_number, MAX_REPT_COUNT);
+        return REPT_ERROR;
+    }
+    return REPT_START;
+}
+
+/**
+ * check_rept_end - recognize a .endr line
+ * @param line: source line
+ * @return YES if the line closes a repeat block, NO otherwise
+ */
+static int check_rept_end(const char *line) {
+    const char *rest = directive_argument(line, DIRECTIVE_ENDR);
+
+    if (!rest) return NO;
+    while (*rest && strchr(WHITESPACE_CHARS, *rest)) rest++;
+    return *rest == NULL_CHAR ? YES : NO;
+}
+
+/**
+ * build_template - split a body into literal text and counter slots
+ * @param tpl: template to fill
+ * @param body: block body text
+ * @return SUCCESS if built, FAILURE on allocation failure
+ */
+int build_template(line_template *tpl, const char *body) {
+    const char *marker;
+    size_t body_length = strlen(body);
+    int slots = 0;
+
+    for (marker = strstr(body, REPT_COUNTER); marker; marker = strstr(marker + REPT_COUNTER_LENGTH, REPT_COUNTER)) {
+        slots++;
+    }
+
+    tpl->text = malloc(body_length + 1);
+    tpl->slots = slots ? malloc(slots * sizeof(size_t)) : NULL;
+    if (!tpl->text || (slots && !tpl->slots)) {
+        fprintf(stderr, MALLOC_FAILED);
+        free(tpl->text);
+        free(tpl->slots);
+        return FAILURE;
+    }
+
+    /* copy the literal pieces and remember where each counter goes */
+    tpl->length = 0;
+    tpl->slot_count = 0;
+    while ((marker = strstr(body, REPT_COUNTER)) != NULL) {
+        memcpy(tpl->text + tpl->length, body, (size_t)(marker - body));
+        tpl->length += (size_t)(marker - body);
+        tpl->slots[tpl->slot_count++] = tpl->length;
+        body = marker + REPT_COUNTER_LENGTH;
+    }
+    strcpy(tpl->text + tpl->length, body);
+    tpl->length += strlen(body);
+    return SUCCESS;
+}
+
+/**
+ * emit_template - write one iteration of a template
+ * @param tpl: template to write
+ * @param out: output stream
+ * @param iteration: value printed in each counter slot
+ */
+void emit_template(const line_template *tpl, FILE *out, long iteration) {
+    size_t written = 0;
+    int i;
+
+    for (i = 0; i < tpl->slot_count; i++) {
+        fwrite(tpl->text + written, 1, tpl->slots[i] - written, out);
+        fprintf(out, "%ld", iteration);
+        written = tpl->slots[i];
+    }
+    fwrite(tpl->text + written, 1, tpl->length - written, out);
+}
+
+/**
+ * free_template - release a template
+ * @param tpl: template to free
+ */
+void free_template(line_template *tpl) {
+    free(tpl->text);
+    free(tpl->slots);
+    tpl->text = NULL;
+    tpl->slots = NULL;
+    tpl->length = 0;
+    tpl->slot_count = 0;
+}
+
+/**
+ * write_expanded_line - write one expanded line and its line map entry
+ * @param out: expansion output
+ * @param text: line text, including its newline
+ * @param origin: source line the text came from
+ */
+void write_expanded_line(const expansion_output *out, const char *text, int origin) {
+    /* lines are gathered into chunks so the file is written in large blocks */
+    if (!out->chunk || append_text(out->chunk, text) == FAILURE) {
+        flush_expansion(out);
+        fputs(text, out->text);
+    } else if (out->chunk->length >= EXPANSION_CHUNK_SIZE) {
+        flush_expansion(out);
+    }
+    if (out->lines) fprintf(out->lines, "%d\n", origin);
+}
+
+/**
+ * flush_expansion - write the gathered chunk of expanded text
+ * the buffer is kept for the next chunk
+ * @param out: expansion output
+ */
+void flush_expansion(const expansion_output *out) {
+    if (!out->chunk || out->chunk->length == 0) return;
+    fwrite(out->chunk->data, 1, out->chunk->length, out->text);
+    out->chunk->length = 0;
+    out->chunk->data[0] = NULL_CHAR;
+}
+
+/**
+ * emit_repeated - write the body of a closed block count times
+ * the body is scanned for counter slots once, not once per iteration
+ * @param state: repeat state holding the body and its line origins
+ * @param out: expansion output
+ * @return SUCCESS if written, FAILURE on allocation failure
+ */
+int emit_repeated(const repeat_state *state, const expansion_output *out) {
+    line_template tpl;
+    long i;
+    int j;
+
+    if (!state->body.data || state->count == 0) return SUCCESS;
+    if (build_template(&tpl, state->body.data) == FAILURE) return FAILURE;
+
+    /* the template is written straight to the file, after the text before it */
+    flush_expansion(out);
+
+    for (i = 0; i < state->count; i++) {
+        emit_template(&tpl, out->text, i);
+        for (j = 0; out->lines && j < state->origin_count; j++) {
+            fprintf(out->lines, "%d\n", state->origins[j]);
+        }
+    }
+
+    free_template(&tpl);
+    return SUCCESS;
+}
+
+/**
+ * append_origin - remember the source line of a collected body line
+ * @param state: repeat state
+ * @param origin: source line number
+ * @return SUCCESS if stored, FAILURE on allocation failure
+ */
+static int append_origin(repeat_state *state, int origin) {
+    int capacity;
+    int *origins;
+
+    if (state->origin_count == state->origin_capacity) {
+        capacity = state->origin_capacity ? state->origin_capacity * 2 : INITIAL_ORIGIN_CAPACITY;
+        origins = realloc(state->origins, capacity * sizeof(int));
+        if (!origins) {
+            fprintf(stderr, MALLOC_FAILED);
+            return FAILURE;
+        }
+        state->origins = origins;
+        state->origin_capacity = capacity;
+    }
+    state->origins[state->origin_count++] = origin;
+    return SUCCESS;
+}
+
+/**
+ * init_repeat - start a scan with no open repeat block
+ * @param state: state to initialize
+ */
+void init_repeat(repeat_state *state) {
+    state->active = NO;
+    state->count = 0;
+    state->start_line = 0;
+    init_text_buffer(&state->body);
+    state->origins = NULL;
+    state->origin_count = 0;
+    state->origin_capacity = 0;
+}
+
+/**
+ * repeat_line - route one expanded line through the repeat block handling
+ * .rept opens a block, .endr writes it out, body lines are collected and
+ * every other line is written to the output unchanged
+ * @param state: repeat state
+ * @param line: expanded source line
+ * @param origin: source line the text came from, for the line map
+ * @param line_number: line number for messages
+ * @param out: expansion output
+ * @return SUCCESS if handled, FAILURE on a malformed block
+ */
+int repeat_line(repeat_state *state, const char *line, int origin, int line_number, const expansion_output *out) {
+    long count;
+    int status = check_rept_start(line, &count, line_number);
+
+    if (status == REPT_ERROR) return FAILURE;
+    if (status == REPT_START) {
+        if (state->active) {
+            fprintf(stderr, ERROR_NESTED_REPT, line_number);
+            return FAILURE;
+        }
+        state->active = YES;
+        state->count = count;
+        state->start_line = line_number;
+        return SUCCESS;
+    }
+
+    if (check_rept_end(line)) {
+        if (!state->active) {
+            fprintf(stderr, ERROR_ENDR_WITHOUT_REPT, line_number);
+            return FAILURE;
+        }
+        state->active = NO;
+        status = emit_repeated(state, out);
+        /* keep the allocations for the next block */
+        state->body.length = 0;
+        state->origin_count = 0;
+        if (state->body.data) state->body.data[0] = NULL_CHAR;
+        return status;
+    }
+
+    if (state->active) {
+        if (append_origin(state, origin) == FAILURE) return FAILURE;
+        return append_text(&state->body, line);
+    }
+
+    write_expanded_line(out, line, origin);
+    return SUCCESS;
+}
+
+/**
+ * free_repeat - release a repeat state without checking for an open block
+ * @param state: repeat state
+ */
+void free_repeat(repeat_state *state) {
+    free_text_buffer(&state->body);
+    free(state->origins);
+    init_repeat(state);
+}
+
+/**
+ * finish_repeat - check that the last block was closed and release the state
+ * @param state: repeat state
+ * @return SUCCESS if no block is open, FAILURE otherwise
+ */
+int finish_repeat(repeat_state *state) {
+    int result = SUCCESS;
+
+    if (state->active) {
+        fprintf(stderr, ERROR_MISSING_ENDR, state->start_line);
+        result = FAILURE;
+    }
+    free_repeat(state);
+    return result;
+}
@@ -0,0 +1,158 @@
+#ifndef REPEAT_H
+#define REPEAT_H
+
+#include <stdio.h>
+#include "utils.h"
+
+/* repeat block directives */
+#define DIRECTIVE_REPT ".rept"
+#define DIRECTIVE_ENDR ".endr"
+
+/* iteration counter written in the body, replaced by 0, 1, 2, ... */
+#define REPT_COUNTER "\\@"
+#define REPT_COUNTER_LENGTH 2
+
+/* limits */
+#define MAX_REPT_COUNT 100000L
+#define INITIAL_BODY_CAPACITY 256
+#define INITIAL_ORIGIN_CAPACITY 16
+#define EXPANSION_CHUNK_SIZE 65536L     /* expanded text gathered before each write */
+
+/* error messages */
+#define ERROR_INVALID_REPT_COUNT "Error (line %d): .rept needs a count from 0 to %ld\n"
+#define ERROR_NESTED_REPT "Error (line %d): .rept blocks cannot be nested\n"
+#define ERROR_ENDR_WITHOUT_REPT "Error (line %d): .endr without .rept\n"
+#define ERROR_MISSING_ENDR "Error: .rept at line %d not closed with .endr\n"
+#define ERROR_MACRO_IN_REPT "Error (line %d): macro definition inside .rept block\n"
+
+/* growable text buffer for a block body */
+typedef struct {
+    char *data;         /* NUL-terminated text, or NULL while empty */
+    size_t length;      /* characters used, excluding the NUL */
+    size_t capacity;    /* bytes allocated */
+} text_buffer;
+
+/* body split once into literal text and counter slots */
+typedef struct {
+    char *text;             /* body with the counter markers removed */
+    size_t length;          /* length of text */
+    size_t *slots;          /* offsets in text where the counter is printed, ascending */
+    int slot_count;         /* number of slots */
+} line_template;
+
+/* open repeat block while expanding a file */
+typedef struct {
+    int active;             /* YES between .rept and .endr */
+    long count;             /* iterations requested by .rept */
+    int start_line;         /* line of the .rept, for messages */
+    text_buffer body;       /* expanded body lines */
+    int *origins;           /* source line of each body line */
+    int origin_count;       /* body lines collected */
+    int origin_capacity;    /* entries allocated in origins */
+} repeat_state;
+
+/* destination of expanded lines */
+typedef struct {
+    FILE *text;             /* expanded source (.am) */
+    FILE *lines;            /* line map: source line of each expanded line, or NULL */
+    text_buffer *chunk;     /* expanded text not yet written to text, or NULL to write each line */
+} expansion_output;
+
+/**
+ * init_text_buffer - initialize an empty buffer
+ * @param buffer: buffer to initialize
+ */
+void init_text_buffer(text_buffer *buffer);
+
+/**
+ * append_text - add text to the end of a buffer
+ * @param buffer: buffer to grow
+ * @param text: text to append
+ * @return SUCCESS if appended, FAILURE on allocation failure
+ */
+int append_text(text_buffer *buffer, const char *text);
+
+/**
+ * free_text_buffer - release a buffer
+ * @param buffer: buffer to free
+ */
+void free_text_buffer(text_buffer *buffer);
+
+/**
+ * build_template - split a body into literal text and counter slots
+ * @param tpl: template to fill
+ * @param body: block body text
+ * @return SUCCESS if built, FAILURE on allocation failure
+ */
+int build_template(line_template *tpl, const char *body);
+
+/**
+ * emit_template - write one iteration of a template
+ * @param tpl: template to write
+ * @param out: output stream
+ * @param iteration: value printed in each counter slot
+ */
+void emit_template(const line_template *tpl, FILE *out, long iteration);
+
+/**
+ * free_template - release a template
+ * @param tpl: template to free
+ */
+void free_template(line_template *tpl);
+
+/**
+ * write_expanded_line - write one expanded line and its line map entry
+ * @param out: expansion output
+ * @param text: line text, including its newline
+ * @param origin: source line the text came from
+ */
+void write_expanded_line(const expansion_output *out, const char *text, int origin);
+
+/**
+ * flush_expansion - write the gathered chunk of expanded text
+ * @param out: expansion output
+ */
+void flush_expansion(const expansion_output *out);
+
+/**
+ * emit_repeated - write the body of a closed block count times
+ * the body is scanned for counter slots once, not once per iteration
+ * @param state: repeat state holding the body and its line origins
+ * @param out: expansion output
+ * @return SUCCESS if written, FAILURE on allocation failure
+ */
+int emit_repeated(const repeat_state *state, const expansion_output *out);
+
+/**
+ * init_repeat - start a scan with no open repeat block
+ * @param state: state to initialize
+ */
+void init_repeat(repeat_state *state);
+
+/**
+ * repeat_line - route one expanded line through the repeat block handling
+ * .rept opens a block, .endr writes it out, body lines are collected and
+ * every other line is written to the output unchanged
+ * @param state: repeat state
+ * @param line: expanded source line
+ * @param origin: source line the text came from, for the line map
+ * @param line_number: line number for messages
+ * @param out: expansion output
+ * @return SUCCESS if handled, FAILURE on a malformed block
+ */
+int repeat_line(repeat_state *state, const char *line, int origin, int line_number, const expansion_output *out);
+
+/**
+ * free_repeat - release a repeat state without checking for an open block
+ * @param state: repeat state
+ */
+void free_repeat(repeat_state *state);
+
+/**
+ * finish_repeat - check that the last block was closed and release the state
+ * @param state: repeat state
+ * @return SUCCESS if no block is open, FAILURE otherwise
+ */
+int finish_repeat(repeat_state *state);
+
+#endif /* REPEAT_H */
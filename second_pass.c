@@ -1,6 +1,10 @@
 #include "second_pass.h"
 #include "parser.h"
+#include "line_memo.h"
+#include "source_reader.h"
+#include "archive.h"
 #include "commands.h"
+#include "object_writer.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -91,82 +95,6 @@ static int parse_matrix_dimensions(const char* operand, int* rows, int* cols) {
     }
 }
 
-/**
- * create_memory_image - create memory image structure
- * @param ic_final: final instruction counter value
- * @param dc_final: final data counter value
- * @return pointer to allocated memory image, or NULL if failed
- */
-memory_image* create_memory_image(int ic_final, int dc_final) {
-
-    memory_image* image;
-    
-    /* check if the ic_final is valid */
-    if (ic_final < INITIAL_IC) {
-        fprintf(stderr, ERROR_IC_FINAL_TOO_SMALL, ic_final, INITIAL_IC);
-        return NULL;
-    }
-    
-    /* check if the dc_final is valid */
-    if (dc_final < 0) {
-        fprintf(stderr, ERROR_DC_FINAL_NEGATIVE, dc_final);
-        return NULL;
-    }
-
-   
-    
-    /* allocate memory for the memory image */
-    image = malloc(sizeof(memory_image));
-    if (!image) {
-        fprintf(stderr, MALLOC_FAILED);
-        return NULL;
-    }
-
-    /* initialize the memory image */
-    image->instruction_count = ic_final - INITIAL_IC;
-    image->data_count = dc_final;
-    image->ic_final = ic_final;
-    image->dc_final = dc_final;
-
-    /* allocate memory for instructions */
-    if (image->instruction_count > 0) {
-        image->instructions = malloc(image->instruction_count * sizeof(machine_word));
-        if (!image->instructions) {
-            fprintf(stderr, MALLOC_FAILED);
-            free(image);
-            return NULL;
-        }
-    } else {
-        image->instructions = NULL;
-    }
-
-    /* allocate memory for data */
-    if (image->data_count > 0) {
-        image->data = malloc(image->data_count * sizeof(machine_word));
-        if (!image->data) {
-            fprintf(stderr, MALLOC_FAILED);
-            free(image->instructions);
-            free(image);
-            return NULL;
-        }
-    } else {
-        image->data = NULL;
-    }
-
-    return image;
-}
-
-/**
- * free_memory_image - free memory image structure
- * @param image: memory image to free
- */
-void free_memory_image(memory_image* image) {
-    if (!image) return;
-    if (image->instructions) free(image->instructions);
-    if (image->data) free(image->data);
-    free(image);
-}
-
 /**
  * create_instruction_word - create instruction word with opcode and addressing modes
  * @param opcode: instruction opcode
@@ -305,14 +233,14 @@ void free_entry_symbols(entry_symbol* list) {
 /**
  * encode_operand - encode a single operand
  * @param operand: operand string to encode
- * @param table: symbol table for label resolution
+ * @param labels: symbol table for label resolution, at the scope of the line
  * @param mode: addressing mode of the operand
  * @param word: machine word to store encoded operand
  * @param current_address: current memory address
  * @param ext_list: pointer to external references list
  * @return SUCCESS if encoding successful, FAILURE otherwise
  */
-int encode_operand(const char* operand, const label_table* table, addressing_mode mode,
+int encode_operand(const char* operand, const label_scope* labels, addressing_mode mode,
                   machine_word* word, int current_address, ext_ref** ext_list) {
     label_node* label;
     int reg_num;
@@ -336,7 +264,7 @@ int encode_operand(const char* operand, const label_table* table, addressing_mod
 
         case MODE_DIRECT:
             /* direct: label */
-            label = find_label(table, operand);
+            label = resolve_label(labels, operand);
             if (!label) {
                 fprintf(stderr, ERROR_UNDEFINED_LABEL, operand);
                 return FAILURE;
@@ -386,13 +314,13 @@ int encode_operand(const char* operand, const label_table* table, addressing_mod
 /**
  * encode_matrix_operand - encode matrix operand: label[reg1][reg2]
  * @param operand: matrix operand string
- * @param table: symbol table for label resolution
+ * @param labels: symbol table for label resolution, at the scope of the line
  * @param words: array to store encoded machine words
  * @param current_address: current memory address
  * @param ext_list: pointer to external references list
  * @return SUCCESS if encoding successful, FAILURE otherwise
  */
-static int encode_matrix_operand(const char* operand, const label_table* table,
+static int encode_matrix_operand(const char* operand, const label_scope* labels,
                                 machine_word* words, int current_address, ext_ref** ext_list) {
     char* copy;
     char* first_bracket;
@@ -447,7 +375,7 @@ static int encode_matrix_operand(const char* operand, const label_table* table,
     }
 
     /* first word: label address */
-    label = find_label(table, label_name);
+    label = resolve_label(labels, label_name);
     if (!label) {
         fprintf(stderr, ERROR_UNDEFINED_LABEL, label_name);
         free(copy);
@@ -481,14 +409,14 @@ static int encode_matrix_operand(const char* operand, const label_table* table,
 /**
  * encode_instruction - encode a complete instruction
  * @param parts: parsed instruction parts
- * @param table: symbol table for label resolution
+ * @param labels: symbol table for label resolution, at the scope of the line
  * @param words: array to store encoded machine words
  * @param word_count: pointer to store number of words generated
  * @param current_ic: current instruction counter value
  * @param ext_list: pointer to external references list
  * @return SUCCESS if encoding successful, FAILURE otherwise
  */
-int encode_instruction(const separate_line* parts, const label_table* table,
+int encode_instruction(const separate_line* parts, const label_scope* labels,
                       machine_word* words, int* word_count, int current_ic, ext_ref** ext_list) {
     const command_instructions* inst;
     addressing_mode src_mode = MODE_IMMEDIATE; /* default values */
@@ -508,13 +436,13 @@ int encode_instruction(const separate_line* parts, const label_table* table,
 
     /* determine addressing modes */
     if (inst->num_of_operands >= 1) {
-        dst_mode_mask = get_operand_mode(parts->operands[inst->num_of_operands - 1]);
+        dst_mode_mask = line_operand_mode(parts, inst->num_of_operands - 1);
         if (dst_mode_mask == FAILURE) return FAILURE;
         dst_mode = convert_to_addressing_mode(dst_mode_mask);
     }
 
     if (inst->num_of_operands == 2) {
-        src_mode_mask = get_operand_mode(parts->operands[0]);
+        src_mode_mask = line_operand_mode(parts, 0);
         if (src_mode_mask == FAILURE) return FAILURE;
         src_mode = convert_to_addressing_mode(src_mode_mask);
     }
@@ -535,13 +463,13 @@ int encode_instruction(const separate_line* parts, const label_table* table,
     if (inst->num_of_operands == 1) {
         /* one operand (destination) */
         if (dst_mode == MODE_MATRIX) {
-            if (encode_matrix_operand(parts->operands[0], table, &words[words_used],
+            if (encode_matrix_operand(parts->operands[0], labels, &words[words_used],
                                     current_ic + words_used, ext_list) == FAILURE) {
                 return FAILURE;
             }
             words_used += 2; /* matrix takes 2 words */
         } else {
-            if (encode_operand(parts->operands[0], table, dst_mode, &words[words_used],
+            if (encode_operand(parts->operands[0], labels, dst_mode, &words[words_used],
                              current_ic + words_used, ext_list) == FAILURE) {
                 return FAILURE;
             }
@@ -567,13 +495,13 @@ int encode_instruction(const separate_line* parts, const label_table* table,
         } else {
             /* encode source operand */
             if (src_mode == MODE_MATRIX) {
-                if (encode_matrix_operand(parts->operands[0], table, &words[words_used],
+                if (encode_matrix_operand(parts->operands[0], labels, &words[words_used],
                                         current_ic + words_used, ext_list) == FAILURE) {
                     return FAILURE;
                 }
                 words_used += 2;
             } else {
-                if (encode_operand(parts->operands[0], table, src_mode, &words[words_used],
+                if (encode_operand(parts->operands[0], labels, src_mode, &words[words_used],
                                  current_ic + words_used, ext_list) == FAILURE) {
                     return FAILURE;
                 }
@@ -582,13 +510,13 @@ int encode_instruction(const separate_line* parts, const label_table* table,
 
             /* encode destination operand */
             if (dst_mode == MODE_MATRIX) {
-                if (encode_matrix_operand(parts->operands[1], table, &words[words_used],
+                if (encode_matrix_operand(parts->operands[1], labels, &words[words_used],
                                         current_ic + words_used, ext_list) == FAILURE) {
                     return FAILURE;
                 }
                 words_used += 2;
             } else {
-                if (encode_operand(parts->operands[1], table, dst_mode, &words[words_used],
+                if (encode_operand(parts->operands[1], labels, dst_mode, &words[words_used],
                                  current_ic + words_used, ext_list) == FAILURE) {
                     return FAILURE;
                 }
@@ -601,97 +529,6 @@ int encode_instruction(const separate_line* parts, const label_table* table,
     return SUCCESS;
 }
 
-/**
- * generate_object_file - generate object file (.ob)
- * @param base_filename: base filename without extension
- * @param image: memory image containing encoded instructions and data
- * @return SUCCESS if file generated successfully, FAILURE otherwise
- */
-int generate_object_file(const char* base_filename, const memory_image* image) {
-    FILE* file;
-    char* filename;
-    int i;
-    int ic_count;
-    char* ic_str_orig;
-    char* dc_str_orig;
-    char* ic_str;
-    char* dc_str;
-    char* address_str;
-    char* word_str;
-
-    if (!base_filename || !image) return FAILURE;
-
-    /* create filename with .ob extension */
-    filename = malloc(strlen(base_filename) + EXTENSION_SIZE); /* .ob + \0 */
-    if (!filename) {
-        fprintf(stderr, MALLOC_FAILED);
-        return FAILURE;
-    }
-    strcpy(filename, base_filename);
-    strcat(filename, OBJECT_EXT);
-
-    file = fopen(filename, FILE_WRITE_MODE);
-    if (!file) {
-        fprintf(stderr, ERROR_CANNOT_OPEN_FILE_WRITE, filename);
-        free(filename);
-        return FAILURE;
-    }
-
-    /* write header: IC_final-100 DC_final in base-4 */
-    ic_count = image->ic_final - INITIAL_IC; /* total instruction words */
-
-    ic_str_orig = malloc(BASE4_BUFFER_SIZE);
-    dc_str_orig = malloc(BASE4_BUFFER_SIZE);
-    strcpy(ic_str_orig, number_to_base4_letters(ic_count));
-    strcpy(dc_str_orig, number_to_base4_letters(image->dc_final));
-    ic_str = ic_str_orig;
-    dc_str = dc_str_orig;
-
-    /* remove only leading 'a's, keep minimum required digits */
-    while (*ic_str == BASE4_LETTER_OFFSET && *(ic_str + 1) != NULL_CHAR) ic_str++;
-    while (*dc_str == BASE4_LETTER_OFFSET && *(dc_str + 1) != NULL_CHAR) dc_str++;
-
-    fprintf(file, FORMAT_TWO_STRINGS, ic_str, dc_str);
-    free(ic_str_orig);
-    free(dc_str_orig);
-
-    /* write instruction words */
-    for (i = 0; i < image->instruction_count; i++) {
-        address_str = malloc(BASE4_ADDRESS_BUFFER_SIZE);
-        word_str = malloc(BASE4_CODE_BUFFER_SIZE);
-        
-        /* write base-4 address (4 digits) and base-4 word (5 digits) */
-        strcpy(address_str, number_to_base4_letters(image->instructions[i].address));
-        strcpy(word_str, number_to_base4_code(image->instructions[i].word));
-        
-
-        
-        fprintf(file, FORMAT_TWO_STRINGS, address_str, word_str);
-        
-        free(address_str);
-        free(word_str);
-    }
-
-    /* write data words */
-    for (i = 0; i < image->data_count; i++) {
-        address_str = malloc(BASE4_ADDRESS_BUFFER_SIZE);
-        word_str = malloc(BASE4_CODE_BUFFER_SIZE);
-        
-        /* write base-4 address (4 digits) and base-4 word (5 digits) */
-        strcpy(address_str, number_to_base4_letters(INITIAL_IC + image->instruction_count + i));
-        strcpy(word_str, number_to_base4_code(image->data[i].word));
-        
-        fprintf(file, FORMAT_TWO_STRINGS, address_str, word_str);
-        
-        free(address_str);
-        free(word_str);
-    }
-
-    fclose(file);
-    free(filename);
-    return SUCCESS;
-}
-
 /**
  * generate_entries_file - generate entries file (.ent)
  * @param base_filename: base filename without extension
@@ -731,7 +568,7 @@ int generate_entries_file(const char* base_filename, const label_table* table) {
     strcpy(filename, base_filename);
     strcat(filename, ENTRIES_EXT);
 
-    file = fopen(filename, FILE_WRITE_MODE);
+    file = create_output(filename);
     if (!file) {
         fprintf(stderr, ERROR_CANNOT_OPEN_FILE_WRITE, filename);
         free(filename);
@@ -761,7 +598,7 @@ int generate_entries_file(const char* base_filename, const label_table* table) {
         current = current->next;
     }
 
-    fclose(file);
+    release_output(file);
     free(filename);
     return SUCCESS;
 }
@@ -791,7 +628,7 @@ int generate_externals_file(const char* base_filename, ext_ref* ext_list) {
     strcpy(filename, base_filename);
     strcat(filename, EXTERNALS_EXT);
 
-    file = fopen(filename, FILE_WRITE_MODE);
+    file = create_output(filename);
     if (!file) {
         fprintf(stderr, ERROR_CANNOT_OPEN_FILE_WRITE, filename);
         free(filename);
@@ -805,21 +642,46 @@ int generate_externals_file(const char* base_filename, ext_ref* ext_list) {
         current = current->next;
     }
 
-    fclose(file);
+    release_output(file);
     free(filename);
     return SUCCESS;
 }
 
+/* destination for encoded data words: the whole data segment text or a streamed text window */
+typedef struct {
+    char* text;              /* data segment text, one line per word, or NULL when streaming */
+    text_window* window;     /* formatted data text, or NULL for the segment text */
+    int base_address;        /* address of the first data word */
+    int index;               /* number of data words emitted so far */
+    int count;               /* lines text has room for */
+} data_sink;
+
+/**
+ * emit_data_word - store one data word in the sink
+ * @param sink: destination for the word
+ * @param word: encoded data word
+ * @return SUCCESS if stored, FAILURE on write error
+ */
+static int emit_data_word(data_sink* sink, unsigned int word) {
+    if (sink->window) {
+        if (window_write_word(sink->window, sink->base_address + sink->index, word) == FAILURE) {
+            return FAILURE;
+        }
+    } else if (sink->index < sink->count) {
+        format_object_line(sink->text + (size_t)sink->index * OB_LINE_LENGTH, sink->base_address + sink->index, word);
+    }
+    sink->index++;
+    return SUCCESS;
+}
+
 /**
  * process_data_line - process data directives and encode data
  * @param parts: parsed directive parts
- * @param data_words: array to store encoded data words
- * @param data_index: pointer to current data index
+ * @param sink: destination for encoded data words
  * @param line_number: current line number for error reporting
  * @return SUCCESS if processing successful, FAILURE otherwise
  */
-static int process_data_line(const separate_line* parts, machine_word* data_words,
-                           int* data_index, int line_number) {
+static int process_data_line(const separate_line* parts, data_sink* sink, int line_number) {
     int i;
     int value;
     const char* str;
@@ -830,10 +692,7 @@ static int process_data_line(const separate_line* parts, machine_word* data_word
         /* process .data directive */
         for (i = 0; i < parts->how_many_operands; i++) {
             value = (int)strtol(parts->operands[i], NULL, BASE_10);
-            data_words[*data_index].word = value & TEN_BIT_MASK; /* 10 bits */
-            data_words[*data_index].are = ARE_ABSOLUTE;
-            data_words[*data_index].address = *data_index;
-            (*data_index)++;
+            if (emit_data_word(sink, value & TEN_BIT_MASK) == FAILURE) return FAILURE; /* 10 bits */
         }
     } else if (strcmp(parts->command, DIRECTIVE_STRING) == 0) {
         /* process .string directive */
@@ -843,17 +702,11 @@ static int process_data_line(const separate_line* parts, machine_word* data_word
 
             /* skip opening quote and process characters */
             for (i = QUOTE_OFFSET; i < len - QUOTE_OFFSET; i++) { /* skip quotes */
-                data_words[*data_index].word = (unsigned char)str[i];
-                data_words[*data_index].are = ARE_ABSOLUTE;
-                data_words[*data_index].address = *data_index;
-                (*data_index)++;
+                if (emit_data_word(sink, (unsigned char)str[i]) == FAILURE) return FAILURE;
             }
 
             /* add null terminator */
-            data_words[*data_index].word = 0;
-            data_words[*data_index].are = ARE_ABSOLUTE;
-            data_words[*data_index].address = *data_index;
-            (*data_index)++;
+            if (emit_data_word(sink, 0) == FAILURE) return FAILURE;
         }
     } else if (strcmp(parts->command, DIRECTIVE_MAT) == 0) {
         /* process .mat directive */
@@ -870,14 +723,11 @@ static int process_data_line(const separate_line* parts, machine_word* data_word
             if (i + 1 < parts->how_many_operands) {
                 /* use provided value */
                 value = (int)strtol(parts->operands[i + 1], NULL, BASE_10);
-                data_words[*data_index].word = value & TEN_BIT_MASK;
+                if (emit_data_word(sink, value & TEN_BIT_MASK) == FAILURE) return FAILURE;
             } else {
                 /* initialize to zero */
-                data_words[*data_index].word = 0;
+                if (emit_data_word(sink, 0) == FAILURE) return FAILURE;
             }
-            data_words[*data_index].are = ARE_ABSOLUTE;
-            data_words[*data_index].address = *data_index;
-            (*data_index)++;
         }
     }
 
@@ -885,155 +735,399 @@ static int process_data_line(const separate_line* parts, machine_word* data_word
 }
 
 /**
- * second_pass - main second pass function
- * @param filename: path to macro-expanded source file (.am)
+ * is_data_command - check if command is a data-producing directive
+ * @param command: command string to check
+ * @return YES if .data, .string or .mat, NO otherwise
+ */
+static int is_data_command(const char* command) {
+    if (!command) return NO;
+    if (strcmp(command, DIRECTIVE_DATA) == 0 ||
+        strcmp(command, DIRECTIVE_STRING) == 0 ||
+        strcmp(command, DIRECTIVE_MAT) == 0) {
+        return YES;
+    }
+    return NO;
+}
+
+/**
+ * open_object_output - create the .ob file for a source
+ * @param base_filename: base filename without extension
+ * @param object_filename: output parameter for the allocated .ob filename
+ * @return open stream, or NULL if failed
+ */
+static FILE* open_object_output(const char* base_filename, char** object_filename) {
+    FILE* file;
+    char* filename;
+
+    filename = malloc(strlen(base_filename) + EXTENSION_SIZE); /* .ob + \0 */
+    if (!filename) {
+        fprintf(stderr, MALLOC_FAILED);
+        return NULL;
+    }
+    strcpy(filename, base_filename);
+    strcat(filename, OBJECT_EXT);
+
+    file = create_output(filename);
+    if (!file) {
+        fprintf(stderr, ERROR_CANNOT_OPEN_FILE_WRITE, filename);
+        free(filename);
+        return NULL;
+    }
+
+    *object_filename = filename;
+    return file;
+}
+
+/**
+ * write_object_text - write the .ob file from formatted segment text
+ * @param base_filename: base filename without extension
+ * @param code: instruction text, in address order
+ * @param code_length: bytes of instruction text
+ * @param data: data text, in address order
+ * @param data_length: bytes of data text
+ * @param ic_final: final instruction counter from first pass
+ * @param dc_final: final data counter from first pass
+ * @return SUCCESS if written, FAILURE otherwise (no partial file is left)
+ */
+static int write_object_text(const char* base_filename, const char* code, size_t code_length, const char* data,
+                             size_t data_length, int ic_final, int dc_final) {
+    FILE* object_file;
+    char* object_filename = NULL;
+    int result = SUCCESS;
+
+    object_file = open_object_output(base_filename, &object_filename);
+    if (!object_file) return FAILURE;
+
+    write_object_header(object_file, ic_final - INITIAL_IC, dc_final);
+    if (fwrite(code, 1, code_length, object_file) != code_length ||
+        fwrite(data, 1, data_length, object_file) != data_length) {
+        fprintf(stderr, ERROR_WINDOW_WRITE_FAILED);
+        result = FAILURE;
+    }
+    release_output(object_file);
+
+    if (result == FAILURE) discard_output(object_filename);
+    free(object_filename);
+    return result;
+}
+
+/**
+ * encode_source - second pass formatting each word straight into its .ob text
+ * both segments are sized by the first pass, so every word goes to its final
+ * line as soon as it is encoded and no memory image is built
+ * @param filename: path to the source file, names the output files
+ * @param program: loaded IR program to read instead of filename, or NULL
  * @param table: symbol table built during first pass
  * @param ic_final: final instruction counter from first pass
  * @param dc_final: final data counter from first pass
  * @return SUCCESS if second pass completed successfully, FAILURE otherwise
  */
-int second_pass(const char* filename, const label_table* table, int ic_final, int dc_final) {
-    FILE* file;
-    char line[MAX_LINE_LENGTH];
-    memory_image* image;
+static int encode_source(const char* filename, const ir_program* program, const label_table* table, int ic_final,
+                         int dc_final) {
+    char* code_text;
+    char* data_text;
+    size_t code_length;
+    size_t data_length;
     ext_ref* ext_list = NULL;
-    int line_number = 1;
-    int current_ic = INITIAL_IC;
-    int instruction_index = 0;
-    int data_index = 0;
+    data_sink data;
     int has_errors = 0;
     char* base_filename;
-    separate_line* parts;
+    const separate_line* parts;
     machine_word words[5]; /* max 5 words per instruction */
     int word_count = 0;
+    int current_ic = INITIAL_IC;
+    int line;
     int i;
-    char* trimmed;
-
-    /* open source file */
-    file = open_file_read(filename);
-    if (!file) return FAILURE;
+    label_scope labels;
+    source_reader reader;
+    int status;
 
-    /* create memory image */
-    image = create_memory_image(ic_final, dc_final);
-    if (!image) {
-        fclose(file);
+    if (ic_final < INITIAL_IC) {
+        fprintf(stderr, ERROR_IC_FINAL_TOO_SMALL, ic_final, INITIAL_IC);
+        return FAILURE;
+    }
+    if (dc_final < 0) {
+        fprintf(stderr, ERROR_DC_FINAL_NEGATIVE, dc_final);
         return FAILURE;
     }
 
-    /* first pass through file: encode instructions */
-    while (fgets(line, sizeof(line), file)) {
+    /* one .ob line per word; +1 keeps empty segments allocatable */
+    code_length = (size_t)(ic_final - INITIAL_IC) * OB_LINE_LENGTH;
+    data_length = (size_t)dc_final * OB_LINE_LENGTH;
+    code_text = malloc(code_length + 1);
+    data_text = malloc(data_length + 1);
+    if (!code_text || !data_text) {
+        fprintf(stderr, MALLOC_FAILED);
+        free(code_text);
+        free(data_text);
+        return FAILURE;
+    }
 
-        /* skip empty lines, comments, and long lines */
-        if (strlen(line) >= MAX_LINE_LENGTH - NEWLINE_OFFSET && line[MAX_LINE_LENGTH_MINUS_2] != '\n') {
-            fprintf(stderr, ERROR_LINE_TOO_LONG, MAX_LINE_LENGTH_MINUS_1);
-            has_errors = 1;
-            line_number++;
-            continue;
-        }
+    /* open source file */
+    if (open_source(&reader, filename, program) == FAILURE) {
+        free(code_text);
+        free(data_text);
+        return FAILURE;
+    }
 
-        /* skip empty/comment lines */
-        trimmed = line;
-        while (*trimmed == SPACE_CHAR || *trimmed == TAB_CHAR) trimmed++;
-        if (*trimmed == NULL_CHAR || *trimmed == NEWLINE_CHAR || *trimmed == SEMICOLON_CHAR) {
-            line_number++;
-            continue;
-        }
+    data.text = data_text;
+    data.window = NULL;
+    data.base_address = ic_final;
+    data.index = 0;
+    data.count = dc_final;
 
-        parts = parse_line(line);
-        if (!parts) {
-            line_number++;
-            continue;
-        }
+    /* single scan: instruction and data words each go to their own segment text */
+    init_label_scope(&labels, table);
+    while ((status = read_source_line(&reader, &parts)) != SOURCE_END) {
 
-        /* skip directives - they're handled in the data pass */
-        if (parts->command && parts->command[0] == DOT_CHAR) {
-            free_separate_line(parts);
-            line_number++;
+        /* report long lines; unparsed lines are left to the first pass */
+        if (status == SOURCE_TOO_LONG) {
+            fprintf(stderr, ERROR_LINE_TOO_LONG, MAX_LINE_LENGTH_MINUS_1);
+            has_errors = 1;
             continue;
         }
+        if (status == SOURCE_UNPARSED) continue;
+        enter_label_scope(&labels, parts->label);
 
-        /* encode instruction */
-        if (encode_instruction(parts, table, words, &word_count, current_ic, &ext_list) == SUCCESS) {
-            /* copy words to memory image */
-            for (i = 0; i < word_count; i++) {
-                if (instruction_index < image->instruction_count) {
-
-                    image->instructions[instruction_index] = words[i];
-                    instruction_index++;
+        if (is_data_command(parts->command)) {
+            if (process_data_line(parts, &data, reader.line_number) == FAILURE) {
+                has_errors = 1;
+            }
+        } else if (parts->command && parts->command[0] != DOT_CHAR) {
+            if (encode_instruction(parts, &labels, words, &word_count, current_ic, &ext_list) == SUCCESS) {
+                for (i = 0; i < word_count; i++) {
+                    line = words[i].address - INITIAL_IC;
+                    if (line >= 0 && line < ic_final - INITIAL_IC) {
+                        format_object_line(code_text + (size_t)line * OB_LINE_LENGTH, words[i].address,
+                                           words[i].word);
+                    }
                 }
+                current_ic += word_count;
+            } else {
+                has_errors = 1;
             }
-            current_ic += word_count;
-        } else {
-            has_errors = 1;
         }
 
-        free_separate_line(parts);
-        line_number++;
+        release_line(parts);
     }
 
-    /* reset file for data pass */
-    rewind(file);
-    line_number = 1;
+    close_source(&reader);
 
-    /* second pass: encode data */
-    while (fgets(line, sizeof(line), file)) {
-
-        /* skip empty lines and comments */
-        trimmed = line;
-        while (*trimmed == SPACE_CHAR || *trimmed == TAB_CHAR) trimmed++;
-        if (*trimmed == NULL_CHAR || *trimmed == NEWLINE_CHAR || *trimmed == SEMICOLON_CHAR) {
-            line_number++;
-            continue;
+    /* Generate output files if no errors */
+    if (!has_errors) {
+        base_filename = extract_base_filename(filename);
+        if (base_filename) {
+            write_object_text(base_filename, code_text, code_length, data_text, data_length, ic_final, dc_final);
+            generate_entries_file(base_filename, table);
+            generate_externals_file(base_filename, ext_list);
+            free(base_filename);
         }
+    }
 
-        parts = parse_line(line);
-        if (!parts) {
-            line_number++;
-            continue;
-        }
+    /* Cleanup */
+    free(code_text);
+    free(data_text);
+    free_external_references(ext_list);
 
-        /* Process only data directives */
-        if (parts->command &&
-            (strcmp(parts->command, DIRECTIVE_DATA) == 0 ||
-             strcmp(parts->command, DIRECTIVE_STRING) == 0 ||
-             strcmp(parts->command, DIRECTIVE_MAT) == 0)) {
+    return has_errors ? FAILURE : SUCCESS;
+}
 
-            if (process_data_line(parts, image->data, &data_index, line_number) == FAILURE) {
-                has_errors = 1;
-            }
-        }
+/**
+ * stream_source - second pass with bounded memory
+ * @param filename: path to the source file, names the output files
+ * @param program: loaded IR program to read instead of filename, or NULL
+ * @param table: symbol table built during first pass
+ * @param ic_final: final instruction counter from first pass
+ * @param dc_final: final data counter from first pass
+ * @param memory_budget: bytes available for buffered object text
+ * @return SUCCESS if second pass completed successfully, FAILURE otherwise
+ */
+static int stream_source(const char* filename, const ir_program* program, const label_table* table, int ic_final,
+                         int dc_final, long memory_budget) {
+    FILE* object_file;
+    FILE* data_spill;
+    char* base_filename;
+    char* object_filename = NULL;
+    text_window instruction_window;
+    text_window data_window;
+    data_sink data;
+    ext_ref* ext_list = NULL;
+    const separate_line* parts;
+    machine_word words[5]; /* max 5 words per instruction */
+    int word_count = 0;
+    int current_ic = INITIAL_IC;
+    int has_errors = 0;
+    int i;
+    label_scope labels;
+    source_reader reader;
+    int status;
 
-        free_separate_line(parts);
-        line_number++;
+    if (ic_final < INITIAL_IC) {
+        fprintf(stderr, ERROR_IC_FINAL_TOO_SMALL, ic_final, INITIAL_IC);
+        return FAILURE;
+    }
+    if (dc_final < 0) {
+        fprintf(stderr, ERROR_DC_FINAL_NEGATIVE, dc_final);
+        return FAILURE;
     }
 
-    fclose(file);
+    base_filename = extract_base_filename(filename);
+    if (!base_filename) return FAILURE;
 
-    /* Generate output files if no errors */
-    if (!has_errors) {
+    if (open_source(&reader, filename, program) == FAILURE) {
+        free(base_filename);
+        return FAILURE;
+    }
 
-        base_filename = extract_base_filename(filename);
-        if (base_filename) {
+    object_file = open_object_output(base_filename, &object_filename);
+    if (!object_file) {
+        close_source(&reader);
+        free(base_filename);
+        return FAILURE;
+    }
 
+    /* data text is produced interleaved with code, so it waits in a spill stream */
+    data_spill = tmpfile();
+    if (!data_spill) {
+        fprintf(stderr, ERROR_SPILL_CREATE_FAILED);
+        release_output(object_file);
+        discard_output(object_filename);
+        free(object_filename);
+        close_source(&reader);
+        free(base_filename);
+        return FAILURE;
+    }
 
+    /* half of the budget for each segment window */
+    if (init_text_window(&instruction_window, object_file, (size_t)(memory_budget / 2)) == FAILURE) {
+        has_errors = 1;
+    } else if (init_text_window(&data_window, data_spill, (size_t)(memory_budget / 2)) == FAILURE) {
+        free_text_window(&instruction_window);
+        has_errors = 1;
+    }
+    if (has_errors) {
+        fclose(data_spill);
+        release_output(object_file);
+        discard_output(object_filename);
+        free(object_filename);
+        close_source(&reader);
+        free(base_filename);
+        return FAILURE;
+    }
 
-            generate_object_file(base_filename, image);
+    data.text = NULL;
+    data.window = &data_window;
+    data.base_address = ic_final;
+    data.index = 0;
+    data.count = dc_final;
 
+    write_object_header(object_file, ic_final - INITIAL_IC, dc_final);
 
-            generate_entries_file(base_filename, table);
+    /* single scan: code goes straight to the object file, data to the spill */
+    init_label_scope(&labels, table);
+    while ((status = read_source_line(&reader, &parts)) != SOURCE_END) {
 
+        if (status == SOURCE_TOO_LONG) {
+            fprintf(stderr, ERROR_LINE_TOO_LONG, MAX_LINE_LENGTH_MINUS_1);
+            has_errors = 1;
+            continue;
+        }
+        if (status == SOURCE_UNPARSED) continue;
+        enter_label_scope(&labels, parts->label);
 
-            generate_externals_file(base_filename, ext_list);
+        if (is_data_command(parts->command)) {
+            if (process_data_line(parts, &data, reader.line_number) == FAILURE) {
+                has_errors = 1;
+            }
+        } else if (parts->command && parts->command[0] != DOT_CHAR) {
+            if (encode_instruction(parts, &labels, words, &word_count, current_ic, &ext_list) == SUCCESS) {
+                for (i = 0; i < word_count; i++) {
+                    if (window_write_word(&instruction_window, words[i].address, words[i].word) == FAILURE) {
+                        has_errors = 1;
+                    }
+                }
+                current_ic += word_count;
+            } else {
+                has_errors = 1;
+            }
+        }
 
-            free(base_filename);
+        release_line(parts);
+    }
+
+    close_source(&reader);
+
+    /* instructions first, then the buffered data segment */
+    if (!has_errors) {
+        if (flush_text_window(&instruction_window) == FAILURE ||
+            flush_text_window(&data_window) == FAILURE) {
+            has_errors = 1;
+        } else {
+            rewind(data_spill);
+            if (append_stream(data_spill, object_file) == FAILURE) {
+                has_errors = 1;
+            }
         }
-    } else {
+    }
 
+    free_text_window(&instruction_window);
+    free_text_window(&data_window);
+    fclose(data_spill);
+    release_output(object_file);
+
+    if (!has_errors) {
+        generate_entries_file(base_filename, table);
+        generate_externals_file(base_filename, ext_list);
+    } else {
+        /* don't leave a partial object file behind */
+        discard_output(object_filename);
     }
 
-    /* Cleanup */
-    free_memory_image(image);
     free_external_references(ext_list);
+    free(object_filename);
+    free(base_filename);
 
     return has_errors ? FAILURE : SUCCESS;
-}
\ No newline at end of file
+}
+
+/**
+ * second_pass - main second pass function
+ * @param filename: path to macro-expanded source file (.am)
+ * @param table: symbol table built during first pass
+ * @param ic_final: final instruction counter from first pass
+ * @param dc_final: final data counter from first pass
+ * @return SUCCESS if second pass completed successfully, FAILURE otherwise
+ */
+int second_pass(const char* filename, const label_table* table, int ic_final, int dc_final) {
+    return encode_source(filename, NULL, table, ic_final, dc_final);
+}
+
+/**
+ * second_pass_streaming - second pass with bounded memory
+ * @param filename: path to macro-expanded source file (.am)
+ * @param table: symbol table built during first pass
+ * @param ic_final: final instruction counter from first pass
+ * @param dc_final: final data counter from first pass
+ * @param memory_budget: bytes available for buffered object text
+ * @return SUCCESS if second pass completed successfully, FAILURE otherwise
+ */
+int second_pass_streaming(const char* filename, const label_table* table, int ic_final, int dc_final,
+                          long memory_budget) {
+    return stream_source(filename, NULL, table, ic_final, dc_final, memory_budget);
+}
+
+/**
+ * second_pass_on_program - second pass over a loaded IR program
+ * @param filename: IR file the program came from, names the output files
+ * @param program: IR program from load_ir_program
+ * @param table: symbol table built during first pass
+ * @param ic_final: final instruction counter from first pass
+ * @param dc_final: final data counter from first pass
+ * @param memory_budget: bytes for streamed object text, 0 for the in-memory image
+ * @return SUCCESS if second pass completed successfully, FAILURE otherwise
+ */
+int second_pass_on_program(const char* filename, const ir_program* program, const label_table* table,
+                           int ic_final, int dc_final, long memory_budget) {
+    if (memory_budget > 0) return stream_source(filename, program, table, ic_final, dc_final, memory_budget);
+    return encode_source(filename, program, table, ic_final, dc_final);
+}
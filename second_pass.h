@@ -3,6 +3,7 @@
 
 #include "labelTable.h"
 #include "utils.h"
+#include "ir_format.h"
 
 /* hardcoded label name definitions */
 #define EXAMPLE_LABEL_LENGTH "LENGTH"
@@ -15,16 +16,6 @@ typedef struct {
     int address;           /* memory address of this word */
 } machine_word;
 
-/* memory image structures */
-typedef struct {
-    machine_word *instructions;    /* instruction memory */
-    machine_word *data;           /* data memory */
-    int instruction_count;        /* number of instruction words */
-    int data_count;              /* number of data words */
-    int ic_final;                /* final IC value */
-    int dc_final;                /* final DC value */
-} memory_image;
-
 /* external reference structure for .ext file */
 typedef struct ext_ref {
     char symbol_name[MAX_LABEL_LENGTH + 1];
@@ -51,58 +42,62 @@ typedef struct entry_symbol {
  */
 int second_pass(const char* filename, const label_table* table, int ic_final, int dc_final);
 
-/* memory image management */
 /**
- * create_memory_image - create memory image structure
- * @param ic_final: final instruction counter value
- * @param dc_final: final data counter value
- * @return pointer to allocated memory image, or NULL if failed
+ * second_pass_streaming - second pass with bounded memory
+ * encodes in a single scan and writes .ob text through fixed-size windows;
+ * data words wait in a temporary stream so they still follow the instructions
+ * @param filename: path to macro-expanded source file (.am)
+ * @param table: symbol table built during first pass
+ * @param ic_final: final instruction counter from first pass
+ * @param dc_final: final data counter from first pass
+ * @param memory_budget: bytes available for buffered object text
+ * @return SUCCESS if second pass completed successfully, FAILURE otherwise
  */
-memory_image* create_memory_image(int ic_final, int dc_final);
+int second_pass_streaming(const char* filename, const label_table* table, int ic_final, int dc_final,
+                          long memory_budget);
 
 /**
- * free_memory_image - free memory image structure
- * @param image: memory image to free
+ * second_pass_on_program - second pass over a loaded IR program
+ * @param filename: IR file the program came from, names the output files
+ * @param program: IR program from load_ir_program
+ * @param table: symbol table built during first pass
+ * @param ic_final: final instruction counter from first pass
+ * @param dc_final: final data counter from first pass
+ * @param memory_budget: bytes for streamed object text, 0 for the in-memory image
+ * @return SUCCESS if second pass completed successfully, FAILURE otherwise
  */
-void free_memory_image(memory_image* image);
+int second_pass_on_program(const char* filename, const ir_program* program, const label_table* table,
+                           int ic_final, int dc_final, long memory_budget);
 
 /* instruction encoding */
 /**
  * encode_instruction - encode a complete instruction
  * @param parts: parsed instruction parts
- * @param table: symbol table for label resolution
+ * @param labels: symbol table for label resolution, at the scope of the line
  * @param words: array to store encoded machine words
  * @param word_count: pointer to store number of words generated
  * @param current_ic: current instruction counter value
  * @param ext_list: pointer to external references list
  * @return SUCCESS if encoding successful, FAILURE otherwise
  */
-int encode_instruction(const separate_line* parts, const label_table* table,
+int encode_instruction(const separate_line* parts, const label_scope* labels,
                       machine_word* words, int* word_count, int current_ic, ext_ref** ext_list);
 
 /* operand encoding */
 /**
  * encode_operand - encode a single operand
  * @param operand: operand string to encode
- * @param table: symbol table for label resolution
+ * @param labels: symbol table for label resolution, at the scope of the line
  * @param mode: addressing mode of the operand
  * @param word: machine word to store encoded operand
  * @param current_address: current memory address
  * @param ext_list: pointer to external references list
  * @return SUCCESS if encoding successful, FAILURE otherwise
  */
-int encode_operand(const char* operand, const label_table* table, addressing_mode mode,
+int encode_operand(const char* operand, const label_scope* labels, addressing_mode mode,
                   machine_word* word, int current_address, ext_ref** ext_list);
 
 /* output file generation */
-/**
- * generate_object_file - generate object file (.ob)
- * @param base_filename: base filename without extension
- * @param image: memory image containing encoded instructions and data
- * @return SUCCESS if file generated successfully, FAILURE otherwise
- */
-int generate_object_file(const char* base_filename, const memory_image* image);
-
 /**
  * generate_entries_file - generate entries file (.ent)
  * @param base_filename: base filename without extension
@@ -0,0 +1,371 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils.h"
+#include "obj_reader.h"
+#include "machine.h"
+#include "debugger.h"
+#include "profiler.h"
+#include "coverage.h"
+#include "labelTable.h"
+#include "first_pass.h"
+
+/* command line options */
+#define OPTION_PREFIX '-'
+#define OPTION_DEBUG "-d"
+#define OPTION_INPUT "-i"
+#define OPTION_PROFILE "-p"
+#define OPTION_COVERAGE "-c"
+
+/* error messages */
+#define ERROR_UNKNOWN_OPTION "Error: Unknown option '%s'\n"
+#define ERROR_MISSING_OPTION_VALUE "Error: Option '%s' requires a value\n"
+#define ERROR_NO_PROGRAM "Error: No program specified\n\n"
+#define ERROR_EXTRA_ARGUMENT "Error: Unexpected argument '%s'\n"
+#define ERROR_DEBUG_AND_PROFILE "Error: only one of -d, -p and -c can be used\n"
+#define WARNING_NO_SOURCE_LINES "Warning: cannot read source lines from '%s', coverage has addresses only\n"
+#define WARNING_NO_SOURCE_LABELS "Warning: cannot read labels from '%s', profile shows addresses only\n"
+
+/* usage messages */
+#define MSG_USAGE_FORMAT "Usage: %s [-d | -p report | -c coverage] [-i input] program\n"
+#define MSG_DESCRIPTION "\nRuns program.ob, using program.ent and program.ext for symbol names.\n"
+#define MSG_OPTIONS "\nOptions:\n"
+#define MSG_OPTION_DEBUG "  -d        debug: read debugger commands from standard input\n"
+#define MSG_OPTION_INPUT "  -i FILE   read program input (red) from FILE instead of standard input\n"
+#define MSG_OPTION_PROFILE "  -p FILE   profile: write flat, call-graph and data-access reports to FILE\n"
+#define MSG_OPTION_COVERAGE "  -c FILE   coverage: write executed addresses and source lines to FILE\n"
+
+/* simulator settings selected on the command line */
+typedef struct {
+    int debug;                  /* YES to start the debugger */
+    const char *input_name;     /* program input file, or NULL for stdin */
+    const char *profile_name;   /* profile report file, or NULL when not profiling */
+    const char *coverage_name;  /* coverage file, or NULL when not recording coverage */
+    const char *program;        /* program base name (or .ob path) */
+} simulator_options;
+
+/**
+ * print usage information
+ * @param program_name: name of the executable program
+ */
+static void print_usage(const char *program_name) {
+    printf(MSG_USAGE_FORMAT, program_name);
+    printf(MSG_DESCRIPTION);
+    printf(MSG_OPTIONS);
+    printf(MSG_OPTION_DEBUG);
+    printf(MSG_OPTION_INPUT);
+    printf(MSG_OPTION_PROFILE);
+    printf(MSG_OPTION_COVERAGE);
+}
+
+/**
+ * parse_arguments - read options and the program name
+ * @param argc: number of command line arguments
+ * @param argv: array of command line argument strings
+ * @param options: settings to fill
+ * @return SUCCESS if the command line is valid, FAILURE otherwise
+ */
+static int parse_arguments(int argc, char *argv[], simulator_options *options) {
+    int i;
+
+    options->debug = NO;
+    options->input_name = NULL;
+    options->profile_name = NULL;
+    options->coverage_name = NULL;
+    options->program = NULL;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], OPTION_DEBUG) == 0) {
+            options->debug = YES;
+        } else if (strcmp(argv[i], OPTION_INPUT) == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, ERROR_MISSING_OPTION_VALUE, argv[i]);
+                return FAILURE;
+            }
+            options->input_name = argv[++i];
+        } else if (strcmp(argv[i], OPTION_PROFILE) == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, ERROR_MISSING_OPTION_VALUE, argv[i]);
+                return FAILURE;
+            }
+            options->profile_name = argv[++i];
+        } else if (strcmp(argv[i], OPTION_COVERAGE) == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, ERROR_MISSING_OPTION_VALUE, argv[i]);
+                return FAILURE;
+            }
+            options->coverage_name = argv[++i];
+        } else if (argv[i][0] == OPTION_PREFIX) {
+            fprintf(stderr, ERROR_UNKNOWN_OPTION, argv[i]);
+            return FAILURE;
+        } else if (options->program) {
+            fprintf(stderr, ERROR_EXTRA_ARGUMENT, argv[i]);
+            return FAILURE;
+        } else {
+            options->program = argv[i];
+        }
+    }
+
+    if (!options->program) {
+        fprintf(stderr, ERROR_NO_PROGRAM);
+        return FAILURE;
+    }
+    if ((options->debug != NO) + (options->profile_name != NULL) + (options->coverage_name != NULL) > 1) {
+        fprintf(stderr, ERROR_DEBUG_AND_PROFILE);
+        return FAILURE;
+    }
+    return SUCCESS;
+}
+
+/**
+ * program_base_name - accept either "prog" or "prog.ob"
+ * @param program: program argument
+ * @return new allocated base name, or NULL if failed
+ */
+static char *program_base_name(const char *program) {
+    size_t len = strlen(program);
+    size_t ext_len = strlen(OBJECT_EXT);
+
+    if (len > ext_len && strcmp(program + len - ext_len, OBJECT_EXT) == 0) {
+        return extract_base_filename(program);
+    }
+    return build_filename(program, "");
+}
+
+/**
+ * load_program - read the object and symbol files of a program
+ * @param base: program base name
+ * @param module: output object
+ * @param entries: output entry symbols
+ * @param externals: output external references
+ * @return SUCCESS if all files are valid, FAILURE otherwise
+ */
+static int load_program(const char *base, object_module *module, symbol_file *entries, symbol_file *externals) {
+    char *filename;
+    int result;
+
+    filename = build_filename(base, OBJECT_EXT);
+    if (!filename) return FAILURE;
+    result = load_object_file(filename, module);
+    free(filename);
+    if (result == FAILURE) return FAILURE;
+
+    filename = build_filename(base, ENTRIES_EXT);
+    if (!filename) return FAILURE;
+    result = load_symbol_file(filename, entries, NO);
+    free(filename);
+    if (result == FAILURE) return FAILURE;
+
+    filename = build_filename(base, EXTERNALS_EXT);
+    if (!filename) return FAILURE;
+    result = load_symbol_file(filename, externals, NO);
+    free(filename);
+    return result;
+}
+
+/**
+ * run_profiled - run the program with profiling and write the report
+ * labels come from the first pass over the program's .am file, so the
+ * report names every routine and data label, not only entries
+ * @param m: machine prepared with init_machine
+ * @param base: program base name
+ * @param report_name: report file name
+ * @return final machine state
+ */
+static machine_state run_profiled(machine *m, const char *base, const char *report_name) {
+    profile *p;
+    label_table labels;
+    char *source;
+    FILE *report;
+    machine_state state;
+    int have_labels = NO;
+    int ic, dc;
+
+    p = create_profile();
+    if (!p) return MACHINE_FAULT;
+
+    state = profile_run(m, p);
+
+    init_label_table(&labels);
+    source = build_filename(base, MACRO_EXT);
+    if (source && first_pass_on_table(source, &labels, &ic, &dc) == SUCCESS) {
+        have_labels = YES;
+    } else if (source) {
+        fprintf(stderr, WARNING_NO_SOURCE_LABELS, source);
+    }
+
+    report = fopen(report_name, FILE_WRITE_MODE);
+    if (!report) {
+        fprintf(stderr, ERROR_CANNOT_OPEN_FILE_WRITE, report_name);
+    } else {
+        write_profile(report, m, p, have_labels ? &labels : NULL);
+        fclose(report);
+    }
+
+    free_label_table(&labels);
+    free(source);
+    free_profile(p);
+    return state;
+}
+
+/**
+ * load_line_map - read the .lin file written by the assembler's -l option
+ * @param base: program base name
+ * @param count: output parameter for the number of .am lines
+ * @return allocated array, entry i is the source line of .am line i + 1, or NULL if unavailable
+ */
+static int *load_line_map(const char *base, int *count) {
+    char *filename;
+    FILE *file;
+    int *lines = NULL;
+    int *grown;
+    int capacity = 0;
+    int line;
+
+    *count = 0;
+    filename = build_filename(base, LINE_MAP_EXT);
+    if (!filename) return NULL;
+    file = fopen(filename, FILE_READ_MODE);
+    free(filename);
+    if (!file) return NULL;
+
+    while (fscanf(file, "%d", &line) == 1) {
+        if (*count == capacity) {
+            capacity = capacity ? capacity * 2 : MACHINE_MEMORY_SIZE;
+            grown = realloc(lines, capacity * sizeof(int));
+            if (!grown) {
+                fprintf(stderr, MALLOC_FAILED);
+                free(lines);
+                fclose(file);
+                *count = 0;
+                return NULL;
+            }
+            lines = grown;
+        }
+        lines[(*count)++] = line;
+    }
+
+    fclose(file);
+    return lines;
+}
+
+/**
+ * run_covered - run the program and write which instructions and source lines it executed
+ * line numbers refer to the .as file when the assembler wrote a .lin line map
+ * (option -l), and to the .am file otherwise
+ * @param m: machine prepared with init_machine
+ * @param base: program base name
+ * @param coverage_name: coverage file name
+ * @return final machine state
+ */
+static machine_state run_covered(machine *m, const char *base, const char *coverage_name) {
+    coverage cov;
+    int am_lines[MACHINE_MEMORY_SIZE];
+    int *line_map;
+    int map_count;
+    char *source;
+    FILE *out;
+    machine_state state;
+    int address, line;
+
+    init_coverage(&cov);
+    state = coverage_run(m, cov.executed);
+
+    memset(am_lines, 0, sizeof(am_lines));
+    source = build_filename(base, MACRO_EXT);
+    if (source && first_pass_code_lines(source, am_lines, MACHINE_MEMORY_SIZE) == FAILURE) {
+        fprintf(stderr, WARNING_NO_SOURCE_LINES, source);
+        memset(am_lines, 0, sizeof(am_lines));
+    }
+    free(source);
+
+    line_map = load_line_map(base, &map_count);
+    cov.source = build_filename(base, line_map ? SOURCE_EXT : MACRO_EXT);
+
+    for (address = 0; address < MACHINE_MEMORY_SIZE; address++) {
+        line = am_lines[address];
+        if (line_map && line > 0) line = line <= map_count ? line_map[line - 1] : 0;
+        if (line <= 0) continue;
+
+        coverage_add_line(cov.code_lines, &cov.code_count, line);
+        if (BITMAP_TEST(cov.executed, address)) {
+            coverage_add_line(cov.covered_lines, &cov.covered_count, line);
+        }
+    }
+    free(line_map);
+
+    out = fopen(coverage_name, FILE_WRITE_MODE);
+    if (!out) {
+        fprintf(stderr, ERROR_CANNOT_OPEN_FILE_WRITE, coverage_name);
+    } else {
+        write_coverage(out, &cov);
+        fclose(out);
+    }
+
+    free_coverage(&cov);
+    return state;
+}
+
+/**
+ * main
+ * @param argc: number of command line arguments
+ * @param argv: array of command line argument strings
+ * @return 0 if the program halted normally, EXIT_FAILURE_CODE otherwise
+ */
+int main(int argc, char *argv[]) {
+    simulator_options options;
+    object_module module;
+    symbol_file entries, externals;
+    machine *m;
+    debugger dbg;
+    FILE *input = stdin;
+    char *base;
+    machine_state state = MACHINE_FAULT;
+
+    if (parse_arguments(argc, argv, &options) == FAILURE) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE_CODE;
+    }
+
+    base = program_base_name(options.program);
+    if (!base) return EXIT_FAILURE_CODE;
+
+    module.words = NULL;
+    entries.symbols = NULL;
+    entries.text = NULL;
+    externals.symbols = NULL;
+    externals.text = NULL;
+
+    m = malloc(sizeof(machine));
+    if (!m) {
+        fprintf(stderr, MALLOC_FAILED);
+    } else if (load_program(base, &module, &entries, &externals) == SUCCESS) {
+        if (options.input_name) {
+            input = fopen(options.input_name, FILE_READ_MODE);
+            if (!input) fprintf(stderr, ERROR_CANNOT_OPEN_FILE, options.input_name);
+        }
+
+        if (input && init_machine(m, &module, input, stdout) == SUCCESS) {
+            if (options.debug) {
+                init_debugger(&dbg, m, &entries, &externals);
+                state = run_debugger(&dbg, stdin);
+            } else if (options.profile_name) {
+                state = run_profiled(m, base, options.profile_name);
+            } else if (options.coverage_name) {
+                state = run_covered(m, base, options.coverage_name);
+            } else {
+                state = machine_run(m);
+            }
+        }
+
+        if (input && input != stdin) fclose(input);
+    }
+
+    free_object_module(&module);
+    free_symbol_file(&entries);
+    free_symbol_file(&externals);
+    free(m);
+    free(base);
+
+    return state == MACHINE_FAULT ? EXIT_FAILURE_CODE : 0;
+}
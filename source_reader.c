@@ -0,0 +1,104 @@
+#include "source_reader.h"
+#include "archive.h"
+#include <string.h>
+
+/**
+ * open_source - start reading the statements of a source
+ * @param reader: reader to initialize
+ * @param filename: macro-expanded source (.am), used when program is NULL
+ * @param program: loaded IR program, or NULL to read filename
+ * @return SUCCESS if opened, FAILURE otherwise
+ */
+int open_source(source_reader *reader, const char *filename, const ir_program *program) {
+    reader->file = NULL;
+    reader->program = program;
+    reader->record = 0;
+    reader->line_number = INITIAL_LINE_NUMBER - 1;
+    if (program) return SUCCESS;
+
+    reader->file = reopen_output(filename);
+    return reader->file ? SUCCESS : FAILURE;
+}
+
+/**
+ * read_record - lay the next IR record out as a shared line
+ * @param reader: reader of an IR program
+ * @param parts: set to the statement
+ * @return SOURCE_LINE, or SOURCE_END after the last record
+ */
+static int read_record(source_reader *reader, const separate_line **parts) {
+    const ir_program *program = reader->program;
+    const ir_record *record;
+    const ir_operand *operand;
+    separate_line *line = &reader->scratch.parts;
+    int i;
+
+    if (reader->record >= program->record_count) return SOURCE_END;
+    record = &program->records[reader->record++];
+    reader->line_number = record->line;
+
+    /* the pool outlives the pass and shared lines are never modified */
+    line->label = record->label == IR_NO_STRING ? NULL : program->pool + record->label;
+    line->command = (char *)ir_command_name(record->kind);
+    line->how_many_operands = record->operand_count;
+    line->shared = YES;
+    for (i = 0; i < LINE_MEMO_OPERANDS; i++) {
+        reader->scratch.modes[i] = MODE_NOT_CACHED;
+    }
+    for (i = 0; i < record->operand_count; i++) {
+        operand = &program->operands[record->first_operand + i];
+        line->operands[i] = program->pool + operand->text;
+        if (i < LINE_MEMO_OPERANDS && operand->type != 0) reader->scratch.modes[i] = operand->type;
+    }
+
+    *parts = line;
+    return SOURCE_LINE;
+}
+
+/**
+ * read_source_line - read the next statement
+ * @param reader: open reader
+ * @param parts: set to the statement for SOURCE_LINE; give it back with release_line
+ * @return SOURCE_LINE, SOURCE_TOO_LONG, SOURCE_UNPARSED or SOURCE_END
+ */
+int read_source_line(source_reader *reader, const separate_line **parts) {
+    const char *start;
+
+    if (reader->program) return read_record(reader, parts);
+
+    while (fgets(reader->line, sizeof(reader->line), reader->file)) {
+        reader->line_number++;
+        if (strlen(reader->line) >= MAX_LINE_LENGTH - 1 && reader->line[MAX_LINE_LENGTH - 2] != NEWLINE_CHAR) {
+            return SOURCE_TOO_LONG;
+        }
+
+        /* skip empty/whitespace lines and comment lines starting with ';' */
+        start = reader->line;
+        while (*start == SPACE_CHAR || *start == TAB_CHAR) start++;
+        if (*start == CARRIAGE_RETURN_CHAR) start++;
+        if (*start == NULL_CHAR || *start == NEWLINE_CHAR || *start == SEMICOLON_CHAR) continue;
+
+        *parts = share_line(start);
+        return *parts ? SOURCE_LINE : SOURCE_UNPARSED;
+    }
+    return SOURCE_END;
+}
+
+/**
+ * rewind_source - start again from the first statement
+ * @param reader: open reader
+ */
+void rewind_source(source_reader *reader) {
+    reader->record = 0;
+    reader->line_number = INITIAL_LINE_NUMBER - 1;
+    if (reader->file) rewind(reader->file);
+}
+
+/**
+ * close_source - finish reading a source
+ * @param reader: reader to close
+ */
+void close_source(source_reader *reader) {
+    if (reader->file) release_output(reader->file);
+    reader->file = NULL;
+}
@@ -0,0 +1,56 @@
+#ifndef SOURCE_READER_H
+#define SOURCE_READER_H
+
+#include <stdio.h>
+#include "utils.h"
+#include "line_memo.h"
+#include "ir_format.h"
+
+/* read_source_line results */
+#define SOURCE_END 0            /* no more lines */
+#define SOURCE_LINE 1           /* a statement */
+#define SOURCE_TOO_LONG 2       /* a text line longer than MAX_LINE_LENGTH */
+#define SOURCE_UNPARSED 3       /* a text line parse_line rejected */
+
+/* statements of a pass, from the .am text or from a loaded IR program */
+typedef struct {
+    FILE *file;                     /* text source, NULL when reading IR */
+    const ir_program *program;      /* IR source, NULL when reading text */
+    int record;                     /* next IR record */
+    int line_number;                /* line of the last statement read */
+    char line[MAX_LINE_LENGTH];     /* last text line */
+    memo_entry scratch;             /* last IR record, laid out as a full-size shared line */
+} source_reader;
+
+/**
+ * open_source - start reading the statements of a source
+ * @param reader: reader to initialize
+ * @param filename: macro-expanded source (.am), used when program is NULL
+ * @param program: loaded IR program, or NULL to read filename
+ * @return SUCCESS if opened, FAILURE otherwise
+ */
+int open_source(source_reader *reader, const char *filename, const ir_program *program);
+
+/**
+ * read_source_line - read the next statement
+ * blank and comment lines are skipped; IR records come out with their operand
+ * modes already known to line_operand_mode
+ * @param reader: open reader
+ * @param parts: set to the statement for SOURCE_LINE; give it back with release_line
+ * @return SOURCE_LINE, SOURCE_TOO_LONG, SOURCE_UNPARSED or SOURCE_END
+ */
+int read_source_line(source_reader *reader, const separate_line **parts);
+
+/**
+ * rewind_source - start again from the first statement
+ * @param reader: open reader
+ */
+void rewind_source(source_reader *reader);
+
+/**
+ * close_source - finish reading a source
+ * @param reader: reader to close
+ */
+void close_source(source_reader *reader);
+
+#endif /* SOURCE_READER_H */
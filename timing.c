@@ -0,0 +1,1108 @@
+#include "timing.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "first_pass.h"
+
+#define NO_BLOCK -1
+#define NO_ROUTINE -1
+#define NO_LINK -1
+#define NOT_VISITED -1
+#define BLOCK_SUCCESSORS 2
+#define INITIAL_LINKS 64
+#define TIMING_LINE_BUFFER 256
+
+/* routine analysis states */
+#define ROUTINE_PENDING 0
+#define ROUTINE_ACTIVE 1
+#define ROUTINE_DONE 2
+
+/* basic block: ends at jmp, bne, jsr, rts or stop, or before a jump target */
+typedef struct {
+    int start;                          /* first instruction */
+    int last;                           /* last instruction */
+    int end;                            /* address after the block */
+    int succ[BLOCK_SUCCESSORS];         /* blocks that can run next in the same routine */
+    int callee;                         /* routine called by a closing jsr, or NO_ROUTINE */
+    int exit;                           /* YES if the block ends with rts or stop */
+    timing_status problem;              /* TIMING_BOUNDED unless the block defeats analysis */
+    timing_cost cost;                   /* the block's own instructions, callee excluded */
+} timing_block;
+
+/* entry of a singly linked list kept in one pool */
+typedef struct {
+    int node;
+    int next;
+} timing_link;
+
+/* per-block state while one routine is analyzed */
+typedef struct {
+    int pre;                /* depth-first preorder number, or NOT_VISITED */
+    int last_pre;           /* highest preorder number in the block's subtree */
+    int on_stack;           /* YES while the search is below the block */
+    int next_succ;          /* next successor the search will follow */
+    int preds;              /* list of predecessor blocks */
+    int back_edges;         /* list of blocks that jump back to this loop header */
+    int exits;              /* list of targets leaving this loop */
+    int owner;              /* innermost loop header holding the block, or NO_BLOCK */
+    int parent;             /* union-find link toward the enclosing collapsed loop */
+    int body_head;          /* first block of this loop's body, in reverse postorder */
+    int body_tail;
+    int body_next;          /* next block in the owner's body */
+    int header;             /* YES if a back edge targets the block */
+    int summarized;         /* YES once the loop is collapsed into this block */
+    int returns;            /* YES if the collapsed loop can reach rts or stop */
+    unsigned long bound;    /* loop bound used for the summary */
+    timing_cost summary;    /* cost of the whole collapsed loop */
+    timing_cost dist;       /* longest path to the block, block included */
+    int reached;            /* YES once dist is set */
+    int path_pred;          /* previous block on the path with the most cycles */
+    unsigned long mark;     /* visit stamp for the call search */
+} timing_node;
+
+/* longest paths within one loop, or within the routine's top level */
+typedef struct {
+    int header;             /* loop header, or NO_BLOCK for the top level */
+    timing_cost cycle;      /* longest way from the header back to it */
+    timing_cost exit;       /* longest way from the header out */
+    int has_exit;
+    int returns;            /* YES if a way out is rts or stop */
+    int exit_node;          /* block that ends the longest way out */
+} timing_region;
+
+/* analysis state shared by all routines */
+typedef struct {
+    const machine *m;
+    const cycle_model *model;
+    const unsigned long *bounds;
+    unsigned char *loops;
+    timing_report *report;
+    timing_block *blocks;
+    int block_count;
+    int block_of[MACHINE_MEMORY_SIZE];          /* block starting at each address */
+    unsigned char is_start[MACHINE_MEMORY_SIZE];/* YES where an instruction starts */
+    timing_node *nodes;
+    int *stack;
+    int *pre_order;                             /* visited blocks by preorder number */
+    int *post_order;                            /* visited blocks in postorder */
+    int visit_count;
+    timing_link *links;
+    int link_count;
+    int link_capacity;
+    int *routine_of_block;
+    unsigned char *state;                       /* ROUTINE_* by routine */
+    unsigned long stamp;
+} timing_context;
+
+/**
+ * default_cycle_model - one cycle per instruction, per word and per memory access
+ * @param model: model to fill
+ */
+void default_cycle_model(cycle_model *model) {
+    int i;
+
+    for (i = 0; i < NUM_OF_OPCODES; i++) model->instruction[i] = MODEL_DEFAULT_INSTRUCTION;
+    model->word = MODEL_DEFAULT_WORD;
+    model->memory = MODEL_DEFAULT_MEMORY;
+}
+
+/**
+ * model_opcode - opcode of a mnemonic, without get_instruction's error message
+ * @param name: mnemonic
+ * @return opcode, or INVALID
+ */
+static int model_opcode(const char *name) {
+    int i;
+
+    for (i = 0; i < NUM_OF_OPCODES; i++) {
+        if (strcmp(instruction_table[i].name, name) == 0) return instruction_table[i].opcode;
+    }
+    return INVALID;
+}
+
+/**
+ * read_cycle_model - read a cycle model file over the default model
+ * @param filename: model file
+ * @param model: model to fill
+ * @return SUCCESS if every line is valid, FAILURE otherwise
+ */
+int read_cycle_model(const char *filename, cycle_model *model) {
+    char line[TIMING_LINE_BUFFER];
+    char name[MODEL_NAME_LENGTH + 1];
+    unsigned long cycles;
+    char extra;
+    FILE *file;
+    int line_number = 0;
+    int result = SUCCESS;
+    int opcode;
+    const char *p;
+
+    default_cycle_model(model);
+    file = fopen(filename, FILE_READ_MODE);
+    if (!file) {
+        fprintf(stderr, ERROR_CANNOT_OPEN_FILE, filename);
+        return FAILURE;
+    }
+
+    while (fgets(line, sizeof(line), file)) {
+        line_number++;
+        for (p = line; isspace((unsigned char)*p); p++) {
+        }
+        if (*p == NULL_CHAR || *p == SEMICOLON_CHAR) continue;
+
+        if (sscanf(p, "%31s %lu %c", name, &cycles, &extra) != 2) {
+            fprintf(stderr, ERROR_BAD_MODEL_LINE, filename, line_number);
+            result = FAILURE;
+        } else if (strcmp(name, MODEL_KEY_WORD) == 0) {
+            model->word = cycles;
+        } else if (strcmp(name, MODEL_KEY_MEMORY) == 0) {
+            model->memory = cycles;
+        } else if ((opcode = model_opcode(name)) != INVALID) {
+            model->instruction[opcode] = cycles;
+        } else {
+            fprintf(stderr, ERROR_UNKNOWN_MODEL_NAME, filename, line_number, name);
+            result = FAILURE;
+        }
+    }
+
+    fclose(file);
+    return result;
+}
+
+/**
+ * parse_loopbound - recognize a "; @loopbound N" line
+ * @param line: source line
+ * @param bound: output for N, 0 if the annotation is malformed
+ * @return YES if the line is an annotation, NO otherwise
+ */
+static int parse_loopbound(const char *line, unsigned long *bound) {
+    const char *p = line;
+    char *end;
+
+    *bound = 0;
+    while (isspace((unsigned char)*p)) p++;
+    if (*p != SEMICOLON_CHAR) return NO;
+    p++;
+    while (isspace((unsigned char)*p)) p++;
+    if (strncmp(p, LOOPBOUND_KEYWORD, strlen(LOOPBOUND_KEYWORD)) != 0) return NO;
+    p += strlen(LOOPBOUND_KEYWORD);
+    if (*p != NULL_CHAR && !isspace((unsigned char)*p)) return NO;
+
+    while (isspace((unsigned char)*p)) p++;
+    if (!isdigit((unsigned char)*p)) return YES;
+    *bound = strtoul(p, &end, BASE_10);
+    for (p = end; isspace((unsigned char)*p); p++) {
+    }
+    if (*p != NULL_CHAR) *bound = 0;
+    return YES;
+}
+
+/**
+ * read_loop_bounds - read the @loopbound annotations of a program's .am file
+ * annotations and instructions both come in line order, so each annotation is
+ * matched to the next instruction in one merge
+ * @param filename: macro-expanded source the program was assembled from
+ * @param m: machine holding the decoded program
+ * @param bounds: indexed by address, set to the bound of each annotated instruction
+ * @param lines: indexed by address, set to the .am line of each annotation
+ * @return SUCCESS if the file was read and every annotation is valid, FAILURE otherwise
+ */
+int read_loop_bounds(const char *filename, const machine *m, unsigned long *bounds, int *lines) {
+    int code_lines[MACHINE_MEMORY_SIZE];
+    char line[TIMING_LINE_BUFFER];
+    unsigned long bound;
+    FILE *file;
+    int line_number = 0;
+    int address = INITIAL_IC;
+    int result = SUCCESS;
+    int c;
+
+    memset(code_lines, 0, sizeof(code_lines));
+    if (first_pass_code_lines(filename, code_lines, MACHINE_MEMORY_SIZE) == FAILURE) return FAILURE;
+
+    file = fopen(filename, FILE_READ_MODE);
+    if (!file) {
+        fprintf(stderr, ERROR_CANNOT_OPEN_FILE, filename);
+        return FAILURE;
+    }
+
+    while (fgets(line, sizeof(line), file)) {
+        line_number++;
+        if (!strchr(line, NEWLINE_CHAR)) {
+            /* the rest of an overlong line is not an annotation */
+            while ((c = getc(file)) != EOF && c != NEWLINE_CHAR) {
+            }
+        }
+        if (!parse_loopbound(line, &bound)) continue;
+        if (bound == 0) {
+            fprintf(stderr, ERROR_BAD_LOOPBOUND, filename, line_number);
+            result = FAILURE;
+            continue;
+        }
+
+        while (address < m->code_end && code_lines[address] <= line_number) {
+            address += m->decoded[address].length;
+        }
+        if (address >= m->code_end) {
+            fprintf(stderr, WARNING_LOOPBOUND_NO_INSTRUCTION, filename, line_number);
+            continue;
+        }
+        bounds[address] = bound;
+        lines[address] = line_number;
+    }
+
+    fclose(file);
+    return result;
+}
+
+/**
+ * add_cost - add one cost to another
+ * @param total: cost to update
+ * @param cost: cost to add
+ */
+static void add_cost(timing_cost *total, const timing_cost *cost) {
+    total->instructions += cost->instructions;
+    total->cycles += cost->cycles;
+}
+
+/**
+ * raise_cost - keep the larger of two costs, each measure on its own
+ * @param worst: cost to update
+ * @param cost: candidate
+ */
+static void raise_cost(timing_cost *worst, const timing_cost *cost) {
+    if (cost->instructions > worst->instructions) worst->instructions = cost->instructions;
+    if (cost->cycles > worst->cycles) worst->cycles = cost->cycles;
+}
+
+/**
+ * memory_accesses - number of data reads and writes an operand causes
+ * @param inst: decoded instruction
+ * @param op: &inst->src or &inst->dst
+ * @return 0, 1 or 2
+ */
+static unsigned long memory_accesses(const decoded_instruction *inst, const decoded_operand *op) {
+    int access = operand_access(inst, op);
+
+    return (unsigned long)(((access & OPERAND_READ) ? 1 : 0) + ((access & OPERAND_WRITE) ? 1 : 0));
+}
+
+/**
+ * instruction_cost - cost of one instruction under the cycle model
+ * @param model: cycle model
+ * @param inst: decoded instruction
+ * @param cost: output
+ */
+static void instruction_cost(const cycle_model *model, const decoded_instruction *inst, timing_cost *cost) {
+    unsigned long accesses = 0;
+
+    if (inst->operands == DOUBLE_OPERAND) accesses += memory_accesses(inst, &inst->src);
+    if (inst->operands != NO_OPERANDS) accesses += memory_accesses(inst, &inst->dst);
+
+    cost->instructions = 1;
+    cost->cycles = model->instruction[inst->opcode] + model->word * inst->length + model->memory * accesses;
+}
+
+/**
+ * ends_block - whether an instruction ends a basic block
+ * @param opcode: instruction opcode
+ * @return YES for jmp, bne, jsr, rts and stop
+ */
+static int ends_block(int opcode) {
+    return opcode == JMP || opcode == BNE || opcode == JSR || opcode == RTS || opcode == STOP;
+}
+
+/**
+ * direct_target - address a jmp, bne or jsr goes to, when it is fixed and inside the code
+ * @param ctx: analysis state
+ * @param inst: decoded jump
+ * @param problem: output, why there is no target
+ * @return target address, or NO_BLOCK with problem set
+ */
+static int direct_target(const timing_context *ctx, const decoded_instruction *inst, timing_status *problem) {
+    int target = inst->dst.value;
+
+    if (inst->flags & DECODED_EXTERNAL) {
+        *problem = TIMING_EXTERNAL_TARGET;
+    } else if (inst->dst.mode != MODE_DIRECT) {
+        *problem = TIMING_INDIRECT_JUMP;
+    } else if (target < INITIAL_IC || target >= ctx->m->code_end || !ctx->is_start[target]) {
+        *problem = TIMING_BAD_TARGET;
+    } else {
+        return target;
+    }
+    return NO_BLOCK;
+}
+
+/**
+ * link_block - set a block's successor or callee from its closing jump
+ * @param ctx: analysis state
+ * @param block: block to update
+ * @param slot: where the target block goes
+ */
+static void link_block(timing_context *ctx, timing_block *block, int *slot) {
+    timing_status problem = TIMING_BOUNDED;
+    int target = direct_target(ctx, &ctx->m->decoded[block->last], &problem);
+
+    if (target == NO_BLOCK) {
+        block->problem = problem;
+    } else {
+        *slot = ctx->block_of[target];
+    }
+}
+
+/**
+ * build_blocks - split the code into basic blocks and link them
+ * @param ctx: analysis state
+ * @return SUCCESS, or FAILURE if allocation failed
+ */
+static int build_blocks(timing_context *ctx) {
+    const machine *m = ctx->m;
+    const decoded_instruction *inst;
+    unsigned char leader[MACHINE_MEMORY_SIZE];
+    timing_status problem;
+    timing_block *block = NULL;
+    timing_cost cost;
+    int address, target, next;
+    int count = 0;
+    int i;
+
+    memset(leader, 0, sizeof(leader));
+    for (address = INITIAL_IC; address < m->code_end; address += m->decoded[address].length) {
+        ctx->is_start[address] = YES;
+    }
+    if (m->code_end > INITIAL_IC) leader[INITIAL_IC] = YES;
+
+    for (address = INITIAL_IC; address < m->code_end; address = next) {
+        inst = &m->decoded[address];
+        next = address + inst->length;
+        if (!ends_block(inst->opcode)) continue;
+        if (next < m->code_end) leader[next] = YES;
+        if (inst->opcode != RTS && inst->opcode != STOP) {
+            target = direct_target(ctx, inst, &problem);
+            if (target != NO_BLOCK) leader[target] = YES;
+            if (target != NO_BLOCK && target <= address && inst->opcode != JSR) {
+                /* a backward branch and its target are where loop bounds may go */
+                ctx->loops[target] = YES;
+                ctx->loops[address] = YES;
+            }
+        }
+    }
+
+    for (address = INITIAL_IC; address < m->code_end; address += m->decoded[address].length) {
+        if (leader[address]) count++;
+    }
+    ctx->block_count = count;
+    ctx->blocks = malloc((count > 0 ? count : 1) * sizeof(timing_block));
+    if (!ctx->blocks) {
+        fprintf(stderr, MALLOC_FAILED);
+        return FAILURE;
+    }
+
+    count = 0;
+    for (address = INITIAL_IC; address < m->code_end; address += m->decoded[address].length) {
+        if (leader[address]) {
+            block = &ctx->blocks[count];
+            ctx->block_of[address] = count++;
+            block->start = address;
+            block->succ[0] = NO_BLOCK;
+            block->succ[1] = NO_BLOCK;
+            block->callee = NO_BLOCK;
+            block->exit = NO;
+            block->problem = TIMING_BOUNDED;
+            block->cost.instructions = 0;
+            block->cost.cycles = 0;
+        }
+        instruction_cost(ctx->model, &m->decoded[address], &cost);
+        add_cost(&block->cost, &cost);
+        block->last = address;
+        block->end = address + m->decoded[address].length;
+    }
+
+    for (i = 0; i < ctx->block_count; i++) {
+        block = &ctx->blocks[i];
+        inst = &m->decoded[block->last];
+
+        if (inst->opcode == RTS || inst->opcode == STOP) {
+            block->exit = YES;
+            continue;
+        }
+        if (inst->opcode != JMP) {
+            /* everything else, jsr included, can go on to the next block */
+            if (block->end >= m->code_end) {
+                block->problem = TIMING_FALLS_OFF;
+            } else {
+                block->succ[0] = ctx->block_of[block->end];
+            }
+        }
+        if (inst->opcode == JMP) link_block(ctx, block, &block->succ[0]);
+        if (inst->opcode == BNE) link_block(ctx, block, &block->succ[1]);
+        if (inst->opcode == JSR) link_block(ctx, block, &block->callee);
+    }
+    return SUCCESS;
+}
+
+/**
+ * find_routines - make the program entry and every jsr target a routine
+ * @param ctx: analysis state with blocks built
+ * @return SUCCESS, or FAILURE if allocation failed
+ */
+static int find_routines(timing_context *ctx) {
+    timing_report *report = ctx->report;
+    routine_timing *routine;
+    int i, count = 0;
+
+    ctx->routine_of_block = malloc((ctx->block_count > 0 ? ctx->block_count : 1) * sizeof(int));
+    if (!ctx->routine_of_block) {
+        fprintf(stderr, MALLOC_FAILED);
+        return FAILURE;
+    }
+    for (i = 0; i < ctx->block_count; i++) ctx->routine_of_block[i] = NO_ROUTINE;
+    if (ctx->block_count > 0) ctx->routine_of_block[0] = 0;
+    for (i = 0; i < ctx->block_count; i++) {
+        if (ctx->blocks[i].callee != NO_BLOCK) ctx->routine_of_block[ctx->blocks[i].callee] = 0;
+    }
+
+    /* number the routines in address order */
+    for (i = 0; i < ctx->block_count; i++) {
+        if (ctx->routine_of_block[i] != NO_ROUTINE) ctx->routine_of_block[i] = count++;
+    }
+
+    report->routines = malloc((count > 0 ? count : 1) * sizeof(routine_timing));
+    ctx->state = calloc((size_t)(count > 0 ? count : 1), 1);
+    if (!report->routines || !ctx->state) {
+        fprintf(stderr, MALLOC_FAILED);
+        return FAILURE;
+    }
+    report->routine_count = count;
+
+    for (i = 0; i < ctx->block_count; i++) {
+        if (ctx->routine_of_block[i] == NO_ROUTINE) continue;
+        routine = &report->routines[ctx->routine_of_block[i]];
+        routine->entry = ctx->blocks[i].start;
+        routine->status = TIMING_BOUNDED;
+        routine->status_address = routine->entry;
+        routine->worst.instructions = 0;
+        routine->worst.cycles = 0;
+        routine->path = NULL;
+        routine->path_length = 0;
+    }
+    for (i = 0; i < ctx->block_count; i++) {
+        if (ctx->blocks[i].callee != NO_BLOCK) ctx->blocks[i].callee = ctx->routine_of_block[ctx->blocks[i].callee];
+    }
+    return SUCCESS;
+}
+
+/**
+ * reset_node - put a block's per-routine state back to its initial values
+ * @param ctx: analysis state
+ * @param index: block index
+ */
+static void reset_node(timing_context *ctx, int index) {
+    timing_node *node = &ctx->nodes[index];
+    unsigned long mark = node->mark;
+
+    memset(node, 0, sizeof(timing_node));
+    node->mark = mark;
+    node->pre = NOT_VISITED;
+    node->last_pre = NOT_VISITED;
+    node->on_stack = NO;
+    node->preds = NO_LINK;
+    node->back_edges = NO_LINK;
+    node->exits = NO_LINK;
+    node->owner = NO_BLOCK;
+    node->parent = index;
+    node->body_head = NO_BLOCK;
+    node->body_tail = NO_BLOCK;
+    node->body_next = NO_BLOCK;
+    node->header = NO;
+    node->summarized = NO;
+    node->returns = NO;
+    node->reached = NO;
+    node->path_pred = NO_BLOCK;
+}
+
+/**
+ * add_link - push a node onto a pooled list
+ * @param ctx: analysis state
+ * @param head: list head to update
+ * @param node: node to add
+ * @return SUCCESS, or FAILURE if allocation failed
+ */
+static int add_link(timing_context *ctx, int *head, int node) {
+    timing_link *grown;
+    int capacity;
+
+    if (ctx->link_count == ctx->link_capacity) {
+        capacity = ctx->link_capacity ? ctx->link_capacity * 2 : INITIAL_LINKS;
+        grown = realloc(ctx->links, capacity * sizeof(timing_link));
+        if (!grown) {
+            fprintf(stderr, MALLOC_FAILED);
+            return FAILURE;
+        }
+        ctx->links = grown;
+        ctx->link_capacity = capacity;
+    }
+    ctx->links[ctx->link_count].node = node;
+    ctx->links[ctx->link_count].next = *head;
+    *head = ctx->link_count++;
+    return SUCCESS;
+}
+
+/**
+ * find_node - representative of the collapsed loop holding a block
+ * @param ctx: analysis state
+ * @param index: block index
+ * @return the outermost collapsed loop header holding the block, or the block itself
+ */
+static int find_node(timing_context *ctx, int index) {
+    int root = index;
+    int next;
+
+    while (ctx->nodes[root].parent != root) root = ctx->nodes[root].parent;
+    while (ctx->nodes[index].parent != root) {
+        next = ctx->nodes[index].parent;
+        ctx->nodes[index].parent = root;
+        index = next;
+    }
+    return root;
+}
+
+/**
+ * set_status - record why a routine has no bound, keeping the first reason
+ * @param routine: routine to update
+ * @param status: reason
+ * @param address: instruction the reason refers to
+ */
+static void set_status(routine_timing *routine, timing_status status, int address) {
+    if (routine->status != TIMING_BOUNDED) return;
+    routine->status = status;
+    routine->status_address = address;
+}
+
+/**
+ * collect_calls - list the jsr blocks a routine reaches, checking every block on the way
+ * @param ctx: analysis state
+ * @param routine: routine index
+ * @param calls: output, room for every block
+ * @return number of jsr blocks
+ */
+static int collect_calls(timing_context *ctx, int routine, int *calls) {
+    routine_timing *timing = &ctx->report->routines[routine];
+    timing_block *block;
+    int count = 0;
+    int sp = 0;
+    int b, i, s;
+
+    ctx->stamp++;
+    b = ctx->block_of[timing->entry];
+    ctx->nodes[b].mark = ctx->stamp;
+    ctx->stack[sp++] = b;
+
+    while (sp > 0) {
+        b = ctx->stack[--sp];
+        block = &ctx->blocks[b];
+        if (block->problem != TIMING_BOUNDED) set_status(timing, block->problem, block->last);
+        if (block->callee != NO_ROUTINE) {
+            if (ctx->state[block->callee] == ROUTINE_ACTIVE) {
+                set_status(timing, TIMING_RECURSION, block->last);
+            } else {
+                calls[count++] = b;
+            }
+        }
+        for (i = 0; i < BLOCK_SUCCESSORS; i++) {
+            s = block->succ[i];
+            if (s == NO_BLOCK || ctx->nodes[s].mark == ctx->stamp) continue;
+            ctx->nodes[s].mark = ctx->stamp;
+            ctx->stack[sp++] = s;
+        }
+    }
+    return count;
+}
+
+/**
+ * search_routine - depth-first search numbering blocks and finding back edges
+ * @param ctx: analysis state
+ * @param entry: entry block
+ * @return SUCCESS, or FAILURE if allocation failed
+ */
+static int search_routine(timing_context *ctx, int entry) {
+    timing_node *node;
+    int sp = 0;
+    int counter = 0;
+    int b, s;
+
+    ctx->visit_count = 0;
+    ctx->nodes[entry].pre = counter;
+    ctx->pre_order[counter++] = entry;
+    ctx->nodes[entry].on_stack = YES;
+    ctx->stack[sp++] = entry;
+
+    while (sp > 0) {
+        b = ctx->stack[sp - 1];
+        node = &ctx->nodes[b];
+        if (node->next_succ == BLOCK_SUCCESSORS) {
+            node->on_stack = NO;
+            node->last_pre = counter - 1;
+            ctx->post_order[ctx->visit_count++] = b;
+            sp--;
+            continue;
+        }
+
+        s = ctx->blocks[b].succ[node->next_succ++];
+        if (s == NO_BLOCK) continue;
+        if (add_link(ctx, &ctx->nodes[s].preds, b) == FAILURE) return FAILURE;
+
+        if (ctx->nodes[s].pre == NOT_VISITED) {
+            ctx->nodes[s].pre = counter;
+            ctx->pre_order[counter++] = s;
+            ctx->nodes[s].on_stack = YES;
+            ctx->stack[sp++] = s;
+        } else if (ctx->nodes[s].on_stack) {
+            ctx->nodes[s].header = YES;
+            if (add_link(ctx, &ctx->nodes[s].back_edges, b) == FAILURE) return FAILURE;
+        }
+    }
+    return SUCCESS;
+}
+
+/**
+ * collect_loop - find the body of one loop and collapse it into its header
+ * walks predecessors back from the blocks that jump to the header; inner loops
+ * are already collapsed, so each block is added to exactly one body
+ * @param ctx: analysis state
+ * @param header: loop header
+ * @return YES if the loop is only entered through its header, NO otherwise
+ */
+static int collect_loop(timing_context *ctx, int header) {
+    timing_node *h = &ctx->nodes[header];
+    int sp = 0;
+    int link, x, y;
+
+    for (link = h->back_edges; link != NO_LINK; link = ctx->links[link].next) {
+        y = find_node(ctx, ctx->links[link].node);
+        if (y == header || ctx->nodes[y].owner != NO_BLOCK) continue;
+        ctx->nodes[y].owner = header;
+        ctx->nodes[y].parent = header;
+        ctx->stack[sp++] = y;
+    }
+
+    while (sp > 0) {
+        x = ctx->stack[--sp];
+        for (link = ctx->nodes[x].preds; link != NO_LINK; link = ctx->links[link].next) {
+            y = find_node(ctx, ctx->links[link].node);
+            if (y == header || ctx->nodes[y].owner != NO_BLOCK) continue;
+            /* a predecessor outside the header's subtree enters the loop from the side */
+            if (ctx->nodes[y].pre < h->pre || ctx->nodes[y].pre > h->last_pre) return NO;
+            ctx->nodes[y].owner = header;
+            ctx->nodes[y].parent = header;
+            ctx->stack[sp++] = y;
+        }
+    }
+    return YES;
+}
+
+/**
+ * order_bodies - list each loop's body in reverse postorder, a topological order
+ * of the edges that remain once inner loops are collapsed
+ * @param ctx: analysis state
+ */
+static void order_bodies(timing_context *ctx) {
+    timing_node *owner;
+    int i, x;
+
+    for (i = ctx->visit_count - 1; i >= 0; i--) {
+        x = ctx->post_order[i];
+        if (ctx->nodes[x].owner == NO_BLOCK) continue;
+        owner = &ctx->nodes[ctx->nodes[x].owner];
+        if (owner->body_tail == NO_BLOCK) {
+            owner->body_head = x;
+        } else {
+            ctx->nodes[owner->body_tail].body_next = x;
+        }
+        owner->body_tail = x;
+    }
+}
+
+/**
+ * node_cost - cost of running a block, or a whole collapsed loop, once
+ * @param ctx: analysis state
+ * @param x: block index
+ * @param cost: output
+ */
+static void node_cost(const timing_context *ctx, int x, timing_cost *cost) {
+    const timing_block *block = &ctx->blocks[x];
+
+    if (ctx->nodes[x].summarized) {
+        *cost = ctx->nodes[x].summary;
+        return;
+    }
+    *cost = block->cost;
+    if (block->callee != NO_ROUTINE) add_cost(cost, &ctx->report->routines[block->callee].worst);
+}
+
+/**
+ * leave_region - account for a way out of a region at a block
+ * @param ctx: analysis state
+ * @param region: region being measured
+ * @param x: block the way out starts from
+ */
+static void leave_region(const timing_context *ctx, timing_region *region, int x) {
+    const timing_cost *dist = &ctx->nodes[x].dist;
+
+    if (!region->has_exit || dist->cycles > region->exit.cycles) region->exit_node = x;
+    if (!region->has_exit) {
+        region->exit = *dist;
+        region->has_exit = YES;
+    } else {
+        raise_cost(&region->exit, dist);
+    }
+}
+
+/**
+ * follow_edge - extend the longest path to a block across one edge
+ * @param ctx: analysis state
+ * @param region: region being measured
+ * @param x: source block, reached
+ * @param s: target block
+ * @return SUCCESS, or FAILURE if allocation failed
+ */
+static int follow_edge(timing_context *ctx, timing_region *region, int x, int s) {
+    timing_node *source = &ctx->nodes[x];
+    timing_node *target;
+    timing_cost cost;
+    int r = find_node(ctx, s);
+
+    if (r == region->header) {
+        raise_cost(&region->cycle, &source->dist);
+        return SUCCESS;
+    }
+    if (ctx->nodes[r].owner != region->header) {
+        leave_region(ctx, region, x);
+        return add_link(ctx, &ctx->nodes[region->header].exits, s);
+    }
+
+    target = &ctx->nodes[r];
+    node_cost(ctx, r, &cost);
+    add_cost(&cost, &source->dist);
+    if (!target->reached) {
+        target->dist = cost;
+        target->path_pred = x;
+        target->reached = YES;
+        return SUCCESS;
+    }
+    if (cost.cycles > target->dist.cycles) target->path_pred = x;
+    raise_cost(&target->dist, &cost);
+    return SUCCESS;
+}
+
+/**
+ * visit_node - follow every edge out of a reached block or collapsed loop
+ * @param ctx: analysis state
+ * @param region: region being measured
+ * @param x: block index
+ * @return SUCCESS, or FAILURE if allocation failed
+ */
+static int visit_node(timing_context *ctx, timing_region *region, int x) {
+    timing_node *node = &ctx->nodes[x];
+    int link, i;
+
+    if (!node->reached) return SUCCESS;
+
+    if (node->summarized) {
+        for (link = node->exits; link != NO_LINK; link = ctx->links[link].next) {
+            if (follow_edge(ctx, region, x, ctx->links[link].node) == FAILURE) return FAILURE;
+        }
+        if (node->returns) {
+            leave_region(ctx, region, x);
+            region->returns = YES;
+        }
+        return SUCCESS;
+    }
+
+    for (i = 0; i < BLOCK_SUCCESSORS; i++) {
+        if (ctx->blocks[x].succ[i] == NO_BLOCK) continue;
+        if (follow_edge(ctx, region, x, ctx->blocks[x].succ[i]) == FAILURE) return FAILURE;
+    }
+    if (ctx->blocks[x].exit) {
+        leave_region(ctx, region, x);
+        region->returns = YES;
+    }
+    return SUCCESS;
+}
+
+/**
+ * start_region - begin measuring paths from a block
+ * @param ctx: analysis state
+ * @param region: region to initialize
+ * @param header: loop header, or NO_BLOCK for the top level
+ * @param first: block the paths start at
+ */
+static void start_region(timing_context *ctx, timing_region *region, int header, int first) {
+    memset(region, 0, sizeof(timing_region));
+    region->header = header;
+    region->has_exit = NO;
+    region->returns = NO;
+    region->exit_node = NO_BLOCK;
+    node_cost(ctx, first, &ctx->nodes[first].dist);
+    ctx->nodes[first].reached = YES;
+    ctx->nodes[first].path_pred = NO_BLOCK;
+}
+
+/**
+ * loop_bound - bound annotated at the loop header or at a branch that closes the loop
+ * @param ctx: analysis state
+ * @param header: loop header
+ * @return the bound, or 0 if there is none
+ */
+static unsigned long loop_bound(timing_context *ctx, int header) {
+    int address = ctx->blocks[header].start;
+    int link;
+
+    if (ctx->bounds[address] == 0) {
+        for (link = ctx->nodes[header].back_edges; link != NO_LINK; link = ctx->links[link].next) {
+            address = ctx->blocks[ctx->links[link].node].last;
+            if (ctx->bounds[address] != 0) break;
+        }
+    }
+    return ctx->bounds[address];
+}
+
+/**
+ * summarize_loop - collapse a loop into its header as one node
+ * the header runs at most bound times, so the loop costs at most bound - 1
+ * trips around it plus the longest way out
+ * @param ctx: analysis state
+ * @param routine: routine being analyzed
+ * @param header: loop header, inner loops already summarized
+ * @return SUCCESS, or FAILURE if allocation failed
+ */
+static int summarize_loop(timing_context *ctx, routine_timing *routine, int header) {
+    timing_node *h = &ctx->nodes[header];
+    timing_region region;
+    unsigned long bound = loop_bound(ctx, header);
+    int x;
+
+    if (bound == 0) {
+        set_status(routine, TIMING_UNBOUNDED_LOOP, ctx->blocks[header].start);
+        return SUCCESS;
+    }
+
+    start_region(ctx, &region, header, header);
+    if (visit_node(ctx, &region, header) == FAILURE) return FAILURE;
+    for (x = h->body_head; x != NO_BLOCK; x = ctx->nodes[x].body_next) {
+        if (visit_node(ctx, &region, x) == FAILURE) return FAILURE;
+    }
+    if (!region.has_exit) {
+        set_status(routine, TIMING_NO_EXIT, ctx->blocks[header].start);
+        return SUCCESS;
+    }
+
+    h->summary.instructions = (bound - 1) * region.cycle.instructions + region.exit.instructions;
+    h->summary.cycles = (bound - 1) * region.cycle.cycles + region.exit.cycles;
+    h->summarized = YES;
+    h->returns = region.returns;
+    h->bound = bound;
+    h->reached = NO;
+    h->path_pred = NO_BLOCK;
+    for (x = h->body_head; x != NO_BLOCK; x = ctx->nodes[x].body_next) ctx->nodes[x].parent = header;
+    return SUCCESS;
+}
+
+/**
+ * record_path - store the top-level path that ends at a block
+ * @param ctx: analysis state
+ * @param routine: routine to update
+ * @param last: last block of the path
+ * @return SUCCESS, or FAILURE if allocation failed
+ */
+static int record_path(timing_context *ctx, routine_timing *routine, int last) {
+    int length = 0;
+    int x;
+
+    for (x = last; x != NO_BLOCK; x = ctx->nodes[x].path_pred) length++;
+    routine->path = malloc(length * sizeof(timing_step));
+    if (!routine->path) {
+        fprintf(stderr, MALLOC_FAILED);
+        return FAILURE;
+    }
+    routine->path_length = length;
+    for (x = last; x != NO_BLOCK; x = ctx->nodes[x].path_pred) {
+        length--;
+        routine->path[length].address = ctx->blocks[x].start;
+        routine->path[length].iterations = ctx->nodes[x].summarized ? ctx->nodes[x].bound : 0;
+    }
+    return SUCCESS;
+}
+
+/**
+ * time_routine - worst case of a routine whose callees are done
+ * @param ctx: analysis state
+ * @param routine: routine to analyze
+ * @return SUCCESS, or FAILURE if allocation failed
+ */
+static int time_routine(timing_context *ctx, routine_timing *routine) {
+    timing_region region;
+    int entry = ctx->block_of[routine->entry];
+    int result;
+    int i, x;
+
+    result = search_routine(ctx, entry);
+
+    /* innermost loops have the highest preorder numbers */
+    for (i = ctx->visit_count - 1; result == SUCCESS && i >= 0; i--) {
+        x = ctx->pre_order[i];
+        if (ctx->nodes[x].header && !collect_loop(ctx, x)) {
+            set_status(routine, TIMING_IRREDUCIBLE_LOOP, ctx->blocks[x].start);
+            break;
+        }
+    }
+
+    if (result == SUCCESS && routine->status == TIMING_BOUNDED) {
+        order_bodies(ctx);
+        for (i = 0; i < ctx->visit_count; i++) ctx->nodes[ctx->pre_order[i]].parent = ctx->pre_order[i];
+        for (i = ctx->visit_count - 1; result == SUCCESS && i >= 0; i--) {
+            x = ctx->pre_order[i];
+            if (!ctx->nodes[x].header) continue;
+            result = summarize_loop(ctx, routine, x);
+            if (routine->status != TIMING_BOUNDED) break;
+        }
+    }
+
+    if (result == SUCCESS && routine->status == TIMING_BOUNDED) {
+        start_region(ctx, &region, NO_BLOCK, entry);
+        for (i = ctx->visit_count - 1; result == SUCCESS && i >= 0; i--) {
+            x = ctx->post_order[i];
+            if (ctx->nodes[x].owner == NO_BLOCK) result = visit_node(ctx, &region, x);
+        }
+        if (result == SUCCESS && !region.has_exit) {
+            set_status(routine, TIMING_NO_EXIT, routine->entry);
+        } else if (result == SUCCESS) {
+            routine->worst = region.exit;
+            result = record_path(ctx, routine, region.exit_node);
+        }
+    }
+
+    for (i = 0; i < ctx->visit_count; i++) reset_node(ctx, ctx->post_order[i]);
+    ctx->link_count = 0;
+    return result;
+}
+
+/**
+ * analyze_routine - analyze a routine after the routines it calls
+ * @param ctx: analysis state
+ * @param index: routine index
+ * @return SUCCESS, or FAILURE if allocation failed
+ */
+static int analyze_routine(timing_context *ctx, int index) {
+    routine_timing *routine = &ctx->report->routines[index];
+    const timing_block *block;
+    int *calls;
+    int count, i;
+    int result = SUCCESS;
+
+    ctx->state[index] = ROUTINE_ACTIVE;
+    calls = malloc(ctx->block_count * sizeof(int));
+    if (!calls) {
+        fprintf(stderr, MALLOC_FAILED);
+        return FAILURE;
+    }
+
+    count = collect_calls(ctx, index, calls);
+    for (i = 0; result == SUCCESS && i < count; i++) {
+        if (ctx->state[ctx->blocks[calls[i]].callee] == ROUTINE_PENDING) {
+            result = analyze_routine(ctx, ctx->blocks[calls[i]].callee);
+        }
+    }
+    for (i = 0; result == SUCCESS && i < count; i++) {
+        block = &ctx->blocks[calls[i]];
+        if (ctx->report->routines[block->callee].status != TIMING_BOUNDED) {
+            set_status(routine, TIMING_UNBOUNDED_CALLEE, block->last);
+        }
+    }
+    free(calls);
+
+    if (result == SUCCESS && routine->status == TIMING_BOUNDED) result = time_routine(ctx, routine);
+    ctx->state[index] = ROUTINE_DONE;
+    return result;
+}
+
+/**
+ * analyze_timing - find the worst-case instruction count and cycles of every routine
+ * @param m: machine holding the decoded program
+ * @param bounds: loop bounds by address, 0 where there is none
+ * @param model: cycle model
+ * @param report: output (free with free_timing_report)
+ * @param loops: indexed by address, set to YES at each backward jmp or bne and at its target
+ * @return SUCCESS, or FAILURE if allocation failed
+ */
+int analyze_timing(const machine *m, const unsigned long *bounds, const cycle_model *model, timing_report *report,
+                   unsigned char *loops) {
+    timing_context *ctx;
+    int result;
+    int size, i;
+
+    report->routines = NULL;
+    report->routine_count = 0;
+
+    ctx = calloc(1, sizeof(timing_context));
+    if (!ctx) {
+        fprintf(stderr, MALLOC_FAILED);
+        return FAILURE;
+    }
+    ctx->m = m;
+    ctx->model = model;
+    ctx->bounds = bounds;
+    ctx->loops = loops;
+    ctx->report = report;
+
+    result = build_blocks(ctx);
+    if (result == SUCCESS) result = find_routines(ctx);
+
+    if (result == SUCCESS) {
+        size = ctx->block_count > 0 ? ctx->block_count : 1;
+        ctx->nodes = malloc(size * sizeof(timing_node));
+        ctx->stack = malloc(size * sizeof(int));
+        ctx->pre_order = malloc(size * sizeof(int));
+        ctx->post_order = malloc(size * sizeof(int));
+        if (!ctx->nodes || !ctx->stack || !ctx->pre_order || !ctx->post_order) {
+            fprintf(stderr, MALLOC_FAILED);
+            result = FAILURE;
+        }
+    }
+
+    if (result == SUCCESS) {
+        for (i = 0; i < ctx->block_count; i++) {
+            ctx->nodes[i].mark = 0;
+            reset_node(ctx, i);
+        }
+        for (i = 0; result == SUCCESS && i < report->routine_count; i++) {
+            if (ctx->state[i] == ROUTINE_PENDING) result = analyze_routine(ctx, i);
+        }
+    }
+
+    free(ctx->blocks);
+    free(ctx->routine_of_block);
+    free(ctx->state);
+    free(ctx->nodes);
+    free(ctx->stack);
+    free(ctx->pre_order);
+    free(ctx->post_order);
+    free(ctx->links);
+    free(ctx);
+    if (result == FAILURE) free_timing_report(report);
+    return result;
+}
+
+/**
+ * free_timing_report - release a report from analyze_timing
+ * @param report: report to free
+ */
+void free_timing_report(timing_report *report) {
+    int i;
+
+    for (i = 0; report->routines && i < report->routine_count; i++) free(report->routines[i].path);
+    free(report->routines);
+    report->routines = NULL;
+    report->routine_count = 0;
+}
@@ -0,0 +1,124 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdio.h>
+#include "utils.h"
+#include "commands.h"
+#include "machine.h"
+
+/* "; @loopbound N" in the .am source bounds the loop whose header, or whose
+ * closing branch, is the next instruction: the header runs at most N times
+ * each time the loop is entered */
+#define LOOPBOUND_KEYWORD "@loopbound"
+
+/* cycle model file: "name cycles" per line, name is a mnemonic or a key below */
+#define MODEL_KEY_WORD "word"           /* cycles per instruction word fetched */
+#define MODEL_KEY_MEMORY "memory"       /* cycles per data read or write */
+#define MODEL_DEFAULT_INSTRUCTION 1
+#define MODEL_DEFAULT_WORD 1
+#define MODEL_DEFAULT_MEMORY 1
+#define MODEL_NAME_LENGTH 31
+
+/* error messages */
+#define ERROR_BAD_LOOPBOUND "Error: %s (line %d): @loopbound needs a positive count\n"
+#define ERROR_BAD_MODEL_LINE "Error: %s (line %d): expected 'name cycles'\n"
+#define ERROR_UNKNOWN_MODEL_NAME "Error: %s (line %d): unknown instruction '%s'\n"
+#define WARNING_LOOPBOUND_NO_INSTRUCTION "Warning: %s (line %d): @loopbound is not followed by an instruction\n"
+
+/* cycles charged for each instruction */
+typedef struct {
+    unsigned long instruction[NUM_OF_OPCODES];  /* base cost, by opcode */
+    unsigned long word;                         /* per word, operand words included */
+    unsigned long memory;                       /* per data memory read or write */
+} cycle_model;
+
+/* cost of a path */
+typedef struct {
+    unsigned long instructions;
+    unsigned long cycles;
+} timing_cost;
+
+/* whether a routine has a bound, and why not */
+typedef enum {
+    TIMING_BOUNDED,
+    TIMING_UNBOUNDED_LOOP,      /* loop without @loopbound */
+    TIMING_IRREDUCIBLE_LOOP,    /* loop entered other than through its header */
+    TIMING_NO_EXIT,             /* loop that never reaches rts or stop */
+    TIMING_INDIRECT_JUMP,       /* jmp, bne or jsr through a matrix operand */
+    TIMING_EXTERNAL_TARGET,     /* jmp, bne or jsr to an external label */
+    TIMING_BAD_TARGET,          /* jump target is not an instruction */
+    TIMING_FALLS_OFF,           /* runs past the last instruction */
+    TIMING_RECURSION,           /* calls itself, directly or not */
+    TIMING_UNBOUNDED_CALLEE     /* calls a routine without a bound */
+} timing_status;
+
+/* one step of a critical path */
+typedef struct {
+    int address;                /* first instruction of the block or loop */
+    unsigned long iterations;   /* loop bound for a whole loop, 0 for a block */
+} timing_step;
+
+/* worst case of one routine: the program entry or a jsr target */
+typedef struct {
+    int entry;                  /* address of the first instruction */
+    timing_status status;
+    int status_address;         /* instruction the status refers to */
+    timing_cost worst;          /* valid when status is TIMING_BOUNDED */
+    timing_step *path;          /* path with the most cycles, entry to rts or stop */
+    int path_length;
+} routine_timing;
+
+/* result of analyze_timing */
+typedef struct {
+    routine_timing *routines;   /* by entry address, so the program entry is first */
+    int routine_count;
+} timing_report;
+
+/**
+ * default_cycle_model - one cycle per instruction, per word and per memory access
+ * @param model: model to fill
+ */
+void default_cycle_model(cycle_model *model);
+
+/**
+ * read_cycle_model - read a cycle model file over the default model
+ * @param filename: model file
+ * @param model: model to fill
+ * @return SUCCESS if every line is valid, FAILURE otherwise
+ */
+int read_cycle_model(const char *filename, cycle_model *model);
+
+/**
+ * read_loop_bounds - read the @loopbound annotations of a program's .am file
+ * @param filename: macro-expanded source the program was assembled from
+ * @param m: machine holding the decoded program
+ * @param bounds: indexed by address, set to the bound of each annotated instruction
+ * @param lines: indexed by address, set to the .am line of each annotation
+ * @return SUCCESS if the file was read and every annotation is valid, FAILURE otherwise
+ */
+int read_loop_bounds(const char *filename, const machine *m, unsigned long *bounds, int *lines);
+
+/**
+ * analyze_timing - find the worst-case instruction count and cycles of every routine
+ * code is split into basic blocks at jmp, bne, jsr, rts and stop; loops are found
+ * with a depth-first search and collapsed innermost first into one node costing
+ * (bound - 1) full iterations plus the longest way out, which leaves a longest-path
+ * problem on an acyclic graph; callees are analyzed before their callers
+ * @param m: machine holding the decoded program
+ * @param bounds: loop bounds by address, 0 where there is none
+ * @param model: cycle model
+ * @param report: output (free with free_timing_report)
+ * @param loops: indexed by address, set to YES at each backward jmp or bne and at its target,
+ *               the places a bound can apply
+ * @return SUCCESS, or FAILURE if allocation failed
+ */
+int analyze_timing(const machine *m, const unsigned long *bounds, const cycle_model *model, timing_report *report,
+                   unsigned char *loops);
+
+/**
+ * free_timing_report - release a report from analyze_timing
+ * @param report: report to free
+ */
+void free_timing_report(timing_report *report);
+
+#endif /* TIMING_H */
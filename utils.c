@@ -102,6 +102,7 @@ int is_valid_macro_name(const char *name) {
  * @return SUCCESS if valid label, FAILURE otherwise
  */
 int is_valid_label(const char* label, int print_errors) {
+    const char* name;
     int i;
     size_t len;
 
@@ -129,8 +130,12 @@ int is_valid_label(const char* label, int print_errors) {
         return FAILURE;
     }
 
+    /* a local label is the prefix followed by a label name */
+    name = label[0] == LOCAL_LABEL_PREFIX ? label + 1 : label;
+    len = strlen(name);
+
     /* label needs to start with a letter */
-    if (!isalpha(label[0])) {
+    if (!isalpha(name[0])) {
         if (print_errors) {
             fprintf(stderr, ERROR_INVALID_LABEL, label);
         }
@@ -138,8 +143,8 @@ int is_valid_label(const char* label, int print_errors) {
     }
 
     /* check if all other characters are letters or digits */
-    for (i = 1; label[i]; i++) {
-        if (!isalpha(label[i]) && !isdigit(label[i])) {
+    for (i = 1; name[i]; i++) {
+        if (!isalpha(name[i]) && !isdigit(name[i])) {
             if (print_errors) {
                 fprintf(stderr, ERROR_INVALID_LABEL, label);
             }
@@ -148,7 +153,7 @@ int is_valid_label(const char* label, int print_errors) {
     }
 
     /* label cannot be an opcode */
-    if (is_valid_opcode(label)) {
+    if (is_valid_opcode(name)) {
         if (print_errors) {
             fprintf(stderr, ERROR_INVALID_LABEL, label);
         }
@@ -157,8 +162,8 @@ int is_valid_label(const char* label, int print_errors) {
 
     /* label cannot be a register (r0-r7) */
             if (len == REGISTER_NAME_LENGTH &&
-            label[0] == REGISTER_PREFIX_CHAR) {
-        if (label[1] >= MIN_REGISTER_CHAR && label[1] <= MAX_REGISTER_CHAR) {
+            name[0] == REGISTER_PREFIX_CHAR) {
+        if (name[1] >= MIN_REGISTER_CHAR && name[1] <= MAX_REGISTER_CHAR) {
             if (print_errors) {
                 fprintf(stderr, ERROR_INVALID_LABEL, label);
             }
@@ -268,6 +273,25 @@ static int parse_matrix_access(const char *operand) {
     return result;
 }
 
+/**
+ * build_filename - joins a base name and an extension
+ * @base_filename: base name without extension
+ * @suffix: file extension
+ * returns new allocated string, or NULL if failed
+ */
+char *build_filename(const char *base_filename, const char *suffix) {
+    char *filename;
+
+    filename = malloc(strlen(base_filename) + strlen(suffix) + 1);
+    if (!filename) {
+        fprintf(stderr, MALLOC_FAILED);
+        return NULL;
+    }
+    strcpy(filename, base_filename);
+    strcat(filename, suffix);
+    return filename;
+}
+
 /**
  * free all allocated memory in a separate_line structure
  * @param s: pointer to separate_line structure we want to free
@@ -344,6 +368,78 @@ FILE *open_file_write_with_suffix(const char *base_filename, const char *suffix)
     return open_file_write(buffer);
 }
 
+/* read a whole file into one buffer */
+char *read_entire_file(const char *filename, size_t *length) {
+    FILE *f;
+    long size;
+    char *buffer;
+
+    f = fopen(filename, FILE_READ_BINARY_MODE);
+    if (!f) {
+        fprintf(stderr, ERROR_CANNOT_OPEN_FILE, filename);
+        return NULL;
+    }
+
+    /* find the size so the file is read with a single call */
+    if (fseek(f, 0L, SEEK_END) != 0 || (size = ftell(f)) < 0) {
+        fprintf(stderr, ERROR_CANNOT_READ_FILE, filename);
+        fclose(f);
+        return NULL;
+    }
+    rewind(f);
+
+    buffer = malloc((size_t)size + 1);
+    if (!buffer) {
+        fprintf(stderr, MALLOC_FAILED);
+        fclose(f);
+        return NULL;
+    }
+
+    if (fread(buffer, 1, (size_t)size, f) != (size_t)size) {
+        fprintf(stderr, ERROR_CANNOT_READ_FILE, filename);
+        free(buffer);
+        fclose(f);
+        return NULL;
+    }
+    fclose(f);
+
+    buffer[size] = NULL_CHAR;
+    if (length) *length = (size_t)size;
+    return buffer;
+}
+
+/* make room for one more array element */
+int grow_array(void **array, int *capacity, int count, size_t size, int initial) {
+    void *grown;
+    int new_capacity;
+
+    if (count < *capacity) return SUCCESS;
+    new_capacity = *capacity > 0 ? *capacity * 2 : initial;
+    grown = realloc(*array, (size_t)new_capacity * size);
+    if (!grown) {
+        fprintf(stderr, MALLOC_FAILED);
+        return FAILURE;
+    }
+    *array = grown;
+    *capacity = new_capacity;
+    return SUCCESS;
+}
+
+/**
+ * hash_string - FNV-1a hash of a string
+ * @param text: string to hash
+ * @return 32-bit hash
+ */
+unsigned long hash_string(const char *text) {
+    unsigned long hash = FNV_OFFSET_BASIS;
+
+    while (*text) {
+        hash ^= (unsigned char)*text++;
+        hash = (hash * FNV_PRIME) & HASH_MASK_32;
+    }
+    return hash;
+}
+
 /* extract base filename without suffix */
 char *extract_base_filename(const char *filename) {
     char *base;
@@ -451,6 +547,7 @@ int is_valid_number(const char *str) {
 int get_operand_mode(const char *operand) {
     int i;
     const char *num_part;
+    const char *name;
     size_t len;
     int is_label_like;
 
@@ -522,12 +619,14 @@ int get_operand_mode(const char *operand) {
 
     /* check if this is direct addressing (simple label) */
     /* direct addressing: any string that starts with letter contains only letters and digits*/
-    if (strlen(operand) > 0 && isalpha(operand[0])) {
+    /* (after the prefix of a local label) */
+    name = operand[0] == LOCAL_LABEL_PREFIX ? operand + 1 : operand;
+    if (strlen(name) > 0 && isalpha(name[0])) {
         is_label_like = 1;
 
         /* check if it is like a label */
-        for (i = 0; operand[i]; i++) {
-            if (!isalpha(operand[i]) && !isdigit(operand[i])) {
+        for (i = 0; name[i]; i++) {
+            if (!isalpha(name[i]) && !isdigit(name[i])) {
                 /* it's not a label */
                 is_label_like = 0;
                 break;
@@ -543,4 +642,49 @@ int get_operand_mode(const char *operand) {
     /* invalid */
     fprintf(stderr, ERROR_INVALID_OPERAND, operand);
     return FAILURE;
-}
\ No newline at end of file
+}
+
+#ifdef COUNT_ALLOCATIONS
+/* the counting wrappers call the real allocator */
+#undef malloc
+#undef calloc
+#undef realloc
+
+unsigned long allocation_count = 0;
+unsigned long allocation_bytes = 0;
+
+/**
+ * counted_malloc - malloc that updates the allocation counters
+ * @param size: bytes to allocate
+ * @return the allocated block, or NULL
+ */
+void* counted_malloc(size_t size) {
+    allocation_count++;
+    allocation_bytes += (unsigned long)size;
+    return malloc(size);
+}
+
+/**
+ * counted_calloc - calloc that updates the allocation counters
+ * @param count: number of elements
+ * @param size: size of one element
+ * @return the zeroed block, or NULL
+ */
+void* counted_calloc(size_t count, size_t size) {
+    allocation_count++;
+    allocation_bytes += (unsigned long)(count * size);
+    return calloc(count, size);
+}
+
+/**
+ * counted_realloc - realloc that updates the allocation counters
+ * @param pointer: block to resize, or NULL
+ * @param size: new size in bytes
+ * @return the resized block, or NULL
+ */
+void* counted_realloc(void* pointer, size_t size) {
+    allocation_count++;
+    allocation_bytes += (unsigned long)size;
+    return realloc(pointer, size);
+}
+#endif /* COUNT_ALLOCATIONS */
@@ -15,6 +15,7 @@
 #define DIRECTIVE_EXTERN ".extern"
 #define DIRECTIVE_ENTRY ".entry"
 #define MAX_LABEL_LENGTH 31
+#define LOCAL_LABEL_PREFIX '.'          /* ".name" is local to the last global label */
 #define MAX_MACRO_BODY 1000
 #define MAX_OPERANDS 1000
 
@@ -69,6 +70,11 @@
 
 /* numeric constants */
 #define BASE_10 10
+
+/* FNV-1a parameters (32-bit) for hash_string */
+#define FNV_OFFSET_BASIS 2166136261UL
+#define FNV_PRIME 16777619UL
+#define HASH_MASK_32 0xFFFFFFFFUL
 #define REGISTER_NAME_LENGTH 2
 #define MATRIX_DIMENSION_STRING_LENGTH 10
 #define MIN_REGISTER_NUMBER 0
@@ -129,6 +135,8 @@
 /* file operation modes */
 #define FILE_READ_MODE "r"
 #define FILE_WRITE_MODE "w"
+#define FILE_READ_BINARY_MODE "rb"
+#define FILE_WRITE_BINARY_MODE "wb"
 
 /* file extension */
 #define SOURCE_EXT ".as"
@@ -136,6 +144,7 @@
 #define OBJECT_EXT ".ob"
 #define ENTRIES_EXT ".ent"
 #define EXTERNALS_EXT ".ext"
+#define LINE_MAP_EXT ".lin"
 
 /* matrix processing */
 #define MAX_OPERAND_LENGTH (MAX_LINE_LENGTH - 1)
@@ -149,6 +158,7 @@
 #define MALLOC_FAILED "Error: memory allocation failed\n"
 #define ERROR_CANNOT_OPEN_FILE "Error: cannot open file '%s'\n"
 #define ERROR_CANNOT_OPEN_FILE_WRITE "Error: cannot open file '%s' for writing\n"
+#define ERROR_CANNOT_READ_FILE "Error: cannot read file '%s'\n"
 #define ERROR_INVALID_OPERAND "Error: invalid operand '%s'\n"
 #define ERROR_INVALID_REGISTER "Error: invalid register '%s' (must be r0-r7)\n"
 #define ERROR_INVALID_IMMEDIATE "Error: invalid immediate value '%s'\n"
@@ -188,6 +198,13 @@
 
 
 
+/* bitmaps: one bit per entry, packed into bytes */
+#define BITS_PER_BYTE 8
+#define BITMAP_BYTES(bits) (((bits) + BITS_PER_BYTE - 1) / BITS_PER_BYTE)
+#define BITMAP_TEST(map, bit) (((map)[(bit) / BITS_PER_BYTE] >> ((bit) % BITS_PER_BYTE)) & 1)
+#define BITMAP_SET(map, bit) ((map)[(bit) / BITS_PER_BYTE] |= (unsigned char)(1 << ((bit) % BITS_PER_BYTE)))
+#define BITMAP_CLEAR(map, bit) ((map)[(bit) / BITS_PER_BYTE] &= (unsigned char)~(1 << ((bit) % BITS_PER_BYTE)))
+
 /* addressing modes enumeration */
 typedef enum {
     MODE_IMMEDIATE = 0,    /* immediate - #number */
@@ -206,9 +223,11 @@ typedef enum {
 /* structure representing a parsed assembly line */
 typedef struct {
     char *label;                          /* optional label */
-    char *operands[MAX_OPERANDS];         /* array of operand strings */
     char *command;                        /* instruction or directive */
     int how_many_operands;                /* number of operands */
+    int shared;                           /* YES if owned by the line memo (see line_memo.h) */
+    char *operands[MAX_OPERANDS];         /* array of operand strings; last, so the line memo
+                                             can allocate only the ones a line uses */
 } separate_line;
 
 /* function declarations */
@@ -277,6 +296,33 @@ FILE* open_file_write(const char* filename);
  */
 FILE* open_file_write_with_suffix(const char* base_filename, const char* suffix);
 
+/**
+ * read_entire_file - loads a whole file into one allocated buffer
+ * @filename: file to read
+ * @length: output parameter for the number of bytes read
+ * returns NUL-terminated buffer (caller frees), or NULL if failed
+ */
+char* read_entire_file(const char* filename, size_t* length);
+
+/**
+ * grow_array - makes room for one more element, doubling the allocation
+ * @array: pointer to the array pointer
+ * @capacity: allocated elements, updated
+ * @count: elements in use
+ * @size: size of one element
+ * @initial: capacity of the first allocation
+ * returns SUCCESS if there is room, FAILURE if out of memory
+ */
+int grow_array(void** array, int* capacity, int count, size_t size, int initial);
+
+/**
+ * build_filename - joins a base name and an extension
+ * @base_filename: base name without extension
+ * @suffix: file extension
+ * returns new allocated string, or NULL if failed
+ */
+char* build_filename(const char* base_filename, const char* suffix);
+
 /**
  * extract_base_filename - removes extension from filename
  * @filename: original filename with extension
@@ -291,6 +337,13 @@ char* extract_base_filename(const char* filename);
  */
 int is_valid_number(const char* str);
 
+/**
+ * hash_string - FNV-1a hash of a string
+ * @text: string to hash
+ * returns 32-bit hash
+ */
+unsigned long hash_string(const char* text);
+
 /**
  * number_to_base4_letters - converts number to base-4 letter encoding
  * @value: integer value to convert
@@ -305,4 +358,41 @@ char* number_to_base4_letters(int value);
  */
 char* number_to_base4_code(int value);
 
+/* allocation counting for perffuzz, compiled in with -DCOUNT_ALLOCATIONS */
+#ifdef COUNT_ALLOCATIONS
+#include <stdlib.h>
+
+/* calls to malloc, calloc and realloc since the counters were last cleared */
+extern unsigned long allocation_count;
+/* bytes requested by those calls */
+extern unsigned long allocation_bytes;
+
+/**
+ * counted_malloc - malloc that updates the allocation counters
+ * @size: bytes to allocate
+ * returns the allocated block, or NULL
+ */
+void* counted_malloc(size_t size);
+
+/**
+ * counted_calloc - calloc that updates the allocation counters
+ * @count: number of elements
+ * @size: size of one element
+ * returns the zeroed block, or NULL
+ */
+void* counted_calloc(size_t count, size_t size);
+
+/**
+ * counted_realloc - realloc that updates the allocation counters
+ * @pointer: block to resize, or NULL
+ * @size: new size in bytes
+ * returns the resized block, or NULL
+ */
+void* counted_realloc(void* pointer, size_t size);
+
+#define malloc(size) counted_malloc(size)
+#define calloc(count, size) counted_calloc(count, size)
+#define realloc(pointer, size) counted_realloc(pointer, size)
+#endif /* COUNT_ALLOCATIONS */
+
 #endif /* UTILS_H */
\ No newline at end of file
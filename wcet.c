@@ -0,0 +1,337 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils.h"
+#include "obj_reader.h"
+#include "machine.h"
+#include "timing.h"
+#include "labelTable.h"
+#include "first_pass.h"
+
+/* command line options */
+#define OPTION_PREFIX '-'
+#define OPTION_MODEL "-m"
+#define OPTION_BUDGET "-b"
+
+/* error messages */
+#define ERROR_UNKNOWN_OPTION "Error: Unknown option '%s'\n"
+#define ERROR_MISSING_OPTION_VALUE "Error: Option '%s' requires a value\n"
+#define ERROR_BAD_BUDGET "Error: '%s' is not a cycle count\n"
+#define ERROR_NO_PROGRAM "Error: No program specified\n\n"
+#define ERROR_EXTRA_ARGUMENT "Error: Unexpected argument '%s'\n"
+#define ERROR_OVER_BUDGET "Error: worst case of %lu cycles exceeds the budget of %lu\n"
+#define ERROR_NO_BOUND "Error: the program has no worst-case bound\n"
+#define WARNING_NO_SOURCE "Warning: cannot read '%s', loops have no bounds and routines no names\n"
+#define WARNING_LOOPBOUND_UNUSED "Warning: %s (line %d): @loopbound is not on a loop header or backward branch\n"
+
+/* report text */
+#define MSG_REPORT_HEADER "Worst-case timing of %s, default cycle model\n\n"
+#define MSG_REPORT_HEADER_MODEL "Worst-case timing of %s, cycle model '%s'\n\n"
+#define MSG_REPORT_COLUMNS "  address  instructions        cycles  routine\n"
+#define MSG_REPORT_ROW "  %7d %13lu %13lu  "
+#define MSG_REPORT_UNBOUNDED_ROW "  %7d %13s %13s  "
+#define MSG_UNBOUNDED "-"
+#define MSG_PATHS_HEADER "\nCritical paths:\n\n"
+#define MSG_PATH_ROUTINE "  "
+#define MSG_PATH_SEPARATOR " -> "
+#define MSG_PATH_LOOP " (loop x%lu)"
+#define MSG_STATUS_PREFIX ": unbounded, "
+#define MSG_NO_LABEL "(no label)"
+#define FORMAT_ADDRESS "%d"
+#define FORMAT_LABEL_OFFSET "%s+%d"
+
+/* usage messages */
+#define MSG_USAGE_FORMAT "Usage: %s [-m model] [-b cycles] program\n"
+#define MSG_DESCRIPTION "\nReports the worst-case instruction count and cycles of every routine in\n" \
+    "program.ob, the program entry and each jsr target, without running it.\n" \
+    "Loops need a '; @loopbound N' line in the source before their first\n" \
+    "instruction or their closing branch; program.am supplies them and the labels.\n"
+#define MSG_OPTIONS "\nOptions:\n"
+#define MSG_OPTION_MODEL "  -m FILE   cycle model: 'name cycles' lines, name is a mnemonic, word or memory\n"
+#define MSG_OPTION_BUDGET "  -b N      exit with status 1 unless the program entry is bounded by N cycles\n"
+
+/* why a routine has no bound, by timing_status */
+static const char *status_text[] = {
+    "bounded",
+    "loop without @loopbound at ",
+    "loop entered other than through its header at ",
+    "loop never reaches rts or stop at ",
+    "jump through a matrix operand at ",
+    "jump to an external label at ",
+    "jump to a non-instruction at ",
+    "runs past the last instruction at ",
+    "recursive call at ",
+    "call to an unbounded routine at "
+};
+
+/* analyzer settings selected on the command line */
+typedef struct {
+    const char *model_name;     /* cycle model file, or NULL for the default */
+    const char *program;        /* program base name (or .ob path) */
+    unsigned long budget;       /* cycle budget of the program entry */
+    int has_budget;             /* YES when -b was given */
+} wcet_options;
+
+/**
+ * print usage information
+ * @param program_name: name of the executable program
+ */
+static void print_usage(const char *program_name) {
+    printf(MSG_USAGE_FORMAT, program_name);
+    printf(MSG_DESCRIPTION);
+    printf(MSG_OPTIONS);
+    printf(MSG_OPTION_MODEL);
+    printf(MSG_OPTION_BUDGET);
+}
+
+/**
+ * parse_arguments - read options and the program name
+ * @param argc: number of command line arguments
+ * @param argv: array of command line argument strings
+ * @param options: settings to fill
+ * @return SUCCESS if the command line is valid, FAILURE otherwise
+ */
+static int parse_arguments(int argc, char *argv[], wcet_options *options) {
+    char *end;
+    int i;
+
+    options->model_name = NULL;
+    options->program = NULL;
+    options->budget = 0;
+    options->has_budget = NO;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], OPTION_MODEL) == 0 || strcmp(argv[i], OPTION_BUDGET) == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, ERROR_MISSING_OPTION_VALUE, argv[i]);
+                return FAILURE;
+            }
+            if (strcmp(argv[i], OPTION_MODEL) == 0) {
+                options->model_name = argv[++i];
+                continue;
+            }
+            i++;
+            options->budget = strtoul(argv[i], &end, BASE_10);
+            if (end == argv[i] || *end != NULL_CHAR || argv[i][0] == OPTION_PREFIX) {
+                fprintf(stderr, ERROR_BAD_BUDGET, argv[i]);
+                return FAILURE;
+            }
+            options->has_budget = YES;
+        } else if (argv[i][0] == OPTION_PREFIX) {
+            fprintf(stderr, ERROR_UNKNOWN_OPTION, argv[i]);
+            return FAILURE;
+        } else if (options->program) {
+            fprintf(stderr, ERROR_EXTRA_ARGUMENT, argv[i]);
+            return FAILURE;
+        } else {
+            options->program = argv[i];
+        }
+    }
+
+    if (!options->program) {
+        fprintf(stderr, ERROR_NO_PROGRAM);
+        return FAILURE;
+    }
+    return SUCCESS;
+}
+
+/**
+ * program_base_name - accept either "prog" or "prog.ob"
+ * @param program: program argument
+ * @return new allocated base name, or NULL if failed
+ */
+static char *program_base_name(const char *program) {
+    size_t len = strlen(program);
+    size_t ext_len = strlen(OBJECT_EXT);
+
+    if (len > ext_len && strcmp(program + len - ext_len, OBJECT_EXT) == 0) {
+        return extract_base_filename(program);
+    }
+    return build_filename(program, "");
+}
+
+/**
+ * print_location - print an address as the nearest code label at or below it
+ * @param out: report stream
+ * @param labels: labels from the first pass, or NULL
+ * @param address: instruction address
+ */
+static void print_location(FILE *out, const label_table *labels, int address) {
+    const label_node *node;
+    const label_node *best = NULL;
+
+    /* .entry turns a code label into LABEL_ENTRY, so both name routines */
+    for (node = labels ? labels->head : NULL; node; node = node->next) {
+        if (!node->is_defined || node->address > address) continue;
+        if (node->type != LABEL_CODE && node->type != LABEL_ENTRY) continue;
+        if (!best || node->address > best->address) best = node;
+    }
+
+    if (!labels) {
+        fprintf(out, FORMAT_ADDRESS, address);
+    } else if (!best) {
+        fprintf(out, MSG_NO_LABEL);
+    } else if (best->address == address) {
+        fprintf(out, "%s", best->name);
+    } else {
+        fprintf(out, FORMAT_LABEL_OFFSET, best->name, address - best->address);
+    }
+}
+
+/**
+ * write_report - print each routine's worst case, then its critical path
+ * @param out: report stream
+ * @param program: program base name
+ * @param model_name: cycle model file, or NULL for the default
+ * @param report: analysis result
+ * @param labels: labels from the first pass, or NULL
+ */
+static void write_report(FILE *out, const char *program, const char *model_name, const timing_report *report,
+                         const label_table *labels) {
+    const routine_timing *routine;
+    int i, step;
+
+    if (model_name) {
+        fprintf(out, MSG_REPORT_HEADER_MODEL, program, model_name);
+    } else {
+        fprintf(out, MSG_REPORT_HEADER, program);
+    }
+    fprintf(out, MSG_REPORT_COLUMNS);
+
+    for (i = 0; i < report->routine_count; i++) {
+        routine = &report->routines[i];
+        if (routine->status == TIMING_BOUNDED) {
+            fprintf(out, MSG_REPORT_ROW, routine->entry, routine->worst.instructions, routine->worst.cycles);
+        } else {
+            fprintf(out, MSG_REPORT_UNBOUNDED_ROW, routine->entry, MSG_UNBOUNDED, MSG_UNBOUNDED);
+        }
+        print_location(out, labels, routine->entry);
+        fputc(NEWLINE_CHAR, out);
+    }
+
+    fprintf(out, MSG_PATHS_HEADER);
+    for (i = 0; i < report->routine_count; i++) {
+        routine = &report->routines[i];
+        fprintf(out, MSG_PATH_ROUTINE);
+        print_location(out, labels, routine->entry);
+        if (routine->status != TIMING_BOUNDED) {
+            fprintf(out, MSG_STATUS_PREFIX);
+            fprintf(out, "%s", status_text[routine->status]);
+            print_location(out, labels, routine->status_address);
+            fputc(NEWLINE_CHAR, out);
+            continue;
+        }
+        fputc(COLON, out);
+        fputc(SPACE_CHAR, out);
+        for (step = 0; step < routine->path_length; step++) {
+            if (step > 0) fprintf(out, MSG_PATH_SEPARATOR);
+            print_location(out, labels, routine->path[step].address);
+            if (routine->path[step].iterations > 0) fprintf(out, MSG_PATH_LOOP, routine->path[step].iterations);
+        }
+        fputc(NEWLINE_CHAR, out);
+    }
+}
+
+/**
+ * analyze_program - load a program, analyze it and print the report
+ * @param options: command line settings
+ * @param base: program base name
+ * @return SUCCESS if the report was written and the budget (if any) holds, FAILURE otherwise
+ */
+static int analyze_program(const wcet_options *options, const char *base) {
+    static unsigned long bounds[MACHINE_MEMORY_SIZE];
+    static int bound_lines[MACHINE_MEMORY_SIZE];
+    static unsigned char loops[MACHINE_MEMORY_SIZE];
+    object_module module;
+    cycle_model model;
+    timing_report report;
+    label_table labels;
+    machine *m;
+    char *filename;
+    int have_labels = NO;
+    int source_ok = SUCCESS;
+    int result = FAILURE;
+    int ic, dc, address;
+
+    module.words = NULL;
+    init_label_table(&labels);
+    memset(bounds, 0, sizeof(bounds));
+    memset(bound_lines, 0, sizeof(bound_lines));
+    memset(loops, 0, sizeof(loops));
+
+    if (options->model_name) {
+        if (read_cycle_model(options->model_name, &model) == FAILURE) return FAILURE;
+    } else {
+        default_cycle_model(&model);
+    }
+
+    m = malloc(sizeof(machine));
+    filename = build_filename(base, OBJECT_EXT);
+    if (!m) fprintf(stderr, MALLOC_FAILED);
+    if (!m || !filename || load_object_file(filename, &module) == FAILURE ||
+        init_machine(m, &module, stdin, stdout) == FAILURE) {
+        free(filename);
+        free_object_module(&module);
+        free(m);
+        return FAILURE;
+    }
+    free(filename);
+
+    /* labels and loop bounds come from the source, as for the simulator's profile */
+    filename = build_filename(base, MACRO_EXT);
+    if (filename && first_pass_on_table(filename, &labels, &ic, &dc) == SUCCESS) {
+        have_labels = YES;
+        source_ok = read_loop_bounds(filename, m, bounds, bound_lines);
+    } else if (filename) {
+        fprintf(stderr, WARNING_NO_SOURCE, filename);
+    }
+
+    if (filename && source_ok == SUCCESS && analyze_timing(m, bounds, &model, &report, loops) == SUCCESS) {
+        for (address = 0; address < MACHINE_MEMORY_SIZE; address++) {
+            if (bound_lines[address] > 0 && !loops[address]) {
+                fprintf(stderr, WARNING_LOOPBOUND_UNUSED, filename, bound_lines[address]);
+            }
+        }
+        write_report(stdout, base, options->model_name, &report, have_labels ? &labels : NULL);
+
+        result = SUCCESS;
+        if (options->has_budget && (report.routine_count == 0 || report.routines[0].status != TIMING_BOUNDED)) {
+            fprintf(stderr, ERROR_NO_BOUND);
+            result = FAILURE;
+        } else if (options->has_budget && report.routines[0].worst.cycles > options->budget) {
+            fprintf(stderr, ERROR_OVER_BUDGET, report.routines[0].worst.cycles, options->budget);
+            result = FAILURE;
+        }
+        free_timing_report(&report);
+    }
+
+    free(filename);
+    free_label_table(&labels);
+    free_object_module(&module);
+    free(m);
+    return result;
+}
+
+/**
+ * main
+ * @param argc: number of command line arguments
+ * @param argv: array of command line argument strings
+ * @return 0 if the report was written and the budget holds, EXIT_FAILURE_CODE otherwise
+ */
+int main(int argc, char *argv[]) {
+    wcet_options options;
+    char *base;
+    int result;
+
+    if (parse_arguments(argc, argv, &options) == FAILURE) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE_CODE;
+    }
+
+    base = program_base_name(options.program);
+    if (!base) return EXIT_FAILURE_CODE;
+
+    result = analyze_program(&options, base);
+    free(base);
+    return result == SUCCESS ? 0 : EXIT_FAILURE_CODE;
+}